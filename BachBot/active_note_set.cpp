@@ -0,0 +1,102 @@
+/**
+ * @file active_note_set.cpp
+ * @brief Tracking of sounding organ keys
+ * @copyright
+ * 2022 Andrew Buettner (ABi)
+ *
+ * @section LICENSE
+ *
+ * BachBot - A hymn Midi player for Schlicker organs
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+//  system includes
+// -none-
+
+//  module includes
+// -none-
+
+//  local includes
+#include "active_note_set.h"  //  local include
+
+
+namespace bach_bot {
+
+void ActiveNoteSet::update(const uint8_t *const midi_message,
+                           const size_t size)
+{
+    if (size < MIDI_MESSAGE_SIZE) {
+        return;
+    }
+
+    const auto command = (midi_message[0] >> 4U);
+    const auto channel = (midi_message[0] & 0x0FU);
+    if ((channel < SyndyneKeyboards::MANUAL1_GREAT) ||
+        (channel > SyndyneKeyboards::PETAL)) {
+        return;
+    }
+
+    auto &keyboard = m_active[size_t(channel -
+                                     SyndyneKeyboards::MANUAL1_GREAT)];
+    const auto note = size_t(midi_message[1] & 0x7FU);
+    if ((MidiCommands::NOTE_ON == command) && (midi_message[2] > 0U)) {
+        keyboard.set(note);
+    } else if ((MidiCommands::NOTE_ON == command) ||
+               (MidiCommands::NOTE_OFF == command)) {
+        keyboard.reset(note);
+    }
+}
+
+
+void ActiveNoteSet::release_all(std::vector<NoteMessage> &messages)
+{
+    for (size_t index = 0U; index < m_active.size(); ++index) {
+        auto &keyboard = m_active[index];
+        if (keyboard.none()) {
+            continue;
+        }
+
+        const auto command = make_midi_command_byte(
+            uint8_t(index + SyndyneKeyboards::MANUAL1_GREAT),
+            MidiCommands::NOTE_OFF);
+        for (size_t note = 0U; note < keyboard.size(); ++note) {
+            if (keyboard.test(note)) {
+                messages.push_back({command, uint8_t(note), 0U});
+            }
+        }
+        keyboard.reset();
+    }
+}
+
+
+bool ActiveNoteSet::is_active(const SyndyneKeyboards keyboard,
+                              const uint8_t note) const
+{
+    return m_active[size_t(keyboard - SyndyneKeyboards::MANUAL1_GREAT)].test(
+        note & 0x7FU);
+}
+
+
+size_t ActiveNoteSet::count() const
+{
+    size_t active = 0U;
+    for (const auto &keyboard: m_active) {
+        active += keyboard.count();
+    }
+    return active;
+}
+
+}  //  end bach_bot
@@ -0,0 +1,86 @@
+/**
+ * @file active_note_set.h
+ * @brief Tracking of sounding organ keys
+ * @copyright
+ * 2022 Andrew Buettner (ABi)
+ *
+ * @section LICENSE
+ *
+ * BachBot - A hymn Midi player for Schlicker organs
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @section DESCRIPTION
+ * The organ has no notion of a note timing out; a key left on (stopping in
+ * the middle of a song, a seek, etc) ciphers until it is explicitly released.
+ * Rather than sweeping every key of every keyboard, the player records each
+ * key as it is sent and releases just those that are down.
+ */
+
+#pragma once
+
+//  system includes
+#include <array>  //  std::array
+#include <bitset>  //  std::bitset
+#include <cstdint>  //  uint8_t
+#include <vector>  //  std::vector
+
+//  module includes
+// -none-
+
+//  local includes
+#include "common_defs.h"  //  SyndyneKeyboards, MIDI_MESSAGE_SIZE
+
+
+namespace bach_bot {
+
+/**
+ * @brief Set of keys currently down on each keyboard.
+ */
+class ActiveNoteSet
+{
+public:
+    using NoteMessage = std::array<uint8_t, MIDI_MESSAGE_SIZE>;
+
+    /**
+     * @brief Account for an outgoing message.
+     * @param midi_message message bytes
+     * @param size number of bytes in `midi_message`
+     * @note Anything other than a note event on a keyboard channel is ignored.
+     */
+    void update(const uint8_t *const midi_message, const size_t size);
+
+    /**
+     * @brief Build a release for every key that is down and clear the set.
+     * @param messages[out] note-off messages are appended
+     */
+    void release_all(std::vector<NoteMessage> &messages);
+
+    /**
+     * @brief Test if a key is down
+     * @param keyboard keyboard
+     * @param note MIDI note
+     */
+    bool is_active(const SyndyneKeyboards keyboard, const uint8_t note) const;
+
+    /**
+     * @brief Get the number of keys down over all keyboards
+     */
+    size_t count() const;
+
+private:
+    std::array<std::bitset<128U>, NUM_SYNDYNE_KEYBOARDS> m_active;
+};
+
+}  //  end bach_bot
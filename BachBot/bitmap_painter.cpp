@@ -27,6 +27,7 @@
 
 //  local includes
 #include "bitmap_painter.h"  //  local include
+#include "startup_profiler.h"  //  StartupProfiler
 
 
 namespace bach_bot {
@@ -34,10 +35,23 @@ namespace ui {
 
 BitmapPainter::BitmapPainter(const wxString &filename) :
     wxEvtHandler(),
+    m_pending_image(),
     m_bitmap()
 {
-    const auto loaded = load_image(m_bitmap, wxBITMAP_TYPE_PNG, filename);
-    assert(loaded);
+#ifndef __linux__
+    //  wxImage (unlike wxBitmap) may be used outside of the UI thread.
+    m_pending_image = std::async(std::launch::async, [filename]() {
+        wxStopWatch decode_time;
+        DecodedImage decoded{wxImage(), 0};
+        const auto loaded = load_image(decoded.image, wxBITMAP_TYPE_PNG,
+                                       filename);
+        assert(loaded);
+        decoded.decode_us = decode_time.TimeInMicro();
+        return decoded;
+    });
+#else
+    static_cast<void>(filename);
+#endif // __linux__
 }
 
 
@@ -47,6 +61,7 @@ bool BitmapPainter::ProcessEvent(wxEvent &e)
     if (e.GetEventType() == wxEVT_ERASE_BACKGROUND) {
         auto &erase_event = dynamic_cast<wxEraseEvent&>(e);
         auto *const dc = erase_event.GetDC();
+        finish_loading();
         wxMemoryDC mdc(m_bitmap);
         dc->StretchBlit(wxPoint(0, 0), dc->GetSize(),
                         &mdc, wxPoint(0, 0), mdc.GetSize(), 
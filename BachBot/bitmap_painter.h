@@ -33,7 +33,9 @@
 #pragma once
 
 //  system includes
+#include <future>  //  std::future
 #include <wx/wx.h>  //  wxEvtHandler, wxBitmap, etc
+#include <wx/image.h>  //  wxImage
 #include <wx/stdpaths.h>  //  wxStandardPaths::Get
 #include <wx/filename.h>  //  wxFileName
 
@@ -53,7 +55,9 @@ namespace ui {
  *     auto background = new BitmapPainter(wxT("test.jpg"));
  *     PushEventHandler(background);
  * @endcode
- * The file is assumed to be in the same directory as the executable.
+ * The file is assumed to be in the same directory as the executable.  It is
+ * decoded in the background and only converted to a bitmap on the first
+ * erase event so that it doesn't hold up application start-up.
  */
 class BitmapPainter : public wxEvtHandler
 {
@@ -63,6 +67,22 @@ public:
     virtual bool ProcessEvent(wxEvent &e) override;
 
 private:
+    /**
+     * @brief Result of the background image decode
+     */
+    struct DecodedImage
+    {
+        wxImage image;  ///< decoded image
+        wxLongLong decode_us;  ///< time taken to load and decode
+    };
+
+    /**
+     * @brief Wait for the background decode (if still pending) and convert
+     *        the image into the bitmap.
+     */
+    void finish_loading();
+
+    std::future<DecodedImage> m_pending_image;
     wxBitmap m_bitmap;
 };
 
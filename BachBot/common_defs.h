@@ -83,6 +83,15 @@ constexpr const auto DEFAULT_NO_TEMPO = 120;
  */
 constexpr const auto MIDI_NOTES_IN_OCTAVE = 12;
 
+/** Lowest key of every keyboard (C two octaves below middle-C) */
+constexpr const auto LOWEST_KEYBOARD_NOTE = 36;
+
+/** Highest key of the manuals (C three octaves above middle-C) */
+constexpr const auto HIGHEST_MANUAL_NOTE = 96;
+
+/** Highest key of the pedal board (G above middle-C) */
+constexpr const auto HIGHEST_PETAL_NOTE = 67;
+
 /**
  * @brief Simple definition of a complete event tracking table.
  * @tparam T Type associated with each keyboard-note combination.
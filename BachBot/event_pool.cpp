@@ -0,0 +1,66 @@
+/**
+ * @file event_pool.cpp
+ * @brief Per-song storage of organ MIDI events
+ * @copyright
+ * 2022 Andrew Buettner (ABi)
+ *
+ * @section LICENSE
+ *
+ * BachBot - A hymn Midi player for Schlicker organs
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+//  system includes
+// -none-
+
+//  module includes
+// -none-
+
+//  local includes
+#include "event_pool.h"  //  local include
+
+
+namespace bach_bot {
+
+void EventPool::link(const EventIndex first, const EventIndex second)
+{
+    m_events[first].m_partner = second;
+    m_events[second].m_partner = first;
+}
+
+
+EventPool EventPool::reorder(const std::vector<EventIndex> &order)
+{
+    std::vector<EventIndex> new_index(m_events.size(), NO_EVENT_INDEX);
+    for (size_t i = 0U; i < order.size(); ++i) {
+        new_index[order[i]] = EventIndex(i);
+    }
+
+    EventPool pool;
+    pool.reserve(order.size());
+    for (const auto index: order) {
+        pool.m_events.emplace_back(std::move(m_events[index]));
+        auto &partner = pool.m_events.back().m_partner;
+        if (NO_EVENT_INDEX != partner) {
+            partner = new_index[partner];
+        }
+    }
+
+    m_events.clear();
+    return pool;
+}
+
+}  //  end bach_bot
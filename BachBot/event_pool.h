@@ -0,0 +1,171 @@
+/**
+ * @file event_pool.h
+ * @brief Per-song storage of organ MIDI events
+ * @copyright
+ * 2022 Andrew Buettner (ABi)
+ *
+ * @section LICENSE
+ *
+ * BachBot - A hymn Midi player for Schlicker organs
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @section DESCRIPTION
+ * A song is built from a few thousand small events that are created, paired
+ * (note-on with note-off), re-timed and sorted during import.  Rather than
+ * allocating each event separately, all events of a song live in a single
+ * contiguous pool and refer to each other by 32-bit index.  Once the import
+ * is complete the pool is rebuilt in play order, dropping anything that
+ * didn't make it into the song.
+ */
+
+#pragma once
+
+//  system includes
+#include <utility>  //  std::forward
+#include <vector>  //  std::vector
+
+//  module includes
+// -none-
+
+//  local includes
+#include "organ_midi_event.h"  //  OrganMidiEvent, EventIndex
+
+
+namespace bach_bot {
+
+/**
+ * @brief Contiguous storage of the events of a single song.
+ * @note Indexes are only stable while events are added; references to events
+ *       are invalidated by `emplace`.
+ */
+class EventPool
+{
+public:
+    using iterator = std::vector<OrganMidiEvent>::iterator;
+    using const_iterator = std::vector<OrganMidiEvent>::const_iterator;
+
+    /**
+     * @brief Construct a new event at the end of the pool.
+     * @param args `OrganMidiEvent` constructor arguments (must not refer to
+     *        an event in this pool)
+     * @returns index of the new event
+     */
+    template <typename... Args>
+    EventIndex emplace(Args &&...args)
+    {
+        m_events.emplace_back(std::forward<Args>(args)...);
+        return EventIndex(m_events.size() - 1U);
+    }
+
+    /**
+     * @brief Link two events as a pair (usually note-on/note-off).
+     * @param first first event of the pair
+     * @param second second event of the pair
+     */
+    void link(const EventIndex first, const EventIndex second);
+
+    /**
+     * @brief Rebuild the pool containing only the given events, in order.
+     * @param order events to keep, each at most once
+     * @returns new pool; event `i` is `order[i]` of this pool (partners are
+     *          re-indexed, or unlinked if not kept)
+     * @note The events are moved out of this pool, which is left empty.
+     */
+    EventPool reorder(const std::vector<EventIndex> &order);
+
+    OrganMidiEvent &operator[](const EventIndex index)
+    {
+        return m_events[index];
+    }
+
+    const OrganMidiEvent &operator[](const EventIndex index) const
+    {
+        return m_events[index];
+    }
+
+    OrganMidiEvent &front()
+    {
+        return m_events.front();
+    }
+
+    const OrganMidiEvent &front() const
+    {
+        return m_events.front();
+    }
+
+    OrganMidiEvent &back()
+    {
+        return m_events.back();
+    }
+
+    const OrganMidiEvent &back() const
+    {
+        return m_events.back();
+    }
+
+    iterator begin()
+    {
+        return m_events.begin();
+    }
+
+    iterator end()
+    {
+        return m_events.end();
+    }
+
+    const_iterator begin() const
+    {
+        return m_events.begin();
+    }
+
+    const_iterator end() const
+    {
+        return m_events.end();
+    }
+
+    size_t size() const
+    {
+        return m_events.size();
+    }
+
+    bool empty() const
+    {
+        return m_events.empty();
+    }
+
+    void reserve(const size_t count)
+    {
+        m_events.reserve(count);
+    }
+
+    void clear()
+    {
+        m_events.clear();
+    }
+
+    /**
+     * @brief Get the memory held by the pool (including spare capacity)
+     * @returns size (bytes)
+     */
+    size_t get_memory_bytes() const
+    {
+        return m_events.capacity() * sizeof(OrganMidiEvent);
+    }
+
+private:
+    std::vector<OrganMidiEvent> m_events;
+};
+
+}  //  end bach_bot
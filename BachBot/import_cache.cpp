@@ -0,0 +1,180 @@
+/**
+ * @file import_cache.cpp
+ * @brief Sharing of imported songs between playlist entries
+ * @copyright
+ * 2022 Andrew Buettner (ABi)
+ *
+ * @section LICENSE
+ *
+ * BachBot - A hymn Midi player for Schlicker organs
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+
+//  system includes
+#include <iterator>  //  std::next
+#include <wx/filename.h>  //  wxFileName
+
+//  module includes
+// -none-
+
+//  local includes
+#include "import_cache.h"  //  local include
+
+
+namespace bach_bot {
+
+ImportCache &ImportCache::get()
+{
+    static ImportCache cache;
+    return cache;
+}
+
+
+ImportCache::ImportCache() :
+    m_mutex(),
+    m_parsed_files(),
+    m_compiled_songs(),
+    m_stats{0U, 0U, 0U}
+{
+}
+
+
+std::optional<MidiFileStamp> ImportCache::stamp_file(const wxString &file_name)
+{
+    wxFileName file(file_name);
+    if (!file.FileExists()) {
+        return std::nullopt;
+    }
+    static_cast<void>(file.Normalize(wxPATH_NORM_DOTS | wxPATH_NORM_TILDE |
+                                     wxPATH_NORM_ABSOLUTE | wxPATH_NORM_LONG |
+                                     wxPATH_NORM_CASE));
+    const auto modified = file.GetModificationTime();
+    const auto size = file.GetSize();
+    if (!modified.IsValid() || (wxInvalidSize == size)) {
+        return std::nullopt;
+    }
+
+    return MidiFileStamp{file.GetFullPath().utf8_string(),
+                         modified.GetValue().GetValue(),
+                         size.GetValue()};
+}
+
+
+std::shared_ptr<const ParsedMidiFile> ImportCache::get_parsed_file(
+    const std::optional<MidiFileStamp> &stamp, const wxString &file_name)
+{
+    if (stamp.has_value()) {
+        const auto key = make_key(stamp.value());
+        std::lock_guard<std::mutex> lock(m_mutex);
+        for (auto i = m_parsed_files.begin(); i != m_parsed_files.end(); ++i) {
+            if (i->first == key) {
+                m_parsed_files.splice(m_parsed_files.begin(), m_parsed_files,
+                                      i);
+                ++m_stats.parsed_hits;
+                return m_parsed_files.front().second;
+            }
+        }
+    }
+
+    //  Read outside of the lock, other threads may be importing meanwhile
+    auto file = std::make_shared<const ParsedMidiFile>(
+        file_name.utf8_string(), DEFAULT_MIDI_FILE_PARSER);
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    ++m_stats.files_parsed;
+    if (stamp.has_value()) {
+        m_parsed_files.emplace_front(make_key(stamp.value()), file);
+        if (m_parsed_files.size() > PARSED_FILE_CACHE_SIZE) {
+            m_parsed_files.pop_back();
+        }
+    }
+    return file;
+}
+
+
+std::optional<CompiledSong> ImportCache::find_compiled(
+    const std::optional<MidiFileStamp> &stamp,
+    const ImportParameters &parameters)
+{
+    if (!stamp.has_value()) {
+        return std::nullopt;
+    }
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    const auto cached = m_compiled_songs.find(make_key(stamp.value(),
+                                                       parameters));
+    if (m_compiled_songs.end() == cached) {
+        return std::nullopt;
+    }
+
+    CompiledSong song{cached->second.events.lock(),
+                      cached->second.index.lock(),
+                      cached->second.tempo_detected,
+                      cached->second.ticks_per_measure};
+    if ((nullptr == song.events) || (nullptr == song.index)) {
+        //  Every entry using it was evicted or re-configured
+        m_compiled_songs.erase(cached);
+        return std::nullopt;
+    }
+
+    ++m_stats.compiled_hits;
+    return song;
+}
+
+
+void ImportCache::store_compiled(const std::optional<MidiFileStamp> &stamp,
+                                 const ImportParameters &parameters,
+                                 const CompiledSong &song)
+{
+    if (!stamp.has_value()) {
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    for (auto i = m_compiled_songs.begin(); i != m_compiled_songs.end();) {
+        i = i->second.events.expired() ? m_compiled_songs.erase(i) :
+                                         std::next(i);
+    }
+    m_compiled_songs[make_key(stamp.value(), parameters)] = CachedSong{
+        song.events, song.index, song.tempo_detected, song.ticks_per_measure};
+}
+
+
+ImportCacheStats ImportCache::get_stats() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_stats;
+}
+
+
+ImportCache::FileKey ImportCache::make_key(const MidiFileStamp &stamp)
+{
+    return FileKey(stamp.path, stamp.modified_ms, stamp.size);
+}
+
+
+ImportCache::CompiledKey ImportCache::make_key(
+    const MidiFileStamp &stamp, const ImportParameters &parameters)
+{
+    return CompiledKey(make_key(stamp), parameters.tempo_requested,
+                       parameters.gap_beats, parameters.starting_config.memory,
+                       parameters.starting_config.mode,
+                       parameters.delta_pitch,
+                       parameters.last_note_multiplier);
+}
+
+}  //  end bach_bot
@@ -0,0 +1,203 @@
+/**
+ * @file import_cache.h
+ * @brief Sharing of imported songs between playlist entries
+ * @copyright
+ * 2022 Andrew Buettner (ABi)
+ *
+ * @section LICENSE
+ *
+ * BachBot - A hymn Midi player for Schlicker organs
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @section DESCRIPTION
+ * Services often repeat a file: the same hymn tune for different verses or
+ * the same response several times.  Rather than every playlist entry reading
+ * and importing its file independently, imports go through a cache with two
+ * stages:
+ *
+ *  - Parsed files, keyed by canonical path, modification time and size.
+ *    Entries that differ only in import parameters re-use the file as read
+ *    from disk.  The most recently used `PARSED_FILE_CACHE_SIZE` files are
+ *    kept.
+ *  - Compiled songs, additionally keyed by the import parameters.  Identical
+ *    entries share one compiled event buffer and seek index.  The cache only
+ *    holds weak references, so a compiled song is released once no entry
+ *    uses it.
+ *
+ * Editing a file on disk changes its modification time (or size), so stale
+ * results are never returned.
+ */
+
+#pragma once
+
+//  system includes
+#include <cstdint>  //  uint64_t, int64_t
+#include <list>  //  std::list
+#include <map>  //  std::map
+#include <memory>  //  std::shared_ptr, std::weak_ptr
+#include <mutex>  //  std::mutex
+#include <optional>  //  std::optional
+#include <string>  //  std::string
+#include <tuple>  //  std::tuple
+#include <wx/wx.h>  //  wxString
+
+//  module includes
+// -none-
+
+//  local includes
+#include "event_pool.h"  //  EventPool
+#include "organ_midi_event.h"  //  BankConfig
+#include "song_index.h"  //  SongIndex
+#include "syndyne_importer.h"  //  ParsedMidiFile
+
+
+namespace bach_bot {
+
+/** Number of parsed files kept for re-use */
+constexpr const auto PARSED_FILE_CACHE_SIZE = 16U;
+
+/**
+ * @brief Identity of a MIDI file on disk.
+ */
+struct MidiFileStamp
+{
+    std::string path;  ///< canonical path (UTF-8)
+    int64_t modified_ms;  ///< modification time
+    uint64_t size;  ///< file size (bytes)
+};
+
+
+/**
+ * @brief Playlist entry configuration that affects the compiled song.
+ */
+struct ImportParameters
+{
+    int tempo_requested;
+    double gap_beats;
+    BankConfig starting_config;
+    int delta_pitch;
+    double last_note_multiplier;
+};
+
+
+/**
+ * @brief Song compiled from a MIDI file.
+ */
+struct CompiledSong
+{
+    std::shared_ptr<const EventPool> events;  ///< in play order
+    std::shared_ptr<const SongIndex> index;  ///< seek index of `events`
+    std::optional<int> tempo_detected;
+    int ticks_per_measure;  ///< 0 if unknown
+};
+
+
+/**
+ * @brief Cache effectiveness counters.
+ */
+struct ImportCacheStats
+{
+    uint32_t compiled_hits;  ///< imports served by a shared compiled song
+    uint32_t parsed_hits;  ///< imports that re-used a parsed file
+    uint32_t files_parsed;  ///< files read from disk
+};
+
+
+/**
+ * @brief Application-wide cache of parsed files and compiled songs.
+ * @note Thread-safe.
+ */
+class ImportCache
+{
+public:
+    /**
+     * @brief Get the application-wide cache instance.
+     */
+    static ImportCache &get();
+
+    /**
+     * @brief Identify a file on disk.
+     * @param file_name MIDI file
+     * @returns file identity
+     * @retval std::nullopt file doesn't exist (the import is not cached)
+     */
+    static std::optional<MidiFileStamp> stamp_file(const wxString &file_name);
+
+    /**
+     * @brief Get a parsed file, reading it if it isn't cached.
+     * @param stamp file identity (from `stamp_file`)
+     * @param file_name MIDI file
+     * @returns parsed file (an empty file if it couldn't be read)
+     */
+    std::shared_ptr<const ParsedMidiFile> get_parsed_file(
+        const std::optional<MidiFileStamp> &stamp, const wxString &file_name);
+
+    /**
+     * @brief Find a song already compiled with the same parameters.
+     * @param stamp file identity (from `stamp_file`)
+     * @param parameters import parameters
+     * @returns shared compiled song
+     * @retval std::nullopt not cached (or no longer used by any entry)
+     */
+    std::optional<CompiledSong> find_compiled(
+        const std::optional<MidiFileStamp> &stamp,
+        const ImportParameters &parameters);
+
+    /**
+     * @brief Make a compiled song available to identical entries.
+     * @param stamp file identity (from `stamp_file`)
+     * @param parameters import parameters
+     * @param song compiled song
+     */
+    void store_compiled(const std::optional<MidiFileStamp> &stamp,
+                        const ImportParameters &parameters,
+                        const CompiledSong &song);
+
+    /**
+     * @brief Get the cache effectiveness counters
+     */
+    ImportCacheStats get_stats() const;
+
+private:
+    using FileKey = std::tuple<std::string, int64_t, uint64_t>;
+    using CompiledKey = std::tuple<FileKey, int, double, uint32_t, uint8_t,
+                                   int, double>;
+
+    /**
+     * @brief Compiled song, held only while an entry uses it.
+     */
+    struct CachedSong
+    {
+        std::weak_ptr<const EventPool> events;
+        std::weak_ptr<const SongIndex> index;
+        std::optional<int> tempo_detected;
+        int ticks_per_measure;
+    };
+
+    ImportCache();
+
+    static FileKey make_key(const MidiFileStamp &stamp);
+    static CompiledKey make_key(const MidiFileStamp &stamp,
+                                const ImportParameters &parameters);
+
+    mutable std::mutex m_mutex;  ///< protects all members below
+    /** Most recently used first */
+    std::list<std::pair<FileKey, std::shared_ptr<const ParsedMidiFile>>>
+        m_parsed_files;
+    std::map<CompiledKey, CachedSong> m_compiled_songs;
+    ImportCacheStats m_stats;
+};
+
+}  //  end bach_bot
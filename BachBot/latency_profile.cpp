@@ -0,0 +1,392 @@
+/**
+ * @file latency_profile.cpp
+ * @brief Per-device MIDI output latency compensation
+ * @copyright
+ * 2022 Andrew Buettner (ABi)
+ *
+ * @section LICENSE
+ *
+ * BachBot - A hymn Midi player for Schlicker organs
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+//  system includes
+#include <algorithm>  //  std::sort, std::clamp
+#include <array>  //  std::array
+#include <cctype>  //  std::isalnum
+#include <cmath>  //  std::llround
+#include <stdexcept>  //  std::runtime_error
+#include <thread>  //  std::this_thread::yield
+#include <vector>  //  std::vector
+#include <wx/config.h>  //  wxConfigBase
+
+//  module includes
+// -none-
+
+//  local includes
+#include "latency_profile.h"  //  local include
+#include "common_defs.h"  //  make_midi_command_byte, MidiCommands
+#include "midi_interface.h"  //  RtMidiOut, RtMidiIn
+#include "monotonic_clock.h"  //  get_monotonic_ns
+#include "syndyne_importer.h"  //  generate_pulse_pattern
+
+
+namespace {
+/** Name of the local port used to measure the host's own MIDI overhead */
+constexpr const auto LOOPBACK_VIRTUAL_PORT_NAME = "BachBot Calibration";
+
+constexpr const auto NOTE_OFFSET_KEY = wxT("NoteOffsetUs");
+constexpr const auto BANK_OFFSET_KEY = wxT("BankOffsetUs");
+
+/** Loopback measurements are stored in this sub-group of the port's group */
+constexpr const auto LOOPBACK_GROUP = wxT("/Loopback");
+constexpr const auto ROUND_TRIP_GROUP = wxT("/RoundTrip");
+constexpr const auto BASELINE_GROUP = wxT("/Baseline");
+constexpr const auto ONE_WAY_GROUP = wxT("/OneWay");
+constexpr const auto PROBES_SENT_KEY = wxT("/ProbesSent");
+constexpr const auto PROBES_RECEIVED_KEY = wxT("/ProbesReceived");
+
+
+/**
+ * @brief Convert a port name to something safe to use as a config group.
+ * @param port_name MIDI port name
+ * @returns config path for the port
+ */
+wxString get_config_path(const std::string &port_name)
+{
+    std::string group;
+    group.reserve(port_name.size());
+    for (const auto c: port_name) {
+        group.push_back(std::isalnum(static_cast<unsigned char>(c)) ? c : '_');
+    }
+    return wxString(wxT("/Latency/")) + wxString(group);
+}
+
+
+/**
+ * @brief Store a latency distribution.
+ * @param config configuration to write to
+ * @param path config group to store the distribution in
+ * @param distribution distribution to store
+ */
+void write_distribution(wxConfigBase &config, const wxString &path,
+                        const bach_bot::LatencyDistribution &distribution)
+{
+    static_cast<void>(config.Write(path + wxT("/MinUs"),
+                                   long(distribution.min_us)));
+    static_cast<void>(config.Write(path + wxT("/MeanUs"),
+                                   long(distribution.mean_us)));
+    static_cast<void>(config.Write(path + wxT("/P50Us"),
+                                   long(distribution.p50_us)));
+    static_cast<void>(config.Write(path + wxT("/P95Us"),
+                                   long(distribution.p95_us)));
+    static_cast<void>(config.Write(path + wxT("/MaxUs"),
+                                   long(distribution.max_us)));
+}
+
+
+/**
+ * @brief Load a latency distribution.
+ * @param config configuration to read from
+ * @param path config group the distribution was stored in
+ * @returns stored distribution
+ * @retval std::nullopt no distribution is stored at `path`
+ */
+std::optional<bach_bot::LatencyDistribution> read_distribution(
+    const wxConfigBase &config, const wxString &path)
+{
+    std::array<long, 5U> values = {0L, 0L, 0L, 0L, 0L};
+    if (!config.Read(path + wxT("/P50Us"), &values[2], 0L)) {
+        return std::nullopt;
+    }
+    static_cast<void>(config.Read(path + wxT("/MinUs"), &values[0], 0L));
+    static_cast<void>(config.Read(path + wxT("/MeanUs"), &values[1], 0L));
+    static_cast<void>(config.Read(path + wxT("/P95Us"), &values[3], 0L));
+    static_cast<void>(config.Read(path + wxT("/MaxUs"), &values[4], 0L));
+    for (auto &value: values) {
+        value = std::max(value, 0L);
+    }
+    return bach_bot::LatencyDistribution{
+        uint32_t(values[0]), uint32_t(values[1]), uint32_t(values[2]),
+        uint32_t(values[3]), uint32_t(values[4])};
+}
+
+
+/**
+ * @brief Summarize latency samples.
+ * @param samples samples (microseconds), must not be empty
+ * @returns distribution of `samples`
+ */
+bach_bot::LatencyDistribution summarize(std::vector<uint32_t> samples)
+{
+    std::sort(samples.begin(), samples.end());
+
+    //  Nearest rank percentiles.
+    const auto count = samples.size();
+    const auto p95 = ((count * 95U) + 99U) / 100U;
+    uint64_t sum = 0U;
+    for (const auto sample: samples) {
+        sum += sample;
+    }
+
+    return bach_bot::LatencyDistribution{
+        samples.front(), uint32_t(sum / count), samples[(count - 1U) / 2U],
+        samples[p95 - 1U], samples.back()};
+}
+
+
+/**
+ * @brief Remove anything waiting in the input queue.
+ * @param midi_in input port
+ */
+void drain_input(RtMidiIn &midi_in)
+{
+    std::vector<unsigned char> message;
+    do {
+        static_cast<void>(midi_in.getMessage(&message));
+    } while (!message.empty());
+}
+
+
+/**
+ * @brief Send a pulse train from `midi_out` and time its arrival on
+ *        `midi_in`.
+ * @param midi_out output port (open)
+ * @param midi_in input port (open), connected to `midi_out`
+ * @param[out] sent number of pulses sent
+ * @returns round trip time of each pulse received (microseconds)
+ */
+std::vector<uint32_t> measure_round_trip(RtMidiOut &midi_out,
+                                         RtMidiIn &midi_in,
+                                         size_t &sent)
+{
+    const auto pulses = bach_bot::generate_pulse_pattern(
+        bach_bot::LOOPBACK_PROBE_COUNT,
+        double(bach_bot::LOOPBACK_PULSE_SPACING_MS) / 1000.0);
+    const auto pulse_status = bach_bot::make_midi_command_byte(
+        bach_bot::LATENCY_PULSE_CHANNEL,
+        bach_bot::MidiCommands::CONTROL_CHANGE);
+    const auto timeout_ns = int64_t(bach_bot::LOOPBACK_TIMEOUT_MS) *
+                            bach_bot::NS_PER_MS;
+
+    //  Send time of each pulse still in flight (0 once it has come back).
+    std::vector<int64_t> sent_ns(pulses.size(), 0);
+    std::vector<uint32_t> samples;
+    samples.reserve(pulses.size());
+
+    std::array<uint8_t, bach_bot::MIDI_MESSAGE_SIZE> pulse{};
+    std::vector<unsigned char> message;
+    drain_input(midi_in);
+
+    //  Spin rather than sleep: the scheduler quantum is about the size of
+    // what we are trying to measure.
+    sent = 0U;
+    const auto start_ns = bach_bot::get_monotonic_ns();
+    auto last_sent_ns = start_ns;
+    auto now_ns = start_ns;
+    while ((samples.size() < pulses.size()) &&
+           ((sent < pulses.size()) || ((now_ns - last_sent_ns) < timeout_ns))) {
+        const auto due_ns = (sent < pulses.size()) ?
+            std::llround(pulses[sent].m_seconds * 1000.0 *
+                         double(bach_bot::NS_PER_MS)) : 0;
+        if ((sent < pulses.size()) && ((now_ns - start_ns) >= due_ns)) {
+            const auto size = pulses[sent].get_midi_message(pulse);
+            last_sent_ns = bach_bot::get_monotonic_ns();
+            sent_ns[sent++] = last_sent_ns;
+            midi_out.sendMessage(pulse.data(), size);
+        }
+
+        static_cast<void>(midi_in.getMessage(&message));
+        now_ns = bach_bot::get_monotonic_ns();
+
+        //  The controller value is the pulse number.
+        if ((message.size() == 3U) && (pulse_status == message[0]) &&
+            (bach_bot::LATENCY_PULSE_CONTROLLER == message[1]) &&
+            (message[2] < sent) && (0 != sent_ns[message[2]])) {
+            samples.push_back(uint32_t((now_ns - sent_ns[message[2]]) /
+                                       bach_bot::NS_PER_US));
+            sent_ns[message[2]] = 0;
+        }
+        std::this_thread::yield();
+    }
+
+    return samples;
+}
+
+
+/**
+ * @brief Measure the round trip through a local virtual port.
+ * @returns round trip distribution
+ * @retval std::nullopt virtual ports are not supported by this MIDI API
+ */
+std::optional<bach_bot::LatencyDistribution> measure_virtual_baseline()
+{
+    try {
+        RtMidiIn midi_in;
+        midi_in.ignoreTypes();
+        midi_in.openVirtualPort(LOOPBACK_VIRTUAL_PORT_NAME);
+
+        RtMidiOut midi_out;
+        const auto port_count = midi_out.getPortCount();
+        for (auto i = 0U; i < port_count; ++i) {
+            const auto name = midi_out.getPortName(i);
+            if (name.find(LOOPBACK_VIRTUAL_PORT_NAME) != std::string::npos) {
+                midi_out.openPort(i);
+                size_t sent = 0U;
+                const auto samples = measure_round_trip(midi_out, midi_in,
+                                                        sent);
+                if (!samples.empty()) {
+                    return summarize(samples);
+                }
+                break;
+            }
+        }
+    } catch (const RtMidiError &) {
+        //  Fall through; not supported.
+    }
+
+    return std::nullopt;
+}
+}  //  end anonymous namespace
+
+
+namespace bach_bot {
+
+uint32_t LoopbackResult::get_device_latency_us() const
+{
+    return one_way.p50_us;
+}
+
+
+LatencyProfile load_latency_profile(const std::string &port_name)
+{
+    const auto *const config = wxConfigBase::Get();
+    const auto path = get_config_path(port_name);
+
+    auto note_offset = 0L;
+    auto bank_offset = 0L;
+    static_cast<void>(config->Read(path + wxT("/") + NOTE_OFFSET_KEY,
+                                   &note_offset, 0L));
+    static_cast<void>(config->Read(path + wxT("/") + BANK_OFFSET_KEY,
+                                   &bank_offset, 0L));
+
+    const auto limit = MAX_LATENCY_OFFSET_MS * 1000L;
+    return LatencyProfile{uint32_t(std::clamp(note_offset, 0L, limit)),
+                          uint32_t(std::clamp(bank_offset, 0L, limit))};
+}
+
+
+void save_latency_profile(const std::string &port_name,
+                          const LatencyProfile &profile)
+{
+    auto *const config = wxConfigBase::Get();
+    const auto path = get_config_path(port_name);
+
+    static_cast<void>(config->Write(path + wxT("/") + NOTE_OFFSET_KEY,
+                                    long(profile.note_offset_us)));
+    static_cast<void>(config->Write(path + wxT("/") + BANK_OFFSET_KEY,
+                                    long(profile.bank_offset_us)));
+    static_cast<void>(config->Flush());
+}
+
+
+std::optional<LoopbackResult> load_loopback_result(
+    const std::string &port_name)
+{
+    const auto *const config = wxConfigBase::Get();
+    const auto path = get_config_path(port_name) + LOOPBACK_GROUP;
+
+    const auto round_trip = read_distribution(*config,
+                                              path + ROUND_TRIP_GROUP);
+    const auto one_way = read_distribution(*config, path + ONE_WAY_GROUP);
+    if (!round_trip.has_value() || !one_way.has_value()) {
+        return std::nullopt;
+    }
+
+    auto probes_sent = 0L;
+    auto probes_received = 0L;
+    static_cast<void>(config->Read(path + PROBES_SENT_KEY, &probes_sent, 0L));
+    static_cast<void>(config->Read(path + PROBES_RECEIVED_KEY,
+                                   &probes_received, 0L));
+
+    return LoopbackResult{round_trip.value(),
+                          read_distribution(*config, path + BASELINE_GROUP),
+                          one_way.value(), size_t(std::max(probes_sent, 0L)),
+                          size_t(std::max(probes_received, 0L))};
+}
+
+
+void save_loopback_result(const std::string &port_name,
+                          const LoopbackResult &result)
+{
+    auto *const config = wxConfigBase::Get();
+    const auto path = get_config_path(port_name) + LOOPBACK_GROUP;
+
+    //  Don't leave the baseline of an earlier measurement behind.
+    static_cast<void>(config->DeleteGroup(path));
+    write_distribution(*config, path + ROUND_TRIP_GROUP, result.round_trip);
+    if (result.baseline.has_value()) {
+        write_distribution(*config, path + BASELINE_GROUP,
+                           result.baseline.value());
+    }
+    write_distribution(*config, path + ONE_WAY_GROUP, result.one_way);
+    static_cast<void>(config->Write(path + PROBES_SENT_KEY,
+                                    long(result.probes_sent)));
+    static_cast<void>(config->Write(path + PROBES_RECEIVED_KEY,
+                                    long(result.probes_received)));
+    static_cast<void>(config->Flush());
+}
+
+
+LoopbackResult measure_loopback_latency(const uint32_t out_port,
+                                        const uint32_t in_port)
+{
+    const auto baseline = measure_virtual_baseline();
+
+    size_t sent = 0U;
+    std::vector<uint32_t> round_trip;
+    try {
+        RtMidiOut midi_out;
+        RtMidiIn midi_in;
+        midi_in.ignoreTypes();
+        midi_out.openPort(out_port);
+        midi_in.openPort(in_port);
+        round_trip = measure_round_trip(midi_out, midi_in, sent);
+    } catch (const RtMidiError &e) {
+        throw std::runtime_error(e.getMessage());
+    }
+
+    if (round_trip.empty()) {
+        throw std::runtime_error(
+            "No loopback probes were received; check that the output is "
+            "connected to the selected input.");
+    }
+
+    //  Each pulse passes through the interface twice (out and back in), so
+    // its round trip less the host MIDI stack overhead is halved.
+    const auto baseline_us = baseline.has_value() ? baseline->p50_us : 0U;
+    std::vector<uint32_t> one_way;
+    one_way.reserve(round_trip.size());
+    for (const auto sample: round_trip) {
+        one_way.push_back((sample > baseline_us) ?
+                          ((sample - baseline_us) / 2U) : 0U);
+    }
+
+    return LoopbackResult{summarize(round_trip), baseline, summarize(one_way),
+                          sent, round_trip.size()};
+}
+
+}  //  end bach_bot
@@ -0,0 +1,162 @@
+/**
+ * @file latency_profile.h
+ * @brief Per-device MIDI output latency compensation
+ * @copyright
+ * 2022 Andrew Buettner (ABi)
+ *
+ * @section LICENSE
+ *
+ * BachBot - A hymn Midi player for Schlicker organs
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @section DESCRIPTION
+ * Every MIDI interface (USB dongle, the console's own interface, etc) adds
+ * its own fixed delay between `sendMessage` and the organ actually seeing the
+ * event.  The player sends events early by the profile of the selected output
+ * port so that notes sound on the beat regardless of the hardware in use.
+ * Bank changes have their own offset as the Syndyne console takes longer to
+ * act on a registration change than it does to sound a note.
+ *
+ * Profiles are stored in the application configuration keyed by port name
+ * (port numbers are not stable when devices are plugged/unplugged).  The
+ * last loopback measurement of each port is stored alongside its profile so
+ * the measured distribution can be reviewed later.
+ */
+
+#pragma once
+
+//  system includes
+#include <cstdint>  //  uint32_t
+#include <cstdlib>  //  size_t
+#include <optional>  //  std::optional
+#include <string>  //  std::string
+
+//  module includes
+// -none-
+
+//  local includes
+// -none-
+
+
+namespace bach_bot {
+
+/** Largest offset that may be configured (ms) */
+constexpr const auto MAX_LATENCY_OFFSET_MS = 500L;
+
+/** Number of pulses sent during a loopback measurement */
+constexpr const auto LOOPBACK_PROBE_COUNT = 64U;
+
+/** Time between pulses; longer than any sane device latency (ms) */
+constexpr const auto LOOPBACK_PULSE_SPACING_MS = 20L;
+
+/** Keep listening this long after the last pulse was sent (ms) */
+constexpr const auto LOOPBACK_TIMEOUT_MS = 250L;
+
+/**
+ * @brief Output latency of a single MIDI port.
+ */
+struct LatencyProfile
+{
+    uint32_t note_offset_us;  ///< send note events this much early
+    uint32_t bank_offset_us;  ///< send bank changes this much early
+};
+
+
+/**
+ * @brief Summary of a set of latency samples (microseconds).
+ */
+struct LatencyDistribution
+{
+    uint32_t min_us;  ///< fastest sample
+    uint32_t mean_us;  ///< arithmetic mean
+    uint32_t p50_us;  ///< median
+    uint32_t p95_us;  ///< 95th percentile
+    uint32_t max_us;  ///< slowest sample
+};
+
+
+/**
+ * @brief Result of a loopback latency measurement.
+ */
+struct LoopbackResult
+{
+    LatencyDistribution round_trip;  ///< out-and-back through the device
+    /** out-and-back through a local virtual port (if available) */
+    std::optional<LatencyDistribution> baseline;
+    /**
+     * per-pulse output latency of the device: the round trip less the median
+     * baseline, halved as the pulse passes through the interface twice
+     */
+    LatencyDistribution one_way;
+    size_t probes_sent;  ///< number of pulses sent
+    size_t probes_received;  ///< number of pulses that came back
+
+    /**
+     * @brief Estimate the output latency of the device under test.
+     * @returns median one-way latency (microseconds)
+     */
+    uint32_t get_device_latency_us() const;
+};
+
+
+/**
+ * @brief Load the latency profile of a port.
+ * @param port_name MIDI output port name
+ * @returns stored profile (zero offsets if the port was never configured)
+ */
+LatencyProfile load_latency_profile(const std::string &port_name);
+
+/**
+ * @brief Store the latency profile of a port.
+ * @param port_name MIDI output port name
+ * @param profile profile to store
+ */
+void save_latency_profile(const std::string &port_name,
+                          const LatencyProfile &profile);
+
+/**
+ * @brief Load the last loopback measurement of a port.
+ * @param port_name MIDI output port name
+ * @returns stored measurement
+ * @retval std::nullopt the port was never measured
+ */
+std::optional<LoopbackResult> load_loopback_result(
+    const std::string &port_name);
+
+/**
+ * @brief Store a loopback measurement of a port (replaces the last one).
+ * @param port_name MIDI output port name
+ * @param result measurement to store
+ */
+void save_loopback_result(const std::string &port_name,
+                          const LoopbackResult &result);
+
+/**
+ * @brief Measure the latency of an output port wired back to an input port.
+ * @param out_port MIDI output port under test
+ * @param in_port MIDI input port that `out_port` is looped back to
+ * @returns measurement result
+ * @throws std::runtime_error ports could not be opened or no probes came back
+ * @note The pulses come from `generate_pulse_pattern` (control changes on
+ *       channel 16 to a controller that the Syndyne console ignores) and are
+ *       sent every `LOOPBACK_PULSE_SPACING_MS`.  `in_port` may be a hardware
+ *       loopback or a local virtual port for a software only run.  This
+ *       blocks for about `LOOPBACK_PROBE_COUNT` * `LOOPBACK_PULSE_SPACING_MS`
+ *       + `LOOPBACK_TIMEOUT_MS` per port pair measured.
+ */
+LoopbackResult measure_loopback_latency(const uint32_t out_port,
+                                        const uint32_t in_port);
+
+}  //  end bach_bot
@@ -26,12 +26,17 @@
 //  system includes
 #include <wx/wxprec.h>  //  Pre-compiled header (VS thing?)
 #include <wx/wx.h>  //  wxApp
+#include <wx/imagpng.h>  //  wxPNGHandler
+#include <wx/filename.h>  //  wxFileName
+#include <wx/stdpaths.h>  //  wxStandardPaths
 
 //  module includes
 // -none-
 
 //  local includes
 #include "player_window.h"  //  Local include
+#include "startup_profiler.h"  //  StartupProfiler
+#include "profile_zone.h"  //  write_profile_trace
 
 
 /**
@@ -42,14 +47,41 @@ class BachBot : public wxApp
 public:
     virtual bool OnInit() override final
     {
-        wxInitAllImageHandlers();
+        BACHBOT_THREAD_NAME("ui");
+        auto &profiler = bach_bot::StartupProfiler::get();
+
+        //  Only PNG (wood.png) is used, don't pay for every other format.
+        wxImage::AddHandler(new wxPNGHandler());
         bach_bot::ui::initialize_global_accelerator_table();
+        profiler.mark(wxT("image handlers"));
+
         m_window = new bach_bot::ui::PlayerWindow();
+        profiler.mark(wxT("main window construction"));
+
         m_window->Show(true);
         SetTopWindow(m_window);
+        profiler.mark(wxT("show main window"));
+
+        //  Runs once the event loop has processed the initial paint/layout.
+        CallAfter([&profiler]() { profiler.finish(); });
         return true;
     }
 
+#if defined(BACHBOT_PROFILE)
+    virtual int OnExit() override final
+    {
+        //  Written next to the start-up log; open it in Perfetto.
+        wxLogNull no_log;
+        const auto dir = wxStandardPaths::Get().GetUserLocalDataDir();
+        if (wxFileName::Mkdir(dir, wxS_DIR_DEFAULT, wxPATH_MKDIR_FULL)) {
+            static_cast<void>(bach_bot::write_profile_trace(
+                wxFileName(dir, wxT("profile.json")).GetFullPath()
+                    .utf8_string()));
+        }
+        return wxApp::OnExit();
+    }
+#endif
+
 private:
     bach_bot::ui::PlayerWindow *m_window = nullptr;
 };
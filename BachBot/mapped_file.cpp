@@ -0,0 +1,166 @@
+/**
+ * @file mapped_file.cpp
+ * @brief Read-only memory mapped file
+ * @copyright
+ * 2022 Andrew Buettner (ABi)
+ *
+ * @section LICENSE
+ *
+ * BachBot - A hymn Midi player for Schlicker organs
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+//  system includes
+#include <filesystem>  //  std::filesystem::u8path
+#include <fstream>  //  std::ifstream
+#include <iterator>  //  std::istreambuf_iterator
+#include <stdexcept>  //  std::runtime_error
+#include <fmt/format.h>  //  fmt::format
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>  //  CreateFileMapping, MapViewOfFile
+#else
+#include <fcntl.h>  //  open
+#include <sys/mman.h>  //  mmap, munmap
+#include <sys/stat.h>  //  fstat
+#include <unistd.h>  //  close
+#endif
+
+//  module includes
+// -none-
+
+//  local includes
+#include "mapped_file.h"  //  local include
+
+
+namespace bach_bot {
+
+MappedFile::MappedFile(const std::string &file_name) :
+    m_data{nullptr},
+    m_size{0U},
+    m_mapped{false},
+    m_buffer()
+#ifdef _WIN32
+    ,
+    m_file_handle{INVALID_HANDLE_VALUE},
+    m_mapping_handle{nullptr}
+#endif
+{
+#ifdef _WIN32
+    //  The narrow API would interpret the name in the ANSI code page.
+    m_file_handle = CreateFileW(std::filesystem::u8path(file_name).c_str(),
+                                GENERIC_READ, FILE_SHARE_READ, nullptr,
+                                OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (INVALID_HANDLE_VALUE != m_file_handle) {
+        LARGE_INTEGER file_size;
+        if (GetFileSizeEx(m_file_handle, &file_size) &&
+                (file_size.QuadPart > 0)) {
+            m_mapping_handle = CreateFileMappingW(m_file_handle, nullptr,
+                                                  PAGE_READONLY, 0U, 0U,
+                                                  nullptr);
+            if (nullptr != m_mapping_handle) {
+                m_data = static_cast<const uint8_t*>(MapViewOfFile(
+                    m_mapping_handle, FILE_MAP_READ, 0U, 0U, 0U));
+                if (nullptr != m_data) {
+                    m_size = size_t(file_size.QuadPart);
+                    m_mapped = true;
+                }
+            }
+        }
+    }
+#else
+    const auto fd = ::open(file_name.c_str(), O_RDONLY);
+    if (fd >= 0) {
+        struct stat file_stat;
+        if ((0 == ::fstat(fd, &file_stat)) && (file_stat.st_size > 0)) {
+            auto *const mapping = ::mmap(nullptr, size_t(file_stat.st_size),
+                                         PROT_READ, MAP_PRIVATE, fd, 0);
+            if (MAP_FAILED != mapping) {
+                //  The whole file is read front-to-back exactly once.
+                static_cast<void>(::madvise(mapping, size_t(file_stat.st_size),
+                                            MADV_SEQUENTIAL));
+                m_data = static_cast<const uint8_t*>(mapping);
+                m_size = size_t(file_stat.st_size);
+                m_mapped = true;
+            }
+        }
+        static_cast<void>(::close(fd));
+    }
+#endif
+
+    if (!m_mapped) {
+        close();
+
+        //  Fall back to a plain read (empty files, pipes, etc)
+        std::ifstream input(std::filesystem::u8path(file_name),
+                            std::ios::binary);
+        if (!input) {
+            throw std::runtime_error(fmt::format("Unable to open {}",
+                                                 file_name));
+        }
+        m_buffer.assign(std::istreambuf_iterator<char>(input),
+                        std::istreambuf_iterator<char>());
+        m_data = m_buffer.data();
+        m_size = m_buffer.size();
+    }
+}
+
+
+MappedFile::~MappedFile()
+{
+    close();
+}
+
+
+const uint8_t *MappedFile::data() const
+{
+    return m_data;
+}
+
+
+size_t MappedFile::size() const
+{
+    return m_size;
+}
+
+
+void MappedFile::close()
+{
+#ifdef _WIN32
+    if (m_mapped) {
+        static_cast<void>(UnmapViewOfFile(m_data));
+    }
+    if (nullptr != m_mapping_handle) {
+        static_cast<void>(CloseHandle(m_mapping_handle));
+        m_mapping_handle = nullptr;
+    }
+    if (INVALID_HANDLE_VALUE != m_file_handle) {
+        static_cast<void>(CloseHandle(m_file_handle));
+        m_file_handle = INVALID_HANDLE_VALUE;
+    }
+#else
+    if (m_mapped) {
+        static_cast<void>(::munmap(const_cast<uint8_t*>(m_data), m_size));
+    }
+#endif
+    m_mapped = false;
+    m_data = nullptr;
+    m_size = 0U;
+}
+
+}  //  end bach_bot
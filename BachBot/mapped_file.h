@@ -0,0 +1,93 @@
+/**
+ * @file mapped_file.h
+ * @brief Read-only memory mapped file
+ * @copyright
+ * 2022 Andrew Buettner (ABi)
+ *
+ * @section LICENSE
+ *
+ * BachBot - A hymn Midi player for Schlicker organs
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @section DESCRIPTION
+ * Map a whole file into memory for read-only access.  On platforms (or file
+ * systems) where mapping is not available the file is read into a private
+ * buffer instead so that callers only ever deal with a pointer and a size.
+ */
+
+#pragma once
+
+//  system includes
+#include <cstdint>  //  uint8_t
+#include <cstdlib>  //  size_t
+#include <string>  //  std::string
+#include <vector>  //  std::vector
+
+//  module includes
+// -none-
+
+//  local includes
+// -none-
+
+
+namespace bach_bot {
+
+/**
+ * @brief Read-only view of an entire file.
+ */
+class MappedFile
+{
+public:
+    /**
+     * @brief Constructor
+     * @param file_name file to map (UTF-8)
+     * @throws std::runtime_error file can not be opened or read
+     */
+    explicit MappedFile(const std::string &file_name);
+
+    MappedFile(const MappedFile &) = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
+
+    ~MappedFile();
+
+    /**
+     * @brief Get the first byte of the file.
+     * @return pointer to file contents (valid for the lifetime of this object)
+     */
+    const uint8_t *data() const;
+
+    /**
+     * @brief Get the size of the file.
+     * @return number of bytes accessible from `data()`
+     */
+    size_t size() const;
+
+private:
+    /**
+     * @brief Release the mapping / handles
+     */
+    void close();
+
+    const uint8_t *m_data;  ///< start of file contents
+    size_t m_size;  ///< file size in bytes
+    bool m_mapped;  ///< `m_data` points into a mapping (not `m_buffer`)
+    std::vector<uint8_t> m_buffer;  ///< fallback when mapping fails
+#ifdef _WIN32
+    void *m_file_handle;  ///< Win32 file handle
+    void *m_mapping_handle;  ///< Win32 file mapping handle
+#endif
+};
+
+}  //  end bach_bot
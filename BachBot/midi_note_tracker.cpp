@@ -42,7 +42,7 @@ namespace {
  * @retval `true` events occur at the same time
  * @retval `false` events are at different times
  */
-bool is_same_time(const smf::MidiEvent &ev, const int organ_time)
+bool is_same_time(const bach_bot::SmfEvent &ev, const int organ_time)
 {
     return (abs(ev.tick - organ_time) <= 1);
 }
@@ -58,62 +58,71 @@ MidiNoteTracker::MidiNoteTracker() :
     m_midi_ticks_on_time{-1},
     m_last_midi_off_time{-1},
     m_note_nesting_count{0U},
-    m_note_on(),
-    m_note_off(),
+    m_note_on{NO_EVENT_INDEX},
+    m_note_off{NO_EVENT_INDEX},
     m_keyboard{SyndyneKeyboards::MANUAL2_SWELL},
     m_event_list()
 {
 }
 
 
-void MidiNoteTracker::add_event(const smf::MidiEvent &ev)
+void MidiNoteTracker::add_event(const SmfEvent &ev, EventPool &pool)
 {
-    auto organ_event = OrganNote(new OrganMidiEvent(ev, m_keyboard));
+    //  Nested on/off events are only counted, don't add them to the pool.
+    auto new_event = [&]() {
+        return pool.emplace(ev, m_keyboard);
+    };
 
-    if (ev.isNoteOn() && !m_on_now) {
-        process_new_note_on_event(organ_event);
-    } else if (ev.isNoteOff() && m_last_event_was_on){
-        process_new_note_off_event(organ_event);
-    } else if (ev.isNoteOn() && is_same_time(ev, m_midi_ticks_on_time)) {
+    if (ev.is_note_on() && !m_on_now) {
+        process_new_note_on_event(new_event(), pool);
+    } else if (ev.is_note_off() && m_last_event_was_on){
+        process_new_note_off_event(new_event(), pool);
+    } else if (ev.is_note_on() && is_same_time(ev, m_midi_ticks_on_time)) {
         ++m_note_nesting_count;
-    } else if (ev.isNoteOff() &&
+    } else if (ev.is_note_off() &&
                is_same_time(ev, m_last_midi_off_time) &&
                (m_note_nesting_count > 0U)) {
         --m_note_nesting_count;
-    } else if (ev.isNoteOn() && m_on_now) {
-        insert_off_event(organ_event);
-        process_new_note_on_event(organ_event);
-    } else if (ev.isNoteOff() && !m_on_now && (m_note_nesting_count > 0U)) {
-        backfill_on_event(organ_event);
-        process_new_note_off_event(organ_event);
+    } else if (ev.is_note_on() && m_on_now) {
+        const auto organ_event = new_event();
+        insert_off_event(organ_event, pool);
+        process_new_note_on_event(organ_event, pool);
+    } else if (ev.is_note_off() && !m_on_now && (m_note_nesting_count > 0U)) {
+        const auto organ_event = new_event();
+        backfill_on_event(pool);
+        process_new_note_off_event(organ_event, pool);
     }
 
-    m_last_event_was_on = ev.isNoteOn();
+    m_last_event_was_on = ev.is_note_on();
 }
 
 
-void MidiNoteTracker::append_events(std::list<OrganNote> &event_list) const
+void MidiNoteTracker::append_events(EventPool &pool,
+                                    std::vector<EventIndex> &event_list) const
 {
-    OrganNote grouped_note_on;
-
-    auto append_pair = [&](const OrganNote &note_on, const OrganNote &note_off) {
-        event_list.emplace_back(note_on);
-        auto &on_event = event_list.back();
-        event_list.emplace_back(note_off);
-        on_event.link(event_list.back());
-        grouped_note_on.reset();
+    auto grouped_note_on = NO_EVENT_INDEX;
+
+    auto append_pair = [&](const EventIndex note_on,
+                           const EventIndex note_off) {
+        event_list.push_back(note_on);
+        event_list.push_back(note_off);
+        pool.link(note_on, note_off);
+        grouped_note_on = NO_EVENT_INDEX;
     };
 
     for (auto i= m_event_list.cbegin(); m_event_list.cend() != i; ++i) {
+        const auto &note_on = pool[i->first];
+        const auto &note_off = pool[i->second];
         auto grouped_length = 0.0;
-        if (grouped_note_on.get() != nullptr) {
-            grouped_length = i->second->m_seconds - grouped_note_on->m_seconds;
+        if (NO_EVENT_INDEX != grouped_note_on) {
+            grouped_length = note_off.m_seconds -
+                             pool[grouped_note_on].m_seconds;
         }
 
 
-        if (i->second->m_seconds - i->first->m_seconds > MINIMUM_NOTE_LENGTH_S) {
+        if (note_off.m_seconds - note_on.m_seconds > MINIMUM_NOTE_LENGTH_S) {
             append_pair(i->first, i->second);
-        } else if (grouped_note_on.get() == nullptr) {
+        } else if (NO_EVENT_INDEX == grouped_note_on) {
             grouped_note_on = i->first;
         } else if (grouped_length > MINIMUM_NOTE_LENGTH_S) {
             append_pair(grouped_note_on, i->second);
@@ -128,55 +137,60 @@ void MidiNoteTracker::set_keyboard(const SyndyneKeyboards keyboard_id)
 }
 
 
-void MidiNoteTracker::process_new_note_on_event(OrganNote &organ_ev)
+void MidiNoteTracker::process_new_note_on_event(const EventIndex organ_ev,
+                                                EventPool &pool)
 {
+    auto &note_on = pool[organ_ev];
     auto last_off_time = -1.0;
-    if (nullptr != m_note_off.get()) {
-        last_off_time = m_note_off->m_seconds;
+    if (NO_EVENT_INDEX != m_note_off) {
+        last_off_time = pool[m_note_off].m_seconds;
     }
 
-    if (organ_ev->m_seconds - last_off_time < MINIMUM_NOTE_GAP_S) {
+    if (note_on.m_seconds - last_off_time < MINIMUM_NOTE_GAP_S) {
         const auto delta = MINIMUM_NOTE_GAP_S / 2.0;
-        m_note_off->m_seconds -= delta;
-        organ_ev->m_seconds += delta;
+        pool[m_note_off].m_seconds -= delta;
+        note_on.m_seconds += delta;
     }
 
     m_note_on = organ_ev;
-    m_midi_ticks_on_time = organ_ev->m_midi_time;
+    m_midi_ticks_on_time = note_on.m_midi_time;
     m_on_now = true;
     ++m_note_nesting_count;
-    organ_ev->m_byte2 = SYNDYNE_NOTE_ON_VELOCITY;
+    note_on.m_byte2 = SYNDYNE_NOTE_ON_VELOCITY;
 }
 
 
-void MidiNoteTracker::process_new_note_off_event(OrganNote &organ_ev)
+void MidiNoteTracker::process_new_note_off_event(const EventIndex organ_ev,
+                                                 EventPool &pool)
 {
+    auto &note_off = pool[organ_ev];
     m_note_off = organ_ev;
     --m_note_nesting_count;
     m_on_now = false;
-    m_last_midi_off_time = organ_ev->m_midi_time;
-    organ_ev->m_byte2 = uint8_t(0U);
+    m_last_midi_off_time = note_off.m_midi_time;
+    note_off.m_byte2 = uint8_t(0U);
     m_event_list.push_back({m_note_on, m_note_off});
 }
 
 
-void MidiNoteTracker::insert_off_event(OrganNote &organ_ev)
+void MidiNoteTracker::insert_off_event(const EventIndex organ_ev,
+                                       EventPool &pool)
 {
-    OrganNote organ_event(*organ_ev);
-    organ_event->m_event_code = make_midi_command_byte(m_keyboard,
-                                                       MidiCommands::NOTE_OFF);
-    process_new_note_off_event(organ_event);
+    //  Copy first; the pool may move its events as it grows.
+    auto copy = pool[organ_ev];
+    copy.m_event_code = make_midi_command_byte(m_keyboard,
+                                               MidiCommands::NOTE_OFF);
+    process_new_note_off_event(pool.emplace(std::move(copy)), pool);
     ++m_note_nesting_count;
 }
 
 
-void MidiNoteTracker::backfill_on_event(OrganNote &organ_ev)
+void MidiNoteTracker::backfill_on_event(EventPool &pool)
 {
-    static_cast<void>(organ_ev);
-    OrganNote organ_event(*m_note_off);
-    organ_event->m_event_code = make_midi_command_byte(m_keyboard,
-                                                       MidiCommands::NOTE_ON);
-    process_new_note_on_event(organ_event);
+    auto copy = pool[m_note_off];
+    copy.m_event_code = make_midi_command_byte(m_keyboard,
+                                               MidiCommands::NOTE_ON);
+    process_new_note_on_event(pool.emplace(std::move(copy)), pool);
     --m_note_nesting_count;
 }
 
@@ -45,13 +45,13 @@
 #pragma once
 
 //  system includes
-#include <list>  //  std::list
-#include <utility>  //  std::pari
+#include <utility>  //  std::pair
+#include <vector>  //  std::vector
 
 //  local includes
 #include "common_defs.h"  //  Orgain timing "magic numbers"
-#include "organ_midi_event.h"  //  OrganMidiEvent
-#include "midi_interface.h"  //  smf::MidiEven
+#include "event_pool.h"  //  EventPool, EventIndex
+#include "smf_reader.h"  //  SmfEvent
 
 namespace bach_bot {
 
@@ -71,15 +71,18 @@ public:
     /**
      * @brief Add a single event to this tracking logic
      * @param ev midi event
+     * @param pool[in/out] song event storage
      * @note ev must be either a NoteOn or NoteOff event.
      */
-    void add_event(const smf::MidiEvent &ev);
+    void add_event(const SmfEvent &ev, EventPool &pool);
 
     /**
      * @brief Append our events to the list
+     * @param pool[in/out] song event storage (pairs are linked)
      * @param[in/out] event_list current list of midi events
     */
-    void append_events(std::list<OrganNote> &event_list) const;
+    void append_events(EventPool &pool,
+                       std::vector<EventIndex> &event_list) const;
 
     /**
      * @brief Set the keyboard that we will use.
@@ -91,27 +94,32 @@ private:
     /**
      * @brief Logic for a new note-on event in the event list.
      * @param organ_ev event to process
+     * @param pool[in/out] song event storage
      * @note this occurs *any* time that the note is turned on including
      *       restrikes.
      */
-    void process_new_note_on_event(OrganNote &organ_ev);
+    void process_new_note_on_event(const EventIndex organ_ev,
+                                   EventPool &pool);
 
     /**
      * @brief Logic for a new not-off event in the event list.
      * @param organ_ev event to process
+     * @param pool[in/out] song event storage
      * @note this will always append a complete (note-on+note-off pair).
      */
-    void process_new_note_off_event(OrganNote &organ_ev);
+    void process_new_note_off_event(const EventIndex organ_ev,
+                                    EventPool &pool);
 
     /**
      * @brief Insert a simulated note-off event in the case of a restrike.
      * @param organ_ev note-on event that caused the restrike.
+     * @param pool[in/out] song event storage
     */
-    void insert_off_event(OrganNote &organ_ev);
+    void insert_off_event(const EventIndex organ_ev, EventPool &pool);
 
     /**
      * @brief Insert a simulated note-on event from last note-off.
-     * @param organ_ev note-off event that necessitated the backfill.
+     * @param pool[in/out] song event storage
      * @note
      * This occurs when multiple note-on events are active and the
      * corresponding note-off events occur at different times.  In this event,
@@ -119,7 +127,7 @@ private:
      * actually supposed to be a restrike and this note-off is the end of that
      * restrike event.
      */
-    void backfill_on_event(OrganNote &organ_ev);
+    void backfill_on_event(EventPool &pool);
 
     bool m_on_now;  ///< Current state, note is on now
     bool m_last_event_was_on;  ///< The last event processed was a note-on
@@ -133,8 +141,8 @@ private:
     int m_last_midi_off_time;  ///< MIDI time of the most recent "note-off"
 
     uint32_t m_note_nesting_count;  ///<  Number of concurrent note-on events
-    OrganNote m_note_on;  ///<  Shared pointer to the last "note-on" event
-    OrganNote m_note_off;  ///<  Shared pointer to the last "note-off" event
+    EventIndex m_note_on;  ///<  Pool index of the last "note-on" event
+    EventIndex m_note_off;  ///<  Pool index of the last "note-off" event
     SyndyneKeyboards m_keyboard;  ///<  Keyboard that events shall be routed to
 
     /**
@@ -143,7 +151,7 @@ private:
      *   - `first` is the note-on event,
      *   - `second` is the matching note-off event
      */
-    std::list<std::pair<OrganNote, OrganNote>> m_event_list;
+    std::vector<std::pair<EventIndex, EventIndex>> m_event_list;
 };
 
 }  //  end bach_bot
@@ -0,0 +1,65 @@
+/**
+ * @file monotonic_clock.h
+ * @brief System monotonic time in nanoseconds
+ * @copyright
+ * 2022 Andrew Buettner (ABi)
+ *
+ * @section LICENSE
+ *
+ * BachBot - A hymn Midi player for Schlicker organs
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @section DESCRIPTION
+ * Every time stamp the player takes - the playback clock, the timer
+ * backends' period measurement and the instrumentation (output port
+ * latency, profile zones) - comes from this one function, so their values
+ * are directly comparable and keep full resolution.  It has no dependencies
+ * beyond the standard library so that the tools can use it too.
+ */
+
+#pragma once
+
+//  system includes
+#include <chrono>  //  std::chrono::steady_clock
+#include <cstdint>  //  int64_t
+
+//  module includes
+// -none-
+
+//  local includes
+// -none-
+
+
+namespace bach_bot {
+
+/** Nanoseconds per microsecond */
+constexpr const int64_t NS_PER_US = 1000;
+
+/** Nanoseconds per millisecond */
+constexpr const int64_t NS_PER_MS = 1000000;
+
+/**
+ * @brief Get the system monotonic time
+ * @returns nanoseconds since an arbitrary (fixed) epoch
+ * @note `std::chrono::steady_clock` is `CLOCK_MONOTONIC` on POSIX and
+ *       `QueryPerformanceCounter` on Windows.
+ */
+inline int64_t get_monotonic_ns()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+}  //  end bach_bot
@@ -25,7 +25,6 @@
 
 //  system includes
 #include <limits>  //  std::numeric_limits
-#include <stdexcept>  //  std::runtime_error
 
 //  module includes
 // -none-
@@ -36,7 +35,7 @@
 
 namespace bach_bot {
 
-OrganMidiEvent::OrganMidiEvent(const smf::MidiEvent& midi_event,
+OrganMidiEvent::OrganMidiEvent(const SmfEvent &midi_event,
                                const SyndyneKeyboards channel) :
     m_event_code{make_midi_command_byte(channel, MidiCommands::SPECIAL)},
     m_mode_change_event{false},
@@ -49,18 +48,18 @@ OrganMidiEvent::OrganMidiEvent(const smf::MidiEvent& midi_event,
     m_metadata(),
     m_midi_time{midi_event.tick},
     m_delta{0},
-    m_partner{nullptr},
+    m_partner{NO_EVENT_INDEX},
     m_song_id{std::numeric_limits<uint32_t>::max()}
 {
-    if (midi_event.isNoteOn()) {
+    if (midi_event.is_note_on()) {
         m_event_code = make_midi_command_byte(channel, MidiCommands::NOTE_ON);
-    } else if (midi_event.isNoteOff()) {
+    } else if (midi_event.is_note_off()) {
         m_event_code = make_midi_command_byte(channel, MidiCommands::NOTE_OFF);
     }
-    if (midi_event.size() > 1) {
-        m_byte1 = uint8_t(midi_event[1]);
-        if (midi_event.size() > 2) {
-            m_byte2 = uint8_t(midi_event[2]);
+    if (midi_event.size > 1U) {
+        m_byte1 = midi_event.byte1;
+        if (midi_event.size > 2U) {
+            m_byte2 = midi_event.byte2;
         } else {
             m_byte2.reset();
         }
@@ -86,7 +85,7 @@ OrganMidiEvent::OrganMidiEvent(const MidiCommands command,
     m_metadata(),
     m_midi_time{0},
     m_delta{0},
-    m_partner{nullptr},
+    m_partner{NO_EVENT_INDEX},
     m_song_id{std::numeric_limits<uint32_t>::max()}
 {
     if (byte1 >= 0) {
@@ -111,7 +110,7 @@ OrganMidiEvent::OrganMidiEvent(const int metadata_value,
     m_metadata(metadata_value),
     m_midi_time{0},
     m_delta{0},
-    m_partner{nullptr},
+    m_partner{NO_EVENT_INDEX},
     m_song_id{std::numeric_limits<uint32_t>::max()}
 {
     if (nullptr != src) {
@@ -125,9 +124,9 @@ OrganMidiEvent::OrganMidiEvent(const int metadata_value,
 }
 
 
-OrganMidiEvent::OrganMidiEvent(const smf::MidiEvent &midi_event,
+OrganMidiEvent::OrganMidiEvent(const SmfEvent &midi_event,
                                const BankConfig &cfg) :
-    m_event_code{make_midi_command_byte(uint8_t(midi_event.getChannel()),
+    m_event_code{make_midi_command_byte(uint8_t(midi_event.get_channel()),
                                         MidiCommands::SPECIAL)},
     m_mode_change_event{true},
     m_desired_memory{cfg.memory},
@@ -139,7 +138,26 @@ OrganMidiEvent::OrganMidiEvent(const smf::MidiEvent &midi_event,
     m_metadata(),
     m_midi_time{midi_event.tick},
     m_delta{0},
-    m_partner{nullptr},
+    m_partner{NO_EVENT_INDEX},
+    m_song_id{std::numeric_limits<uint32_t>::max()}
+{
+}
+
+
+OrganMidiEvent::OrganMidiEvent(const uint8_t event_code,
+                               const bool mode_change_event) :
+    m_event_code{event_code},
+    m_mode_change_event{mode_change_event},
+    m_desired_memory{1U},
+    m_desired_mode_number{1U},
+    m_seconds{0.0},
+    m_delta_time{0.0},
+    m_byte1(),
+    m_byte2(),
+    m_metadata(),
+    m_midi_time{0},
+    m_delta{0},
+    m_partner{NO_EVENT_INDEX},
     m_song_id{std::numeric_limits<uint32_t>::max()}
 {
 }
@@ -155,6 +173,16 @@ wxLongLong OrganMidiEvent::get_us() const
 void OrganMidiEvent::send_event(RtMidiOut& player) const
 {
     std::array<uint8_t, MIDI_MESSAGE_SIZE> midi_message;
+    const auto msg_size = get_midi_message(midi_message);
+    if (msg_size > 0U) {
+        player.sendMessage(midi_message.data(), msg_size);
+    }
+}
+
+
+size_t OrganMidiEvent::get_midi_message(
+    std::array<uint8_t, MIDI_MESSAGE_SIZE> &midi_message) const
+{
     size_t msg_size = 0U;
     if (m_event_code < make_midi_command_byte(0U, SPECIAL)) {
         midi_message[msg_size++] = m_event_code;
@@ -166,9 +194,9 @@ void OrganMidiEvent::send_event(RtMidiOut& player) const
                 midi_message[msg_size++] = m_byte2.value();
             }
         }
-
-        player.sendMessage(midi_message.data(), msg_size);
     }
+
+    return msg_size;
 }
 
 
@@ -205,65 +233,19 @@ void OrganMidiEvent::offset_time(const double seconds, const int ticks)
 }
 
 
-OrganMidiEvent::~OrganMidiEvent()
+bool OrganMidiEvent::operator< (const OrganMidiEvent &rhs) const
 {
-    if (nullptr != m_partner) {
-        m_partner->m_partner = nullptr;
-        m_partner = nullptr;
-    }
-}
-
-
-OrganNote::OrganNote(OrganMidiEvent *const ptr) :
-    std::shared_ptr<OrganMidiEvent>(ptr)
-{
-}
-
-
-OrganNote::OrganNote(const OrganMidiEvent &rhs) :
-    OrganNote(new OrganMidiEvent(rhs))
-{
-    get()->m_partner = nullptr;
-}
-
-
-void OrganNote::link(OrganNote &rhs) const
-{
-    auto *const this_inst = get();
-    if (nullptr == this_inst || nullptr == rhs.get()) {
-        throw std::runtime_error("link() on null instance");
-    }
-    this_inst->m_partner = rhs.get();
-    rhs->m_partner = this_inst;
-}
-
-
-bool OrganNote::operator< (const OrganNote& rhs) const
-{
-    const auto *const this_event = get();
-    if (nullptr == this_event || nullptr == rhs.get()) {
-        throw std::runtime_error("operator< on null instance");
-    }
-
-    const auto time_compare = (this_event->m_seconds < rhs->m_seconds);
-    if (rhs->m_midi_time == this_event->m_midi_time) {
-        if (this_event->is_mode_change_event() == rhs->is_mode_change_event()) {
+    const auto time_compare = (m_seconds < rhs.m_seconds);
+    if (rhs.m_midi_time == m_midi_time) {
+        if (is_mode_change_event() == rhs.is_mode_change_event()) {
             return time_compare;
         }
-        return rhs->is_mode_change_event();
+        return rhs.is_mode_change_event();
     }
     return time_compare;
 }
 
 
-OrganMidiEvent OrganNote::clone() const
-{
-    auto cloned_event = *get();
-    cloned_event.m_partner = nullptr;
-    return cloned_event;
-}
-
-
 BankConfig::BankConfig(int msgdata) :
     BankConfig()
 {
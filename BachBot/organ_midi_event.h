@@ -31,18 +31,26 @@
 
 
 //  system includes
+#include <array>  //  std::array
 #include <cstdint>
-#include <memory>  //  std::shared_ptr
+#include <limits>  //  std::numeric_limits
 #include <optional>  //  std::optional
 #include <utility>  //  std::pair
 #include <wx/wx.h>  //  wxLongLong
 
 //  local includes
 #include "common_defs.h"  //  SyndyneKeyboards
-#include "midi_interface.h"  //  RtMidiOut, smf::MidiEvent
+#include "midi_interface.h"  //  RtMidiOut
+#include "smf_reader.h"  //  SmfEvent
 
 namespace bach_bot {
 
+/** Position of an event within its song's `EventPool` */
+using EventIndex = uint32_t;
+
+/** `EventIndex` value for "no event" */
+constexpr const auto NO_EVENT_INDEX = std::numeric_limits<EventIndex>::max();
+
 /**
  * @brief Type for setting/getting the desired bank configuration.
  * @note
@@ -87,14 +95,12 @@ struct BankConfig
  */
 struct OrganMidiEvent
 {
-    friend class OrganNote;
-
     /**
      * @brief Construct from a MIDI event and map to a specific keyboard.
      * @param midi_event Midi event to take timing and note information from.
      * @param channel Route MIDI event to this keyboard.
      */
-    OrganMidiEvent(const smf::MidiEvent& midi_event,
+    OrganMidiEvent(const SmfEvent &midi_event,
                    const SyndyneKeyboards channel);
 
     /**
@@ -102,7 +108,7 @@ struct OrganMidiEvent
      * @param midi_event Midi event to take timing information from.
      * @param cfg Generate new bank configuration.
      */
-    OrganMidiEvent(const smf::MidiEvent &midi_event, const BankConfig& cfg);
+    OrganMidiEvent(const SmfEvent &midi_event, const BankConfig& cfg);
 
     /**
      * @brief Construct an arbitrary MIDI event
@@ -124,6 +130,15 @@ struct OrganMidiEvent
     OrganMidiEvent(const int metadata_value,
                    const OrganMidiEvent *const src = nullptr);
 
+    /**
+     * @brief Construct an empty event of a given type (the caller fills in
+     *        the remaining fields, ie when restoring a compiled song).
+     * @param event_code MIDI status byte (`SPECIAL` for non-MIDI events)
+     * @param mode_change_event `true` to construct a bank change event
+     */
+    OrganMidiEvent(const uint8_t event_code, const bool mode_change_event);
+
+    OrganMidiEvent(const OrganMidiEvent &) = default;
     OrganMidiEvent(OrganMidiEvent &&) = default;
 
     /**
@@ -132,6 +147,15 @@ struct OrganMidiEvent
      */
     void send_event(RtMidiOut &player) const;
 
+    /**
+     * @brief Build the raw MIDI message for this event.
+     * @param[out] midi_message message bytes
+     * @returns number of bytes used in `midi_message`
+     * @retval 0 this event does not generate a MIDI message
+     */
+    size_t get_midi_message(
+        std::array<uint8_t, MIDI_MESSAGE_SIZE> &midi_message) const;
+
     /**
      * @brief Get the event timing in microseconds.
      * @return Event time relative to the start of song.
@@ -173,7 +197,12 @@ struct OrganMidiEvent
      */
     void offset_time(const double seconds, const int ticks);
 
-    ~OrganMidiEvent();
+    /**
+    * @brief Operator used for sorting events by event time.
+    * @param rhs Event to test in sort function.
+    * @return sort order
+    */
+    bool operator< (const OrganMidiEvent &rhs) const;
 
     uint8_t m_event_code;  ///<  This event command
     const bool m_mode_change_event; ///< Was this constructed as a mode change event?
@@ -186,55 +215,8 @@ struct OrganMidiEvent
     std::optional<int> m_metadata;  ///< Optional metadata associated with event
     int m_midi_time;  ///<  Midi event MIDI ticks time.
     int m_delta;  ///<  Midi ticks since last event.
-    OrganMidiEvent *m_partner;  ///< Partner event (for event pairs)
+    EventIndex m_partner;  ///< Partner event (for event pairs) in same pool
     uint32_t m_song_id;  ///<  The song ID that this event is associated with.
-
-private:
-    /**
-     * @brief Only allow Organ note to do default copy construction.
-     */
-    OrganMidiEvent(const OrganMidiEvent&) = default;
-};
-
-
-/**
-* @brief Simplify this type.  Organ event storage.
-*/
-class OrganNote : public std::shared_ptr<OrganMidiEvent>
-{
-public:
-    OrganNote(const OrganNote &rhs) = default;
-
-    /**
-     * @brief Construct from new
-     * @param ptr pointer to instance
-    */
-    OrganNote(OrganMidiEvent *const ptr = nullptr);
-
-    /**
-     * @brief Copy construct from another instance
-     * @param rhs instance to copy from.
-    */
-    OrganNote(const OrganMidiEvent &rhs);
-
-    /**
-    * @brief Operator used for sorting events by event time.
-    * @param rhs Event to test in sort function.
-    * @return sort order
-    */
-    bool operator< (const OrganNote& rhs) const;
-
-    /**
-    * @brief Link this event to another event (usually note-on/note-off pair)
-    * @param rhs other item being linked.
-    */
-    void link(OrganNote &rhs) const;
-
-    /**
-     * @brief Create a copy of the OrgeNMidiEvent payload.
-     * @returns copy of the payload
-     */
-    OrganMidiEvent clone() const;
 };
 
 
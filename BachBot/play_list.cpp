@@ -26,7 +26,7 @@
 //  system includes
 #include <stdexcept>  //  std::out_of_range
 #include <fmt/format.h>  //  fmt::format
-#include <memory>  //  std::make_unique
+#include <memory>  //  std::make_unique, std::make_shared
 
 //  module includes
 // -none-
@@ -40,14 +40,31 @@ namespace bach_bot {
 
 bool PlayListEntry::import_midi(SyndineImporter *importer)
 {
+    auto &cache = ImportCache::get();
+    const auto stamp = ImportCache::stamp_file(file_name);
+    const auto parameters = get_import_parameters();
+    evicted = false;
+    from_bundle = false;
+    ++generation;
+
+    const auto shared = cache.find_compiled(stamp, parameters);
+    if (shared.has_value()) {
+        midi_events = shared->events;
+        index = shared->index;
+        tempo_detected = shared->tempo_detected;
+        ticks_per_measure = shared->ticks_per_measure;
+        return !midi_events->empty();
+    }
+
     //  Keep large structure off of stack
     std::unique_ptr<SyndineImporter> local_importer;
     if (nullptr == importer) {
         local_importer = std::make_unique<SyndineImporter>(
-            file_name.ToStdString(), song_id);
+            cache.get_parsed_file(stamp, file_name), song_id);
         importer = local_importer.get();
     }
     tempo_detected = importer->get_tempo();
+    ticks_per_measure = importer->get_ticks_per_measure();
     importer->set_bank_config(starting_config.memory,
                               starting_config.mode);
 
@@ -56,12 +73,91 @@ bool PlayListEntry::import_midi(SyndineImporter *importer)
     }
     importer->adjust_key(delta_pitch);
 
+    EventPool events;
     try {
-        midi_events = importer->get_events(gap_beats, last_note_multiplier);
+        events = importer->get_events(gap_beats, last_note_multiplier);
     } catch (std::out_of_range&) {
-        midi_events.clear();
+        events.clear();
+    }
+    midi_events = std::make_shared<const EventPool>(std::move(events));
+    build_index();
+    cache.store_compiled(stamp, parameters, {midi_events, index,
+                                             tempo_detected,
+                                             ticks_per_measure});
+    return !midi_events->empty();
+}
+
+
+void PlayListEntry::build_index()
+{
+    if (nullptr == midi_events) {
+        index.reset();
+        return;
+    }
+    index = std::make_shared<const SongIndex>(*midi_events, ticks_per_measure);
+}
+
+
+ImportParameters PlayListEntry::get_import_parameters() const
+{
+    return ImportParameters{tempo_requested, gap_beats, starting_config,
+                            delta_pitch, last_note_multiplier};
+}
+
+
+std::deque<OrganMidiEvent> PlayListEntry::get_play_events() const
+{
+    if (nullptr == midi_events) {
+        return {};
+    }
+
+    //  A shared song carries the ID of the entry that compiled it
+    std::deque<OrganMidiEvent> events(midi_events->begin(),
+                                      midi_events->end());
+    for (auto &event: events) {
+        event.m_song_id = song_id;
     }
-    return (midi_events.size() > 0U);
+    return events;
+}
+
+
+size_t PlayListEntry::get_event_count() const
+{
+    return (nullptr != midi_events) ? midi_events->size() : 0U;
+}
+
+
+void PlayListEntry::evict()
+{
+    //  Released once no other (identical) entry shares the song
+    midi_events.reset();
+    index.reset();
+    evicted = true;
+    ++generation;
+}
+
+
+bool PlayListEntry::adopt_events(PlayListEntry &&loaded,
+                                 const uint32_t from_generation)
+{
+    if (from_generation != generation) {
+        return false;
+    }
+
+    tempo_detected = loaded.tempo_detected;
+    ticks_per_measure = loaded.ticks_per_measure;
+    midi_events = std::move(loaded.midi_events);
+    index = std::move(loaded.index);
+    evicted = false;
+    ++generation;
+    return true;
+}
+
+
+size_t PlayListEntry::get_memory_bytes() const
+{
+    return ((nullptr != midi_events) ? midi_events->get_memory_bytes() : 0U) +
+           ((nullptr != index) ? index->get_memory_bytes() : 0U);
 }
 
 
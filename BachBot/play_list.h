@@ -29,7 +29,8 @@
 
 //  system includes
 #include <cstdint>  //  uint32_t
-#include <list>  //  std::list
+#include <deque>  //  std::deque
+#include <memory>  //  std::shared_ptr
 #include <optional>  //  std::optional
 #include <wx/wx.h>  //  wxString
 #include <wx/xml/xml.h>  //  wxXml API
@@ -38,9 +39,12 @@
 // -none-
 
 //  local includes
-#include "organ_midi_event.h"  //  OrganNote, BankConfig
+#include "organ_midi_event.h"  //  BankConfig
+#include "event_pool.h"  //  EventPool
 #include "main_window.h"  //  ui::LoadMidiDialog
 #include "syndyne_importer.h"  //  SyndineImporter
+#include "song_index.h"  //  SongIndex
+#include "import_cache.h"  //  ImportParameters
 
 namespace bach_bot {
 
@@ -62,10 +66,24 @@ struct PlayListEntry
 
     //  Actual song data
     std::optional<int> tempo_detected;
-    std::list<OrganNote> midi_events;
+    int ticks_per_measure;  ///< 0 if unknown
+    /** in play order, shared with identical entries (see `ImportCache`) */
+    std::shared_ptr<const EventPool> midi_events;
+    std::shared_ptr<const SongIndex> index;  ///< seek index of `midi_events`
+    /** `midi_events` and `index` were released to save memory */
+    bool evicted = false;
+    /** Incremented each time `midi_events` is replaced or released */
+    uint32_t generation = 0U;
+    /**
+     * `midi_events` came from a service bundle: `file_name` is only a label
+     * (it may not exist here), so the song is never evicted or re-imported
+     */
+    bool from_bundle = false;
 
     /**
      * @brief Load MIDI file and import events
+     * @note An identical entry's compiled song is shared if there is one.
+     *       The song is no longer `from_bundle` afterwards.
      * @param importer optionally provide an already allocated SyndineImporter
      *        instance to use to load events
      * @retval `false` song not loaded
@@ -73,6 +91,53 @@ struct PlayListEntry
      */
     bool import_midi(SyndineImporter *importer=nullptr);
 
+    /**
+     * @brief (Re-)build the seek index after `midi_events` has changed.
+     */
+    void build_index();
+
+    /**
+     * @brief Get the configuration items that affect the compiled song
+     */
+    ImportParameters get_import_parameters() const;
+
+    /**
+     * @brief Copy the compiled song for the player.
+     * @returns events in play order, tagged with this entry's song ID
+     */
+    std::deque<OrganMidiEvent> get_play_events() const;
+
+    /**
+     * @brief Get the number of compiled events (0 if not loaded)
+     */
+    size_t get_event_count() const;
+
+    /**
+     * @brief Release the compiled song, keeping the configuration.
+     * @note `import_midi` (or `adopt_events`) makes the song playable again.
+     */
+    void evict();
+
+    /**
+     * @brief Take the compiled song from a copy of this entry re-imported
+     *        in the background (after eviction or a change to the file).
+     * @param loaded re-imported copy of this entry
+     * @param from_generation `generation` of this entry when the copy was
+     *        made
+     * @retval `true` events adopted
+     * @retval `false` entry was evicted, re-imported or re-configured since
+     *         the copy was made
+     */
+    bool adopt_events(PlayListEntry &&loaded,
+                      const uint32_t from_generation);
+
+    /**
+     * @brief Get the memory held by the compiled song
+     * @returns size (bytes), 0 if evicted
+     * @note Includes memory shared with identical entries.
+     */
+    size_t get_memory_bytes() const;
+
     /**
      * @brief Load the playlist configuration into the song_entry structure
      * @param playlist_node XML node for data
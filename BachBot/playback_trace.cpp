@@ -0,0 +1,115 @@
+/**
+ * @file playback_trace.cpp
+ * @brief Low overhead playback trace capture
+ * @copyright
+ * 2022 Andrew Buettner (ABi)
+ *
+ * @section LICENSE
+ *
+ * BachBot - A hymn Midi player for Schlicker organs
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+//  system includes
+#include <algorithm>  //  std::min
+#include <chrono>  //  std::chrono::milliseconds
+#include <cstring>  //  std::memcpy
+#include <filesystem>  //  std::filesystem::u8path
+#include <stdexcept>  //  std::runtime_error
+#include <fmt/format.h>  //  fmt::format
+
+//  module includes
+// -none-
+
+//  local includes
+#include "playback_trace.h"  //  local include
+
+
+namespace bach_bot {
+
+PlaybackTrace::PlaybackTrace(const std::string &file_name) :
+    m_file_name(file_name),
+    m_output(std::filesystem::u8path(file_name),
+             std::ios::binary | std::ios::trunc),
+    m_ring(RING_SIZE),
+    m_head{0U},
+    m_tail{0U},
+    m_dropped{0U},
+    m_stop{false},
+    m_writer()
+{
+    if (!m_output) {
+        throw std::runtime_error(fmt::format("Unable to create \"{}\"",
+                                             file_name));
+    }
+
+    TraceFileHeader header{};
+    std::memcpy(header.magic, TRACE_FILE_MAGIC, sizeof(header.magic));
+    header.version = TRACE_FILE_VERSION;
+    header.record_size = uint32_t(sizeof(TraceRecord));
+    m_output.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+    m_writer = std::thread(&PlaybackTrace::writer_loop, this);
+}
+
+
+PlaybackTrace::~PlaybackTrace()
+{
+    m_stop = true;
+    if (m_writer.joinable()) {
+        m_writer.join();
+    }
+}
+
+
+void PlaybackTrace::writer_loop()
+{
+    while (!m_stop) {
+        std::this_thread::sleep_for(
+            std::chrono::milliseconds(WRITER_PERIOD_MS));
+        drain();
+    }
+
+    //  Pick up anything recorded between the last drain and the stop.
+    drain();
+    m_output.flush();
+}
+
+
+void PlaybackTrace::drain()
+{
+    const auto head = m_head.load(std::memory_order_acquire);
+    auto tail = m_tail.load(std::memory_order_relaxed);
+
+    //  Write in (at most) 2 contiguous blocks - before and after the wrap.
+    while (tail != head) {
+        const auto index = tail & (RING_SIZE - 1U);
+        const auto count = std::min(head - tail, RING_SIZE - index);
+        m_output.write(reinterpret_cast<const char*>(&m_ring[index]),
+                       std::streamsize(count * sizeof(TraceRecord)));
+        tail += count;
+        m_tail.store(tail, std::memory_order_release);
+    }
+
+    const auto dropped = m_dropped.exchange(0U, std::memory_order_relaxed);
+    if (dropped > 0U) {
+        TraceRecord record{};
+        record.type = TraceRecordType::TRACE_DROPPED;
+        record.queue_depth = dropped;
+        m_output.write(reinterpret_cast<const char*>(&record), sizeof(record));
+    }
+}
+
+}  //  end bach_bot
@@ -0,0 +1,125 @@
+/**
+ * @file playback_trace.h
+ * @brief Low overhead playback trace capture
+ * @copyright
+ * 2022 Andrew Buettner (ABi)
+ *
+ * @section LICENSE
+ *
+ * BachBot - A hymn Midi player for Schlicker organs
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @section DESCRIPTION
+ * The player thread must never wait on the disk.  Records are copied into a
+ * single-producer / single-consumer ring buffer (no locks, no allocation) and
+ * a separate, non real-time, writer thread periodically drains the ring to
+ * the trace file.  If the writer ever falls far enough behind for the ring
+ * to fill, new records are dropped (and counted) rather than blocking the
+ * player.
+ */
+
+#pragma once
+
+//  system includes
+#include <atomic>  //  std::atomic
+#include <cstdint>  //  uint32_t
+#include <fstream>  //  std::ofstream
+#include <string>  //  std::string
+#include <thread>  //  std::thread
+#include <vector>  //  std::vector
+
+//  module includes
+// -none-
+
+//  local includes
+#include "trace_format.h"  //  TraceRecord
+
+
+namespace bach_bot {
+
+/**
+ * @brief Playback trace file writer.
+ */
+class PlaybackTrace
+{
+public:
+    /** Ring buffer capacity in records (must be a power of 2) */
+    static constexpr const size_t RING_SIZE = 16384U;
+
+    /** How often the writer thread drains the ring */
+    static constexpr const auto WRITER_PERIOD_MS = 50;
+
+    /**
+     * @brief Constructor - create the trace file and start the writer.
+     * @param file_name trace file to create (UTF-8)
+     * @throws std::runtime_error file can not be created
+     */
+    explicit PlaybackTrace(const std::string &file_name);
+
+    /**
+     * @brief Destructor - stop the writer after writing all records.
+     */
+    ~PlaybackTrace();
+
+    PlaybackTrace(const PlaybackTrace &) = delete;
+    PlaybackTrace &operator=(const PlaybackTrace &) = delete;
+
+    /**
+     * @brief Add a record to the trace.
+     * @param record record to add
+     * @note Must only be called from one thread (the player).  Never blocks.
+     */
+    void record(const TraceRecord &record)
+    {
+        const auto head = m_head.load(std::memory_order_relaxed);
+        if (head - m_tail.load(std::memory_order_acquire) >= RING_SIZE) {
+            m_dropped.fetch_add(1U, std::memory_order_relaxed);
+            return;
+        }
+
+        m_ring[head & (RING_SIZE - 1U)] = record;
+        m_head.store(head + 1U, std::memory_order_release);
+    }
+
+    /**
+     * @brief Get the trace file name
+     */
+    const std::string &get_file_name() const
+    {
+        return m_file_name;
+    }
+
+private:
+    /**
+     * @brief Writer thread function
+     */
+    void writer_loop();
+
+    /**
+     * @brief Write all records currently in the ring to the file.
+     */
+    void drain();
+
+    const std::string m_file_name;
+    std::ofstream m_output;
+    std::vector<TraceRecord> m_ring;
+    std::atomic<size_t> m_head;  ///< next record to write (player)
+    std::atomic<size_t> m_tail;  ///< next record to read (writer)
+    std::atomic<uint32_t> m_dropped;  ///< records lost since last drain
+    std::atomic<bool> m_stop;
+    std::thread m_writer;
+};
+
+}  //  end bach_bot
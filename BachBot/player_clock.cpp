@@ -0,0 +1,129 @@
+/**
+ * @file player_clock.cpp
+ * @brief Time sources for the MIDI player
+ * @copyright
+ * 2022 Andrew Buettner (ABi)
+ *
+ * @section LICENSE
+ *
+ * BachBot - A hymn Midi player for Schlicker organs
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+//  system includes
+// -none-
+
+//  module includes
+// -none-
+
+//  local includes
+#include "player_clock.h"  //  local include
+
+
+namespace bach_bot {
+
+RealTimeClock::RealTimeClock() :
+    PlayerClock(),
+    m_epoch_ns{get_monotonic_ns()}
+{
+}
+
+
+int64_t RealTimeClock::get_ns() const
+{
+    return get_monotonic_ns() - m_epoch_ns;
+}
+
+
+VirtualClock::VirtualClock() :
+    PlayerClock(),
+    m_now_ns{0}
+{
+}
+
+
+int64_t VirtualClock::get_ns() const
+{
+    return m_now_ns;
+}
+
+
+void VirtualClock::advance(const wxLongLong delta_us)
+{
+    m_now_ns += delta_us.GetValue() * NS_PER_US;
+}
+
+
+PlayerStopWatch::PlayerStopWatch(const PlayerClock &clock) :
+    m_clock(clock),
+    m_anchor_ns{clock.get_ns()},
+    m_anchor_elapsed_ns{0},
+    m_rate_percent{100U}
+{
+}
+
+
+void PlayerStopWatch::start(const wxLongLong &start_us)
+{
+    m_anchor_ns = m_clock.get_ns();
+    m_anchor_elapsed_ns = start_us.GetValue() * NS_PER_US;
+}
+
+
+long PlayerStopWatch::get_ms() const
+{
+    return long(get_ns() / NS_PER_MS);
+}
+
+
+wxLongLong PlayerStopWatch::get_us() const
+{
+    return wxLongLong(get_ns() / NS_PER_US);
+}
+
+
+int64_t PlayerStopWatch::get_ns() const
+{
+    return elapsed_at(m_clock.get_ns());
+}
+
+
+void PlayerStopWatch::set_rate(const uint32_t rate_percent)
+{
+    //  Re-anchor so that the elapsed time is continuous across the change;
+    // both come from the one clock sample so no time is counted twice.
+    const auto now_ns = m_clock.get_ns();
+    m_anchor_elapsed_ns = elapsed_at(now_ns);
+    m_anchor_ns = now_ns;
+    m_rate_percent = rate_percent;
+}
+
+
+void PlayerStopWatch::rebase(const wxLongLong &origin_us)
+{
+    m_anchor_elapsed_ns -= origin_us.GetValue() * NS_PER_US;
+}
+
+
+int64_t PlayerStopWatch::elapsed_at(const int64_t now_ns) const
+{
+    const auto delta_ns = now_ns - m_anchor_ns;
+    if (100U == m_rate_percent) {
+        return m_anchor_elapsed_ns + delta_ns;
+    }
+    return m_anchor_elapsed_ns + delta_ns * int64_t(m_rate_percent) / 100;
+}
+
+}  //  end bach_bot
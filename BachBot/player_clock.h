@@ -0,0 +1,188 @@
+/**
+ * @file player_clock.h
+ * @brief Time sources for the MIDI player
+ * @copyright
+ * 2022 Andrew Buettner (ABi)
+ *
+ * @section LICENSE
+ *
+ * BachBot - A hymn Midi player for Schlicker organs
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @section DESCRIPTION
+ * The player measures song time and the bank change hold-off against a clock
+ * rather than directly against `wxStopWatch`.  During normal playback this is
+ * the system's monotonic time, but the simulator substitutes a clock that
+ * only moves when it is told to so that an entire service can be run as fast
+ * as the CPU allows.
+ *
+ * Time is kept in nanoseconds; the microsecond accessors used by the song
+ * logic are derived from it, so nothing is rounded until it is read.
+ */
+
+#pragma once
+
+//  system includes
+#include <cstdint>  //  uint32_t, int64_t
+#include <wx/wx.h>  //  wxLongLong
+
+//  module includes
+// -none-
+
+//  local includes
+#include "monotonic_clock.h"  //  get_monotonic_ns, NS_PER_US
+
+
+namespace bach_bot {
+
+/**
+ * @brief Abstract monotonic time source.
+ */
+class PlayerClock
+{
+public:
+    /**
+     * @brief Get the current time
+     * @returns time in nanoseconds since an arbitrary (fixed) epoch
+     */
+    virtual int64_t get_ns() const = 0;
+
+    /**
+     * @brief Get the current time
+     * @returns time in microseconds since the same epoch as `get_ns`
+     */
+    wxLongLong get_us() const
+    {
+        return wxLongLong(get_ns() / NS_PER_US);
+    }
+
+    virtual ~PlayerClock() = default;
+};
+
+
+/**
+ * @brief Wall clock time source (used for actual playback).
+ */
+class RealTimeClock : public PlayerClock
+{
+public:
+    RealTimeClock();
+
+    virtual int64_t get_ns() const override;
+
+private:
+    const int64_t m_epoch_ns;  ///< monotonic time at construction
+};
+
+
+/**
+ * @brief Simulated time source, time only moves when advanced.
+ */
+class VirtualClock : public PlayerClock
+{
+public:
+    VirtualClock();
+
+    virtual int64_t get_ns() const override;
+
+    /**
+     * @brief Move time forward
+     * @param delta_us time to advance by in microseconds
+     */
+    void advance(const wxLongLong delta_us);
+
+private:
+    int64_t m_now_ns;
+};
+
+
+/**
+ * @brief Stopwatch measuring elapsed time against a `PlayerClock`.
+ * @note Mirrors the parts of `wxStopWatch` used by the player, with the
+ *       addition of a rate:  elapsed time may run faster or slower than the
+ *       clock.  Changing the rate never makes the elapsed time jump.
+ */
+class PlayerStopWatch
+{
+public:
+    /**
+     * @brief Constructor - the stopwatch is started immediately.
+     * @param clock time source, must outlive this object
+     */
+    explicit PlayerStopWatch(const PlayerClock &clock);
+
+    /**
+     * @brief (Re-)start the stopwatch
+     * @param start_us initial elapsed time in microseconds
+     */
+    void start(const wxLongLong &start_us=0);
+
+    /**
+     * @brief Get the elapsed time
+     * @returns milliseconds since `start`
+     */
+    long get_ms() const;
+
+    /**
+     * @brief Get the elapsed time
+     * @returns microseconds since `start`
+     */
+    wxLongLong get_us() const;
+
+    /**
+     * @brief Get the elapsed time
+     * @returns nanoseconds since `start`
+     */
+    int64_t get_ns() const;
+
+    /**
+     * @brief Change how fast elapsed time runs.
+     * @param rate_percent elapsed time per clock time (100 = real time)
+     * @note Takes effect from now; time already elapsed is unchanged.
+     */
+    void set_rate(const uint32_t rate_percent);
+
+    /**
+     * @brief Move the origin of elapsed time without stopping the stopwatch.
+     * @param origin_us elapsed time that becomes the new zero (microseconds)
+     * @note Unlike `start`, no time is lost between the old and new time
+     *       base, which keeps back-to-back songs on one continuous timeline.
+     */
+    void rebase(const wxLongLong &origin_us);
+
+    /**
+     * @brief Get how fast elapsed time runs.
+     * @returns elapsed time per clock time (100 = real time)
+     */
+    uint32_t get_rate() const
+    {
+        return m_rate_percent;
+    }
+
+private:
+    /**
+     * @brief Get the elapsed time at a given clock time.
+     * @param now_ns clock time (nanoseconds)
+     * @returns elapsed time at `now_ns` (nanoseconds, at the playback rate)
+     */
+    int64_t elapsed_at(const int64_t now_ns) const;
+
+    const PlayerClock &m_clock;
+    int64_t m_anchor_ns;  ///< clock time of the last start/rate change
+    int64_t m_anchor_elapsed_ns;  ///< elapsed time at `m_anchor_ns`
+    uint32_t m_rate_percent;
+};
+
+}  //  end bach_bot
@@ -0,0 +1,440 @@
+/**
+ * @file player_service.cpp
+ * @brief GUI-free control of the player engine
+ * @copyright
+ * 2022 Andrew Buettner (ABi)
+ *
+ * @section LICENSE
+ *
+ * BachBot - A hymn Midi player for Schlicker organs
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+
+//  system includes
+#include <algorithm>  //  std::min
+#include <iterator>  //  std::make_move_iterator
+#include <list>  //  std::list
+#include <sstream>  //  std::istringstream
+#include <stdexcept>  //  std::runtime_error
+#include <fmt/format.h>  //  fmt::format
+
+//  module includes
+// -none-
+
+//  local includes
+#include "player_service.h"  //  local include
+#include "player_window.h"  //  PlayerWindowEvents
+#include "player_clock.h"  //  RealTimeClock
+#include "playlist_reader.h"  //  PlaylistReader
+#include "port_sender.h"  //  PortSender
+#include "latency_profile.h"  //  load_latency_profile
+#include "syndyne_importer.h"  //  generate_test_pattern
+#include "midi_interface.h"  //  RtMidiOut
+
+
+namespace {
+
+/** Characters separating command words */
+constexpr const auto COMMAND_SPACE = " \t\r";
+
+/**
+ * @brief Split a command line into its verb and the rest of the line.
+ * @param line command line
+ * @returns verb, arguments (both trimmed)
+ */
+std::pair<std::string, std::string> split_command(const std::string &line)
+{
+    const auto start = line.find_first_not_of(COMMAND_SPACE);
+    if (std::string::npos == start) {
+        return {};
+    }
+
+    const auto verb_end = line.find_first_of(COMMAND_SPACE, start);
+    const auto verb = line.substr(start, verb_end - start);
+    const auto arg_start = line.find_first_not_of(COMMAND_SPACE, verb_end);
+    if (std::string::npos == arg_start) {
+        return {verb, std::string()};
+    }
+    const auto arg_end = line.find_last_not_of(COMMAND_SPACE);
+    return {verb, line.substr(arg_start, arg_end + 1U - arg_start)};
+}
+
+}  //  end anonymous namespace
+
+
+namespace bach_bot {
+
+/**
+ * @brief Player thread that reports to the service instead of a window.
+ */
+class PlayerService::ServicePlayer : public PlayerThread
+{
+public:
+    ServicePlayer(PortList ports, PlayerService &service) :
+        PlayerThread(nullptr, std::move(ports),
+                     std::make_unique<RealTimeClock>()),
+        m_service(service)
+    {
+    }
+
+protected:
+    virtual void post_ui_event(const wxThreadEvent &event) override
+    {
+        m_service.post_player_event(event.GetId(), event.GetInt());
+    }
+
+private:
+    PlayerService &m_service;
+};
+
+
+PlayerService::PlayerService(std::vector<uint32_t> ports,
+                             StatusCallback on_status,
+                             WakeCallback wake) :
+    m_ports(std::move(ports)),
+    m_on_status(std::move(on_status)),
+    m_wake(std::move(wake)),
+    m_playlist(),
+    m_current_song_id{0U},
+    m_next_song_id{0U},
+    m_current_event_count{0U},
+    m_events_done{0U},
+    m_bank_config(),
+    m_player(),
+    m_event_mutex(),
+    m_event_posted(),
+    m_events()
+{
+}
+
+
+PlayerService::~PlayerService()
+{
+    stop();
+}
+
+
+std::string PlayerService::execute(const std::string &command)
+{
+    const auto [verb, arguments] = split_command(command);
+    try {
+        if ("load" == verb) {
+            return load(arguments);
+        } else if ("play" == verb) {
+            return play();
+        } else if ("stop" == verb) {
+            stop();
+            return "ok";
+        } else if ("next" == verb) {
+            return set_next(arguments);
+        } else if ("bank" == verb) {
+            return set_bank(arguments);
+        } else if ("status" == verb) {
+            return get_status();
+        }
+    } catch (const std::exception &e) {
+        //  Import / playlist / MIDI port errors
+        return fmt::format("error {}", e.what());
+    }
+
+    return fmt::format("error unknown command \"{}\"", verb);
+}
+
+
+void PlayerService::process_player_events()
+{
+    std::deque<std::pair<int, int>> events;
+    {
+        std::lock_guard<std::mutex> lock(m_event_mutex);
+        events.swap(m_events);
+    }
+
+    for (const auto &[id, value] : events) {
+        switch (id) {
+        case ui::PlayerWindowEvents::TICK_EVENT:
+            if (0U != m_current_song_id) {
+                //  The player reports the events still to play
+                m_events_done = m_current_event_count -
+                    std::min(m_current_event_count, size_t(value));
+                m_on_status(fmt::format(
+                    "event position song={} done={} total={}",
+                    m_current_song_id, m_events_done, m_current_event_count));
+            }
+            break;
+
+        case ui::PlayerWindowEvents::SONG_START_EVENT:
+            on_song_start(uint32_t(value));
+            break;
+
+        case ui::PlayerWindowEvents::SONG_END_EVENT:
+            on_song_end(0 != value);
+            break;
+
+        case ui::PlayerWindowEvents::BANK_CHANGE_EVENT:
+            m_bank_config = BankConfig(value);
+            m_on_status(fmt::format("event bank memory={} mode={}",
+                                    m_bank_config.memory,
+                                    m_bank_config.mode));
+            break;
+
+        case ui::PlayerWindowEvents::SONG_META_EVENT:
+            m_on_status(fmt::format("event meta code={}", value));
+            break;
+
+        case ui::PlayerWindowEvents::EXIT_EVENT:
+            finish_player();
+            break;
+
+        default:
+            break;
+        }
+    }
+}
+
+
+void PlayerService::stop()
+{
+    if (nullptr == m_player) {
+        return;
+    }
+
+    //  Runs until the player's exit notification has been handled.
+    m_player->signal_stop();
+    while (nullptr != m_player) {
+        {
+            std::unique_lock<std::mutex> lock(m_event_mutex);
+            m_event_posted.wait(lock, [this] { return !m_events.empty(); });
+        }
+        process_player_events();
+    }
+}
+
+
+void PlayerService::post_player_event(const int id, const int value)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_event_mutex);
+        m_events.emplace_back(id, value);
+    }
+    m_event_posted.notify_one();
+    m_wake();
+}
+
+
+std::string PlayerService::load(const std::string &file_name)
+{
+    if (nullptr != m_player) {
+        return "error stop playback first";
+    } else if (file_name.empty()) {
+        return "error no playlist given";
+    }
+
+    //  Each song imports as soon as its entry has been read
+    PlaylistReader reader(wxString::FromUTF8(file_name));
+    std::list<PlayListEntry> playlist;
+    for (auto song_id = 1U; ; ++song_id) {
+        PlayListEntry entry;
+        entry.song_id = song_id;
+        if (!reader.read_entry(entry)) {
+            break;
+        } else if (!entry.import_midi()) {
+            throw std::runtime_error(fmt::format(
+                "Unable to import song: {}", entry.file_name.utf8_string()));
+        }
+        playlist.push_back(std::move(entry));
+    }
+    reader.order_playlist(playlist);
+
+    m_playlist.assign(std::make_move_iterator(playlist.begin()),
+                      std::make_move_iterator(playlist.end()));
+    m_current_song_id = 0U;
+    set_next_song(m_playlist.empty() ? 0U : 1U);
+    return fmt::format("ok songs={}", m_playlist.size());
+}
+
+
+std::string PlayerService::play()
+{
+    if (nullptr != m_player) {
+        m_player->signal_advance();
+        return "ok advance";
+    } else if (m_ports.empty()) {
+        return "error no MIDI output port configured";
+    }
+
+    RtMidiOut midi_out;
+    const auto port_count = midi_out.getPortCount();
+    PlayerThread::PortList ports;
+    std::string organ_port;
+    for (const auto port : m_ports) {
+        const auto name = (port < port_count) ? midi_out.getPortName(port) :
+                                                std::string();
+        try {
+            ports.push_back(std::make_unique<PortSender>(port, name));
+        } catch (const std::runtime_error &e) {
+            if (ports.empty()) {
+                return fmt::format("error unable to open MIDI output {}: {}",
+                                   port, e.what());
+            }
+            //  A monitor port that fails to open shouldn't stop the service.
+            m_on_status(fmt::format("event warning monitor output {} "
+                                    "disabled: {}", port, e.what()));
+            continue;
+        }
+        if (organ_port.empty()) {
+            organ_port = name;
+        }
+    }
+
+    m_player = std::make_unique<ServicePlayer>(std::move(ports), *this);
+    m_player->set_latency_profile(load_latency_profile(organ_port));
+    m_player->set_bank_config(m_bank_config.memory, m_bank_config.mode);
+    if (0U != m_next_song_id) {
+        const auto &song = m_playlist[m_next_song_id - 1U];
+        m_player->enqueue_next_song(song.get_play_events(), song.index);
+    } else {
+        m_player->enqueue_next_song(generate_test_pattern());
+    }
+
+    m_player->play();
+    return fmt::format("ok playing song={}", m_next_song_id);
+}
+
+
+std::string PlayerService::set_next(const std::string &arguments)
+{
+    std::istringstream input(arguments);
+    auto song_id = 0L;
+    if (!(input >> song_id) || (song_id < 1L) ||
+        (size_t(song_id) > m_playlist.size()))
+    {
+        return fmt::format("error no song \"{}\" in the playlist", arguments);
+    }
+
+    set_next_song(uint32_t(song_id));
+    enqueue_autoplay();
+    return fmt::format("ok next={}", song_id);
+}
+
+
+std::string PlayerService::set_bank(const std::string &arguments)
+{
+    std::istringstream input(arguments);
+    auto memory = 0L;
+    auto mode = 0L;
+    if (!(input >> memory >> mode) || (memory < 1L) || (memory > 100L) ||
+        (mode < 1L) || (mode > 8L))
+    {
+        return "error expected: bank <memory 1-100> <mode 1-8>";
+    }
+
+    m_bank_config = BankConfig(uint32_t(memory), uint8_t(mode));
+    if (nullptr != m_player) {
+        m_player->set_bank_config(m_bank_config.memory, m_bank_config.mode);
+    }
+    m_on_status(fmt::format("event bank memory={} mode={}",
+                            m_bank_config.memory, m_bank_config.mode));
+    return fmt::format("ok memory={} mode={}", memory, mode);
+}
+
+
+std::string PlayerService::get_status() const
+{
+    return fmt::format(
+        "ok state={} song={} next={} done={} total={} memory={} mode={} "
+        "songs={}", (nullptr != m_player) ? "playing" : "stopped",
+        m_current_song_id, m_next_song_id, m_events_done,
+        m_current_event_count, m_bank_config.memory, m_bank_config.mode,
+        m_playlist.size());
+}
+
+
+void PlayerService::set_next_song(const uint32_t song_id)
+{
+    m_next_song_id = song_id;
+    m_on_status(fmt::format("event next song={}", song_id));
+}
+
+
+void PlayerService::enqueue_autoplay()
+{
+    if ((nullptr == m_player) || (0U == m_current_song_id) ||
+        (0U == m_next_song_id) ||
+        !m_playlist[m_current_song_id - 1U].play_next)
+    {
+        return;
+    }
+
+    const auto &song = m_playlist[m_next_song_id - 1U];
+    m_player->enqueue_next_song(song.get_play_events(), song.index);
+}
+
+
+void PlayerService::on_song_start(const uint32_t song_id)
+{
+    //  Song 0 (or unknown) is the test pattern
+    const auto known = (song_id > 0U) && (song_id <= m_playlist.size());
+    m_current_song_id = known ? song_id : 0U;
+    m_current_event_count = known ?
+        m_playlist[song_id - 1U].get_event_count() : 0U;
+    m_events_done = 0U;
+    if (!known) {
+        return;
+    }
+
+    m_on_status(fmt::format("event song_start song={} total={} file={}",
+                            song_id, m_current_event_count,
+                            m_playlist[song_id - 1U].file_name.utf8_string()));
+
+    //  As in the playlist window, the last song is followed by the first.
+    set_next_song((song_id < m_playlist.size()) ? song_id + 1U : 1U);
+    enqueue_autoplay();
+}
+
+
+void PlayerService::on_song_end(const bool completed)
+{
+    if (0U == m_current_song_id) {
+        return;
+    }
+
+    m_on_status(fmt::format("event song_end song={} completed={}",
+                            m_current_song_id, int(completed)));
+    if (!completed) {
+        //  Stopped part way: play it again next time.
+        set_next_song(m_current_song_id);
+    }
+    m_current_song_id = 0U;
+}
+
+
+void PlayerService::finish_player()
+{
+    if (nullptr == m_player) {
+        return;
+    }
+
+    //  The exit notification is the thread's last act, this is quick.
+    static_cast<void>(m_player->Wait());
+    m_player.reset();
+    m_current_song_id = 0U;
+    m_current_event_count = 0U;
+    m_events_done = 0U;
+    m_on_status("event stopped");
+}
+
+}  //  end bach_bot
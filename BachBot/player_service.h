@@ -0,0 +1,180 @@
+/**
+ * @file player_service.h
+ * @brief GUI-free control of the player engine
+ * @copyright
+ * 2022 Andrew Buettner (ABi)
+ *
+ * @section LICENSE
+ *
+ * BachBot - A hymn Midi player for Schlicker organs
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @section DESCRIPTION
+ * `PlayerService` does for a headless player what `PlayerWindow` does for
+ * the GUI: it owns the playlist, starts and stops the player thread, follows
+ * autoplay and keeps track of the organ's bank state.  It is driven by text
+ * commands, one per line, and reports what the player is doing as text
+ * status lines, so that any local process (a small GUI, a shell script) can
+ * run the service over a socket or pipe.
+ *
+ * Commands (replies are `ok [key=value ...]` or `error <reason>`):
+ *   load <playlist.bbp>    replace the playlist (only while stopped)
+ *   play                   play the next song, or Advance if playing
+ *   stop                   stop playing
+ *   next <song>            set the next song (playlist position from 1)
+ *   bank <memory> <mode>   tell the player the organ's current bank
+ *   status                 report the current state
+ *
+ * Status lines (sent unprompted):
+ *   event song_start song=<n> total=<events> file=<name>
+ *   event position song=<n> done=<events> total=<events>
+ *   event song_end song=<n> completed=<0|1>
+ *   event next song=<n>
+ *   event bank memory=<m> mode=<n>
+ *   event meta code=<n>
+ *   event warning <text>
+ *   event stopped
+ *
+ * The player thread only queues its notifications; they are turned into
+ * status lines (and autoplay is followed) on the controlling thread by
+ * `process_player_events`.  Nothing here touches wx event processing.
+ */
+
+#pragma once
+
+//  system includes
+#include <condition_variable>  //  std::condition_variable
+#include <cstdint>  //  uint32_t
+#include <deque>  //  std::deque
+#include <functional>  //  std::function
+#include <memory>  //  std::unique_ptr
+#include <mutex>  //  std::mutex
+#include <string>  //  std::string
+#include <utility>  //  std::pair
+#include <vector>  //  std::vector
+
+//  module includes
+// -none-
+
+//  local includes
+#include "play_list.h"  //  PlayListEntry
+#include "player_thread.h"  //  PlayerThread
+#include "organ_midi_event.h"  //  BankConfig
+
+
+namespace bach_bot {
+
+/**
+ * @brief Runs the player from text commands.
+ * @note Everything except the wake callback runs on one (controlling)
+ *       thread.
+ */
+class PlayerService
+{
+public:
+    /** Receives status lines (controlling thread) */
+    using StatusCallback = std::function<void(const std::string &line)>;
+
+    /** Called from the player thread when `process_player_events` has work */
+    using WakeCallback = std::function<void()>;
+
+    /**
+     * @brief Constructor
+     * @param ports MIDI output port numbers, the organ first then monitors
+     * @param on_status status line handler
+     * @param wake wake-up for the controlling thread (must not block)
+     */
+    PlayerService(std::vector<uint32_t> ports,
+                  StatusCallback on_status,
+                  WakeCallback wake);
+
+    /**
+     * @brief Destructor - stops playback.
+     */
+    ~PlayerService();
+
+    PlayerService(const PlayerService &) = delete;
+    PlayerService &operator=(const PlayerService &) = delete;
+
+    /**
+     * @brief Run a command.
+     * @param command command line (without the line ending)
+     * @returns reply line
+     */
+    std::string execute(const std::string &command);
+
+    /**
+     * @brief Handle notifications queued by the player thread.
+     */
+    void process_player_events();
+
+    /**
+     * @brief Stop playback (if playing) and wait for the player to exit.
+     */
+    void stop();
+
+private:
+    class ServicePlayer;
+
+    /**
+     * @brief Queue a player notification (player thread).
+     * @param id `PlayerWindowEvents` id
+     * @param value event value
+     */
+    void post_player_event(const int id, const int value);
+
+    std::string load(const std::string &file_name);
+    std::string play();
+    std::string set_next(const std::string &arguments);
+    std::string set_bank(const std::string &arguments);
+    std::string get_status() const;
+
+    /**
+     * @brief Change the next song and report it.
+     * @param song_id next song (0: none)
+     */
+    void set_next_song(const uint32_t song_id);
+
+    /**
+     * @brief Hand the next song to the player if the current one autoplays.
+     */
+    void enqueue_autoplay();
+
+    void on_song_start(const uint32_t song_id);
+    void on_song_end(const bool completed);
+
+    /**
+     * @brief Release the player once its thread has exited.
+     */
+    void finish_player();
+
+    const std::vector<uint32_t> m_ports;
+    StatusCallback m_on_status;
+    WakeCallback m_wake;
+
+    std::vector<PlayListEntry> m_playlist;  ///< `song_id` is position + 1
+    uint32_t m_current_song_id;  ///< 0: nothing playing
+    uint32_t m_next_song_id;  ///< 0: nothing queued
+    size_t m_current_event_count;
+    size_t m_events_done;
+    BankConfig m_bank_config;  ///< organ state as last reported
+    std::unique_ptr<ServicePlayer> m_player;
+
+    std::mutex m_event_mutex;  ///< protects `m_events`
+    std::condition_variable m_event_posted;
+    std::deque<std::pair<int, int>> m_events;  ///< from the player thread
+};
+
+}  //  end bach_bot
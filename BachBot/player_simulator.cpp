@@ -0,0 +1,296 @@
+/**
+ * @file player_simulator.cpp
+ * @brief Faster than real-time playback of a service
+ * @copyright
+ * 2022 Andrew Buettner (ABi)
+ *
+ * @section LICENSE
+ *
+ * BachBot - A hymn Midi player for Schlicker organs
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+//  system includes
+#include <filesystem>  //  std::filesystem::u8path
+#include <fstream>  //  std::ofstream
+#include <utility>  //  std::move
+#include <stdexcept>  //  std::runtime_error
+#include <fmt/format.h>  //  fmt::format
+
+//  module includes
+// -none-
+
+//  local includes
+#include "player_simulator.h"  //  local include
+#include "player_window.h"  //  PlayerWindowEvents
+
+
+namespace {
+
+/**
+ * @brief Format a time stamp as `HH:MM:SS.mmm`
+ */
+std::string format_time(const wxLongLong &time_us)
+{
+    const auto ms = time_us.GetValue() / 1000LL;
+    return fmt::format("{:02}:{:02}:{:02}.{:03}", ms / 3600000LL,
+                       (ms / 60000LL) % 60LL, (ms / 1000LL) % 60LL,
+                       ms % 1000LL);
+}
+
+
+const char *bank_command_name(const uint8_t value)
+{
+    switch (value) {
+    case bach_bot::SyndyneBankCommands::GENERAL_CANCEL:
+        return "GENERAL_CANCEL";
+
+    case bach_bot::SyndyneBankCommands::PREV_BANK:
+        return "PREV_BANK";
+
+    case bach_bot::SyndyneBankCommands::NEXT_BANK:
+        return "NEXT_BANK";
+
+    default:
+        return "UNKNOWN";
+    }
+}
+
+}  //  end anonymous namespace
+
+
+namespace bach_bot {
+
+PlayerSimulator::PlayerSimulator(std::vector<SimulatedSong> songs,
+                                 const BankConfig &starting_config) :
+    PlayerThread(nullptr, PortList(), std::make_unique<VirtualClock>()),
+    m_clock(static_cast<VirtualClock&>(get_clock())),
+    m_songs(std::move(songs)),
+    m_next_song{0U},
+    m_stall_deadline_us{0},
+    m_log(),
+    m_songs_played{0U},
+    m_midi_messages{0U},
+    m_bank_changes{0U},
+    m_forced_advances{0U},
+    m_last_bank_change_us(),
+    m_min_bank_spacing_us(),
+    m_wall_time_us{0}
+{
+    set_bank_config(starting_config.memory, starting_config.mode);
+}
+
+
+void PlayerSimulator::run()
+{
+    wxStopWatch wall_time;
+    m_next_song = 0U;
+    while (m_next_song < m_songs.size()) {
+        const auto &song = m_songs[m_next_song++];
+        if ((nullptr == song.midi_events) || song.midi_events->empty()) {
+            log(fmt::format("song {} has no events, skipped", song.song_id));
+            continue;
+        }
+
+        log(fmt::format("operator starts song {}", song.song_id));
+        enqueue_song(song);
+        play_songs();
+    }
+
+    log("service complete");
+    m_wall_time_us = wall_time.TimeInMicro();
+}
+
+
+void PlayerSimulator::save_log(const std::string &file_name) const
+{
+    std::ofstream output(std::filesystem::u8path(file_name), std::ios::trunc);
+    if (!output) {
+        throw std::runtime_error(fmt::format("Unable to create \"{}\"",
+                                             file_name));
+    }
+
+    for (const auto &entry : m_log) {
+        output << format_time(entry.time_us) << "  " << entry.text << "\n";
+    }
+    output << "\n" << get_summary().utf8_string() << "\n";
+
+    if (!output) {
+        throw std::runtime_error(fmt::format("Error writing \"{}\"",
+                                             file_name));
+    }
+}
+
+
+wxString PlayerSimulator::get_summary() const
+{
+    const auto simulated_us = m_clock.get_us();
+    const auto speed = (m_wall_time_us > 0) ?
+        simulated_us.ToDouble() / m_wall_time_us.ToDouble() : 0.0;
+    const auto min_spacing = m_min_bank_spacing_us.has_value() ?
+        fmt::format("{:.1f} ms", m_min_bank_spacing_us->ToDouble() / 1000.0) :
+        std::string("n/a");
+
+    return fmt::format(
+        "Simulated {} of playback in {:.3f} s ({:.0f}x real-time)\n"
+        "Songs played: {} of {}\n"
+        "MIDI messages: {}\n"
+        "Bank changes: {} (minimum spacing {}, required {} ms)\n"
+        "Forced advances (stalled songs): {}",
+        format_time(simulated_us), m_wall_time_us.ToDouble() / 1000000.0,
+        speed, m_songs_played, m_songs.size(), m_midi_messages,
+        m_bank_changes, min_spacing, MINIMUM_BANK_CHANGE_INTERVAL_MS,
+        m_forced_advances);
+}
+
+
+void PlayerSimulator::send_midi(const uint8_t *const midi_message,
+                                const size_t size)
+{
+    ++m_midi_messages;
+    const auto is_bank_change = (MIDI_MESSAGE_SIZE == size) &&
+        (make_midi_command_byte(0U, MidiCommands::CONTROL_CHANGE) ==
+            midi_message[0]) &&
+        (SYNDYNE_CONTROLLER_ID == midi_message[1]);
+
+    if (is_bank_change) {
+        const auto now = m_clock.get_us();
+        if (m_last_bank_change_us.has_value()) {
+            const auto spacing = now - *m_last_bank_change_us;
+            if (!m_min_bank_spacing_us.has_value() ||
+                (spacing < *m_min_bank_spacing_us)) {
+                m_min_bank_spacing_us = spacing;
+            }
+        }
+        m_last_bank_change_us = now;
+        ++m_bank_changes;
+        log(fmt::format("bank {}", bank_command_name(midi_message[2])));
+        return;
+    }
+
+    std::string text("MIDI");
+    for (auto i = 0U; i < size; ++i) {
+        text += fmt::format(" {:02X}", midi_message[i]);
+    }
+    log(std::move(text));
+}
+
+
+void PlayerSimulator::post_ui_event(const wxThreadEvent &event)
+{
+    switch (event.GetId()) {
+    case ui::PlayerWindowEvents::SONG_START_EVENT:
+        on_song_start(uint32_t(event.GetInt()));
+        break;
+
+    case ui::PlayerWindowEvents::SONG_END_EVENT:
+        log(fmt::format("song end ({})",
+                        (0 != event.GetInt()) ? "complete" : "stopped"));
+        break;
+
+    case ui::PlayerWindowEvents::BANK_CHANGE_EVENT: {
+        const BankConfig config(event.GetInt());
+        log(fmt::format("organ at memory {} mode {}", config.memory,
+                        config.mode));
+        break;
+    }
+
+    case ui::PlayerWindowEvents::SONG_META_EVENT:
+        log(fmt::format("meta event {}", event.GetInt()));
+        break;
+
+    default:
+        //  Progress ticks and exit aren't outputs
+        break;
+    }
+}
+
+
+void PlayerSimulator::wait_for_tick()
+{
+    m_clock.advance(TICK_US);
+    if (m_clock.get_us() > m_stall_deadline_us) {
+        ++m_forced_advances;
+        log("song stalled, operator presses Advance");
+        m_stall_deadline_us = m_clock.get_us() + STALL_LIMIT_US;
+        queue_message(MessageId::ADVANCE_MESSAGE);
+    } else {
+        queue_message(MessageId::TICK_MESSAGE);
+    }
+}
+
+
+void PlayerSimulator::precache_next_song(const uint32_t song_id)
+{
+    log(fmt::format("last note of song {}", song_id));
+}
+
+
+void PlayerSimulator::log(std::string text)
+{
+    m_log.push_back({m_clock.get_us(), std::move(text)});
+}
+
+
+void PlayerSimulator::on_song_start(const uint32_t song_id)
+{
+    ++m_songs_played;
+    const auto index = find_song(song_id);
+    if (index >= m_songs.size()) {
+        log(fmt::format("song start {} (not in playlist)", song_id));
+        return;
+    }
+
+    const auto &song = m_songs[index];
+    log(fmt::format("song start {} \"{}\"", song_id,
+                    song.file_name.utf8_string()));
+
+    const auto &last_event = song.midi_events->back();
+    m_stall_deadline_us = m_clock.get_us() + last_event.get_us() +
+                          STALL_LIMIT_US;
+
+    m_next_song = index + 1U;
+    if (song.autoplay && (m_next_song < m_songs.size())) {
+        const auto &next_song = m_songs[m_next_song++];
+        log(fmt::format("autoplay queues song {}", next_song.song_id));
+        enqueue_song(next_song);
+    }
+}
+
+
+void PlayerSimulator::enqueue_song(const SimulatedSong &song)
+{
+    //  A shared song carries the ID of the entry that compiled it
+    std::deque<OrganMidiEvent> events(song.midi_events->begin(),
+                                      song.midi_events->end());
+    for (auto &event: events) {
+        event.m_song_id = song.song_id;
+    }
+    enqueue_next_song(std::move(events));
+}
+
+
+size_t PlayerSimulator::find_song(const uint32_t song_id) const
+{
+    auto index = 0U;
+    for (; index < m_songs.size(); ++index) {
+        if (song_id == m_songs[index].song_id) {
+            break;
+        }
+    }
+    return index;
+}
+
+}  //  end bach_bot
@@ -0,0 +1,180 @@
+/**
+ * @file player_simulator.h
+ * @brief Faster than real-time playback of a service
+ * @copyright
+ * 2022 Andrew Buettner (ABi)
+ *
+ * @section LICENSE
+ *
+ * BachBot - A hymn Midi player for Schlicker organs
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @section DESCRIPTION
+ * The simulator runs the player's song, note and bank change logic
+ * (`run_song`, `process_notes`, `do_mode_check`) against a virtual clock on
+ * the calling thread.  Instead of waiting on the real-time timer, each time
+ * the player would block for a tick the clock is advanced by one timer
+ * period and a tick is delivered immediately.  Every MIDI message and UI
+ * notification is recorded with its (simulated) time stamp.
+ *
+ * The simulation plays the whole playlist in order.  Autoplay chains are
+ * followed exactly as the UI would follow them; when a chain ends the next
+ * song is started straight away as if the operator had pressed Play.
+ */
+
+#pragma once
+
+//  system includes
+#include <cstdint>  //  uint32_t
+#include <deque>  //  std::deque
+#include <memory>  //  std::shared_ptr
+#include <optional>  //  std::optional
+#include <string>  //  std::string
+#include <vector>  //  std::vector
+#include <wx/wx.h>  //  wxString, wxLongLong
+
+//  module includes
+// -none-
+
+//  local includes
+#include "player_thread.h"  //  PlayerThread
+#include "player_clock.h"  //  VirtualClock
+#include "organ_midi_event.h"  //  OrganMidiEvent, BankConfig
+#include "event_pool.h"  //  EventPool
+
+
+namespace bach_bot {
+
+/**
+ * @brief Single song to be played by the simulator.
+ */
+struct SimulatedSong
+{
+    uint32_t song_id;  ///< playlist song ID
+    wxString file_name;  ///< used for the log only
+    /** compiled song events (may be shared with other playlist entries) */
+    std::shared_ptr<const EventPool> midi_events;
+    bool autoplay;  ///< automatically continue to the next song
+};
+
+
+/**
+ * @brief Time stamped simulator output.
+ */
+struct SimulationLogEntry
+{
+    wxLongLong time_us;  ///< simulated time
+    std::string text;  ///< description of the output
+};
+
+
+/**
+ * @brief Runs a playlist through the player logic using simulated time.
+ */
+class PlayerSimulator : public PlayerThread
+{
+public:
+    /** Simulated timer period (matches the real-time timer) */
+    static constexpr const auto TICK_US = 1000L;
+
+    /**
+     * @brief Time a song may run beyond its last event before the simulated
+     *        operator presses Advance (eg bank never matches).
+     */
+    static constexpr const auto STALL_LIMIT_US = 300000000L;
+
+    /**
+     * @brief Constructor
+     * @param songs songs in playlist order
+     * @param starting_config organ bank configuration before the service
+     */
+    PlayerSimulator(std::vector<SimulatedSong> songs,
+                    const BankConfig &starting_config);
+
+    /**
+     * @brief Simulate the entire playlist.
+     * @note Runs on the calling thread and returns when done.
+     */
+    void run();
+
+    /**
+     * @brief Get the simulation output log
+     */
+    const std::vector<SimulationLogEntry> &get_log() const
+    {
+        return m_log;
+    }
+
+    /**
+     * @brief Write the log (and summary) to a UTF-8 text file.
+     * @param file_name file to write (UTF-8)
+     * @throws std::runtime_error file can not be written
+     */
+    void save_log(const std::string &file_name) const;
+
+    /**
+     * @brief Get a human readable summary of the simulation
+     */
+    wxString get_summary() const;
+
+protected:
+    virtual void send_midi(const uint8_t *const midi_message,
+                           const size_t size) override;
+    virtual void post_ui_event(const wxThreadEvent &event) override;
+    virtual void wait_for_tick() override;
+    virtual void precache_next_song(const uint32_t song_id) override;
+
+private:
+    /**
+     * @brief Add a log entry at the current simulated time
+     * @param text entry text
+     */
+    void log(std::string text);
+
+    /**
+     * @brief Handle the start of a song (follow autoplay).
+     * @param song_id song that started
+     */
+    void on_song_start(const uint32_t song_id);
+
+    /**
+     * @brief Queue a song to be played next.
+     * @param song song to queue
+     */
+    void enqueue_song(const SimulatedSong &song);
+
+    /**
+     * @brief Get the playlist position of a song
+     * @param song_id song to find
+     * @returns index into `m_songs` (`m_songs.size()` if not found)
+     */
+    size_t find_song(const uint32_t song_id) const;
+
+    VirtualClock &m_clock;
+    const std::vector<SimulatedSong> m_songs;
+    size_t m_next_song;  ///< Next song the "operator" will start
+    wxLongLong m_stall_deadline_us;  ///< When to force an advance
+    std::vector<SimulationLogEntry> m_log;
+
+    size_t m_songs_played;
+    size_t m_midi_messages;
+    size_t m_bank_changes;
+    size_t m_forced_advances;
+    std::optional<wxLongLong> m_last_bank_change_us;
+    std::optional<wxLongLong> m_min_bank_spacing_us;
+    wxLongLong m_wall_time_us;
+};
+
+}  //  end bach_bot
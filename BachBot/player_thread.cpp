@@ -26,6 +26,9 @@
 //  system includes
 #include <stdexcept>  //  std::runtime_error
 #include <memory>  //  std::unique_ptr
+#include <algorithm>  //  std::copy_n, std::clamp
+#include <cstdlib>  //  std::abs
+#include <set>  //  std::set
 
 //  module includes
 // -none-
@@ -34,22 +37,71 @@
 #include "player_thread.h"  //   local include
 #include "player_window.h"  //  PlayerWindowEvents
 #include "rt_timer.h"  //  RTTimer
+#include "profile_zone.h"  //  BACHBOT_ZONE
 
 
 namespace {
 constexpr const auto TICKS_PER_UI_REFRESH = 500U;
+
+/** Tick intervals longer than this get their own trace record */
+constexpr const auto TRACE_LATE_TICK_US = 2000U;
+
+/** `MINIMUM_BANK_CHANGE_INTERVAL_MS` in player clock units */
+constexpr const auto BANK_CHANGE_INTERVAL_US =
+    int64_t(bach_bot::MINIMUM_BANK_CHANGE_INTERVAL_MS) * 1000;
+
+/** Nominal real-time timer period */
+constexpr const auto TIMER_PERIOD_US = 1000;
+
+/** Stack pre-faulted by the warm-up (well above the player's deepest use) */
+constexpr const auto WARM_UP_STACK_BYTES = 64U * 1024U;
+
+/** Smallest page size in use, stride for touching the stack */
+constexpr const auto WARM_UP_PAGE_BYTES = 4096U;
+
+/** Ticks averaged when checking whether the timer has settled */
+constexpr const auto WARM_UP_SETTLE_TICKS = 32;
+
+/** Timer has settled once the average period is this close to nominal */
+constexpr const auto WARM_UP_TOLERANCE_US = 50;
+
+/** Longest wait for the timer to settle (ticks) */
+constexpr const auto WARM_UP_MAX_TICKS = 500U;
+
+
+/**
+ * @brief Touch every page of the stack the player may use.
+ * @note Called from `warm_up`, whose frame is at the depth `play_songs` will
+ *       later run at.
+ */
+void prefault_stack()
+{
+    volatile uint8_t stack[WARM_UP_STACK_BYTES];
+    for (auto i = 0U; i < WARM_UP_STACK_BYTES; i += WARM_UP_PAGE_BYTES) {
+        stack[i] = 0U;
+    }
+    static_cast<void>(stack[0]);
+}
 }
 
 
 namespace bach_bot {
 
-void send_bank_change_message(RtMidiOut &midi_out,
-                              const SyndyneBankCommands value)
+std::array<uint8_t, MIDI_MESSAGE_SIZE> make_bank_change_message(
+    const SyndyneBankCommands value)
 {
     std::array<uint8_t, MIDI_MESSAGE_SIZE> midi_message;
     midi_message[0] = make_midi_command_byte(0U, MidiCommands::CONTROL_CHANGE);
     midi_message[1] = SYNDYNE_CONTROLLER_ID;
     midi_message[2] = value;
+    return midi_message;
+}
+
+
+void send_bank_change_message(RtMidiOut &midi_out,
+                              const SyndyneBankCommands value)
+{
+    const auto midi_message = make_bank_change_message(value);
 
     if (!midi_out.isPortOpen()) {
         throw std::runtime_error("Sending MIDI message on closed port");
@@ -59,67 +111,159 @@ void send_bank_change_message(RtMidiOut &midi_out,
 }
 
 
-PlayerThread::PlayerThread(wxFrame* const frame, RtMidiOut &intf) :
+PlayerThread::PlayerThread(wxFrame* const frame, PortList ports) :
+    PlayerThread(frame, std::move(ports), std::make_unique<RealTimeClock>())
+{
+}
+
+
+PlayerThread::PlayerThread(wxFrame *const frame, PortList ports,
+                           std::unique_ptr<PlayerClock> clock) :
     wxThread(wxTHREAD_JOINABLE),
     m_mutex(),
     m_event_queue(),
     m_midi_event_queue(),
+    m_next_event{0U},
+    m_next_mode_event{0U},
+    m_song_index(),
     m_precache(),
+    m_precache_index(),
     m_test_precache{false},
     m_playing_test_pattern{false},
     m_memory_number{1U},
     m_mode_number{1U},
     m_desired_config(),
     m_frame{frame},
-    m_midi_out(intf),
+    m_ports(std::move(ports)),
     m_waiting{nullptr},
-    m_current_time(),
-    m_bank_change_delay(),
-    m_last_message{MessageId::NO_MESSAGE},
+    m_clock(std::move(clock)),
+    m_transposer(),
+    m_active_notes(),
+    m_current_time(*m_clock),
+    m_last_bank_change_us{0},
+    m_bank_step_due_us{NO_BANK_STEP},
+    m_note_offset_us{0},
+    m_bank_offset_us{0},
+    m_trace(),
+    m_last_tick_us{0},
+    m_max_tick_interval_us{0U},
+    m_trace_ticks{0U},
     m_first_match{false},
-    m_desired_config_shared()
+    m_resume_us{0},
+    m_resume_notes(),
+    m_desired_config_shared(),
+    m_current_config_shared()
 {
     m_desired_config_shared = int(m_desired_config);
-    m_bank_change_delay.Start(MINIMUM_BANK_CHANGE_INTERVAL_MS);
+    m_current_config_shared = int(BankConfig{m_memory_number, m_mode_number});
+    //  No change has been sent yet, so the first step may go out at once.
+    m_last_bank_change_us = m_clock->get_us().GetValue() -
+                            BANK_CHANGE_INTERVAL_US;
 }
 
 
 wxThread::ExitCode PlayerThread::Entry()
 {
+    BACHBOT_THREAD_NAME("player");
     std::unique_ptr<RTTimer> timer(create_timer(this));
     
     timer->start_timer();
-    while (load_next_song()) {
-        if (!run_song()) {
-            break;
-        }
-    }
+    warm_up();
+    play_songs();
 
     timer->stop_timer();
     wxThreadEvent exit_event(wxEVT_THREAD,
                              ui::PlayerWindowEvents::EXIT_EVENT);
     exit_event.SetInt(0);
-    wxQueueEvent(m_frame, exit_event.Clone());
+    post_ui_event(exit_event);
 
     return nullptr;
 }
 
 
+void PlayerThread::warm_up()
+{
+    BACHBOT_ZONE("warm_up");
+    const auto start_us = m_clock->get_us();
+
+    //  Fault in the stack and pull the first song's events into the cache
+    // now, rather than on its first notes.
+    prefault_stack();
+    {
+        wxMutexLocker lock(m_mutex);
+        volatile int64_t sum = 0;
+        for (const auto &midi_event: m_precache) {
+            sum = sum + midi_event.get_us().GetValue();
+        }
+    }
+
+    //  Releasing note 0 (below any organ's compass) runs the output path down
+    // to the driver without sounding anything.
+    const std::array<uint8_t, MIDI_MESSAGE_SIZE> probe = {
+        make_midi_command_byte(0U, MidiCommands::NOTE_OFF), 0U, 0U};
+    send_message(probe.data(), probe.size());
+
+    //  The timer adapts its sleep to the measured period: wait until the
+    // average is on time.  Any command ends the wait and is kept for the song.
+    auto ticks = 0U;
+    auto settle_ticks = 0;
+    auto settle_start_us = m_clock->get_us();
+    while (ticks < WARM_UP_MAX_TICKS) {
+        const auto message = wait_for_message();
+        if (MessageId::TICK_MESSAGE != message.first) {
+            wxMutexLocker lock(m_mutex);
+            m_event_queue.push_front(message);
+            break;
+        }
+
+        ++ticks;
+        if (++settle_ticks < WARM_UP_SETTLE_TICKS) {
+            continue;
+        }
+        const auto now = m_clock->get_us();
+        const auto mean_us = (now - settle_start_us).GetValue() /
+                             WARM_UP_SETTLE_TICKS;
+        if (std::abs(mean_us - TIMER_PERIOD_US) <= WARM_UP_TOLERANCE_US) {
+            break;
+        }
+        settle_ticks = 0;
+        settle_start_us = now;
+    }
+
+    if (nullptr != m_trace) {
+        auto record = make_trace_record(TraceRecordType::TRACE_WARM_UP, 0);
+        record.actual_us = (m_clock->get_us() - start_us).GetValue();
+        record.queue_depth = ticks;
+        m_trace->record(record);
+    }
+}
+
+
+void PlayerThread::play_songs()
+{
+    m_first_match = false;
+    m_resume_us = 0;
+    m_resume_notes.clear();
+    while (load_next_song()) {
+        if (!run_song()) {
+            break;
+        }
+    }
+
+    //  Stopped part way through a song (or a song left a key down).
+    release_active_notes();
+}
+
+
 bool PlayerThread::run_song()
 {
     auto run = true;
     auto i = 0U;
-    m_current_time.Start();
-    m_test_precache = false;
-    m_playing_test_pattern = false;
-
-    const auto song_id = m_midi_event_queue.front().m_song_id;
-    wxThreadEvent start_event(wxEVT_THREAD,
-                              ui::PlayerWindowEvents::SONG_START_EVENT);
-    start_event.SetInt(int(song_id));
-    wxQueueEvent(m_frame, start_event.Clone());
+    m_current_time.start();
+    m_last_tick_us = m_clock->get_us();
+    begin_song();
 
-    while (run && (m_midi_event_queue.size() > 0U)) {
+    while (run && (get_events_remaining() > 0U)) {
         auto message = wait_for_message();
         switch (message.first) {
         case MessageId::ADVANCE_MESSAGE:
@@ -131,52 +275,147 @@ bool PlayerThread::run_song()
             run = false;
             break;
 
+        case MessageId::BANK_MESSAGE: {
+            const auto midi_message = make_bank_change_message(
+                SyndyneBankCommands(message.second));
+            send_message(midi_message.data(), MIDI_MESSAGE_SIZE);
+            //  Automatic steps keep their spacing from manual ones too.
+            m_last_bank_change_us = m_clock->get_us().GetValue();
+            break;
+        }
+
+        case MessageId::SEEK_MESSAGE:
+            if ((nullptr != m_song_index) && !m_playing_test_pattern) {
+                seek(m_song_index->seek_us(m_midi_event_queue,
+                                           int64_t(message.second) * 1000));
+            }
+            break;
+
+        case MessageId::SEEK_MEASURE_MESSAGE:
+            if ((nullptr != m_song_index) && m_song_index->has_measures() &&
+                    !m_playing_test_pattern) {
+                seek(m_song_index->seek_measure(m_midi_event_queue,
+                                                int(message.second)));
+            }
+            break;
+
+        case MessageId::TEMPO_MESSAGE:
+            //  Picked up by `process_notes` on the next tick.
+            set_tempo(uint32_t(message.second));
+            break;
+
+        case MessageId::TRANSPOSE_MESSAGE:
+            set_transpose(int(intptr_t(message.second)));
+            break;
+
+        case MessageId::PANIC_MESSAGE:
+            release_active_notes();
+            break;
+
         case MessageId::TICK_MESSAGE:
+            if (nullptr != m_trace) {
+                trace_tick();
+            }
             if (++i >= TICKS_PER_UI_REFRESH) {
                 i = 0U;
                 wxThreadEvent tick_event(wxEVT_THREAD,
                                          ui::PlayerWindowEvents::TICK_EVENT);
-                tick_event.SetInt(int(m_midi_event_queue.size()));
-                wxQueueEvent(m_frame, tick_event.Clone());
+                tick_event.SetInt(int(get_events_remaining()));
+                post_ui_event(tick_event);
             }
             if (m_first_match) {
                 process_notes();
             }
+
+            //  One compare per tick; the state is only examined when a step
+            // is both needed and allowed.
+            if (!m_playing_test_pattern && (get_events_remaining() > 0U) &&
+                (m_clock->get_us().GetValue() >=
+                    m_bank_step_due_us.load(std::memory_order_relaxed))) {
+                do_mode_check();
+            }
             break;
 
         default:
             break;
         }
+    }
+
+    end_song(m_midi_event_queue.front().m_song_id, run);
+    return run;
+}
+
+
+void PlayerThread::begin_song()
+{
+    m_test_precache = false;
+    m_playing_test_pattern = false;
 
-        m_last_message = message.first;
+    const auto song_id = m_midi_event_queue.front().m_song_id;
+    if (nullptr != m_trace) {
+        m_trace->record(make_trace_record(TraceRecordType::TRACE_SONG_START,
+                                          0));
+    }
+
+    wxThreadEvent start_event(wxEVT_THREAD,
+                              ui::PlayerWindowEvents::SONG_START_EVENT);
+    start_event.SetInt(int(song_id));
+    post_ui_event(start_event);
+}
+
+
+void PlayerThread::end_song(const uint32_t song_id, const bool completed)
+{
+    if (nullptr != m_trace) {
+        auto record = make_trace_record(TraceRecordType::TRACE_SONG_END,
+                                        m_current_time.get_us());
+        record.song_id = song_id;
+        //  After a splice the queue already holds the next song.
+        record.queue_depth = completed ? 0U : uint32_t(get_events_remaining());
+        record.size = 1U;
+        record.data[0] = uint8_t(completed);
+        m_trace->record(record);
     }
 
     wxThreadEvent end_event(wxEVT_THREAD,
                             ui::PlayerWindowEvents::SONG_END_EVENT);
-    end_event.SetInt(int(run));
-    wxQueueEvent(m_frame, end_event.Clone());
-    return run;
+    end_event.SetInt(int(completed));
+    post_ui_event(end_event);
 }
 
 
-PlayerThread::Message PlayerThread::wait_for_message()
+bool PlayerThread::splice_next_song()
 {
-    wxMutexLocker lock(m_mutex);
+    const auto song_id = m_midi_event_queue.front().m_song_id;
+    const auto song_end_us = m_midi_event_queue.back().get_us();
+    if (!load_next_song()) {
+        return false;
+    }
+
+    end_song(song_id, true);
+    m_current_time.rebase(song_end_us);
 
-    //  To reduce overhead, do the mode check while locked.  Do before blocking
-    // in order to reduce transition delays.
-    if ((MessageId::TICK_MESSAGE == m_last_message) && 
-        !m_playing_test_pattern &&
-        (m_midi_event_queue.size() > 0U) &&
-        (m_bank_change_delay.Time() > MINIMUM_BANK_CHANGE_INTERVAL_MS)) {
-        do_mode_check();
+    {
+        wxMutexLocker lock(m_mutex);
+        if ((m_desired_config.memory != m_memory_number) ||
+            (m_desired_config.mode != m_mode_number)) {
+            //  Hold (as at the start of a song) until the organ has stepped
+            // to the registration of the next song, then carry on from here.
+            m_resume_us = m_current_time.get_us();
+            m_first_match = false;
+        }
     }
 
+    begin_song();
+    return true;
+}
+
+
+PlayerThread::Message PlayerThread::wait_for_message()
+{
+    wxMutexLocker lock(m_mutex);
     if (m_event_queue.size() == 0U) {
-        wxCondition signal(m_mutex);
-        m_waiting = &signal;
-        static_cast<void>(signal.Wait());
-        m_waiting = nullptr;
+        wait_for_tick();
     }
 
     if (m_event_queue.size() == 0U) {
@@ -192,6 +431,12 @@ PlayerThread::Message PlayerThread::wait_for_message()
 void PlayerThread::post_message(const MessageId msg_id, const uintptr_t value)
 {
     wxMutexLocker lock(m_mutex);
+    queue_message(msg_id, value);
+}
+
+
+void PlayerThread::queue_message(const MessageId msg_id, const uintptr_t value)
+{
     m_event_queue.push_back({ msg_id, value });
     if (nullptr != m_waiting) {
         m_waiting->Signal();
@@ -199,6 +444,30 @@ void PlayerThread::post_message(const MessageId msg_id, const uintptr_t value)
 }
 
 
+void PlayerThread::wait_for_tick()
+{
+    wxCondition signal(m_mutex);
+    m_waiting = &signal;
+    static_cast<void>(signal.Wait());
+    m_waiting = nullptr;
+}
+
+
+void PlayerThread::send_midi(const uint8_t *const midi_message,
+                             const size_t size)
+{
+    for (const auto &port: m_ports) {
+        static_cast<void>(port->send(midi_message, size));
+    }
+}
+
+
+void PlayerThread::post_ui_event(const wxThreadEvent &event)
+{
+    wxQueueEvent(m_frame, event.Clone());
+}
+
+
 void PlayerThread::play()
 {
     if (Create() != wxTHREAD_NO_ERROR) {
@@ -210,11 +479,13 @@ void PlayerThread::play()
 }
 
 
-void PlayerThread::enqueue_next_song(std::deque<OrganMidiEvent> song_events)
+void PlayerThread::enqueue_next_song(std::deque<OrganMidiEvent> song_events,
+                                     std::shared_ptr<const SongIndex> index)
 {
     wxMutexLocker lock(m_mutex);
     m_test_precache = true;
     m_precache = std::move(song_events);
+    m_precache_index = std::move(index);
 }
 
 
@@ -227,16 +498,42 @@ BankConfig PlayerThread::get_desired_config() const
 
 void PlayerThread::process_notes()
 {
-    const auto time_now = m_current_time.TimeInMicro();
+    if (get_release_us(m_midi_event_queue[m_next_event]) <=
+            m_current_time.get_us()) {
+        release_events();
+    }
+
+    //  Not while holding for a registration (after a splice), and the test
+    // pattern drives the registration display itself.
+    if (m_first_match && !m_playing_test_pattern) {
+        apply_mode_changes();
+    }
+}
+
+
+void PlayerThread::release_events()
+{
+    BACHBOT_ZONE("process_notes");
+    auto time_now = m_current_time.get_us();
     do {
-        const auto &midi_event = m_midi_event_queue.front();
-        const auto timestamp = midi_event.get_us();
+        const auto &midi_event = m_midi_event_queue[m_next_event];
+        const auto timestamp = get_release_us(midi_event);
         if (timestamp > time_now) {
             break;
         }
 
         if (!midi_event.is_mode_change_event()) {
-            midi_event.send_event(m_midi_out);
+            std::array<uint8_t, MIDI_MESSAGE_SIZE> midi_message;
+            const auto msg_size = midi_event.get_midi_message(midi_message);
+            if ((msg_size > 0U) && send_note(midi_message, msg_size)) {
+                if (nullptr != m_trace) {
+                    auto record = make_trace_record(
+                        TraceRecordType::TRACE_MIDI_EVENT, timestamp);
+                    record.size = uint8_t(msg_size);
+                    std::copy_n(midi_message.begin(), msg_size, record.data);
+                    m_trace->record(record);
+                }
+            }
         }
         if (m_playing_test_pattern) {
             const BankConfig msg{uint32_t(midi_event.m_byte1.value()),
@@ -244,28 +541,61 @@ void PlayerThread::process_notes()
             wxThreadEvent bank_event(wxEVT_THREAD,
                                      ui::PlayerWindowEvents::BANK_CHANGE_EVENT);
             bank_event.SetInt(int(msg));
-            wxQueueEvent(m_frame, bank_event.Clone());
-        } else {
-            m_desired_config = midi_event.get_bank_config();
+            post_ui_event(bank_event);
         }
 
         if (midi_event.m_metadata.has_value()) {
             handle_meta_event(midi_event.m_metadata.value());
         }
 
-        m_midi_event_queue.pop_front();
-    } while (m_midi_event_queue.size() > 0U);
+        ++m_next_event;
+        if ((0U == get_events_remaining()) && splice_next_song()) {
+            if (!m_first_match) {
+                //  Waiting for the registration; `do_mode_check` resumes.
+                break;
+            }
+            //  Anything due at the very start of the next song goes out now.
+            time_now = m_current_time.get_us();
+        }
+    } while (get_events_remaining() > 0U);
+}
+
 
-    m_desired_config_shared = int(m_desired_config);
+void PlayerThread::apply_mode_changes()
+{
+    const auto time_now = m_current_time.get_us();
+    while ((m_next_mode_event < m_midi_event_queue.size()) &&
+           (get_release_us(m_midi_event_queue[m_next_mode_event]) <=
+                time_now)) {
+        const auto config =
+            m_midi_event_queue[m_next_mode_event].get_bank_config();
+        if (int(config) != int(m_desired_config)) {
+            wxMutexLocker lock(m_mutex);
+            m_desired_config = config;
+            m_desired_config_shared = int(m_desired_config);
+            schedule_bank_step();
+        }
+        m_next_mode_event = find_mode_change(m_next_mode_event + 1U);
+    }
+}
+
+
+size_t PlayerThread::find_mode_change(size_t event_index) const
+{
+    while ((event_index < m_midi_event_queue.size()) &&
+           !m_midi_event_queue[event_index].is_mode_change_event()) {
+        ++event_index;
+    }
+    return event_index;
 }
 
 
 void PlayerThread::force_advance()
 {
-    const auto &current_event = m_midi_event_queue.front();
-    const auto ms = current_event.get_us().GetValue();
-    m_current_time.Start(long(ms / 1000LL));
+    const auto &current_event = m_midi_event_queue[m_next_event];
+    m_current_time.start(current_event.get_us());
     m_first_match = true;
+    send_resume_notes();
 }
 
 
@@ -275,7 +605,17 @@ void PlayerThread::set_bank_config(const uint32_t current_memory,
     wxMutexLocker lock(m_mutex);
     m_memory_number = current_memory;
     m_mode_number = current_mode;
-    m_bank_change_delay.Start();
+    m_current_config_shared = int(BankConfig{m_memory_number, m_mode_number});
+    //  The organ may have just been changed by hand: hold off, then re-check.
+    m_last_bank_change_us = m_clock->get_us().GetValue();
+    schedule_bank_step();
+}
+
+
+void PlayerThread::schedule_bank_step()
+{
+    m_bank_step_due_us = m_last_bank_change_us.load() +
+                         BANK_CHANGE_INTERVAL_US;
 }
 
 
@@ -283,25 +623,48 @@ void PlayerThread::do_mode_check()
 {
     wxMutexLocker lock(m_mutex);
 
+    //  Hard limit on the spacing, whoever scheduled the check (and whatever
+    // changed since).
+    if (m_clock->get_us().GetValue() <
+            m_last_bank_change_us.load() + BANK_CHANGE_INTERVAL_US) {
+        schedule_bank_step();
+        return;
+    }
+
     if (m_desired_config.memory == m_memory_number &&
         m_desired_config.mode == m_mode_number)
     {
-        //  Nothing to do.
+        //  Nothing to do until the desired (or organ) state changes.
+        m_bank_step_due_us = NO_BANK_STEP;
         if (!m_first_match) {
-            m_current_time.Start(0L);
+            m_current_time.start(m_resume_us);
             m_first_match = true;
+            send_resume_notes();
         }
         return;
     }
 
+    BACHBOT_ZONE("do_mode_check");
     auto send_change = [&](const SyndyneBankCommands value) {
-        send_bank_change_message(m_midi_out, value);
+        const BankConfig config{m_memory_number, m_mode_number};
+        m_current_config_shared = int(config);
+        const auto midi_message = make_bank_change_message(value);
+        send_message(midi_message.data(), MIDI_MESSAGE_SIZE);
+        if (nullptr != m_trace) {
+            const auto now = m_current_time.get_us();
+            auto record = make_trace_record(
+                TraceRecordType::TRACE_BANK_CHANGE, now);
+            record.size = 1U;
+            record.data[0] = value;
+            m_trace->record(record);
+        }
         wxThreadEvent bank_event(wxEVT_THREAD,
                                  ui::PlayerWindowEvents::BANK_CHANGE_EVENT);
-        BankConfig config{m_memory_number, m_mode_number};
         bank_event.SetInt(int(config));
-        wxQueueEvent(m_frame, bank_event.Clone());
-        m_bank_change_delay.Start();
+        post_ui_event(bank_event);
+        m_last_bank_change_us = m_clock->get_us().GetValue();
+        //  Keep stepping until the state matches.
+        schedule_bank_step();
     };
 
     auto step_down = [=]() {
@@ -342,6 +705,93 @@ void PlayerThread::do_mode_check()
 }
 
 
+void PlayerThread::seek(const SongPosition &target)
+{
+    //  Work from what is actually sounding rather than from the index:
+    // after an earlier seek, its notes may still be waiting in
+    // `m_resume_notes` and were never struck.
+    std::vector<Transposer::NoteMessage> sounding;
+    m_transposer.get_held(sounding);
+
+    //  Release anything that isn't sounding at the new position; notes that
+    // sound in both places are left alone rather than re-struck.
+    std::set<uint16_t> kept;
+    for (const auto &note: sounding) {
+        const auto key = uint16_t((note[0] << 8U) | note[1]);
+        if (0U != target.held.count(key)) {
+            static_cast<void>(kept.insert(key));
+        } else {
+            SongPosition::NoteMessage note_off = {
+                make_midi_command_byte(note[0] & 0x0FU,
+                                       MidiCommands::NOTE_OFF),
+                note[1], 0U};
+            static_cast<void>(send_note(note_off, note_off.size()));
+        }
+    }
+
+    m_resume_notes.clear();
+    for (const auto &[key, note]: target.held) {
+        if (0U == kept.count(key)) {
+            m_resume_notes.push_back(note);
+        }
+    }
+
+    //  Hold off (as at the start of a song) until the organ has caught up
+    // with the registration at the new position.
+    m_next_event = target.event_index;
+    m_next_mode_event = find_mode_change(m_next_event);
+    m_resume_us = wxLongLong(target.us);
+    m_first_match = false;
+
+    wxMutexLocker lock(m_mutex);
+    m_desired_config = target.config;
+    m_desired_config_shared = int(m_desired_config);
+    schedule_bank_step();
+}
+
+
+void PlayerThread::send_resume_notes()
+{
+    for (auto &note: m_resume_notes) {
+        static_cast<void>(send_note(note, note.size()));
+    }
+    m_resume_notes.clear();
+}
+
+
+bool PlayerThread::send_note(Transposer::NoteMessage &midi_message,
+                             const size_t size)
+{
+    //  The test pattern walks every key, so it is never transposed.
+    if (!m_playing_test_pattern && !m_transposer.apply(midi_message, size)) {
+        return false;
+    }
+    send_message(midi_message.data(), size);
+    return true;
+}
+
+
+void PlayerThread::send_message(const uint8_t *const midi_message,
+                                const size_t size)
+{
+    m_active_notes.update(midi_message, size);
+    send_midi(midi_message, size);
+}
+
+
+void PlayerThread::release_active_notes()
+{
+    std::vector<ActiveNoteSet::NoteMessage> messages;
+    m_active_notes.release_all(messages);
+    for (const auto &midi_message: messages) {
+        send_midi(midi_message.data(), midi_message.size());
+    }
+
+    //  Notes still to be released by the song are not held anymore.
+    m_transposer.reset();
+}
+
+
 void PlayerThread::precache_next_song(const uint32_t song_id)
 {
     //  Nothing done here anymore.  This is just a stub in case I want to do
@@ -358,12 +808,99 @@ bool PlayerThread::load_next_song()
         m_desired_config = m_precache.front().get_bank_config();
         m_desired_config_shared = int(m_desired_config);
         m_midi_event_queue = std::move(m_precache);
+        m_song_index = std::move(m_precache_index);
+        m_next_event = 0U;
+        m_next_mode_event = find_mode_change(0U);
+        schedule_bank_step();
     }
 
     return (song_size > 0U);
 }
 
 
+void PlayerThread::set_trace(std::unique_ptr<PlaybackTrace> trace)
+{
+    m_trace = std::move(trace);
+}
+
+
+void PlayerThread::set_latency_profile(const LatencyProfile &profile)
+{
+    m_note_offset_us = wxLongLong(profile.note_offset_us);
+    m_bank_offset_us = wxLongLong(profile.bank_offset_us);
+}
+
+
+void PlayerThread::set_tempo(const uint32_t tempo_percent)
+{
+    m_current_time.set_rate(std::clamp(tempo_percent, MIN_TEMPO_PERCENT,
+                                       MAX_TEMPO_PERCENT));
+}
+
+
+void PlayerThread::set_transpose(const int steps)
+{
+    std::vector<Transposer::NoteMessage> messages;
+    m_transposer.set_offset(steps, messages);
+    for (const auto &midi_message: messages) {
+        send_message(midi_message.data(), midi_message.size());
+    }
+}
+
+
+std::vector<std::pair<std::string, PortStats>>
+PlayerThread::get_port_stats() const
+{
+    std::vector<std::pair<std::string, PortStats>> stats;
+    for (const auto &port: m_ports) {
+        stats.emplace_back(port->get_name(), port->get_stats());
+    }
+    return stats;
+}
+
+
+TraceRecord PlayerThread::make_trace_record(
+    const TraceRecordType type, const wxLongLong &scheduled_us) const
+{
+    TraceRecord record{};
+    record.type = type;
+    record.scheduled_us = scheduled_us.GetValue();
+    record.actual_us = m_current_time.get_us().GetValue();
+    //  Not all callers hold `m_mutex`; use the snapshot.
+    const auto config = BankConfig(int(m_current_config_shared));
+    record.memory = uint8_t(config.memory);
+    record.mode = config.mode;
+    if (get_events_remaining() > 0U) {
+        record.song_id = m_midi_event_queue.front().m_song_id;
+        record.queue_depth = uint32_t(get_events_remaining());
+    }
+    return record;
+}
+
+
+void PlayerThread::trace_tick()
+{
+    const auto now = m_clock->get_us();
+    const auto interval = uint32_t((now - m_last_tick_us).GetValue());
+    m_last_tick_us = now;
+    if (interval > m_max_tick_interval_us) {
+        m_max_tick_interval_us = interval;
+    }
+
+    ++m_trace_ticks;
+    if ((m_trace_ticks >= TICKS_PER_UI_REFRESH) ||
+        (interval > TRACE_LATE_TICK_US)) {
+        auto record = make_trace_record(TraceRecordType::TRACE_TICK,
+                                        m_current_time.get_us());
+        record.tick_interval_us = m_max_tick_interval_us;
+        record.queue_depth = m_trace_ticks;
+        m_trace->record(record);
+        m_max_tick_interval_us = 0U;
+        m_trace_ticks = 0U;
+    }
+}
+
+
 void PlayerThread::handle_meta_event(const int meta_event_id)
 {
     switch (meta_event_id) {
@@ -380,7 +917,7 @@ void PlayerThread::handle_meta_event(const int meta_event_id)
             wxThreadEvent meta_event(wxEVT_THREAD,
                                      ui::PlayerWindowEvents::SONG_META_EVENT);
             meta_event.SetInt(meta_event_id);
-            wxQueueEvent(m_frame, meta_event.Clone());
+            post_ui_event(meta_event);
         }
     }
 }
@@ -388,7 +925,7 @@ void PlayerThread::handle_meta_event(const int meta_event_id)
 
 PlayerThread::~PlayerThread()
 {
-    m_midi_out.closePort();
+    //  Ports close as their senders are destroyed.
 }
 
 }  //  end bach_bot
@@ -33,10 +33,15 @@
 #pragma once
 
 //  system includes
+#include <array>  //  std::array
 #include <cstdint>  //  uint32_t, uintptr_t, etc
 #include <deque>  //  std::deque
+#include <limits>  //  std::numeric_limits
 #include <atomic>  //  std::atomic
+#include <memory>  //  std::unique_ptr
+#include <string>  //  std::string
 #include <utility>  //  std::pair
+#include <vector>  //  std::vector
 #include <wx/wx.h>  //  wxCondition, wxThread, etc
 
 //  module includes
@@ -45,10 +50,31 @@
 //  local includes
 #include "midi_interface.h"  //  RtMidiOut
 #include "common_defs.h"
-#include "organ_midi_event.h"  //  OrganNote, BankConfig
+#include "organ_midi_event.h"  //  OrganMidiEvent, BankConfig
+#include "player_clock.h"  //  PlayerClock, PlayerStopWatch
+#include "playback_trace.h"  //  PlaybackTrace, TraceRecord
+#include "latency_profile.h"  //  LatencyProfile
+#include "port_sender.h"  //  PortSender, PortStats
+#include "song_index.h"  //  SongIndex, SongPosition
+#include "transposer.h"  //  Transposer
+#include "active_note_set.h"  //  ActiveNoteSet
 
 namespace bach_bot {
 
+/** Slowest playback tempo (percent of the recorded tempo) */
+constexpr const auto MIN_TEMPO_PERCENT = 50U;
+
+/** Fastest playback tempo (percent of the recorded tempo) */
+constexpr const auto MAX_TEMPO_PERCENT = 150U;
+
+/**
+ * @brief Build a bank-change message
+ * @param value bank command
+ * @returns raw MIDI message
+ */
+std::array<uint8_t, MIDI_MESSAGE_SIZE> make_bank_change_message(
+    const SyndyneBankCommands value);
+
 /**
  * @brief Manually send an explicit bank-change message
  * @param midi_out[in] MIDI output handler
@@ -65,6 +91,7 @@ class RTTimer;
  */
 class PlayerThread : public wxThread
 {
+protected:
     /**
      * @brief Internal messages used between threads
      */
@@ -74,7 +101,13 @@ class PlayerThread : public wxThread
         TICK_MESSAGE,
         STOP_MESSAGE,
         START_MESSAGE,
-        ADVANCE_MESSAGE
+        ADVANCE_MESSAGE,
+        BANK_MESSAGE,
+        SEEK_MESSAGE,
+        SEEK_MEASURE_MESSAGE,
+        TEMPO_MESSAGE,
+        TRANSPOSE_MESSAGE,
+        PANIC_MESSAGE
     };
 
     /**
@@ -83,13 +116,20 @@ class PlayerThread : public wxThread
      */
     using Message = std::pair<MessageId, uintptr_t>;
 
+    /** `m_bank_step_due_us` value when no bank step is needed */
+    static constexpr const int64_t NO_BANK_STEP =
+        std::numeric_limits<int64_t>::max();
+
 public:
+    /** Output ports, the organ first followed by any monitor ports */
+    using PortList = std::vector<std::unique_ptr<PortSender>>;
+
     /**
      * @brief Constructor
      * @param frame reference to main window
-     * @param[in] intf Midi interface to send events to
+     * @param ports MIDI ports to send events to (already open)
      */
-    PlayerThread(wxFrame *const frame, RtMidiOut &intf);
+    PlayerThread(wxFrame *const frame, PortList ports);
 
     /**
      * @brief Thread-safe call to send MIDI stop to.
@@ -115,6 +155,72 @@ public:
         post_message(MessageId::ADVANCE_MESSAGE);
     }
 
+    /**
+     * @brief Thread-safe call to send a manual bank change while playing.
+     * @param value bank command
+     * @note The player owns the ports while it runs, so manual changes must
+     *       go out through it.
+     */
+    void signal_bank_change(const SyndyneBankCommands value)
+    {
+        post_message(MessageId::BANK_MESSAGE, uintptr_t(value));
+    }
+
+    /**
+     * @brief Thread-safe call to move to a time in the current song.
+     * @param ms song time (milliseconds)
+     * @note Notes that should be sounding at that time are restored once the
+     *       organ has reached the registration in effect at that time.
+     *       Ignored if the song was enqueued without an index.
+     */
+    void signal_seek(const uint32_t ms)
+    {
+        post_message(MessageId::SEEK_MESSAGE, uintptr_t(ms));
+    }
+
+    /**
+     * @brief Thread-safe call to move to a measure in the current song.
+     * @param measure measure number (from 1)
+     * @sa signal_seek
+     */
+    void signal_seek_measure(const uint32_t measure)
+    {
+        post_message(MessageId::SEEK_MEASURE_MESSAGE, uintptr_t(measure));
+    }
+
+    /**
+     * @brief Thread-safe call to change the playback tempo while playing.
+     * @param tempo_percent percent of the recorded tempo (clamped to
+     *        `MIN_TEMPO_PERCENT`..`MAX_TEMPO_PERCENT`)
+     * @note Song time is warped from the current position onward; nothing
+     *       already played (or queued) is moved.  Bank change hold-offs are
+     *       in real time and are not affected.
+     */
+    void signal_tempo(const uint32_t tempo_percent)
+    {
+        post_message(MessageId::TEMPO_MESSAGE, uintptr_t(tempo_percent));
+    }
+
+    /**
+     * @brief Thread-safe call to release every key that is down.
+     * @note Playback continues, later notes sound as normal.
+     */
+    void signal_panic()
+    {
+        post_message(MessageId::PANIC_MESSAGE);
+    }
+
+    /**
+     * @brief Thread-safe call to change the key while playing.
+     * @param steps half-steps up (or down if negative) from the imported
+     *        key, at most one octave
+     * @note Held notes are moved to the new key straight away.
+     */
+    void signal_transpose(const int steps)
+    {
+        post_message(MessageId::TRANSPOSE_MESSAGE, uintptr_t(intptr_t(steps)));
+    }
+
     /**
      * @brief Play music, upon completion `EXIT_EVENT` will be issued.
      * @note
@@ -128,8 +234,10 @@ public:
     /**
      * @brief Enqueue the events for the next song to be played
      * @param song_events song events
+     * @param index seek index of `song_events` (`nullptr` disables seeking)
      */
-    void enqueue_next_song(std::deque<OrganMidiEvent> song_events);
+    void enqueue_next_song(std::deque<OrganMidiEvent> song_events,
+                           std::shared_ptr<const SongIndex> index=nullptr);
 
     BankConfig get_desired_config() const;
 
@@ -141,6 +249,40 @@ public:
     void set_bank_config(const uint32_t current_memory,
                          const uint8_t current_mode);
 
+    /**
+     * @brief Capture a playback trace while playing.
+     * @param trace trace writer (`nullptr` to disable tracing)
+     * @note Must be called before `play`.
+     */
+    void set_trace(std::unique_ptr<PlaybackTrace> trace);
+
+    /**
+     * @brief Compensate for the output latency of the MIDI interface.
+     * @param profile latency of the output port
+     * @note Must be called before `play`.
+     */
+    void set_latency_profile(const LatencyProfile &profile);
+
+    /**
+     * @brief Set the initial playback tempo.
+     * @param tempo_percent percent of the recorded tempo
+     * @note Must be called before `play`, use `signal_tempo` afterwards.
+     */
+    void set_tempo(const uint32_t tempo_percent);
+
+    /**
+     * @brief Set the initial transposition.
+     * @param steps half-steps up (or down if negative)
+     * @note Must be called before `play`, use `signal_transpose` afterwards.
+     */
+    void set_transpose(const int steps);
+
+    /**
+     * @brief Get the delivery statistics of each output port (thread-safe).
+     * @returns port name and statistics, in port order
+     */
+    std::vector<std::pair<std::string, PortStats>> get_port_stats() const;
+
     /**
      * @brief Callback to post timer tick events.
      */
@@ -152,8 +294,73 @@ public:
     virtual ~PlayerThread() override;
 
 protected:
+    /**
+     * @brief Constructor for alternate (non real-time) players.
+     * @param frame window to send UI events to (may be `nullptr` if
+     *        `post_ui_event` is overridden)
+     * @param ports MIDI ports (may be empty if `send_midi` is overridden)
+     * @param clock time source used for all player timing
+     */
+    PlayerThread(wxFrame *const frame, PortList ports,
+                 std::unique_ptr<PlayerClock> clock);
+
     virtual ExitCode Entry() override;
 
+    /**
+     * @brief Play songs until the queue is exhausted or stopped.
+     * @note This is the body of the thread, less the timer control.
+     */
+    void play_songs();
+
+    /**
+     * @brief Output a raw MIDI message.
+     * @param midi_message message bytes
+     * @param size number of bytes in `midi_message`
+     * @note The default implementation queues the message on every port.
+     *       The player calls this through `send_message`.
+     */
+    virtual void send_midi(const uint8_t *const midi_message,
+                           const size_t size);
+
+    /**
+     * @brief Deliver an event to the UI.
+     * @param event event to deliver (will be cloned if required)
+     */
+    virtual void post_ui_event(const wxThreadEvent &event);
+
+    /**
+     * @brief Block until a message has been queued.
+     * @note Called with `m_mutex` locked and no messages queued.  The default
+     *       implementation waits for a message to be posted by another
+     *       thread (usually the tick timer).
+     */
+    virtual void wait_for_tick();
+
+    /**
+     * @brief Queue a message without taking the mutex.
+     * @note `m_mutex` *must* be held by the caller.
+     * @param msg_id Message to be posted
+     * @param value extra message data - meaning may be message specific.
+     */
+    void queue_message(const MessageId msg_id, const uintptr_t value = 0U);
+
+    /**
+    * @brief Pre-cache the events for the next song during the final duration
+    *        of the current one.  This _may_ be the longest note in the song.
+    *        and therefore it's a good time to attempt to pre-load the next
+    *        song's events.
+    * @param song_id current song ID
+    */
+    virtual void precache_next_song(const uint32_t song_id);
+
+    /**
+     * @brief Get the time source used by this player.
+     */
+    PlayerClock &get_clock()
+    {
+        return *m_clock;
+    }
+
 private:
 
     /**
@@ -163,6 +370,33 @@ private:
      */
     bool run_song();
 
+    /**
+     * @brief Report the start of the currently loaded song.
+     */
+    void begin_song();
+
+    /**
+     * @brief Report the end of a song.
+     * @param song_id song that ended
+     * @param completed `false` if the song was stopped
+     */
+    void end_song(const uint32_t song_id, const bool completed);
+
+    /**
+     * @brief Continue straight into the enqueued song, if any, once the
+     *        last event of the current song has been played.
+     * @retval `true` next song loaded, song time now runs from its start
+     * @retval `false` no song enqueued
+     * @note The stopwatch is rebased by the length of the finished song
+     *       rather than restarted, so an autoplay chain plays on a single
+     *       timeline: the gap between songs is exactly the next song's
+     *       leading delay.  If the next song needs a different
+     *       registration it is held (as at the start of a song) until the
+     *       organ has stepped to it, which stretches the gap by the time
+     *       the steps take.
+     */
+    bool splice_next_song();
+
     /**
      * @brief General message posting API
      * @param msg_id Message to be posted
@@ -181,6 +415,26 @@ private:
      */
     void process_notes();
 
+    /**
+     * @brief Send the events that are due, in queue order.
+     */
+    void release_events();
+
+    /**
+     * @brief Take up the registration of mode changes that are due.
+     * @note Mode changes are followed by their own cursor: they sort after
+     *       the notes of their tick, so in queue order they could never go
+     *       out ahead of those notes (and the bank offset would be lost).
+     */
+    void apply_mode_changes();
+
+    /**
+     * @brief Find the next mode change event in the current song.
+     * @param event_index first event to look at
+     * @returns index of the mode change, or the queue size if there is none
+     */
+    size_t find_mode_change(size_t event_index) const;
+
     /**
      * @brief Advance logic to reset internal player time to the next event's
      *        time.
@@ -189,17 +443,86 @@ private:
 
     /**
      * @brief Internal logic to check the mode and (possibly) change it.
+     * @note Runs only once `m_bank_step_due_us` has passed; never sends a
+     *       step less than `MINIMUM_BANK_CHANGE_INTERVAL_MS` after the last.
      */
     void do_mode_check();
 
     /**
-    * @brief Pre-cache the events for the next song during the final duration
-    *        of the current one.  This _may_ be the longest note in the song.
-    *        and therefore it's a good time to attempt to pre-load the next
-    *        song's events.
-    * @param song_id current song ID
-    */
-    void precache_next_song(const uint32_t song_id);
+     * @brief Ask for a mode check at the earliest time a step is allowed.
+     * @note Call whenever the desired or actual bank state changes, with
+     *       `m_mutex` held: the deadline is derived from the last change
+     *       in two steps, and an unlocked caller could overwrite a newer
+     *       deadline with a stale one.
+     */
+    void schedule_bank_step();
+
+    /**
+     * @brief Move playback to a new position in the current song.
+     * @param target song state to continue from
+     */
+    void seek(const SongPosition &target);
+
+    /**
+     * @brief Output a MIDI message, keeping track of the keys that are down.
+     * @param midi_message message bytes
+     * @param size number of bytes in `midi_message`
+     */
+    void send_message(const uint8_t *const midi_message, const size_t size);
+
+    /**
+     * @brief Release every key that is down (in a single burst).
+     */
+    void release_active_notes();
+
+    /**
+     * @brief Transpose and output a song note.
+     * @param midi_message[in/out] message bytes (transposed on return)
+     * @param size number of bytes in `midi_message`
+     * @retval `true` message sent
+     * @retval `false` message not required at the current transposition
+     */
+    bool send_note(Transposer::NoteMessage &midi_message, const size_t size);
+
+    /**
+     * @brief Sound the notes held over a seek.
+     */
+    void send_resume_notes();
+
+    /**
+     * @brief Convert a real-time offset to song time at the current tempo.
+     * @param offset_us real-time offset (microseconds)
+     * @returns offset in song time (microseconds)
+     */
+    wxLongLong to_song_time(const wxLongLong &offset_us) const
+    {
+        return offset_us * long(m_current_time.get_rate()) / 100L;
+    }
+
+    /**
+     * @brief Get the song time an event is sent at.
+     * @param midi_event event to send
+     * @returns event time less the output latency of its type (microseconds)
+     * @note Events are released early by the output latency of the
+     *       interface.  Mode changes have their own offset and are looked
+     *       ahead by `apply_mode_changes`; the bank change itself goes out
+     *       on the next mode check after that.  The offsets are real time,
+     *       so they stretch with the tempo.
+     */
+    wxLongLong get_release_us(const OrganMidiEvent &midi_event) const
+    {
+        return midi_event.get_us() - to_song_time(
+            midi_event.is_mode_change_event() ? m_bank_offset_us :
+                                                m_note_offset_us);
+    }
+
+    /**
+     * @brief Get the number of events left to play in the current song
+     */
+    size_t get_events_remaining() const
+    {
+        return m_midi_event_queue.size() - m_next_event;
+    }
 
     /**
      * @brief Move enqueued song to the MIDI event queue.
@@ -208,6 +531,28 @@ private:
      */
     bool load_next_song();
 
+    /**
+     * @brief Build a trace record for the current player state.
+     * @param type record type
+     * @param scheduled_us time the event was due
+     * @returns record with the time, song and bank state filled in
+     */
+    TraceRecord make_trace_record(const TraceRecordType type,
+                                  const wxLongLong &scheduled_us) const;
+
+    /**
+     * @brief Account for a timer tick in the trace.
+     */
+    void trace_tick();
+
+    /**
+     * @brief Get ready for the first song: pre-fault memory, exercise the
+     *        output path and let the newly started timer settle.
+     * @note Runs once per thread, before `play_songs`.  The time taken is
+     *       recorded in the trace (`TRACE_WARM_UP`).
+     */
+    void warm_up();
+
     /**
      * @brief Handling of internal "metadata" events
      * @param meta_event_id metadata event id / code.
@@ -221,12 +566,18 @@ private:
      * 1. `m_event_queue`
      * 1. `m_precache`
      * 1. `m_memory_number`/`m_mode_number`
+     * 1. `m_desired_config` (writes)
+     * 1. `m_bank_step_due_us` (via `schedule_bank_step`)
      */
     wxMutex m_mutex;
 
     std::deque<Message> m_event_queue;  ///< Current Thread-Safe event queue
-    std::deque<OrganMidiEvent> m_midi_event_queue;  ///< List of midi events
+    std::deque<OrganMidiEvent> m_midi_event_queue;  ///< Current song events
+    size_t m_next_event;  ///< Next event in `m_midi_event_queue` to play
+    size_t m_next_mode_event;  ///< Next mode change in `m_midi_event_queue`
+    std::shared_ptr<const SongIndex> m_song_index;  ///< Current song index
     std::deque<OrganMidiEvent> m_precache;  ///< Cache of next song's events
+    std::shared_ptr<const SongIndex> m_precache_index;  ///< Next song index
     /** Flag that we have already checked the cache for the next song */
     bool m_test_precache;
 
@@ -248,7 +599,7 @@ private:
     BankConfig m_desired_config;  ///< The most recent desired bank/mode
 
     wxFrame *const m_frame;  ///<  Pointer to parent window
-    RtMidiOut &m_midi_out;  ///<  Reference to MIDI port
+    const PortList m_ports;  ///<  MIDI output ports
 
     /**
      * @brief Thread signal that player pends on.  Set `nullptr_t` if thread is
@@ -256,9 +607,22 @@ private:
      */
     wxCondition *m_waiting;
 
-    wxStopWatch m_current_time;  ///<  Current time and event time measurement.
-    wxStopWatch m_bank_change_delay;  ///<  Holdoff delay between bank changes.
-    MessageId m_last_message;  ///< The most recently processed message
+    std::unique_ptr<PlayerClock> m_clock;  ///<  Time source for stopwatches
+    Transposer m_transposer;  ///<  Live key change of song notes
+    ActiveNoteSet m_active_notes;  ///<  Keys down as sent to the organ
+    /** Song time and event time measurement (runs at the playback tempo) */
+    PlayerStopWatch m_current_time;
+    /** Clock time of the last bank change sent (microseconds) */
+    std::atomic<int64_t> m_last_bank_change_us;
+    /** Clock time the bank state is next due a check (`NO_BANK_STEP`: never) */
+    std::atomic<int64_t> m_bank_step_due_us;
+    wxLongLong m_note_offset_us;  ///<  Send note events early by this much
+    wxLongLong m_bank_offset_us;  ///<  Process mode changes early by this much
+
+    std::unique_ptr<PlaybackTrace> m_trace;  ///<  Optional trace capture
+    wxLongLong m_last_tick_us;  ///<  Clock time of the last tick
+    uint32_t m_max_tick_interval_us;  ///<  Since last tick trace record
+    uint32_t m_trace_ticks;  ///<  Ticks since last tick trace record
 
     /**
      * @brief Flag: don't start processing notes on first run until either the
@@ -267,11 +631,21 @@ private:
      */
     bool m_first_match;
 
+    wxLongLong m_resume_us;  ///<  Song time to start at once the state matches
+    /** Notes to sound once the state matches (after a seek) */
+    std::vector<SongPosition::NoteMessage> m_resume_notes;
+
     /**
      * @briefCopy of current "desired config" that can be read easily by the UI
      * thread.
      */
     std::atomic<int> m_desired_config_shared;
+
+    /**
+     * @brief Copy of `m_memory_number`/`m_mode_number` that can be read
+     *        without `m_mutex` (ie when making trace records).
+     */
+    std::atomic<int> m_current_config_shared;
 };
 
 }  //  end bach_bot
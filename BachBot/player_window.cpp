@@ -24,13 +24,19 @@
 
 
 //  system includes
-#include <algorithm>  //  std::foreach
+#include <algorithm>  //  std::foreach, std::clamp
 #include <stdexcept>  //  std::runtime_error. std::out_of_range
 #include <string>  //  std::string
 #include <string_view>  //  sv, std::swap
 #include <array>  //  std::array
+#include <vector>  //  std::vector
+#include <set>  //  std::set
 #include <fmt/format.h>  //  fmt::format
 #include <wx/xml/xml.h>  //  wxXml API
+#include <wx/mstream.h>  //  wxMemoryOutputStream
+#include <wx/filename.h>  //  wxFileName
+#include <wx/stdpaths.h>  //  wxStandardPaths
+#include <wx/datetime.h>  //  wxDateTime
 
 //  module includes
 // -none-
@@ -40,7 +46,13 @@
 #include "player_thread.h"  //  PlayerThread
 #include "organ_midi_event.h"  //  OrganMidiEvent, BankConfig
 #include "syndyne_importer.h"  //  SyndineImporter
+#include "import_cache.h"  //  ImportCache
 #include "playlist_loader.h"  //  PlaylistLoader
+#include "playlist_bundle.h"  //  load_playlist_bundle, save_playlist_bundle
+#include "startup_profiler.h"  //  StartupProfiler
+#include "player_simulator.h"  //  PlayerSimulator
+#include "playback_trace.h"  //  PlaybackTrace
+#include "profile_zone.h"  //  BACHBOT_ZONE
 
 
 namespace {
@@ -50,6 +62,12 @@ namespace {
     constexpr const auto NOW_PLAYING_LEN = 78U;
     constexpr const auto UP_NEXT_LEN = 76U;
 
+    /** Tempo change per press of the tempo accelerators (percent) */
+    constexpr const auto TEMPO_STEP_PERCENT = 2L;
+
+    /** Wait this long after the last change to a file before re-importing */
+    constexpr const auto FILE_CHANGE_SETTLE_MS = 500;
+
     enum AcceleratorEntries : size_t
     {
         MOVE_UP_ACCEL = 0U,
@@ -57,6 +75,11 @@ namespace {
         PLAY_NEXT_ACCEL1,
         PLAY_NEXT_ACCEL2,
         PLAY_ACTIVATE_ACCEL,
+        TEMPO_UP_ACCEL1,
+        TEMPO_UP_ACCEL2,
+        TEMPO_DOWN_ACCEL1,
+        TEMPO_DOWN_ACCEL2,
+        PANIC_ACCEL,
         NUM_ACCEL_ENTRIES
     };
 
@@ -65,6 +88,48 @@ namespace {
     constexpr const auto image_name = L"wood.png"sv;
 
     std::optional<wxString> s_window_title;
+
+    /**
+     * @brief Describe a latency distribution on one line.
+     * @param distribution distribution to describe
+     * @returns description (milliseconds)
+     */
+    std::wstring format_distribution(
+        const bach_bot::LatencyDistribution &distribution)
+    {
+        return fmt::format(
+            L"median {:.2f}ms  p95 {:.2f}ms  mean {:.2f}ms  "
+             "range {:.2f}-{:.2f}ms",
+            double(distribution.p50_us) / 1000.0,
+            double(distribution.p95_us) / 1000.0,
+            double(distribution.mean_us) / 1000.0,
+            double(distribution.min_us) / 1000.0,
+            double(distribution.max_us) / 1000.0);
+    }
+
+    /**
+     * @brief Describe a loopback measurement.
+     * @param result measurement to describe
+     * @param indent prefix of each line
+     * @returns description, one line per distribution
+     */
+    std::wstring format_loopback(const bach_bot::LoopbackResult &result,
+                                 const std::wstring &indent)
+    {
+        auto baseline = std::wstring(L"not available");
+        if (result.baseline.has_value()) {
+            baseline = format_distribution(result.baseline.value());
+        }
+
+        return fmt::format(
+            L"{0}Probes received: {1}/{2}\n"
+             "{0}Round trip: {3}\n"
+             "{0}Host MIDI baseline: {4}\n"
+             "{0}One-way latency: {5}\n",
+            indent, result.probes_received, result.probes_sent,
+            format_distribution(result.round_trip), baseline,
+            format_distribution(result.one_way));
+    }
 }  //  end anonymous namespace
 
 
@@ -83,6 +148,17 @@ void initialize_global_accelerator_table()
                                           PlayerWindowEvents::SET_NEXT_EVENT);
     g_accel_entries[PLAY_ACTIVATE_ACCEL].Set(
         0, WXK_F5, PlayerWindowEvents::PLAY_ACTIVATE_EVENT);
+    g_accel_entries[TEMPO_UP_ACCEL1].Set(wxACCEL_CTRL, '=',
+                                         PlayerWindowEvents::TEMPO_UP_EVENT);
+    g_accel_entries[TEMPO_UP_ACCEL2].Set(wxACCEL_CTRL, WXK_NUMPAD_ADD,
+                                         PlayerWindowEvents::TEMPO_UP_EVENT);
+    g_accel_entries[TEMPO_DOWN_ACCEL1].Set(
+        wxACCEL_CTRL, '-', PlayerWindowEvents::TEMPO_DOWN_EVENT);
+    g_accel_entries[TEMPO_DOWN_ACCEL2].Set(
+        wxACCEL_CTRL, WXK_NUMPAD_SUBTRACT,
+        PlayerWindowEvents::TEMPO_DOWN_EVENT);
+    g_accel_entries[PANIC_ACCEL].Set(0, WXK_ESCAPE,
+                                     PlayerWindowEvents::PANIC_EVENT);
 }
 
 
@@ -91,16 +167,44 @@ PlayerWindow::PlayerWindow() :
     wxLog(),
     m_player_thread(),
     m_midi_devices(),
+    m_device_placeholder{nullptr},
+    m_trace_menu{nullptr},
+    m_tempo_menu{nullptr},
+    m_tempo_percent{100U},
+    m_transpose_menu{nullptr},
+    m_transpose_steps{0},
+    m_port_enumerator(),
     m_midi_out(),
     m_current_device_id{0U},
+    m_latency_profile{0U, 0U},
+    m_port_names(),
+    m_monitor_menu{nullptr},
+    m_monitor_submenu{nullptr},
+    m_port_stats(),
     m_current_song_event_count{0U},
     m_current_song_id{0U},
     m_next_song_id{0U, false},
     m_song_list(0U, 0U),
     m_song_labels(),
+    m_song_budget_mb{load_song_memory_budget_mb()},
+    m_song_reloader([this](PlayListEntry loaded, uint32_t generation,
+                           bool imported) {
+        auto song = std::make_shared<PlayListEntry>(std::move(loaded));
+        CallAfter([=] {
+            on_song_reloaded(std::move(*song), generation, imported);
+        });
+    }),
+    m_file_watcher(),
+    m_changed_files(),
+    m_stale_songs(),
+    m_file_change_timer(this, PlayerWindowEvents::FILE_CHANGE_TIMER),
     m_current_config(),
     m_playlist_name(),
     m_playlist_changed{false},
+    m_playlist_saver([this](const std::string &file_name,
+                            const std::optional<std::string> &error) {
+        CallAfter([=] { on_playlist_saved(file_name, error); });
+    }),
     m_selected_control{nullptr},
     m_accel_table(int(NUM_ACCEL_ENTRIES), g_accel_entries.data()),
     m_ui_animation_timer(this, PlayerWindowEvents::UI_ANIMATE_TICK),
@@ -109,17 +213,78 @@ PlayerWindow::PlayerWindow() :
     m_background(image_name.data()),
     m_sync_config{false}
 {
-    for (auto i = 0U; i < m_midi_out.getPortCount(); ++i) {
-        m_midi_devices.emplace_back(
-            device_select, wxID_ANY, wxString(m_midi_out.getPortName(i)),
-            wxEmptyString, wxITEM_RADIO
-        );
-        device_select->Append(&m_midi_devices.back());
-        device_select->Bind(wxEVT_COMMAND_MENU_SELECTED,
-                            [=](wxCommandEvent&) { on_device_changed(i); },
-                            m_midi_devices.back().GetId());
-    }
-    m_midi_devices.front().Check();
+    StartupProfiler::get().mark(wxT("main window widgets"));
+
+    m_device_placeholder = device_select->Append(
+        wxID_ANY, wxT("Searching for MIDI devices..."));
+    m_device_placeholder->Enable(false);
+    m_port_enumerator = std::thread(&PlayerWindow::enumerate_midi_ports, this);
+    Bind(wxEVT_FSWATCHER, &PlayerWindow::on_file_changed, this);
+
+    //  Insert ahead of the "Quit" separator
+    auto *const export_menu = m_menu1->Insert(
+        m_menu1->GetMenuItemCount() - 2U, wxID_ANY,
+        wxT("&Export Service Bundle..."));
+    m_menu1->Bind(wxEVT_COMMAND_MENU_SELECTED, &PlayerWindow::on_export_bundle,
+                  this, export_menu->GetId());
+    auto *const simulate_menu = m_menu1->Insert(
+        m_menu1->GetMenuItemCount() - 2U, wxID_ANY,
+        wxT("Si&mulate Service..."));
+    m_menu1->Bind(wxEVT_COMMAND_MENU_SELECTED,
+                  &PlayerWindow::on_simulate_service, this,
+                  simulate_menu->GetId());
+    auto *const budget_menu = m_menu1->Insert(
+        m_menu1->GetMenuItemCount() - 2U, wxID_ANY,
+        wxT("Song Memory &Budget..."));
+    m_menu1->Bind(wxEVT_COMMAND_MENU_SELECTED,
+                  &PlayerWindow::on_edit_song_budget, this,
+                  budget_menu->GetId());
+
+    m_menu4->AppendSeparator();
+    m_trace_menu = m_menu4->AppendCheckItem(wxID_ANY,
+                                            wxT("Capture Playback &Trace"));
+    auto *const latency_menu = m_menu4->Append(wxID_ANY,
+                                               wxT("Output &Latency..."));
+    m_menu4->Bind(wxEVT_COMMAND_MENU_SELECTED, &PlayerWindow::on_edit_latency,
+                  this, latency_menu->GetId());
+    auto *const calibrate_menu = m_menu4->Append(
+        wxID_ANY, wxT("Loop&back Latency Calibration..."));
+    m_menu4->Bind(wxEVT_COMMAND_MENU_SELECTED,
+                  &PlayerWindow::on_calibrate_latency, this,
+                  calibrate_menu->GetId());
+    auto *const stats_menu = m_menu4->Append(
+        wxID_ANY, wxT("Output Port &Statistics..."));
+    m_menu4->Bind(wxEVT_COMMAND_MENU_SELECTED, &PlayerWindow::on_port_stats,
+                  this, stats_menu->GetId());
+
+    m_menu4->AppendSeparator();
+    auto *const seek_time_menu = m_menu4->Append(wxID_ANY,
+                                                 wxT("Seek to T&ime..."));
+    m_menu4->Bind(wxEVT_COMMAND_MENU_SELECTED, &PlayerWindow::on_seek_time,
+                  this, seek_time_menu->GetId());
+    auto *const seek_measure_menu = m_menu4->Append(
+        wxID_ANY, wxT("Seek to M&easure..."));
+    m_menu4->Bind(wxEVT_COMMAND_MENU_SELECTED, &PlayerWindow::on_seek_measure,
+                  this, seek_measure_menu->GetId());
+    m_tempo_menu = m_menu4->Append(wxID_ANY, wxT("Tem&po (100%)..."));
+    m_menu4->Bind(wxEVT_COMMAND_MENU_SELECTED, &PlayerWindow::on_edit_tempo,
+                  this, m_tempo_menu->GetId());
+    m_transpose_menu = m_menu4->Append(wxID_ANY, wxT("Tra&nspose (+0)..."));
+    m_menu4->Bind(wxEVT_COMMAND_MENU_SELECTED,
+                  &PlayerWindow::on_edit_transpose, this,
+                  m_transpose_menu->GetId());
+    m_menu4->Append(PlayerWindowEvents::PANIC_EVENT,
+                    wxT("Release All &Keys\tEsc"));
+
+    auto *const timing_menu = m_menu2->Append(wxID_ANY,
+                                              wxT("&Startup Timing..."));
+    m_menu2->Bind(wxEVT_COMMAND_MENU_SELECTED, &PlayerWindow::on_startup_timing,
+                  this, timing_menu->GetId());
+    auto *const memory_menu = m_menu2->Append(wxID_ANY,
+                                              wxT("Song &Memory..."));
+    m_menu2->Bind(wxEVT_COMMAND_MENU_SELECTED, &PlayerWindow::on_song_memory,
+                  this, memory_menu->GetId());
+
     header_container->Show(false);
     layout_scroll_panel();
 
@@ -200,7 +365,8 @@ void PlayerWindow::on_load_playlist(wxCommandEvent &event)
     }
 
     wxFileDialog open_dialog(this, "Open Playlist", "", "",
-                             "BachBot Playlist|*.bbp",
+                             "BachBot Playlist|*.bbp|"
+                             "BachBot Service Bundle|*.bbs",
                              wxFD_OPEN | wxFD_FILE_MUST_EXIST);
 
     [[maybe_unused]] auto s1 = m_staticline1->GetSize();
@@ -210,6 +376,12 @@ void PlayerWindow::on_load_playlist(wxCommandEvent &event)
         return;
     }
 
+    const wxFileName playlist_file(open_dialog.GetPath());
+    if (playlist_file.GetExt().IsSameAs(PLAYLIST_BUNDLE_EXTENSION, false)) {
+        load_bundle(open_dialog.GetPath());
+        return;
+    }
+
     PlaylistXmlLoader loader(this, open_dialog.GetPath());
     loader.set_on_success_callback([&](std::list<PlayListEntry> playlist) {
         clear_playlist_window();
@@ -218,6 +390,8 @@ void PlayerWindow::on_load_playlist(wxCommandEvent &event)
                 add_playlist_entry(i);
             }
             layout_scroll_panel();
+            update_song_residency();
+            update_file_watches();
         }
 
         m_playlist_name = open_dialog.GetPath();
@@ -259,8 +433,42 @@ void PlayerWindow::on_save_playlist(wxCommandEvent &event)
             song_id = song->get_sequence().second;
         }
 
-        playlist_doc.Save(m_playlist_name.value());
+        //  Serialize here, but leave the (possibly slow) disk to the saver
+        wxMemoryOutputStream playlist_stream;
+        playlist_doc.Save(playlist_stream);
+        std::string contents(playlist_stream.GetSize(), '\0');
+        static_cast<void>(playlist_stream.CopyTo(contents.data(),
+                                                 contents.size()));
+        m_playlist_saver.save(m_playlist_name.value().utf8_string(),
+                              std::move(contents));
         update_window_title(false);
+        SetStatusText(fmt::format(
+            L"Saving {}...",
+            wxFileName(m_playlist_name.value()).GetFullName()));
+    }
+}
+
+
+void PlayerWindow::on_playlist_saved(const std::string &file_name,
+                                     const std::optional<std::string> &error)
+{
+    const auto name = wxFileName(wxString::FromUTF8(file_name)).GetFullName();
+    if (!error.has_value()) {
+        //  A later save may be queued already; keep showing "Saving" for it
+        if (!m_playlist_saver.is_busy()) {
+            SetStatusText(fmt::format(L"Saved {}", name));
+        }
+        return;
+    }
+
+    SetStatusText(fmt::format(L"Unable to save {}", name));
+    wxMessageBox(wxString::FromUTF8(fmt::format("Error saving playlist:\n{}",
+                                                error.value())),
+                 "Save Error", wxOK | wxICON_ERROR);
+    if (m_playlist_name.has_value() &&
+        (m_playlist_name.value().utf8_string() == file_name)) {
+        //  Still unsaved; keep the change flag so exit prompts again
+        update_window_title(true);
     }
 }
 
@@ -279,7 +487,10 @@ void PlayerWindow::on_open_midi(wxCommandEvent &event)
     PlayListEntry song_entry;
     song_entry.song_id = uint32_t(m_song_labels.size()) + 1U;
     auto importer = std::make_unique<SyndineImporter>(
-        open_dialog.GetPath().ToStdString(), song_entry.song_id);
+        ImportCache::get().get_parsed_file(
+            ImportCache::stamp_file(open_dialog.GetPath()),
+            open_dialog.GetPath()),
+        song_entry.song_id);
 
     song_entry.file_name = open_dialog.GetPath();
     song_entry.tempo_detected = importer->get_tempo();
@@ -314,6 +525,8 @@ void PlayerWindow::on_open_midi(wxCommandEvent &event)
     add_playlist_entry(song_entry);
     layout_scroll_panel();
     m_song_list.second = song_entry.song_id;
+    update_song_residency();
+    update_file_watches();
     update_window_title(true);
 }
 
@@ -341,6 +554,78 @@ void PlayerWindow::on_about(wxCommandEvent &event)
 }
 
 
+void PlayerWindow::on_startup_timing(wxCommandEvent &event)
+{
+    static_cast<void>(event);
+    wxMessageBox(StartupProfiler::get().get_report(), wxT("Startup Timing"),
+                 wxOK | wxICON_INFORMATION);
+}
+
+
+void PlayerWindow::on_song_memory(wxCommandEvent &event)
+{
+    static_cast<void>(event);
+    if (0U == m_song_list.first) {
+        wxMessageBox(wxT("The playlist is empty."), wxT("Song Memory"),
+                     wxOK | wxICON_INFORMATION);
+        return;
+    }
+
+    std::wstring report;
+    std::set<const EventPool*> counted;
+    auto total_bytes = size_t(0U);
+    auto evicted = 0U;
+    auto song_id = m_song_list.first;
+    while (song_id > 0U) {
+        const auto *const song = m_song_labels[song_id].get();
+        const auto &entry = song->get_playlist_entry();
+        const auto name = wxFileName(entry.file_name).GetFullName();
+        if (entry.evicted) {
+            report += fmt::format(L"{}: evicted\n", name);
+            ++evicted;
+        } else if (!counted.insert(entry.midi_events.get()).second) {
+            report += fmt::format(L"{}: shared with an earlier entry\n",
+                                  name);
+        } else {
+            const auto bytes = entry.get_memory_bytes();
+            report += fmt::format(L"{}: {:.1f}KB ({} events)\n", name,
+                                  double(bytes) / 1024.0,
+                                  entry.get_event_count());
+            total_bytes += bytes;
+        }
+        song_id = song->get_sequence().second;
+    }
+    report += fmt::format(L"\nTotal: {:.1f}MB of {}MB budget, {} evicted",
+                          double(total_bytes) / (1024.0 * 1024.0),
+                          m_song_budget_mb, evicted);
+
+    const auto cache = ImportCache::get().get_stats();
+    report += fmt::format(L"\nImports: {} files read, {} re-used a parsed "
+                           "file, {} shared a compiled song",
+                          cache.files_parsed, cache.parsed_hits,
+                          cache.compiled_hits);
+
+    wxMessageBox(report, wxT("Song Memory"), wxOK | wxICON_INFORMATION);
+}
+
+
+void PlayerWindow::on_edit_song_budget(wxCommandEvent &event)
+{
+    static_cast<void>(event);
+    const auto budget_mb = wxGetNumberFromUser(
+        wxT("Memory allowed for compiled songs.  Songs furthest from the\n"
+            "playhead are unloaded beyond this and re-imported before they\n"
+            "are played."),
+        wxT("MB:"), wxT("Song Memory Budget"), m_song_budget_mb, 1L,
+        MAX_SONG_MEMORY_BUDGET_MB, this);
+    if (budget_mb > 0L) {
+        m_song_budget_mb = budget_mb;
+        save_song_memory_budget_mb(budget_mb);
+        update_song_residency();
+    }
+}
+
+
 void PlayerWindow::on_thread_tick(wxThreadEvent &event)
 {
     auto events_complete = 0;
@@ -354,6 +639,7 @@ void PlayerWindow::on_thread_tick(wxThreadEvent &event)
 void PlayerWindow::on_thread_exit(wxThreadEvent &event)
 {
     static_cast<void>(event);
+    m_port_stats = m_player_thread->get_port_stats();
     m_player_thread.reset();
     m_current_song_event_count = 0U;
     m_current_song_id = 0U;
@@ -362,6 +648,9 @@ void PlayerWindow::on_thread_exit(wxThreadEvent &event)
     m_playing_label.set_label_text(L"Not Playing");
     std::for_each(m_midi_devices.begin(), m_midi_devices.end(),
                   [](wxMenuItem& i) { i.Enable(); });
+    if (nullptr != m_monitor_submenu) {
+        m_monitor_submenu->Enable();
+    }
 
     new_playlist_menu->Enable();
     load_playlist_menu->Enable();
@@ -375,6 +664,382 @@ void PlayerWindow::on_thread_exit(wxThreadEvent &event)
 void PlayerWindow::on_device_changed(const uint32_t device_id)
 {
     m_current_device_id = device_id;
+    m_latency_profile = load_latency_profile(m_port_names[device_id]);
+}
+
+
+void PlayerWindow::on_seek_time(wxCommandEvent &event)
+{
+    static_cast<void>(event);
+    if ((nullptr == m_player_thread) || (0U == m_current_song_id)) {
+        wxMessageBox(wxT("Seeking requires a song to be playing."),
+                     wxT("Can't seek"), wxOK | wxICON_INFORMATION);
+        return;
+    }
+
+    auto *const song = m_song_labels[m_current_song_id].get();
+    const auto index = song->get_song_index();
+    if (nullptr == index) {
+        return;
+    }
+
+    const auto duration_s = long(index->get_duration_us() / 1000000);
+    const auto seconds = wxGetNumberFromUser(
+        wxT("Continue playing from (seconds into the song):"),
+        wxT("Seconds:"), wxT("Seek to Time"), 0L, 0L, duration_s, this);
+    if ((seconds >= 0L) && (nullptr != m_player_thread)) {
+        m_player_thread->signal_seek(uint32_t(seconds) * 1000U);
+    }
+}
+
+
+void PlayerWindow::on_seek_measure(wxCommandEvent &event)
+{
+    static_cast<void>(event);
+    if ((nullptr == m_player_thread) || (0U == m_current_song_id)) {
+        wxMessageBox(wxT("Seeking requires a song to be playing."),
+                     wxT("Can't seek"), wxOK | wxICON_INFORMATION);
+        return;
+    }
+
+    auto *const song = m_song_labels[m_current_song_id].get();
+    const auto index = song->get_song_index();
+    if ((nullptr == index) || !index->has_measures()) {
+        wxMessageBox(wxT("Measure numbers are not known for this song."),
+                     wxT("Can't seek"), wxOK | wxICON_INFORMATION);
+        return;
+    }
+
+    const auto measure = wxGetNumberFromUser(
+        wxT("Continue playing from the start of measure:"),
+        wxT("Measure:"), wxT("Seek to Measure"), 1L, 1L,
+        long(index->get_measure_count()), this);
+    if ((measure > 0L) && (nullptr != m_player_thread)) {
+        m_player_thread->signal_seek_measure(uint32_t(measure));
+    }
+}
+
+
+void PlayerWindow::on_edit_tempo(wxCommandEvent &event)
+{
+    static_cast<void>(event);
+    const auto percent = wxGetNumberFromUser(
+        wxT("Playback tempo as a percentage of the recorded tempo.\n"
+            "Use Ctrl+Plus / Ctrl+Minus to adjust while playing."),
+        wxT("Percent:"), wxT("Tempo"), long(m_tempo_percent),
+        long(MIN_TEMPO_PERCENT), long(MAX_TEMPO_PERCENT), this);
+    if (percent > 0L) {
+        set_tempo(percent);
+    }
+}
+
+
+void PlayerWindow::on_edit_transpose(wxCommandEvent &event)
+{
+    static_cast<void>(event);
+    wxArrayString choices;
+    for (auto steps = -MIDI_NOTES_IN_OCTAVE; steps <= MIDI_NOTES_IN_OCTAVE;
+         ++steps) {
+        choices.Add(fmt::format(L"{:+d} half-steps", steps));
+    }
+
+    const auto selection = wxGetSingleChoiceIndex(
+        wxT("Play in a different key (in addition to any key change made "
+            "when the songs were added):"),
+        wxT("Transpose"), choices, m_transpose_steps + MIDI_NOTES_IN_OCTAVE,
+        this);
+    if (selection < 0) {
+        return;
+    }
+
+    m_transpose_steps = selection - MIDI_NOTES_IN_OCTAVE;
+    m_transpose_menu->SetItemLabel(
+        fmt::format(L"Tra&nspose ({:+d})...", m_transpose_steps));
+    if (nullptr != m_player_thread) {
+        m_player_thread->signal_transpose(m_transpose_steps);
+    }
+}
+
+
+void PlayerWindow::on_panic(wxCommandEvent &event)
+{
+    static_cast<void>(event);
+    if (m_midi_devices.empty()) {
+        return;
+    }
+
+    if (nullptr != m_player_thread) {
+        //  The player knows exactly which keys it left down.
+        m_player_thread->signal_panic();
+        return;
+    }
+
+    //  Nothing is tracked while stopped; anything still sounding was left by
+    // something else (ie a crash) so sweep every key.
+    try {
+        const auto port_open = m_midi_out.isPortOpen();
+        if (!port_open) {
+            m_midi_out.openPort(m_current_device_id);
+        }
+        for (const auto keyboard: {SyndyneKeyboards::MANUAL1_GREAT,
+                                   SyndyneKeyboards::MANUAL2_SWELL,
+                                   SyndyneKeyboards::PETAL}) {
+            const auto high_limit = (SyndyneKeyboards::PETAL == keyboard) ?
+                HIGHEST_PETAL_NOTE : HIGHEST_MANUAL_NOTE;
+            for (auto note = LOWEST_KEYBOARD_NOTE; note <= high_limit;
+                 ++note) {
+                const std::array<uint8_t, MIDI_MESSAGE_SIZE> note_off = {
+                    make_midi_command_byte(keyboard, MidiCommands::NOTE_OFF),
+                    uint8_t(note), 0U};
+                m_midi_out.sendMessage(note_off.data(), note_off.size());
+            }
+        }
+        if (!port_open) {
+            m_midi_out.closePort();
+        }
+    } catch (const RtMidiError &e) {
+        wxMessageBox(fmt::format(L"Unable to release keys:\n"
+                                  "Error reported was: {}",
+                                 wxString(e.getMessage())));
+    }
+}
+
+
+void PlayerWindow::on_accel_tempo_up_event(wxCommandEvent &event)
+{
+    static_cast<void>(event);
+    set_tempo(long(m_tempo_percent) + TEMPO_STEP_PERCENT);
+}
+
+
+void PlayerWindow::on_accel_tempo_down_event(wxCommandEvent &event)
+{
+    static_cast<void>(event);
+    set_tempo(long(m_tempo_percent) - TEMPO_STEP_PERCENT);
+}
+
+
+void PlayerWindow::set_tempo(const long tempo_percent)
+{
+    m_tempo_percent = uint32_t(std::clamp(tempo_percent,
+                                          long(MIN_TEMPO_PERCENT),
+                                          long(MAX_TEMPO_PERCENT)));
+    m_tempo_menu->SetItemLabel(
+        fmt::format(L"Tem&po ({}%)...", m_tempo_percent));
+    if (nullptr != m_player_thread) {
+        m_player_thread->signal_tempo(m_tempo_percent);
+    }
+}
+
+
+void PlayerWindow::on_port_stats(wxCommandEvent &event)
+{
+    static_cast<void>(event);
+    auto stats = m_port_stats;
+    if (nullptr != m_player_thread) {
+        stats = m_player_thread->get_port_stats();
+    }
+
+    if (stats.empty()) {
+        wxMessageBox(wxT("Nothing has been played yet."),
+                     wxT("Output Port Statistics"), wxOK | wxICON_INFORMATION);
+        return;
+    }
+
+    std::wstring report;
+    for (const auto &[name, port]: stats) {
+        report += fmt::format(
+            L"{}\n"
+             "  Sent: {}  Dropped: {}  Late (>{}ms): {}\n"
+             "  Delay mean: {:.3f}ms  max: {:.3f}ms\n",
+            wxString(name), port.messages, port.dropped,
+            PORT_LATE_US / 1000U, port.late,
+            port.get_mean_late_us() / 1000.0,
+            double(port.max_late_us) / 1000.0);
+
+        const auto loopback = load_loopback_result(name);
+        if (loopback.has_value()) {
+            report += L"  Last loopback measurement:\n" +
+                      format_loopback(loopback.value(), L"    ");
+        }
+        report += L"\n";
+    }
+
+    wxMessageBox(report, wxT("Output Port Statistics"),
+                 wxOK | wxICON_INFORMATION);
+}
+
+
+void PlayerWindow::on_edit_latency(wxCommandEvent &event)
+{
+    static_cast<void>(event);
+    if (m_port_names.empty()) {
+        return;
+    }
+
+    const auto &port_name = m_port_names[m_current_device_id];
+    const auto note_ms = wxGetNumberFromUser(
+        wxT("Send notes early by (ms):"), wxT("Notes:"),
+        fmt::format(L"Output Latency - {}", wxString(port_name)),
+        long(m_latency_profile.note_offset_us / 1000U), 0L,
+        MAX_LATENCY_OFFSET_MS, this);
+    if (note_ms < 0L) {
+        return;
+    }
+
+    const auto bank_ms = wxGetNumberFromUser(
+        wxT("Send bank changes early by (ms):"), wxT("Bank changes:"),
+        fmt::format(L"Output Latency - {}", wxString(port_name)),
+        long(m_latency_profile.bank_offset_us / 1000U), 0L,
+        MAX_LATENCY_OFFSET_MS, this);
+    if (bank_ms < 0L) {
+        return;
+    }
+
+    m_latency_profile.note_offset_us = uint32_t(note_ms) * 1000U;
+    m_latency_profile.bank_offset_us = uint32_t(bank_ms) * 1000U;
+    save_latency_profile(port_name, m_latency_profile);
+}
+
+
+void PlayerWindow::on_calibrate_latency(wxCommandEvent &event)
+{
+    static_cast<void>(event);
+    if (m_port_names.empty() || (nullptr != m_player_thread)) {
+        wxMessageBox(wxT("Calibration requires an idle MIDI output device."),
+                     wxT("Can't calibrate"), wxOK | wxICON_ERROR);
+        return;
+    }
+
+    wxArrayString input_names;
+    try {
+        RtMidiIn midi_in;
+        const auto port_count = midi_in.getPortCount();
+        for (auto i = 0U; i < port_count; ++i) {
+            input_names.Add(wxString(midi_in.getPortName(i)));
+        }
+    } catch (const RtMidiError &e) {
+        static_cast<void>(e);
+    }
+
+    if (input_names.IsEmpty()) {
+        wxMessageBox(wxT("No MIDI input device is available to loop back to."),
+                     wxT("Can't calibrate"), wxOK | wxICON_ERROR);
+        return;
+    }
+
+    const auto &port_name = m_port_names[m_current_device_id];
+    const auto in_port = wxGetSingleChoiceIndex(
+        fmt::format(L"Connect the output of \"{}\" to a MIDI input (a "
+                     "hardware loopback, or a virtual port for a software "
+                     "only run) and select that input:", wxString(port_name)),
+        wxT("Loopback Latency Calibration"), input_names, this);
+    if (in_port < 0) {
+        return;
+    }
+
+    LoopbackResult result{};
+    try {
+        wxBusyCursor wait;
+        result = measure_loopback_latency(m_current_device_id,
+                                          uint32_t(in_port));
+    } catch (const std::runtime_error &e) {
+        wxMessageBox(fmt::format(L"Calibration failed:\n"
+                                  "Error reported was: {}",
+                                 wxString(e.what())),
+                     wxT("Calibration failed"), wxOK | wxICON_ERROR);
+        return;
+    }
+
+    //  The console's extra bank change delay can't be seen through the
+    // loopback; keep whatever was configured on top of the note offset.
+    const auto device_us = result.get_device_latency_us();
+    auto bank_extra_us = 0U;
+    if (m_latency_profile.bank_offset_us > m_latency_profile.note_offset_us) {
+        bank_extra_us = m_latency_profile.bank_offset_us -
+                        m_latency_profile.note_offset_us;
+    }
+
+    //  Keep the measurement even if it isn't used as the profile.
+    save_loopback_result(port_name, result);
+
+    const auto answer = wxMessageBox(fmt::format(
+        L"{}\n"
+         "Estimated output latency: {:.2f}ms\n\n"
+         "Use this for \"{}\"?",
+        format_loopback(result, L""), double(device_us) / 1000.0,
+        wxString(port_name)),
+        wxT("Loopback Latency Calibration"),
+        wxYES_NO | wxICON_QUESTION, this);
+    if (wxYES != answer) {
+        return;
+    }
+
+    m_latency_profile.note_offset_us = device_us;
+    m_latency_profile.bank_offset_us = device_us + bank_extra_us;
+    save_latency_profile(port_name, m_latency_profile);
+}
+
+
+void PlayerWindow::enumerate_midi_ports()
+{
+    wxStopWatch enumerate_time;
+    std::vector<std::string> port_names;
+    try {
+        RtMidiOut midi_out;
+        const auto port_count = midi_out.getPortCount();
+        for (auto i = 0U; i < port_count; ++i) {
+            port_names.push_back(midi_out.getPortName(i));
+        }
+    } catch (const RtMidiError &) {
+        port_names.clear();
+    }
+
+    const auto enumerate_us = enumerate_time.TimeInMicro();
+    CallAfter([=]() {
+        populate_device_menu(port_names);
+        StartupProfiler::get().add_background(wxT("MIDI port enumeration"),
+                                              enumerate_us);
+    });
+}
+
+
+void PlayerWindow::populate_device_menu(
+    const std::vector<std::string> &port_names)
+{
+    if (port_names.empty()) {
+        m_device_placeholder->SetItemLabel(wxT("No MIDI devices found"));
+        return;
+    }
+
+    device_select->Delete(m_device_placeholder);
+    m_device_placeholder = nullptr;
+    m_port_names = port_names;
+
+    const auto player_active = (nullptr != m_player_thread);
+    for (auto i = 0U; i < port_names.size(); ++i) {
+        m_midi_devices.emplace_back(
+            device_select, wxID_ANY, wxString(port_names[i]),
+            wxEmptyString, wxITEM_RADIO
+        );
+        device_select->Append(&m_midi_devices.back());
+        device_select->Bind(wxEVT_COMMAND_MENU_SELECTED,
+                            [=](wxCommandEvent&) { on_device_changed(i); },
+                            m_midi_devices.back().GetId());
+        m_midi_devices.back().Enable(!player_active);
+    }
+    m_midi_devices.front().Check();
+    m_latency_profile = load_latency_profile(m_port_names.front());
+
+    m_monitor_menu = new wxMenu();
+    for (const auto &name: port_names) {
+        static_cast<void>(m_monitor_menu->AppendCheckItem(wxID_ANY,
+                                                          wxString(name)));
+    }
+    device_select->AppendSeparator();
+    m_monitor_submenu = device_select->AppendSubMenu(m_monitor_menu,
+                                                     wxT("&Monitor Outputs"));
+    m_monitor_submenu->Enable(!player_active);
 }
 
 
@@ -398,12 +1063,14 @@ void PlayerWindow::on_song_starts_playing(wxThreadEvent &event)
         m_current_song_id = song_id;
         m_next_song_id.second = false;
         set_next_song(song_data->get_sequence().second);
-        m_current_song_event_count = song_data->get_song_events().size();
+        m_current_song_event_count =
+            song_data->get_playlist_entry().get_event_count();
         event_count->SetRange(int(m_current_song_event_count));
         m_playing_label.set_label_text(song_data->get_filename());
         song_data->set_playing();
         scroll_to_widget(song_data);
     }
+    reload_stale_songs();
 }
 
 
@@ -416,6 +1083,7 @@ void PlayerWindow::on_song_done_playing(wxThreadEvent &event)
         set_next_song(m_current_song_id);
     }
     m_current_song_id = 0U;
+    reload_stale_songs();
 }
 
 
@@ -457,6 +1125,7 @@ void PlayerWindow::on_accel_play_next_event(wxCommandEvent &event)
 
 void PlayerWindow::on_timer_tick(wxTimerEvent &event)
 {
+    BACHBOT_ZONE("PlayerWindow::on_timer_tick");
     static_cast<void>(event);
     m_up_next_label.animate_tick();
     m_playing_label.animate_tick();
@@ -497,6 +1166,116 @@ void PlayerWindow::on_timer_tick(wxTimerEvent &event)
 }
 
 
+void PlayerWindow::on_export_bundle(wxCommandEvent &event)
+{
+    static_cast<void>(event);
+    if (0U == m_song_list.first) {
+        wxMessageBox(wxT("The playlist is empty."), wxT("Export Service Bundle"),
+                     wxOK | wxICON_INFORMATION);
+        return;
+    }
+
+    wxFileDialog save_dialog(this, "Export Service Bundle", "", "",
+                             "BachBot Service Bundle|*.bbs",
+                             wxFD_SAVE | wxFD_OVERWRITE_PROMPT);
+    if (save_dialog.ShowModal() == wxID_CANCEL) {
+        return;
+    }
+
+    std::vector<const PlayListEntry*> playlist;
+    auto song_id = m_song_list.first;
+    while (song_id > 0U) {
+        auto *const song = m_song_labels[song_id].get();
+        song->ensure_resident();
+        playlist.push_back(&song->get_playlist_entry());
+        song_id = song->get_sequence().second;
+    }
+
+    try {
+        save_playlist_bundle(save_dialog.GetPath().utf8_string(), playlist);
+    } catch (const std::runtime_error &e) {
+        wxMessageBox(fmt::format(L"Error exporting service bundle:\n"
+                                  "Error reported was: {}",
+                                 wxString(e.what())));
+    }
+    update_song_residency();
+}
+
+
+void PlayerWindow::on_simulate_service(wxCommandEvent &event)
+{
+    static_cast<void>(event);
+    if (0U == m_song_list.first) {
+        wxMessageBox(wxT("The playlist is empty."), wxT("Simulate Service"),
+                     wxOK | wxICON_INFORMATION);
+        return;
+    }
+
+    wxFileDialog save_dialog(this, "Save Simulation Log", "", "",
+                             "Simulation Log|*.log",
+                             wxFD_SAVE | wxFD_OVERWRITE_PROMPT);
+    if (save_dialog.ShowModal() == wxID_CANCEL) {
+        return;
+    }
+
+    std::vector<SimulatedSong> songs;
+    auto song_id = m_song_list.first;
+    while (song_id > 0U) {
+        auto *const song = m_song_labels[song_id].get();
+        song->ensure_resident();
+        const auto &entry = song->get_playlist_entry();
+        songs.push_back({song_id, entry.file_name, entry.midi_events,
+                         song->get_autoplay()});
+        song_id = song->get_sequence().second;
+    }
+    update_song_residency();
+
+    PlayerSimulator simulator(std::move(songs), m_current_config);
+    {
+        wxBusyCursor busy;
+        simulator.run();
+    }
+
+    try {
+        simulator.save_log(save_dialog.GetPath().utf8_string());
+    } catch (const std::runtime_error &e) {
+        wxMessageBox(fmt::format(L"Error saving simulation log:\n"
+                                  "Error reported was: {}",
+                                 wxString::FromUTF8(e.what())));
+        return;
+    }
+
+    wxMessageBox(simulator.get_summary(), wxT("Simulate Service"),
+                 wxOK | wxICON_INFORMATION);
+}
+
+
+void PlayerWindow::load_bundle(const wxString &file_name)
+{
+    std::list<PlayListEntry> playlist;
+    try {
+        playlist = load_playlist_bundle(file_name.utf8_string());
+    } catch (const std::runtime_error &e) {
+        wxMessageBox(fmt::format(L"Error loading service bundle:\n"
+                                  "Error reported was: {}",
+                                 wxString(e.what())));
+        return;
+    }
+
+    clear_playlist_window();
+    for (const auto &i: playlist) {
+        add_playlist_entry(i);
+    }
+    layout_scroll_panel();
+    update_song_residency();
+    update_file_watches();
+
+    //  A bundle is not a playlist file, "Save" has to ask for a `.bbp` name.
+    m_playlist_name.reset();
+    update_window_title(false);
+}
+
+
 void PlayerWindow::on_move_event(const uint32_t song_id,
                                  PlaylistEntryControl *control,
                                  const bool direction)
@@ -537,6 +1316,7 @@ void PlayerWindow::on_move_event(const uint32_t song_id,
             set_next_song(cur_sequence.second);
         }
     }
+    update_song_residency();
 }
 
 
@@ -546,7 +1326,7 @@ void PlayerWindow::on_checkbox_event(const uint32_t song_id, const bool checked)
         if (checked && (0U != m_next_song_id.first)) {
             auto control = m_song_labels[m_next_song_id.first].get();
             control->set_next();
-            m_player_thread->enqueue_next_song(control->get_song_events());
+            enqueue_next_song(control);
         } else {
             m_player_thread->enqueue_next_song({});
             if (0U != m_next_song_id.first &&
@@ -628,6 +1408,8 @@ void PlayerWindow::on_drop_midi_file(wxDropFilesEvent &event)
                               add_playlist_entry(i);
                           });
             layout_scroll_panel();
+            update_song_residency();
+            update_file_watches();
             update_window_title(true);
         }
     });
@@ -838,6 +1620,15 @@ void PlayerWindow::on_memory_down_button_clicked(wxCommandEvent &event)
 
 void PlayerWindow::send_manual_message(const SyndyneBankCommands value)
 {
+    if (m_midi_devices.empty()) {
+        return;
+    }
+
+    if (nullptr != m_player_thread) {
+        m_player_thread->signal_bank_change(value);
+        return;
+    }
+
     const auto port_open = m_midi_out.isPortOpen();
     if (!port_open) {
         m_midi_out.openPort(m_current_device_id);
@@ -859,6 +1650,11 @@ void PlayerWindow::clear_playlist_window()
     });
 
     m_song_labels.clear();
+    m_changed_files.clear();
+    m_stale_songs.clear();
+    if (nullptr != m_file_watcher) {
+        static_cast<void>(m_file_watcher->RemoveAll());
+    }
     m_up_next_label.set_label_text(wxT(""));
     static_cast<void>(playlist_label->Show(true));
     layout_scroll_panel();
@@ -957,14 +1753,198 @@ void PlayerWindow::set_next_song(uint32_t song_id, bool priority)
                 (nullptr != m_player_thread.get()))
             {
                 next_song->set_next();
-                m_player_thread->enqueue_next_song(
-                    next_song->get_song_events());
+                enqueue_next_song(next_song);
             } else if (song_id != m_current_song_id) {
                 next_song->reset_status();
             }
         } else {
             m_up_next_label.set_label_text(wxT(""));
         }
+        update_song_residency();
+    }
+}
+
+
+void PlayerWindow::update_song_residency()
+{
+    BACHBOT_ZONE("PlayerWindow::update_song_residency");
+    const auto playhead = (0U != m_current_song_id) ? m_current_song_id :
+                                                       m_next_song_id.first;
+    std::vector<PlaylistEntryControl*> order;
+    auto playhead_pos = size_t(0U);
+    for (auto song_id = m_song_list.first; song_id > 0U;) {
+        auto *const song = m_song_labels[song_id].get();
+        if (song_id == playhead) {
+            playhead_pos = order.size();
+        }
+        order.push_back(song);
+        song_id = song->get_sequence().second;
+    }
+
+    std::vector<SongResidency> songs;
+    songs.reserve(order.size());
+    for (auto pos = size_t(0U); pos < order.size(); ++pos) {
+        const auto &entry = order[pos]->get_playlist_entry();
+        const auto behind = (pos < playhead_pos);
+        const auto distance = behind ? (playhead_pos - pos) :
+                                       (pos - playhead_pos);
+        const auto pinned = (!behind && (distance <= SONG_PREFETCH_DISTANCE)) ||
+                            (entry.song_id == m_current_song_id) ||
+                            (entry.song_id == m_next_song_id.first) ||
+                            entry.from_bundle;
+        if (pinned && entry.evicted) {
+            m_song_reloader.request(entry);
+        }
+        songs.push_back({entry.song_id, distance, behind, pinned,
+                         entry.midi_events.get(), entry.get_memory_bytes()});
+    }
+
+    const auto budget_bytes = size_t(m_song_budget_mb) * 1024U * 1024U;
+    for (const auto song_id: select_songs_to_evict(std::move(songs),
+                                                   budget_bytes))
+    {
+        m_song_labels[song_id]->evict();
+    }
+}
+
+
+void PlayerWindow::on_song_reloaded(PlayListEntry &&loaded,
+                                    const uint32_t generation,
+                                    const bool imported)
+{
+    if (!imported) {
+        //  Left as it was; an evicted song is tried again when it's needed
+        SetStatusText(fmt::format(L"Unable to re-import {}",
+                                  loaded.file_name));
+        return;
+    }
+
+    //  The song may have been removed (or the playlist replaced) meanwhile
+    const auto song_id = loaded.song_id;
+    const auto song = m_song_labels.find(song_id);
+    if ((m_song_labels.end() == song) ||
+        !song->second->adopt_events(std::move(loaded), generation))
+    {
+        return;
+    }
+
+    //  The player holds its own copy of the next song, replace it as well
+    const auto cur_song = m_song_labels.find(m_current_song_id);
+    if ((song_id == m_next_song_id.first) &&
+        (m_song_labels.end() != cur_song) &&
+        cur_song->second->get_autoplay() &&
+        (nullptr != m_player_thread.get()))
+    {
+        enqueue_next_song(song->second.get());
+    }
+}
+
+
+void PlayerWindow::enqueue_next_song(PlaylistEntryControl *const song)
+{
+    //  Normally prefetched by now.  A song the reloader hasn't got back yet
+    // is imported here: waiting for it would leave the player with nothing
+    // to play next, ending the autoplay chain.  (The background copy is
+    // then stale and discarded.)
+    m_player_thread->enqueue_next_song(song->get_song_events(),
+                                       song->get_song_index());
+}
+
+
+void PlayerWindow::update_file_watches()
+{
+    //  Created on first use, the watcher requires a running event loop
+    if (nullptr == m_file_watcher) {
+        m_file_watcher = std::make_unique<wxFileSystemWatcher>();
+        m_file_watcher->SetOwner(this);
+    }
+    static_cast<void>(m_file_watcher->RemoveAll());
+
+    //  A bundle song's file name is only a label
+    std::set<wxString> directories;
+    for (const auto &song: m_song_labels) {
+        if (!song.second->get_playlist_entry().from_bundle) {
+            directories.insert(
+                wxFileName(song.second->get_filename()).GetPath());
+        }
+    }
+
+    //  Watch directories rather than files: editors commonly save by
+    // replacing the file, and Windows can only watch directories.
+    for (const auto &directory: directories) {
+        static_cast<void>(m_file_watcher->Add(
+            wxFileName::DirName(directory),
+            wxFSW_EVENT_MODIFY | wxFSW_EVENT_CREATE | wxFSW_EVENT_RENAME));
+    }
+}
+
+
+void PlayerWindow::on_file_changed(wxFileSystemWatcherEvent &event)
+{
+    switch (event.GetChangeType()) {
+    case wxFSW_EVENT_MODIFY:
+    case wxFSW_EVENT_CREATE:
+        m_changed_files.push_back(event.GetPath());
+        break;
+
+    case wxFSW_EVENT_RENAME:
+        //  Saved to a temporary file and renamed over the original
+        m_changed_files.push_back(event.GetNewPath());
+        break;
+
+    default:
+        return;
+    }
+
+    //  A save is usually several events (truncate, write, close), wait for
+    // the file to settle
+    static_cast<void>(m_file_change_timer.StartOnce(FILE_CHANGE_SETTLE_MS));
+}
+
+
+void PlayerWindow::on_file_change_timer(wxTimerEvent &event)
+{
+    static_cast<void>(event);
+    const auto changed_files = std::move(m_changed_files);
+    m_changed_files.clear();
+
+    for (const auto &[song_id, control]: m_song_labels) {
+        const auto &entry = control->get_playlist_entry();
+        const wxFileName song_file(entry.file_name);
+        const auto changed = std::any_of(
+            changed_files.begin(), changed_files.end(),
+            [&](const wxFileName &file) { return file.SameAs(song_file); });
+
+        //  An evicted song is imported from the new file when it's needed;
+        // a bundle song keeps the events it was exported with.
+        if (!changed || entry.evicted || entry.from_bundle) {
+            continue;
+        }
+
+        if (song_id == m_current_song_id) {
+            static_cast<void>(m_stale_songs.insert(song_id));
+        } else {
+            m_song_reloader.request(entry, true);
+        }
+    }
+}
+
+
+void PlayerWindow::reload_stale_songs()
+{
+    for (auto i = m_stale_songs.begin(); i != m_stale_songs.end();) {
+        if (*i == m_current_song_id) {
+            ++i;
+            continue;
+        }
+
+        const auto song = m_song_labels.find(*i);
+        if ((m_song_labels.end() != song) &&
+            !song->second->get_playlist_entry().evicted)
+        {
+            m_song_reloader.request(song->second->get_playlist_entry(), true);
+        }
+        i = m_stale_songs.erase(i);
     }
 }
 
@@ -990,15 +1970,71 @@ bool PlayerWindow::pre_close_check(wxCommandEvent &event)
 
 void PlayerWindow::start_player_thread()
 {
-    m_player_thread = std::make_unique<PlayerThread>(this, m_midi_out);
-    m_midi_out.openPort(m_current_device_id);
+    if (m_midi_devices.empty()) {
+        wxMessageBox(wxT("No MIDI output device is available."),
+                     wxT("Can't play"), wxOK | wxICON_ERROR);
+        return;
+    }
+
+    PlayerThread::PortList ports;
+    try {
+        ports.push_back(std::make_unique<PortSender>(
+            m_current_device_id, m_port_names[m_current_device_id]));
+    } catch (const std::runtime_error &e) {
+        wxMessageBox(fmt::format(L"Unable to open MIDI output:\n"
+                                  "Error reported was: {}",
+                                 wxString(e.what())),
+                     wxT("Can't play"), wxOK | wxICON_ERROR);
+        return;
+    }
+
+    //  A monitor port that fails to open shouldn't stop the service.
+    for (auto i = 0U; i < m_port_names.size(); ++i) {
+        if ((i == m_current_device_id) ||
+            !m_monitor_menu->FindItemByPosition(i)->IsChecked()) {
+            continue;
+        }
+        try {
+            ports.push_back(std::make_unique<PortSender>(i, m_port_names[i]));
+        } catch (const std::runtime_error &e) {
+            wxMessageBox(fmt::format(L"Monitor output \"{}\" disabled:\n"
+                                      "Error reported was: {}",
+                                     wxString(m_port_names[i]),
+                                     wxString(e.what())));
+        }
+    }
+
+    m_player_thread = std::make_unique<PlayerThread>(this, std::move(ports));
+    m_player_thread->set_latency_profile(m_latency_profile);
+    m_player_thread->set_tempo(m_tempo_percent);
+    m_player_thread->set_transpose(m_transpose_steps);
+    if (m_trace_menu->IsChecked()) {
+        //  Traces are for after-the-fact analysis, don't stop the music.
+        const auto trace_dir = wxFileName(
+            wxStandardPaths::Get().GetUserLocalDataDir(), wxT("traces"));
+        const wxFileName trace_file(
+            trace_dir.GetFullPath(),
+            wxDateTime::Now().Format(wxT("trace-%Y%m%d-%H%M%S.")) +
+                TRACE_FILE_EXTENSION);
+        try {
+            static_cast<void>(wxFileName::Mkdir(trace_dir.GetFullPath(),
+                                                wxS_DIR_DEFAULT,
+                                                wxPATH_MKDIR_FULL));
+            m_player_thread->set_trace(std::make_unique<PlaybackTrace>(
+                trace_file.GetFullPath().utf8_string()));
+        } catch (const std::runtime_error &e) {
+            wxMessageBox(fmt::format(L"Playback trace disabled:\n"
+                                      "Error reported was: {}",
+                                     wxString::FromUTF8(e.what())));
+        }
+    }
     m_player_thread->set_bank_config(m_current_config.memory,
                                      m_current_config.mode);
 
     if (0U != m_next_song_id.first) {
         auto control = m_song_labels[m_next_song_id.first].get();
         m_player_thread->enqueue_next_song(
-            control->get_song_events());
+            control->get_song_events(), control->get_song_index());
     } else {
         m_player_thread->enqueue_next_song(
             generate_test_pattern());
@@ -1007,6 +2043,7 @@ void PlayerWindow::start_player_thread()
     m_player_thread->play();
     std::for_each(m_midi_devices.begin(), m_midi_devices.end(),
                   [](wxMenuItem &i) { i.Enable(false); });
+    m_monitor_submenu->Enable(false);
 
     new_playlist_menu->Enable(false);
     load_playlist_menu->Enable(false);
@@ -1120,6 +2157,7 @@ void PlayerWindow::remove_song(PlaylistEntryControl *const widget,
     layout_scroll_panel();
     update_window_title(true);
     m_song_labels.erase(song_id);
+    update_file_watches();
 }
 
 
@@ -1165,6 +2203,11 @@ void PlayerWindow::on_control_selected(const uint32_t song_id,
 
 PlayerWindow::~PlayerWindow()
 {
+    if (m_port_enumerator.joinable()) {
+        m_port_enumerator.join();
+    }
+    m_song_reloader.stop();
+    m_playlist_saver.finish();
     static_cast<void>(PopEventHandler());
 
     wxCommandEvent e;
@@ -1188,7 +2231,14 @@ wxBEGIN_EVENT_TABLE(PlayerWindow, wxFrame)
     EVT_MENU(PlayerWindowEvents::MOVE_UP_EVENT, PlayerWindow::on_accel_up_event)
     EVT_MENU(PlayerWindowEvents::SET_NEXT_EVENT, PlayerWindow::on_accel_play_next_event)
     EVT_MENU(PlayerWindowEvents::PLAY_ACTIVATE_EVENT, PlayerWindow::on_play_advance)
+    EVT_MENU(PlayerWindowEvents::TEMPO_UP_EVENT,
+             PlayerWindow::on_accel_tempo_up_event)
+    EVT_MENU(PlayerWindowEvents::TEMPO_DOWN_EVENT,
+             PlayerWindow::on_accel_tempo_down_event)
+    EVT_MENU(PlayerWindowEvents::PANIC_EVENT, PlayerWindow::on_panic)
     EVT_TIMER(PlayerWindowEvents::UI_ANIMATE_TICK, PlayerWindow::on_timer_tick)
+    EVT_TIMER(PlayerWindowEvents::FILE_CHANGE_TIMER,
+              PlayerWindow::on_file_change_timer)
 wxEND_EVENT_TABLE()
 
 }  //  end ui
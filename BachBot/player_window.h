@@ -34,7 +34,12 @@
 #include <utility>  //  std::pair
 #include <map>  //  std::map
 #include <optional>  //  std::optional
+#include <set>  //  std::set
+#include <string>  //  std::string
+#include <thread>  //  std::thread
+#include <vector>  //  std::vector
 #include <wx/wx.h>  //  wxLog, wxThread, etc
+#include <wx/fswatcher.h>  //  wxFileSystemWatcher
 
 //  local includes
 #include "main_window.h"  //  MainWindow
@@ -45,6 +50,10 @@
 #include "label_animator.h"  //  LabelAnimator
 #include "bitmap_painter.h"  //  BitmapPainter
 #include "midi_interface.h"  //  RtMidiOut
+#include "latency_profile.h"  //  LatencyProfile
+#include "port_sender.h"  //  PortStats
+#include "song_memory.h"  //  SongReloader
+#include "playlist_saver.h"  //  PlaylistSaver
 
 
 namespace bach_bot {
@@ -92,7 +101,11 @@ enum PlayerWindowEvents : int
     MOVE_UP_EVENT,  ///< On Move up accelerator (Ctrl+Up)
     SET_NEXT_EVENT,  ///< On Set next accelerator (Ctrl+Enter
     PLAY_ACTIVATE_EVENT,   ///< On Play/Activate accelerator (F5)
+    TEMPO_UP_EVENT,  ///< On Tempo faster accelerator (Ctrl+Plus)
+    TEMPO_DOWN_EVENT,  ///< On Tempo slower accelerator (Ctrl+Minus)
+    PANIC_EVENT,  ///< On Release all keys accelerator (Esc)
     UI_ANIMATE_TICK,  ///< Timer tick event
+    FILE_CHANGE_TIMER,  ///< Changed playlist files have settled
 
     END_UI_EVENTS  ///< Terminating item, not used by UI
 };
@@ -158,6 +171,93 @@ private:
     void on_accel_up_event(wxCommandEvent &event);
     void on_accel_play_next_event(wxCommandEvent &event);
     void on_timer_tick(wxTimerEvent &event);
+    void on_file_changed(wxFileSystemWatcherEvent &event);
+    void on_file_change_timer(wxTimerEvent &event);
+    void on_export_bundle(wxCommandEvent &event);
+    void on_startup_timing(wxCommandEvent &event);
+    void on_simulate_service(wxCommandEvent &event);
+    void on_edit_latency(wxCommandEvent &event);
+    void on_calibrate_latency(wxCommandEvent &event);
+    void on_port_stats(wxCommandEvent &event);
+    void on_song_memory(wxCommandEvent &event);
+    void on_edit_song_budget(wxCommandEvent &event);
+    void on_seek_time(wxCommandEvent &event);
+    void on_seek_measure(wxCommandEvent &event);
+    void on_edit_tempo(wxCommandEvent &event);
+    void on_edit_transpose(wxCommandEvent &event);
+    void on_panic(wxCommandEvent &event);
+    void on_accel_tempo_up_event(wxCommandEvent &event);
+    void on_accel_tempo_down_event(wxCommandEvent &event);
+
+    /**
+     * @brief Change the playback tempo (applied immediately if playing).
+     * @param tempo_percent percent of the recorded tempo
+     */
+    void set_tempo(const long tempo_percent);
+
+    /**
+     * @brief Port enumeration thread function.
+     * @note Enumerating ports can take a noticeable amount of time on some
+     *       systems (driver dependent), so it is kept off of the UI thread
+     *       during start-up.  The result is delivered through `CallAfter`.
+     */
+    void enumerate_midi_ports();
+
+    /**
+     * @brief Populate the device select menu once ports are enumerated.
+     * @param port_names MIDI output port names in port order
+     */
+    void populate_device_menu(const std::vector<std::string> &port_names);
+
+    /**
+     * @brief Replace the playlist with the contents of a service bundle.
+     * @param file_name bundle file to load
+     */
+    void load_bundle(const wxString &file_name);
+
+    /**
+     * @brief Evict songs far from the playhead and start re-importing
+     *        evicted songs close to it.
+     * @note Called whenever the playhead or the playlist changes.
+     */
+    void update_song_residency();
+
+    /**
+     * @brief Watch the directories of every file in the playlist (songs from
+     *        a service bundle excepted).
+     * @note Called whenever songs are added to or removed from the playlist.
+     */
+    void update_file_watches();
+
+    /**
+     * @brief Re-import songs whose file changed while they were playing.
+     */
+    void reload_stale_songs();
+
+    /**
+     * @brief Hand a song re-imported in the background to its entry.
+     * @param loaded re-imported song
+     * @param generation entry generation the song was copied from
+     * @param imported `false` if the import failed (`loaded` is discarded)
+     */
+    void on_song_reloaded(PlayListEntry &&loaded, const uint32_t generation,
+                          const bool imported);
+
+    /**
+     * @brief Give the player its copy of the song to play next.
+     * @param song next song
+     * @note A song that is still evicted is re-imported on the spot.
+     */
+    void enqueue_next_song(PlaylistEntryControl *const song);
+
+    /**
+     * @brief Report the result of a background playlist save (in the status
+     *        bar, and errors in a message box too).
+     * @param file_name playlist file written
+     * @param error failure description (empty on success)
+     */
+    void on_playlist_saved(const std::string &file_name,
+                           const std::optional<std::string> &error);
 
     /**
      * @brief Control menu move event handler
@@ -266,16 +366,36 @@ private:
 
     std::unique_ptr<PlayerThread> m_player_thread;
     std::list<wxMenuItem> m_midi_devices;
+    wxMenuItem *m_device_placeholder;  ///< shown until ports are enumerated
+    wxMenuItem *m_trace_menu;  ///< capture a playback trace when checked
+    wxMenuItem *m_tempo_menu;  ///< shows the current tempo
+    uint32_t m_tempo_percent;  ///< playback tempo (percent of recorded)
+    wxMenuItem *m_transpose_menu;  ///< shows the current transposition
+    int m_transpose_steps;  ///< playback key change (half-steps)
+    std::thread m_port_enumerator;
     RtMidiOut m_midi_out;
     uint32_t m_current_device_id;
+    LatencyProfile m_latency_profile;  ///< of `m_current_device_id`
+    std::vector<std::string> m_port_names;  ///< MIDI output ports
+    wxMenu *m_monitor_menu;  ///< additional ports to copy all events to
+    wxMenuItem *m_monitor_submenu;  ///< `m_monitor_menu` in `device_select`
+    /** Output port statistics from the most recent run */
+    std::vector<std::pair<std::string, PortStats>> m_port_stats;
     size_t m_current_song_event_count;
     uint32_t m_current_song_id;
     std::pair<uint32_t, bool> m_next_song_id;
     std::pair<uint32_t, uint32_t> m_song_list;  ///< front/end of playlist
     std::map<uint32_t, PlaylistEntryType> m_song_labels;
+    long m_song_budget_mb;  ///< memory budget for compiled songs
+    SongReloader m_song_reloader;
+    std::unique_ptr<wxFileSystemWatcher> m_file_watcher;
+    std::vector<wxFileName> m_changed_files;  ///< waiting to settle
+    std::set<uint32_t> m_stale_songs;  ///< file changed while playing
+    wxTimer m_file_change_timer;
     BankConfig m_current_config;
     std::optional<wxString> m_playlist_name;
     bool m_playlist_changed;
+    PlaylistSaver m_playlist_saver;
     PlaylistEntryControl *m_selected_control;
     wxAcceleratorTable m_accel_table;
     wxTimer m_ui_animation_timer;
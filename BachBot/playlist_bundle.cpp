@@ -0,0 +1,417 @@
+/**
+ * @file playlist_bundle.cpp
+ * @brief Self-contained (compiled) playlist bundle
+ * @copyright
+ * 2022 Andrew Buettner (ABi)
+ *
+ * @section LICENSE
+ *
+ * BachBot - A hymn Midi player for Schlicker organs
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+//  system includes
+#include <array>  //  std::array
+#include <cstring>  //  std::memcpy, std::memcmp
+#include <memory>  //  std::make_shared
+#include <stdexcept>  //  std::runtime_error
+#include <fmt/format.h>  //  fmt::format
+
+//  module includes
+// -none-
+
+//  local includes
+#include "playlist_bundle.h"  //  local include
+#include "mapped_file.h"  //  MappedFile
+#include "playlist_saver.h"  //  write_file_atomically
+
+
+namespace {
+
+constexpr const char BUNDLE_MAGIC[8U] = {'B', 'B', 'O', 'T', 'S', 'V', 'C', '\0'};
+constexpr const auto BUNDLE_VERSION = 2U;
+
+/** Version 1 index entries lacked `ticks_per_measure` (and `reserved`) */
+constexpr const auto BUNDLE_V1_INDEX_SIZE = 72U;
+constexpr const auto BUNDLE_BYTE_ORDER = 0x01020304U;
+constexpr const auto BUNDLE_ALIGNMENT = 8U;
+
+enum BundleSongFlags : uint32_t
+{
+    SONG_PLAY_NEXT = 0x01U,
+    SONG_TEMPO_DETECTED = 0x02U
+};
+
+enum BundleEventFlags : uint8_t
+{
+    EVENT_MODE_CHANGE = 0x01U,
+    EVENT_HAS_BYTE1 = 0x02U,
+    EVENT_HAS_BYTE2 = 0x04U,
+    EVENT_HAS_METADATA = 0x08U
+};
+
+struct BundleHeader
+{
+    char magic[8U];
+    uint32_t version;
+    uint32_t byte_order;
+    uint64_t file_size;
+    uint64_t index_offset;
+    uint32_t song_count;
+    uint32_t index_checksum;
+    uint32_t header_checksum;  ///< calculated with this field set to 0
+    uint32_t reserved;
+};
+static_assert(sizeof(BundleHeader) == 48U, "Bundle header layout changed");
+
+struct BundleSongIndex
+{
+    uint32_t song_id;
+    uint32_t flags;
+    int32_t tempo_requested;
+    int32_t tempo_detected;
+    int32_t delta_pitch;
+    uint32_t start_memory;
+    uint32_t start_mode;
+    uint32_t name_length;
+    double gap_beats;
+    double last_note_multiplier;
+    uint64_t name_offset;
+    uint64_t events_offset;
+    uint32_t event_count;
+    uint32_t checksum;  ///< name + event records
+    int32_t ticks_per_measure;  ///< version 2+
+    uint32_t reserved;
+};
+static_assert(sizeof(BundleSongIndex) == 80U, "Bundle index layout changed");
+
+struct BundleEvent
+{
+    double seconds;
+    double delta_time;
+    int32_t midi_time;
+    int32_t delta;
+    uint32_t desired_memory;
+    int32_t metadata;
+    uint8_t event_code;
+    uint8_t desired_mode;
+    uint8_t byte1;
+    uint8_t byte2;
+    uint8_t flags;
+    uint8_t reserved[3U];
+};
+static_assert(sizeof(BundleEvent) == 40U, "Bundle event layout changed");
+
+
+std::array<uint32_t, 256U> build_crc_table()
+{
+    std::array<uint32_t, 256U> table;
+    for (auto i = 0U; i < table.size(); ++i) {
+        auto value = i;
+        for (auto bit = 0U; bit < 8U; ++bit) {
+            value = (value & 1U) ? (0xEDB88320U ^ (value >> 1U)) : (value >> 1U);
+        }
+        table[i] = value;
+    }
+    return table;
+}
+
+
+size_t padding_for(const size_t size)
+{
+    return (BUNDLE_ALIGNMENT - (size % BUNDLE_ALIGNMENT)) % BUNDLE_ALIGNMENT;
+}
+
+
+BundleEvent to_bundle_event(const bach_bot::OrganMidiEvent &event)
+{
+    BundleEvent record;
+    std::memset(&record, 0, sizeof(record));
+    record.seconds = event.m_seconds;
+    record.delta_time = event.m_delta_time;
+    record.midi_time = event.m_midi_time;
+    record.delta = event.m_delta;
+    record.desired_memory = event.m_desired_memory;
+    record.event_code = event.m_event_code;
+    record.desired_mode = event.m_desired_mode_number;
+    if (event.is_mode_change_event()) {
+        record.flags |= EVENT_MODE_CHANGE;
+    }
+    if (event.m_byte1.has_value()) {
+        record.byte1 = event.m_byte1.value();
+        record.flags |= EVENT_HAS_BYTE1;
+    }
+    if (event.m_byte2.has_value()) {
+        record.byte2 = event.m_byte2.value();
+        record.flags |= EVENT_HAS_BYTE2;
+    }
+    if (event.m_metadata.has_value()) {
+        record.metadata = event.m_metadata.value();
+        record.flags |= EVENT_HAS_METADATA;
+    }
+    return record;
+}
+
+
+bach_bot::OrganMidiEvent from_bundle_event(const BundleEvent &record,
+                                           const uint32_t song_id)
+{
+    bach_bot::OrganMidiEvent event(
+        record.event_code, (0U != (record.flags & EVENT_MODE_CHANGE)));
+    event.m_desired_memory = record.desired_memory;
+    event.m_desired_mode_number = record.desired_mode;
+    event.m_seconds = record.seconds;
+    event.m_delta_time = record.delta_time;
+    event.m_midi_time = record.midi_time;
+    event.m_delta = record.delta;
+    event.m_song_id = song_id;
+    if (0U != (record.flags & EVENT_HAS_BYTE1)) {
+        event.m_byte1 = record.byte1;
+    }
+    if (0U != (record.flags & EVENT_HAS_BYTE2)) {
+        event.m_byte2 = record.byte2;
+    }
+    if (0U != (record.flags & EVENT_HAS_METADATA)) {
+        event.m_metadata = record.metadata;
+    }
+    return event;
+}
+
+
+/**
+ * @brief Sequential writer that builds the bundle image in memory.
+ * @note The image is written out in one piece so that an interrupted save
+ *       never leaves a truncated bundle behind.
+ */
+class BundleWriter
+{
+public:
+    void write(const void *const data, const size_t size)
+    {
+        m_image.append(static_cast<const char*>(data), size);
+    }
+
+    void pad()
+    {
+        const std::array<char, BUNDLE_ALIGNMENT> zeros = {};
+        write(zeros.data(), padding_for(m_image.size()));
+    }
+
+    void rewrite_header(const BundleHeader &header)
+    {
+        std::memcpy(&m_image[0], &header, sizeof(header));
+    }
+
+    uint64_t offset() const
+    {
+        return m_image.size();
+    }
+
+    const std::string &image() const
+    {
+        return m_image;
+    }
+
+private:
+    std::string m_image;
+};
+
+}  //  end anonymous namespace
+
+
+namespace bach_bot {
+
+uint32_t crc32(const uint8_t *const data, const size_t size,
+               const uint32_t crc)
+{
+    static const auto crc_table = build_crc_table();
+    auto value = ~crc;
+    for (auto i = size_t(0U); i < size; ++i) {
+        value = crc_table[(value ^ data[i]) & 0xFFU] ^ (value >> 8U);
+    }
+    return ~value;
+}
+
+
+void save_playlist_bundle(const std::string &file_name,
+                          const std::vector<const PlayListEntry*> &playlist)
+{
+    BundleWriter writer;
+    BundleHeader header;
+    std::memset(&header, 0, sizeof(header));
+    writer.write(&header, sizeof(header));  //  Placeholder
+
+    std::vector<BundleSongIndex> index;
+    index.reserve(playlist.size());
+    std::vector<BundleEvent> records;
+    for (const auto *const song: playlist) {
+        BundleSongIndex entry;
+        std::memset(&entry, 0, sizeof(entry));
+        entry.song_id = song->song_id;
+        entry.flags = (song->play_next ? SONG_PLAY_NEXT : 0U);
+        if (song->tempo_detected.has_value()) {
+            entry.flags |= SONG_TEMPO_DETECTED;
+            entry.tempo_detected = song->tempo_detected.value();
+        }
+        entry.tempo_requested = song->tempo_requested;
+        entry.delta_pitch = song->delta_pitch;
+        entry.start_memory = song->starting_config.memory;
+        entry.start_mode = song->starting_config.mode;
+        entry.gap_beats = song->gap_beats;
+        entry.last_note_multiplier = song->last_note_multiplier;
+        entry.ticks_per_measure = song->ticks_per_measure;
+
+        const auto name = song->file_name.utf8_string();
+        entry.name_offset = writer.offset();
+        entry.name_length = uint32_t(name.size());
+        writer.write(name.data(), name.size());
+        writer.pad();
+
+        records.clear();
+        records.reserve(song->get_event_count());
+        if (nullptr != song->midi_events) {
+            for (const auto &event: *song->midi_events) {
+                records.push_back(to_bundle_event(event));
+            }
+        }
+        entry.events_offset = writer.offset();
+        entry.event_count = uint32_t(records.size());
+        const auto records_size = records.size() * sizeof(BundleEvent);
+        writer.write(records.data(), records_size);
+
+        entry.checksum = crc32(
+            reinterpret_cast<const uint8_t*>(name.data()), name.size());
+        entry.checksum = crc32(
+            reinterpret_cast<const uint8_t*>(records.data()), records_size,
+            entry.checksum);
+        index.push_back(entry);
+    }
+
+    const auto index_size = index.size() * sizeof(BundleSongIndex);
+    std::memcpy(header.magic, BUNDLE_MAGIC, sizeof(header.magic));
+    header.version = BUNDLE_VERSION;
+    header.byte_order = BUNDLE_BYTE_ORDER;
+    header.index_offset = writer.offset();
+    header.song_count = uint32_t(index.size());
+    header.index_checksum = crc32(
+        reinterpret_cast<const uint8_t*>(index.data()), index_size);
+    writer.write(index.data(), index_size);
+    header.file_size = writer.offset();
+    header.header_checksum = crc32(reinterpret_cast<const uint8_t*>(&header),
+                                   sizeof(header));
+    writer.rewrite_header(header);
+    write_file_atomically(file_name, writer.image());
+}
+
+
+std::list<PlayListEntry> load_playlist_bundle(const std::string &file_name)
+{
+    const MappedFile bundle(file_name);
+    const auto *const data = bundle.data();
+    const auto size = uint64_t(bundle.size());
+    auto invalid = [&](const char *const reason) {
+        return std::runtime_error(fmt::format("{}: {}", file_name, reason));
+    };
+
+    BundleHeader header;
+    if (size < sizeof(header)) {
+        throw invalid("not a service bundle");
+    }
+    std::memcpy(&header, data, sizeof(header));
+    if (0 != std::memcmp(header.magic, BUNDLE_MAGIC, sizeof(header.magic))) {
+        throw invalid("not a service bundle");
+    }
+    if ((header.version < 1U) || (header.version > BUNDLE_VERSION) ||
+            (BUNDLE_BYTE_ORDER != header.byte_order)) {
+        throw invalid("unsupported bundle version");
+    }
+
+    const auto header_checksum = header.header_checksum;
+    header.header_checksum = 0U;
+    if ((crc32(reinterpret_cast<const uint8_t*>(&header), sizeof(header)) !=
+            header_checksum) || (header.file_size != size)) {
+        throw invalid("bundle header is corrupt");
+    }
+
+    const auto index_stride = (1U == header.version) ?
+        size_t(BUNDLE_V1_INDEX_SIZE) : sizeof(BundleSongIndex);
+    const auto index_size = uint64_t(header.song_count) * index_stride;
+    if ((header.index_offset > size) ||
+            (index_size > size - header.index_offset) ||
+            (crc32(data + header.index_offset, size_t(index_size)) !=
+             header.index_checksum)) {
+        throw invalid("bundle index is corrupt");
+    }
+
+    std::list<PlayListEntry> playlist;
+    for (auto i = 0U; i < header.song_count; ++i) {
+        BundleSongIndex entry;
+        std::memset(&entry, 0, sizeof(entry));
+        std::memcpy(&entry, data + header.index_offset + i * index_stride,
+                    index_stride);
+
+        const auto events_size = uint64_t(entry.event_count) *
+                                 sizeof(BundleEvent);
+        if ((entry.name_offset > size) ||
+                (entry.name_length > size - entry.name_offset) ||
+                (entry.events_offset > size) ||
+                (events_size > size - entry.events_offset)) {
+            throw invalid("song entry out of range");
+        }
+
+        auto checksum = crc32(data + entry.name_offset, entry.name_length);
+        checksum = crc32(data + entry.events_offset, size_t(events_size),
+                         checksum);
+        if (checksum != entry.checksum) {
+            throw invalid("song data is corrupt");
+        }
+
+        //  Songs are renumbered in playlist order, same as a `.bbp` load.
+        PlayListEntry song;
+        song.song_id = i + 1U;
+        song.file_name = wxString::FromUTF8(
+            reinterpret_cast<const char*>(data + entry.name_offset),
+            entry.name_length);
+        song.tempo_requested = entry.tempo_requested;
+        song.gap_beats = entry.gap_beats;
+        song.starting_config = {entry.start_memory,
+                                uint8_t(entry.start_mode)};
+        song.delta_pitch = entry.delta_pitch;
+        song.last_note_multiplier = entry.last_note_multiplier;
+        song.play_next = (0U != (entry.flags & SONG_PLAY_NEXT));
+        song.ticks_per_measure = entry.ticks_per_measure;
+        if (0U != (entry.flags & SONG_TEMPO_DETECTED)) {
+            song.tempo_detected = entry.tempo_detected;
+        }
+
+        EventPool events;
+        events.reserve(entry.event_count);
+        for (auto j = 0U; j < entry.event_count; ++j) {
+            BundleEvent record;
+            std::memcpy(&record, data + entry.events_offset +
+                        j * sizeof(BundleEvent), sizeof(record));
+            events.emplace(from_bundle_event(record, song.song_id));
+        }
+        song.midi_events = std::make_shared<const EventPool>(std::move(events));
+        song.build_index();
+        song.from_bundle = true;
+        playlist.push_back(std::move(song));
+    }
+
+    return playlist;
+}
+
+}  //  end bach_bot
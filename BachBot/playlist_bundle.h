@@ -0,0 +1,89 @@
+/**
+ * @file playlist_bundle.h
+ * @brief Self-contained (compiled) playlist bundle
+ * @copyright
+ * 2022 Andrew Buettner (ABi)
+ *
+ * @section LICENSE
+ *
+ * BachBot - A hymn Midi player for Schlicker organs
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @section DESCRIPTION
+ * A playlist (`.bbp`) only references MIDI files, so opening one means
+ * importing every song again.  A service bundle (`.bbs`) stores the playlist
+ * configuration *and* every song's already compiled organ events in a single
+ * binary file that is read through one memory mapping.  Opening a bundle does
+ * no MIDI parsing at all and does not depend on the MIDI files still being
+ * where (or what) they were when the bundle was exported.
+ *
+ * File layout (little-endian, fixed size records):
+ *   - `BundleHeader`
+ *   - per song: UTF-8 file name (padded to 8 bytes), `BundleEvent` records
+ *   - `BundleSongIndex` table (one per song, in playlist order)
+ * The header, the index and every song payload are each covered by a CRC-32.
+ */
+
+#pragma once
+
+//  system includes
+#include <cstdint>  //  uintXX_t
+#include <cstdlib>  //  size_t
+#include <list>  //  std::list
+#include <string>  //  std::string
+#include <vector>  //  std::vector
+
+//  module includes
+// -none-
+
+//  local includes
+#include "play_list.h"  //  PlayListEntry
+
+
+namespace bach_bot {
+
+/** File extension used for service bundles */
+constexpr const auto PLAYLIST_BUNDLE_EXTENSION = "bbs";
+
+/**
+ * @brief Calculate a CRC-32 (IEEE 802.3) checksum
+ * @param data start of data
+ * @param size number of bytes
+ * @param crc running checksum when checksumming in pieces
+ * @returns checksum
+ */
+uint32_t crc32(const uint8_t *const data, const size_t size,
+               const uint32_t crc=0U);
+
+/**
+ * @brief Export a playlist, including its compiled events, to a bundle.
+ * @param file_name bundle file to write (UTF-8)
+ * @param playlist songs in playlist order
+ * @throws std::runtime_error file can not be written (an existing bundle is
+ *         left unchanged)
+ */
+void save_playlist_bundle(const std::string &file_name,
+                          const std::vector<const PlayListEntry*> &playlist);
+
+/**
+ * @brief Load a playlist from a bundle.
+ * @param file_name bundle file to read (UTF-8)
+ * @returns playlist entries (in playlist order) ready to be played
+ * @throws std::runtime_error file can not be read, is not a bundle or fails
+ *         validation
+ */
+std::list<PlayListEntry> load_playlist_bundle(const std::string &file_name);
+
+}  //  end bach_bot
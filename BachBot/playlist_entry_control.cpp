@@ -185,16 +185,27 @@ void PlaylistEntryControl::swap(PlaylistEntryControl *const other)
 }
 
 
-std::deque<OrganMidiEvent> PlaylistEntryControl::get_song_events() const
+std::deque<OrganMidiEvent> PlaylistEntryControl::get_song_events()
 {
-    std::deque<OrganMidiEvent> events;
-    std::for_each(m_playlist_entry.midi_events.begin(),
-                  m_playlist_entry.midi_events.end(),
-                  [&events](const OrganNote &event) {
-                      events.emplace_back(event.clone());
-                  });
-
-    return events;
+    ensure_resident();
+    return m_playlist_entry.get_play_events();
+}
+
+
+bool PlaylistEntryControl::ensure_resident()
+{
+    if (!m_playlist_entry.evicted) {
+        return true;
+    }
+
+    if (!m_playlist_entry.import_midi()) {
+        wxMessageBox(
+            fmt::format(L"Failed to import for {}", m_playlist_entry.file_name),
+            wxT("Import Error"),
+            wxOK | wxICON_INFORMATION);
+        return false;
+    }
+    return true;
 }
 
 
@@ -38,6 +38,7 @@
 #include <optional>  //  std::optional
 #include <wx/wx.h>  //  wxString
 #include <array>  //
+#include <memory>  //  std::shared_ptr
 
  //  module includes
  // -none-
@@ -160,8 +161,47 @@ public:
     /**
     * @brief Get song events
     * @return Playlist song's events
+    * @note Re-imports the song first if it was evicted.
     */
-    std::deque<OrganMidiEvent> get_song_events() const;
+    std::deque<OrganMidiEvent> get_song_events();
+
+    /**
+     * @brief Get the seek index of the song events
+     * @return index (may be `nullptr` if the song didn't load)
+     * @note Re-imports the song first if it was evicted.
+     */
+    std::shared_ptr<const SongIndex> get_song_index()
+    {
+        ensure_resident();
+        return m_playlist_entry.index;
+    }
+
+    /**
+     * @brief Re-import the song now if it was evicted.
+     * @retval `true` song is loaded
+     * @retval `false` re-import failed (and was reported)
+     */
+    bool ensure_resident();
+
+    /**
+     * @brief Release the compiled song, keeping the configuration.
+     */
+    void evict()
+    {
+        m_playlist_entry.evict();
+    }
+
+    /**
+     * @brief Take the compiled song from a background re-import.
+     * @param loaded re-imported copy of this entry
+     * @param generation entry generation the copy was made from
+     * @retval `true` events adopted
+     * @retval `false` result is stale and was discarded
+     */
+    bool adopt_events(PlayListEntry &&loaded, const uint32_t generation)
+    {
+        return m_playlist_entry.adopt_events(std::move(loaded), generation);
+    }
 
     /**
      * @brief Get the sequence (prev song/next song) data
@@ -191,6 +231,15 @@ public:
         return m_playlist_entry.song_id;
     }
 
+    /**
+     * @brief Get the song configuration and compiled events
+     * @return playlist entry
+     */
+    const PlayListEntry &get_playlist_entry() const
+    {
+        return m_playlist_entry;
+    }
+
     /**
      * @brief Periodically check and update this entry background color.
      * @param up_next `true` if up next, `false` otherwise
@@ -24,7 +24,7 @@
 
 //  system includes
 #include <cstdint>  //  uint32_t
-#include <limits>  //  std::numeric_limits
+#include <stdexcept>  //  std::runtime_error
 #include <fmt/format.h>  //  fmt::format(L
 
 //  module includes
@@ -32,6 +32,7 @@
 
 //  local includes
 #include "playlist_loader.h"  //  local include
+#include "profile_zone.h"  //  BACHBOT_ZONE
 
 
 namespace bach_bot {
@@ -41,67 +42,44 @@ namespace ui {
 PlaylistXmlLoader::PlaylistXmlLoader(wxFrame *const parent,
                                      const wxString &filename) :
     ThreadLoader(parent),
-    m_playlist_doc(),
     m_filename{filename},
-    m_entries()
+    m_reader()
 {
 }
 
 
 int PlaylistXmlLoader::count_children()
 {
-    auto count = -1;
-    if (!m_playlist_doc.Load(m_filename)) {
-        set_error_text(wxT("Invalid file format"));
-        return count;
+    BACHBOT_ZONE("PlaylistXmlLoader::count_children");
+    try {
+        m_reader = std::make_unique<PlaylistReader>(m_filename);
+    } catch (const std::runtime_error &e) {
+        set_error_text(e.what());
+        return -1;
     }
 
-    const auto playlist_root = m_playlist_doc.GetRoot();
-    if (playlist_root->GetName() != L"BachBot_Playlist") {
-        set_error_text(wxT("File format not recognized."));
-    } else {
-        count = _count_children(playlist_root);
-    }
-
-    return count;
+    //  Songs are read as they import, the count isn't known yet
+    return 0;
 }
 
 
-void PlaylistXmlLoader::build_playlist_entry(PlayListEntry &song_entry,
+bool PlaylistXmlLoader::build_playlist_entry(PlayListEntry &song_entry,
                                              const uint32_t song_number)
 {
-    const auto *const child = m_entries[song_number - 1U].second;
-    if (!song_entry.load_config(child)) {
-        set_error_text(fmt::format(L"Invalid song data line {}",
-                                   child->GetLineNumber()));
+    static_cast<void>(song_number);
+    try {
+        return m_reader->read_entry(song_entry);
+    } catch (const std::runtime_error &e) {
+        set_error_text(e.what());
     }
+
+    return true;
 }
 
 
-int PlaylistXmlLoader::_count_children(const wxXmlNode *const playlist_root)
+void PlaylistXmlLoader::order_playlist(std::list<PlayListEntry> &playlist)
 {
-    const auto *child = playlist_root->GetChildren();
-    while (nullptr != child) {
-        if (child->GetName() == L"song" &&
-                child->GetType() == wxXML_ELEMENT_NODE)
-        {
-            const auto &order_text = child->GetAttribute(wxT("order"));
-            auto order = std::numeric_limits<long>::min();
-            const auto ok = order_text.ToCLong(&order);
-            if (!ok || (order < 1)) {
-                return -1;
-            }
-
-            m_entries.push_back({uint32_t(order), child});
-        }
-        child = child->GetNext();
-    }
-
-    std::sort(m_entries.begin(), m_entries.end(), [](const SongNode &a,
-                                                     const SongNode &b) {
-        return a.first < b.first;
-    });
-    return int(m_entries.size());
+    m_reader->order_playlist(playlist);
 }
 
 
@@ -125,10 +103,14 @@ int PlaylistDndLoader::count_children()
 }
 
 
-void PlaylistDndLoader::build_playlist_entry(PlayListEntry &song_entry,
+bool PlaylistDndLoader::build_playlist_entry(PlayListEntry &song_entry,
                                              const uint32_t song_number)
 {
     const auto song_index = song_number - 1U;
+    if (song_index >= m_files.size()) {
+        return false;
+    }
+
     song_entry.file_name = m_files[song_index];
     song_entry.song_id = song_index + m_first_song_id;
     song_entry.tempo_requested = -1;
@@ -137,6 +119,7 @@ void PlaylistDndLoader::build_playlist_entry(PlayListEntry &song_entry,
     song_entry.delta_pitch = 0;
     song_entry.last_note_multiplier = 1.0;
     song_entry.play_next = false;
+    return true;
 }
 
 
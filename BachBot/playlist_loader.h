@@ -28,9 +28,9 @@
 #pragma once
 
 //  system includes
+#include <list>  //  std::list
+#include <memory>  //  std::unique_ptr
 #include <vector>  //  std::vector
-#include <utility>  //  std::pair
-#include <wx/xml/xml.h>  //  wxXml API
 #include <wx/wx.h>  //  wxThread, etc
 
  //  module includes
@@ -39,6 +39,7 @@
  //  local includes
 #include "play_list.h"  //  PlayList, PlayListEntry
 #include "thread_loader.h"  //  ThreadLoader
+#include "playlist_reader.h"  //  PlaylistReader
 
 
 namespace bach_bot {
@@ -46,10 +47,13 @@ namespace ui {
 
 /**
  * @brief Load playlist file.
+ * @note The file is parsed as it is imported: each `song` element is read,
+ *       checked and handed over for import before the next is parsed, so only
+ *       one entry is held in memory and the first song is ready in the same
+ *       time regardless of the playlist length.
  */
 class PlaylistXmlLoader : public ThreadLoader
 {
-    using SongNode = std::pair<uint32_t, const wxXmlNode*>;
 public:
     /**
      * @brief Constructor
@@ -61,22 +65,13 @@ public:
 
 protected:
     virtual int count_children() override;
-    virtual void build_playlist_entry(PlayListEntry &song_entry,
+    virtual bool build_playlist_entry(PlayListEntry &song_entry,
                                       const uint32_t song_number) override;
+    virtual void order_playlist(std::list<PlayListEntry> &playlist) override;
 
 private:
-    /**
-     * @brief Count children (ie songs) in XML tree and sorts them into the
-     *        internal vector (sends start event)
-     * @param playlist_root root note of playlist
-     * @return number of children
-     * @retval <= 0 indicates error
-     */
-    int _count_children(const wxXmlNode *const playlist_root);
-
-    wxXmlDocument m_playlist_doc;
     const wxString m_filename;
-    std::vector<SongNode> m_entries;
+    std::unique_ptr<PlaylistReader> m_reader;
 };
 
 /**
@@ -97,7 +92,7 @@ public:
 
 protected:
     virtual int count_children() override;
-    virtual void build_playlist_entry(PlayListEntry &entry,
+    virtual bool build_playlist_entry(PlayListEntry &entry,
                                       const uint32_t song_number) override;
 
 private:
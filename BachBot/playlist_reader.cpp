@@ -0,0 +1,178 @@
+/**
+ * @file playlist_reader.cpp
+ * @brief Streaming playlist file reader
+ * @copyright
+ * 2022 Andrew Buettner (ABi)
+ *
+ * @section LICENSE
+ *
+ * BachBot - A hymn Midi player for Schlicker organs
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+
+//  system includes
+#include <algorithm>  //  std::stable_sort
+#include <limits>  //  std::numeric_limits
+#include <stdexcept>  //  std::runtime_error, std::out_of_range
+#include <string>  //  std::string
+#include <utility>  //  std::pair
+#include <fmt/format.h>  //  fmt::format
+
+//  module includes
+// -none-
+
+//  local includes
+#include "playlist_reader.h"  //  local include
+
+
+namespace bach_bot {
+
+PlaylistReader::PlaylistReader(const wxString &file_name) :
+    m_file(file_name),
+    m_parser(m_file),
+    m_orders(),
+    m_in_order{true}
+{
+    if (!m_file.IsOk()) {
+        throw std::runtime_error("Unable to open file");
+    }
+
+    //  Only the root element is read here; songs are parsed as they import
+    auto token = XmlToken::END_OF_DOCUMENT;
+    try {
+        token = m_parser.next();
+    } catch (const std::runtime_error &e) {
+        throw std::runtime_error(fmt::format("Invalid file format: {}",
+                                             e.what()));
+    }
+    if ((XmlToken::START_ELEMENT != token) ||
+        (m_parser.get_name() != "BachBot_Playlist"))
+    {
+        throw std::runtime_error("File format not recognized.");
+    }
+}
+
+
+bool PlaylistReader::read_entry(PlayListEntry &entry)
+{
+    std::unique_ptr<wxXmlNode> child;
+    try {
+        child = read_song_node();
+    } catch (const std::runtime_error &e) {
+        throw std::runtime_error(fmt::format("Invalid file format: {}",
+                                             e.what()));
+    }
+    if (nullptr == child) {
+        return false;
+    }
+
+    const auto &order_text = child->GetAttribute(wxT("order"));
+    auto order = std::numeric_limits<long>::min();
+    const auto ok = order_text.ToCLong(&order);
+    if (!ok || (order < 1) ||
+        (order > long(std::numeric_limits<uint32_t>::max())))
+    {
+        throw std::runtime_error(fmt::format("Invalid song order line {}",
+                                             child->GetLineNumber()));
+    }
+
+    m_in_order = m_in_order &&
+                 (m_orders.empty() || (m_orders.back() <= uint32_t(order)));
+    m_orders.push_back(uint32_t(order));
+
+    auto valid = false;
+    try {
+        valid = entry.load_config(child.get());
+    } catch (const std::out_of_range &e) {
+        //  Missing file name (message includes the line)
+        throw std::runtime_error(e.what());
+    }
+    if (!valid) {
+        throw std::runtime_error(fmt::format("Invalid song data line {}",
+                                             child->GetLineNumber()));
+    }
+    return true;
+}
+
+
+void PlaylistReader::order_playlist(std::list<PlayListEntry> &playlist) const
+{
+    //  Files saved by BachBot are already in order; only hand edits land here
+    if (m_in_order) {
+        return;
+    }
+
+    std::vector<std::pair<uint32_t, PlayListEntry>> entries;
+    entries.reserve(playlist.size());
+    auto order = m_orders.cbegin();
+    for (auto &i : playlist) {
+        entries.emplace_back(*order++, std::move(i));
+    }
+    std::stable_sort(entries.begin(), entries.end(),
+                     [](const auto &a, const auto &b) {
+                         return a.first < b.first;
+                     });
+
+    playlist.clear();
+    auto song_id = 0U;
+    for (auto &i : entries) {
+        i.second.song_id = ++song_id;
+        playlist.push_back(std::move(i.second));
+    }
+}
+
+
+std::unique_ptr<wxXmlNode> PlaylistReader::read_song_node()
+{
+    auto token = m_parser.next();
+    while (XmlToken::END_OF_DOCUMENT != token) {
+        if ((XmlToken::START_ELEMENT == token) &&
+            (2U == m_parser.get_depth()) && (m_parser.get_name() == "song"))
+        {
+            auto song = std::make_unique<wxXmlNode>(
+                nullptr, wxXML_ELEMENT_NODE, wxT("song"), wxEmptyString,
+                nullptr, nullptr, m_parser.get_line());
+            for (const auto &i : m_parser.get_attributes()) {
+                song->AddAttribute(wxString::FromUTF8(i.first),
+                                   wxString::FromUTF8(i.second));
+            }
+
+            //  Direct text (and CDATA) is the file name; nested tags ignored
+            std::string content;
+            token = m_parser.next();
+            while (XmlToken::END_ELEMENT != token ||
+                   (m_parser.get_depth() > 1U))
+            {
+                if ((XmlToken::TEXT == token) &&
+                    (2U == m_parser.get_depth()))
+                {
+                    content += m_parser.get_text();
+                }
+                token = m_parser.next();
+            }
+            static_cast<void>(new wxXmlNode(song.get(), wxXML_TEXT_NODE,
+                                            wxEmptyString,
+                                            wxString::FromUTF8(content)));
+            return song;
+        }
+        token = m_parser.next();
+    }
+
+    return nullptr;
+}
+
+}  //  end bach_bot
@@ -0,0 +1,99 @@
+/**
+ * @file playlist_reader.h
+ * @brief Streaming playlist file reader
+ * @copyright
+ * 2022 Andrew Buettner (ABi)
+ *
+ * @section LICENSE
+ *
+ * BachBot - A hymn Midi player for Schlicker organs
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @section DESCRIPTION
+ * Reads the songs of a `.bbp` playlist one at a time, straight from the
+ * file.  Used by the playlist loading dialog and by the headless player,
+ * neither of which should wait for (or hold) the whole file before the first
+ * song can be imported.
+ */
+
+#pragma once
+
+//  system includes
+#include <cstdint>  //  uint32_t
+#include <list>  //  std::list
+#include <memory>  //  std::unique_ptr
+#include <vector>  //  std::vector
+#include <wx/wfstream.h>  //  wxFileInputStream
+#include <wx/xml/xml.h>  //  wxXmlNode
+
+//  module includes
+// -none-
+
+//  local includes
+#include "play_list.h"  //  PlayListEntry
+#include "xml_pull_parser.h"  //  XmlPullParser
+
+
+namespace bach_bot {
+
+/**
+ * @brief Reads playlist entries from a file as they are needed.
+ */
+class PlaylistReader
+{
+public:
+    /**
+     * @brief Constructor - open a playlist and read up to its first song.
+     * @param file_name playlist file
+     * @throws std::runtime_error file can't be opened or isn't a playlist
+     */
+    explicit PlaylistReader(const wxString &file_name);
+
+    PlaylistReader(const PlaylistReader &) = delete;
+    PlaylistReader &operator=(const PlaylistReader &) = delete;
+
+    /**
+     * @brief Read the configuration of the next song.
+     * @param[out] entry song configuration (`song_id` and events untouched)
+     * @retval `true` entry read
+     * @retval `false` end of the playlist
+     * @throws std::runtime_error invalid entry or malformed file (the message
+     *         includes the line number)
+     */
+    bool read_entry(PlayListEntry &entry);
+
+    /**
+     * @brief Put the entries read into playlist (`order`) sequence.
+     * @param[in/out] playlist every entry read, in the order `read_entry`
+     *                returned them; `song_id` is renumbered from 1 if the
+     *                sequence changes
+     */
+    void order_playlist(std::list<PlayListEntry> &playlist) const;
+
+private:
+    /**
+     * @brief Read up to and including the next `song` element.
+     * @return detached `song` node (`nullptr` at the end of the playlist)
+     * @throws std::runtime_error malformed XML
+     */
+    std::unique_ptr<wxXmlNode> read_song_node();
+
+    wxFileInputStream m_file;
+    XmlPullParser m_parser;
+    std::vector<uint32_t> m_orders;  ///< `order` of each entry read
+    bool m_in_order;  ///< `m_orders` is ascending so far
+};
+
+}  //  end bach_bot
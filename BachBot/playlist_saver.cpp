@@ -0,0 +1,258 @@
+/**
+ * @file playlist_saver.cpp
+ * @brief Background, crash-safe playlist saving
+ * @copyright
+ * 2022 Andrew Buettner (ABi)
+ *
+ * @section LICENSE
+ *
+ * BachBot - A hymn Midi player for Schlicker organs
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+
+//  system includes
+#include <algorithm>  //  std::find_if, std::min
+#include <stdexcept>  //  std::runtime_error
+#include <fmt/format.h>  //  fmt::format
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <filesystem>  //  std::filesystem::u8path
+#include <windows.h>  //  CreateFile, FlushFileBuffers, MoveFileEx
+#else
+#include <cerrno>  //  errno
+#include <cstdlib>  //  realpath, free
+#include <cstring>  //  std::strerror
+#include <fcntl.h>  //  open
+#include <sys/stat.h>  //  stat, fchmod
+#include <unistd.h>  //  write, fsync, close, unlink
+#include <cstdio>  //  std::rename
+#endif
+
+//  module includes
+// -none-
+
+//  local includes
+#include "playlist_saver.h"  //  local include
+#include "profile_zone.h"  //  BACHBOT_ZONE, BACHBOT_THREAD_NAME
+
+
+namespace bach_bot {
+
+void write_file_atomically(const std::string &file_name,
+                           const std::string &contents)
+{
+#ifdef _WIN32
+    //  Same directory as the target: a rename can't cross file systems
+    const auto temp_name = file_name + SAVE_TEMP_SUFFIX;
+
+    //  The narrow API would interpret the names in the ANSI code page.
+    const auto wide_name = std::filesystem::u8path(file_name);
+    const auto wide_temp_name = std::filesystem::u8path(temp_name);
+    const auto file = CreateFileW(wide_temp_name.c_str(), GENERIC_WRITE, 0U,
+                                  nullptr, CREATE_ALWAYS,
+                                  FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (INVALID_HANDLE_VALUE == file) {
+        throw std::runtime_error(fmt::format("Unable to create {} (error {})",
+                                             temp_name, GetLastError()));
+    }
+
+    auto written = size_t(0U);
+    auto ok = TRUE;
+    while (ok && (written < contents.size())) {
+        auto chunk = DWORD(0U);
+        ok = WriteFile(file, contents.data() + written,
+                       DWORD(std::min<size_t>(contents.size() - written,
+                                              MAXDWORD)),
+                       &chunk, nullptr);
+        written += chunk;
+    }
+    ok = ok && FlushFileBuffers(file);
+    auto error = ok ? DWORD(ERROR_SUCCESS) : GetLastError();
+    static_cast<void>(CloseHandle(file));
+
+    if (ok && !MoveFileExW(wide_temp_name.c_str(), wide_name.c_str(),
+                           MOVEFILE_REPLACE_EXISTING |
+                           MOVEFILE_WRITE_THROUGH)) {
+        error = GetLastError();
+    }
+    if (ERROR_SUCCESS != error) {
+        static_cast<void>(DeleteFileW(wide_temp_name.c_str()));
+        throw std::runtime_error(fmt::format("Unable to write {} (error {})",
+                                             file_name, error));
+    }
+#else
+    //  Replace the file a symlinked playlist points to, not the link.
+    auto target = file_name;
+    auto *const resolved = ::realpath(file_name.c_str(), nullptr);
+    if (nullptr != resolved) {
+        target = resolved;
+        std::free(resolved);
+    }
+
+    //  Same directory as the target: a rename can't cross file systems
+    const auto temp_name = target + SAVE_TEMP_SUFFIX;
+    const auto fd = ::open(temp_name.c_str(),
+                           O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0666);
+    if (fd < 0) {
+        throw std::runtime_error(fmt::format("Unable to create {}: {}",
+                                             temp_name, std::strerror(errno)));
+    }
+
+    auto error = 0;
+
+    //  Keep the permissions of the file being replaced.
+    struct stat target_stat;
+    if ((0 == ::stat(target.c_str(), &target_stat)) &&
+        (0 != ::fchmod(fd, target_stat.st_mode & 07777))) {
+        error = errno;
+    }
+
+    auto written = size_t(0U);
+    while ((0 == error) && (written < contents.size())) {
+        const auto chunk = ::write(fd, contents.data() + written,
+                                   contents.size() - written);
+        if (chunk >= 0) {
+            written += size_t(chunk);
+        } else if (EINTR != errno) {
+            error = errno;
+        }
+    }
+    if ((0 == error) && (0 != ::fsync(fd))) {
+        error = errno;
+    }
+    if ((0 != ::close(fd)) && (0 == error)) {
+        error = errno;
+    }
+    if ((0 == error) && (0 != std::rename(temp_name.c_str(),
+                                          target.c_str()))) {
+        error = errno;
+    }
+    if (0 != error) {
+        static_cast<void>(::unlink(temp_name.c_str()));
+        throw std::runtime_error(fmt::format("Unable to write {}: {}",
+                                             file_name, std::strerror(error)));
+    }
+
+    //  Flush the directory too, or the rename may not survive a power cut
+    const auto slash = target.find_last_of('/');
+    const auto directory = (std::string::npos == slash) ?
+        std::string(".") : target.substr(0U, std::max<size_t>(slash, 1U));
+    const auto directory_fd = ::open(directory.c_str(),
+                                     O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (directory_fd >= 0) {
+        static_cast<void>(::fsync(directory_fd));
+        static_cast<void>(::close(directory_fd));
+    }
+#endif
+}
+
+
+PlaylistSaver::PlaylistSaver(CallBack on_saved) :
+    m_on_saved(std::move(on_saved)),
+    m_mutex(),
+    m_wake(),
+    m_queue(),
+    m_saving{false},
+    m_stop{false},
+    m_worker()
+{
+    m_worker = std::thread(&PlaylistSaver::save_loop, this);
+}
+
+
+PlaylistSaver::~PlaylistSaver()
+{
+    finish();
+}
+
+
+void PlaylistSaver::save(const std::string &file_name, std::string contents)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto queued = std::find_if(
+            m_queue.begin(), m_queue.end(),
+            [&](const std::pair<std::string, std::string> &i) {
+                return i.first == file_name;
+            });
+        if (m_queue.end() != queued) {
+            queued->second = std::move(contents);
+        } else {
+            m_queue.emplace_back(file_name, std::move(contents));
+        }
+    }
+    m_wake.notify_one();
+}
+
+
+bool PlaylistSaver::is_busy() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_saving || !m_queue.empty();
+}
+
+
+void PlaylistSaver::finish()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stop = true;
+    }
+    m_wake.notify_one();
+    if (m_worker.joinable()) {
+        m_worker.join();
+    }
+}
+
+
+void PlaylistSaver::save_loop()
+{
+    BACHBOT_THREAD_NAME("playlist saver");
+    std::unique_lock<std::mutex> lock(m_mutex);
+    while (true) {
+        m_wake.wait(lock, [this] { return m_stop || !m_queue.empty(); });
+        if (m_queue.empty()) {
+            //  Stopping, and everything queued has been written
+            break;
+        }
+
+        const auto save = std::move(m_queue.front());
+        m_queue.pop_front();
+        m_saving = true;
+        lock.unlock();
+
+        std::optional<std::string> error;
+        try {
+            BACHBOT_ZONE("write_file_atomically");
+            write_file_atomically(save.first, save.second);
+        } catch (const std::runtime_error &e) {
+            error = e.what();
+        }
+
+        //  Not busy by the time the callback is acted on (unless more saves
+        // are queued)
+        lock.lock();
+        m_saving = false;
+        lock.unlock();
+        m_on_saved(save.first, error);
+        lock.lock();
+    }
+}
+
+}  //  end bach_bot
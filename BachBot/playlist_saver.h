@@ -0,0 +1,135 @@
+/**
+ * @file playlist_saver.h
+ * @brief Background, crash-safe playlist saving
+ * @copyright
+ * 2022 Andrew Buettner (ABi)
+ *
+ * @section LICENSE
+ *
+ * BachBot - A hymn Midi player for Schlicker organs
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @section DESCRIPTION
+ * Playlists are often kept on network-mounted music folders where a write can
+ * take seconds, and writing directly over the playlist leaves a truncated
+ * file behind if the application (or the machine) dies part way through.
+ *
+ * The UI thread serializes a snapshot of the playlist to memory, which is
+ * quick, and hands it to a `PlaylistSaver`.  The saver thread writes it to a
+ * temporary file next to the target, flushes it to disk and renames it over
+ * the target, so the playlist on disk is always either the old or the new
+ * version.
+ */
+
+#pragma once
+
+//  system includes
+#include <condition_variable>  //  std::condition_variable
+#include <deque>  //  std::deque
+#include <functional>  //  std::function
+#include <mutex>  //  std::mutex
+#include <optional>  //  std::optional
+#include <string>  //  std::string
+#include <thread>  //  std::thread
+#include <utility>  //  std::pair
+
+//  module includes
+// -none-
+
+//  local includes
+// -none-
+
+
+namespace bach_bot {
+
+/** Suffix of the temporary file written next to the target */
+constexpr const auto SAVE_TEMP_SUFFIX = ".saving";
+
+/**
+ * @brief Replace a file without ever leaving a partially written version.
+ * @param file_name file to write (UTF-8)
+ * @param contents new file contents
+ * @throws std::runtime_error file could not be written (the original, if
+ *         any, is left unchanged)
+ * @note A symbolic link is followed: the file it points to is replaced and
+ *       keeps its permissions.
+ */
+void write_file_atomically(const std::string &file_name,
+                           const std::string &contents);
+
+
+/**
+ * @brief Writes files on a background thread.
+ */
+class PlaylistSaver
+{
+    /**
+     * @brief Callback function format for completed saves
+     * @note Called from the saver thread.
+     */
+    using CallBack = std::function<void(
+        const std::string & /* file_name */,
+        const std::optional<std::string> & /* error text, if failed */)>;
+
+public:
+    /**
+     * @brief Constructor - start the saver thread.
+     * @param on_saved called after each save with the error (if any)
+     */
+    explicit PlaylistSaver(CallBack on_saved);
+
+    /**
+     * @brief Destructor - finish queued saves.
+     */
+    ~PlaylistSaver();
+
+    PlaylistSaver(const PlaylistSaver &) = delete;
+    PlaylistSaver &operator=(const PlaylistSaver &) = delete;
+
+    /**
+     * @brief Queue a file to be written.
+     * @param file_name file to write (UTF-8)
+     * @param contents new file contents
+     * @note A queued save of the same file that hasn't started is replaced.
+     */
+    void save(const std::string &file_name, std::string contents);
+
+    /**
+     * @brief Test for saves that haven't completed.
+     * @note Already `false` when the callback for the last save is made.
+     */
+    bool is_busy() const;
+
+    /**
+     * @brief Finish queued saves and stop the saver thread.
+     */
+    void finish();
+
+private:
+    /**
+     * @brief Saver thread function
+     */
+    void save_loop();
+
+    CallBack m_on_saved;
+    mutable std::mutex m_mutex;  ///< protects the members below
+    std::condition_variable m_wake;
+    std::deque<std::pair<std::string, std::string>> m_queue;
+    bool m_saving;  ///< a save is in progress
+    bool m_stop;
+    std::thread m_worker;
+};
+
+}  //  end bach_bot
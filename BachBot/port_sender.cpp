@@ -0,0 +1,165 @@
+/**
+ * @file port_sender.cpp
+ * @brief Per-port MIDI sender thread
+ * @copyright
+ * 2022 Andrew Buettner (ABi)
+ *
+ * @section LICENSE
+ *
+ * BachBot - A hymn Midi player for Schlicker organs
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+//  system includes
+#include <algorithm>  //  std::copy_n, std::min
+#include <stdexcept>  //  std::runtime_error
+
+//  module includes
+// -none-
+
+//  local includes
+#include "port_sender.h"  //  local include
+#include "monotonic_clock.h"  //  get_monotonic_ns, NS_PER_US
+
+
+namespace bach_bot {
+
+PortSender::PortSender(const uint32_t port, const std::string &name) :
+    m_name(name),
+    m_midi_out(),
+    m_queue(QUEUE_SIZE),
+    m_head{0U},
+    m_tail{0U},
+    m_mutex(),
+    m_wake(),
+    m_waiting{false},
+    m_stop{false},
+    m_messages{0U},
+    m_dropped{0U},
+    m_late{0U},
+    m_max_late_us{0U},
+    m_total_late_us{0U},
+    m_sender()
+{
+    try {
+        m_midi_out.openPort(port);
+    } catch (const RtMidiError &e) {
+        throw std::runtime_error(e.getMessage());
+    }
+
+    m_sender = std::thread(&PortSender::sender_loop, this);
+}
+
+
+PortSender::~PortSender()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stop = true;
+    }
+    m_wake.notify_one();
+
+    if (m_sender.joinable()) {
+        m_sender.join();
+    }
+    m_midi_out.closePort();
+}
+
+
+bool PortSender::send(const uint8_t *const midi_message, const size_t size)
+{
+    const auto head = m_head.load(std::memory_order_relaxed);
+    if (head - m_tail.load(std::memory_order_acquire) >= QUEUE_SIZE) {
+        m_dropped.fetch_add(1U, std::memory_order_relaxed);
+        return false;
+    }
+
+    auto &entry = m_queue[head & (QUEUE_SIZE - 1U)];
+    entry.queued_ns = get_monotonic_ns();
+    entry.size = uint8_t(std::min(size, MIDI_MESSAGE_SIZE));
+    std::copy_n(midi_message, entry.size, entry.data.begin());
+
+    //  Sequentially consistent store/load pair with `sender_loop`: either the
+    // sender sees this message before sleeping or we see it waiting.
+    m_head.store(head + 1U);
+    if (m_waiting.load()) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_wake.notify_one();
+    }
+
+    return true;
+}
+
+
+PortStats PortSender::get_stats() const
+{
+    return PortStats{m_messages.load(std::memory_order_relaxed),
+                     m_dropped.load(std::memory_order_relaxed),
+                     m_late.load(std::memory_order_relaxed),
+                     m_max_late_us.load(std::memory_order_relaxed),
+                     m_total_late_us.load(std::memory_order_relaxed)};
+}
+
+
+void PortSender::sender_loop()
+{
+    for (;;) {
+        drain();
+
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_waiting.store(true);
+        m_wake.wait(lock, [this]() { return m_stop || !is_empty(); });
+        m_waiting.store(false);
+
+        if (m_stop && is_empty()) {
+            break;
+        }
+    }
+}
+
+
+void PortSender::drain()
+{
+    const auto head = m_head.load(std::memory_order_acquire);
+    auto tail = m_tail.load(std::memory_order_relaxed);
+
+    while (tail != head) {
+        const auto &entry = m_queue[tail & (QUEUE_SIZE - 1U)];
+        ++tail;
+        try {
+            m_midi_out.sendMessage(entry.data.data(), entry.size);
+        } catch (const RtMidiError &) {
+            //  A failed port must not take the player down with it.
+            m_dropped.fetch_add(1U, std::memory_order_relaxed);
+            m_tail.store(tail, std::memory_order_release);
+            continue;
+        }
+
+        const auto late_us = uint32_t((get_monotonic_ns() - entry.queued_ns) /
+                                      NS_PER_US);
+        m_messages.fetch_add(1U, std::memory_order_relaxed);
+        m_total_late_us.fetch_add(late_us, std::memory_order_relaxed);
+        if (late_us > PORT_LATE_US) {
+            m_late.fetch_add(1U, std::memory_order_relaxed);
+        }
+        if (late_us > m_max_late_us.load(std::memory_order_relaxed)) {
+            m_max_late_us.store(late_us, std::memory_order_relaxed);
+        }
+        m_tail.store(tail, std::memory_order_release);
+    }
+}
+
+}  //  end bach_bot
@@ -0,0 +1,184 @@
+/**
+ * @file port_sender.h
+ * @brief Per-port MIDI sender thread
+ * @copyright
+ * 2022 Andrew Buettner (ABi)
+ *
+ * @section LICENSE
+ *
+ * BachBot - A hymn Midi player for Schlicker organs
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @section DESCRIPTION
+ * The player may drive more than one MIDI port at a time (the organ plus a
+ * monitoring synth or recorder).  `sendMessage` can block for a long time on
+ * some drivers, so each port is given its own sender thread fed by a
+ * single-producer / single-consumer ring.  The player only ever copies the
+ * message into the ring; a slow (or stuck) monitor port fills its own ring
+ * and drops its own messages without delaying the organ.
+ *
+ * The sender sleeps on a condition variable while its ring is empty.  The
+ * player only takes the (uncontended) mutex to wake it, never to queue.
+ */
+
+#pragma once
+
+//  system includes
+#include <array>  //  std::array
+#include <atomic>  //  std::atomic
+#include <condition_variable>  //  std::condition_variable
+#include <cstdint>  //  uintXX_t
+#include <memory>  //  std::unique_ptr
+#include <mutex>  //  std::mutex
+#include <string>  //  std::string
+#include <thread>  //  std::thread
+#include <vector>  //  std::vector
+
+//  module includes
+// -none-
+
+//  local includes
+#include "common_defs.h"  //  MIDI_MESSAGE_SIZE
+#include "midi_interface.h"  //  RtMidiOut
+
+
+namespace bach_bot {
+
+/** Sender delay above which a message is counted as late (microseconds) */
+constexpr const auto PORT_LATE_US = 2000U;
+
+/**
+ * @brief Snapshot of the delivery statistics of a single port.
+ * @note Lateness is the time from the player queueing a message to the
+ *       driver's `sendMessage` returning.
+ */
+struct PortStats
+{
+    uint64_t messages;  ///< messages sent
+    uint32_t dropped;  ///< messages lost to a full queue
+    uint32_t late;  ///< messages later than `PORT_LATE_US`
+    uint32_t max_late_us;  ///< worst delivery delay
+    uint64_t total_late_us;  ///< sum of all delivery delays
+
+    /**
+     * @brief Get the mean delivery delay
+     * @returns mean delay (microseconds)
+     */
+    double get_mean_late_us() const
+    {
+        return (messages > 0U) ? double(total_late_us) / double(messages) :
+                                 0.0;
+    }
+};
+
+
+/**
+ * @brief Sends MIDI messages to one output port from a dedicated thread.
+ */
+class PortSender
+{
+public:
+    /** Queue capacity in messages (must be a power of 2) */
+    static constexpr const size_t QUEUE_SIZE = 1024U;
+
+    /**
+     * @brief Constructor - open the port and start the sender thread.
+     * @param port MIDI output port number
+     * @param name port name (for reporting)
+     * @throws std::runtime_error port can not be opened
+     */
+    PortSender(const uint32_t port, const std::string &name);
+
+    /**
+     * @brief Destructor - send anything still queued, then close the port.
+     */
+    ~PortSender();
+
+    PortSender(const PortSender &) = delete;
+    PortSender &operator=(const PortSender &) = delete;
+
+    /**
+     * @brief Queue a message for sending.
+     * @param midi_message message bytes
+     * @param size number of bytes (at most `MIDI_MESSAGE_SIZE`)
+     * @retval `true` message queued
+     * @retval `false` queue full, message dropped
+     * @note Must only be called from one thread (the player).
+     */
+    bool send(const uint8_t *const midi_message, const size_t size);
+
+    /**
+     * @brief Get the delivery statistics of this port (thread-safe).
+     */
+    PortStats get_stats() const;
+
+    /**
+     * @brief Get the port name
+     */
+    const std::string &get_name() const
+    {
+        return m_name;
+    }
+
+private:
+    /**
+     * @brief Single queued message
+     */
+    struct QueuedMessage
+    {
+        int64_t queued_ns;  ///< monotonic time the player queued it
+        std::array<uint8_t, MIDI_MESSAGE_SIZE> data;  ///< message bytes
+        uint8_t size;  ///< number of bytes used in `data`
+    };
+
+    /**
+     * @brief Sender thread function
+     */
+    void sender_loop();
+
+    /**
+     * @brief Send everything currently queued.
+     */
+    void drain();
+
+    /**
+     * @brief Test for an empty queue from the sender thread.
+     */
+    bool is_empty() const
+    {
+        return m_head.load() == m_tail.load(std::memory_order_relaxed);
+    }
+
+    const std::string m_name;
+    RtMidiOut m_midi_out;
+    std::vector<QueuedMessage> m_queue;
+    std::atomic<size_t> m_head;  ///< next message to queue (player)
+    std::atomic<size_t> m_tail;  ///< next message to send (sender)
+
+    std::mutex m_mutex;  ///< protects the wait, not the queue
+    std::condition_variable m_wake;
+    std::atomic<bool> m_waiting;  ///< sender is (about to be) asleep
+    std::atomic<bool> m_stop;
+
+    std::atomic<uint64_t> m_messages;
+    std::atomic<uint32_t> m_dropped;
+    std::atomic<uint32_t> m_late;
+    std::atomic<uint32_t> m_max_late_us;
+    std::atomic<uint64_t> m_total_late_us;
+
+    std::thread m_sender;
+};
+
+}  //  end bach_bot
@@ -0,0 +1,200 @@
+/**
+ * @file profile_zone.cpp
+ * @brief Scoped-zone profiler (Chrome trace-event output)
+ * @copyright
+ * 2022 Andrew Buettner (ABi)
+ *
+ * @section LICENSE
+ *
+ * BachBot - A hymn Midi player for Schlicker organs
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+//  system includes
+#include <array>  //  std::array
+#include <fstream>  //  std::ofstream
+#include <memory>  //  std::unique_ptr
+#include <mutex>  //  std::mutex
+#include <vector>  //  std::vector
+#include <fmt/format.h>  //  fmt::format
+
+//  module includes
+// -none-
+
+//  local includes
+#include "profile_zone.h"  //  local include
+#include "monotonic_clock.h"  //  get_monotonic_ns
+
+
+namespace {
+    /** Zones per storage chunk */
+    constexpr const auto ZONE_CHUNK_SIZE = 4096U;
+    static_assert(0U == (bach_bot::MAX_ZONES_PER_THREAD % ZONE_CHUNK_SIZE),
+                  "Zone limit must be a whole number of chunks");
+
+    /**
+     * @brief Single completed zone
+     */
+    struct ZoneRecord
+    {
+        const char *name;
+        int64_t start_ns;  ///< relative to the profile clock epoch
+        int64_t duration_ns;
+    };
+
+    /** Fixed block of zones; never moved once allocated */
+    using ZoneChunk = std::array<ZoneRecord, ZONE_CHUNK_SIZE>;
+
+    /**
+     * @brief Zones recorded by one thread
+     */
+    struct ThreadBuffer
+    {
+        uint32_t thread_id;  ///< trace thread ID (registration order)
+        const char *name;  ///< set by `set_profile_thread_name`
+        std::mutex mutex;  ///< only contended while the trace is written
+        /** Zones in recording order, `ZONE_CHUNK_SIZE` per chunk */
+        std::vector<std::unique_ptr<ZoneChunk>> chunks;
+        size_t zone_count;  ///< zones recorded
+        uint64_t dropped;  ///< zones over `MAX_ZONES_PER_THREAD`
+    };
+
+    /**
+     * @brief Every thread buffer, kept until exit so that the zones of
+     *        finished threads (eg the playlist loader) are still written.
+     */
+    struct ProfileRegistry
+    {
+        int64_t epoch_ns;  ///< monotonic time of the first zone
+        std::mutex mutex;
+        std::vector<std::unique_ptr<ThreadBuffer>> threads;
+    };
+
+    ProfileRegistry &get_registry()
+    {
+        static ProfileRegistry registry{bach_bot::get_monotonic_ns(), {}, {}};
+        return registry;
+    }
+
+    int64_t get_profile_ns()
+    {
+        return bach_bot::get_monotonic_ns() - get_registry().epoch_ns;
+    }
+
+    ThreadBuffer &get_thread_buffer()
+    {
+        thread_local ThreadBuffer *buffer = nullptr;
+        if (nullptr == buffer) {
+            auto &registry = get_registry();
+            std::lock_guard<std::mutex> lock(registry.mutex);
+            registry.threads.push_back(std::make_unique<ThreadBuffer>());
+            buffer = registry.threads.back().get();
+            buffer->thread_id = uint32_t(registry.threads.size());
+            buffer->name = nullptr;
+            //  Full chunk table up front: a new chunk never copies the zones
+            // already recorded (or the table).
+            buffer->chunks.reserve(
+                bach_bot::MAX_ZONES_PER_THREAD / ZONE_CHUNK_SIZE);
+            buffer->chunks.push_back(std::make_unique<ZoneChunk>());
+            buffer->zone_count = 0U;
+            buffer->dropped = 0U;
+        }
+        return *buffer;
+    }
+
+    /**
+     * @brief Format a profile clock time as trace-event microseconds.
+     */
+    std::string to_trace_us(const int64_t ns)
+    {
+        return fmt::format("{}.{:03}", ns / 1000, ns % 1000);
+    }
+}  //  end anonymous namespace
+
+
+namespace bach_bot {
+
+ProfileZone::ProfileZone(const char *const name) :
+    m_name{name},
+    m_start_ns{get_profile_ns()}
+{
+}
+
+
+ProfileZone::~ProfileZone()
+{
+    const auto end_ns = get_profile_ns();
+    auto &buffer = get_thread_buffer();
+    std::lock_guard<std::mutex> lock(buffer.mutex);
+    if (buffer.zone_count < MAX_ZONES_PER_THREAD) {
+        if (buffer.zone_count == buffer.chunks.size() * ZONE_CHUNK_SIZE) {
+            buffer.chunks.push_back(std::make_unique<ZoneChunk>());
+        }
+        (*buffer.chunks.back())[buffer.zone_count % ZONE_CHUNK_SIZE] =
+            {m_name, m_start_ns, end_ns - m_start_ns};
+        ++buffer.zone_count;
+    } else {
+        ++buffer.dropped;
+    }
+}
+
+
+void set_profile_thread_name(const char *const name)
+{
+    auto &buffer = get_thread_buffer();
+    std::lock_guard<std::mutex> lock(buffer.mutex);
+    buffer.name = name;
+}
+
+
+bool write_profile_trace(const std::string &file_name)
+{
+    std::ofstream output(file_name, std::ios::trunc);
+    if (!output) {
+        return false;
+    }
+
+    auto separator = "\n";
+    output << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+    auto &registry = get_registry();
+    std::lock_guard<std::mutex> registry_lock(registry.mutex);
+    for (const auto &thread: registry.threads) {
+        std::lock_guard<std::mutex> lock(thread->mutex);
+        const auto thread_name = (nullptr != thread->name) ?
+            std::string(thread->name) :
+            fmt::format("thread {}", thread->thread_id);
+        output << separator << fmt::format(
+            "{{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":1,\"tid\":{},"
+            "\"args\":{{\"name\":\"{}\",\"dropped_zones\":{}}}}}",
+            thread->thread_id, thread_name, thread->dropped);
+        separator = ",\n";
+
+        for (auto i = size_t(0U); i < thread->zone_count; ++i) {
+            const auto &zone =
+                (*thread->chunks[i / ZONE_CHUNK_SIZE])[i % ZONE_CHUNK_SIZE];
+            output << separator << fmt::format(
+                "{{\"ph\":\"X\",\"name\":\"{}\",\"pid\":1,\"tid\":{},"
+                "\"ts\":{},\"dur\":{}}}",
+                zone.name, thread->thread_id, to_trace_us(zone.start_ns),
+                to_trace_us(zone.duration_ns));
+        }
+    }
+    output << "\n]}\n";
+
+    return bool(output);
+}
+
+}  //  end bach_bot
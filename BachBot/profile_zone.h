@@ -0,0 +1,116 @@
+/**
+ * @file profile_zone.h
+ * @brief Scoped-zone profiler (Chrome trace-event output)
+ * @copyright
+ * 2022 Andrew Buettner (ABi)
+ *
+ * @section LICENSE
+ *
+ * BachBot - A hymn Midi player for Schlicker organs
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @section DESCRIPTION
+ * Timing of the importer, loader, player and UI is recorded as named zones
+ * (a scope with a start and a duration) and written as Chrome trace-event
+ * JSON, which can be opened in Perfetto or `chrome://tracing`.
+ *
+ * Each thread appends to its own buffer, so recording a zone is two clock
+ * reads and a store under a lock that is only ever contended while the
+ * trace is being written.  The buffer grows in fixed chunks, so recorded
+ * zones are never copied.  Zones are compiled in with the `BACHBOT_PROFILE`
+ * definition; without it `BACHBOT_ZONE` and `BACHBOT_THREAD_NAME` expand to
+ * nothing.
+ */
+
+#pragma once
+
+//  system includes
+#include <cstdint>  //  int64_t
+#include <string>  //  std::string
+
+//  module includes
+// -none-
+
+//  local includes
+// -none-
+
+
+namespace bach_bot {
+
+/** Zones kept per thread; later zones are counted but not recorded */
+constexpr const auto MAX_ZONES_PER_THREAD = 1U << 20U;
+
+/**
+ * @brief Records the time spent in a scope on the current thread.
+ * @note Use through `BACHBOT_ZONE` so that it compiles out when profiling is
+ *       disabled.
+ */
+class ProfileZone
+{
+public:
+    /**
+     * @brief Constructor - start the zone.
+     * @param name zone name, must be a string literal (only the pointer is
+     *        kept) without characters that need escaping in JSON
+     */
+    explicit ProfileZone(const char *const name);
+
+    /**
+     * @brief Destructor - end the zone and record it.
+     */
+    ~ProfileZone();
+
+    ProfileZone(const ProfileZone &) = delete;
+    ProfileZone &operator=(const ProfileZone &) = delete;
+
+private:
+    const char *const m_name;
+    const int64_t m_start_ns;  ///< profile clock time the zone started
+};
+
+
+/**
+ * @brief Name the current thread in the trace.
+ * @param name thread name, must be a string literal
+ */
+void set_profile_thread_name(const char *const name);
+
+/**
+ * @brief Write every recorded zone as Chrome trace-event JSON.
+ * @param file_name output file name
+ * @retval `true` trace written
+ * @retval `false` file could not be written
+ * @note Safe to call while other threads are still recording; zones that
+ *       end during the write may be missing from the trace.
+ */
+bool write_profile_trace(const std::string &file_name);
+
+}  //  end bach_bot
+
+
+#define BACHBOT_ZONE_CONCAT_(a, b) a##b
+#define BACHBOT_ZONE_CONCAT(a, b) BACHBOT_ZONE_CONCAT_(a, b)
+
+#if defined(BACHBOT_PROFILE)
+/** Record the time until the end of the enclosing scope as zone `name` */
+#define BACHBOT_ZONE(name) \
+    const bach_bot::ProfileZone BACHBOT_ZONE_CONCAT(profile_zone_, \
+                                                    __LINE__)(name)
+/** Name the current thread in the trace */
+#define BACHBOT_THREAD_NAME(name) bach_bot::set_profile_thread_name(name)
+#else
+#define BACHBOT_ZONE(name)
+#define BACHBOT_THREAD_NAME(name)
+#endif
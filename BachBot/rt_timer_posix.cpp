@@ -35,6 +35,7 @@
 
 //  local includes
 #include "rt_timer.h"  //  RTTimer
+#include "monotonic_clock.h"  //  get_monotonic_ns
 
 
 namespace {
@@ -52,7 +53,6 @@ public:
         RTTimer(player),
         wxThread(wxTHREAD_JOINABLE),
         m_mutex(),
-        m_current_time(),
 #ifdef __APPLE__
         m_power_control(wxPOWER_RESOURCE_SYSTEM, "BachBot Playing"),
         m_screen_control(wxPOWER_RESOURCE_SCREEN, "BachBot Playing"),
@@ -89,12 +89,11 @@ protected:
     virtual ExitCode Entry() override
     {
         fd_set tx_set, rx_set, err_set;
-        m_current_time.Start();
         auto loop_iter = 0;
         auto loop_count = 0U;
         uint64_t delay_us = US_PER_MS;
 
-        auto start_time = m_current_time.TimeInMicro();
+        auto start_ns = bach_bot::get_monotonic_ns();
         while (true) {
             FD_ZERO(&tx_set);
             FD_ZERO(&rx_set);
@@ -102,15 +101,15 @@ protected:
             auto tv = timeval();
             tv.tv_usec = suseconds_t(delay_us);
             static_cast<void>(select(1, &rx_set, &tx_set, &err_set, &tv));
-            const auto end_time = m_current_time.TimeInMicro();
+            const auto end_ns = bach_bot::get_monotonic_ns();
 
             tick();
 
             //  Calculate a ratio to adjust delay by to improve the sleep by.
-            const auto start = uint64_t(start_time.GetValue());
-            const auto end = uint64_t(end_time.GetValue());
-            auto time = delay_us * US_PER_MS;
-            time /= end - start;
+            const auto elapsed_ns = (end_ns > start_ns) ?
+                uint64_t(end_ns - start_ns) : 1ULL;
+            auto time = delay_us * uint64_t(bach_bot::NS_PER_MS);
+            time /= elapsed_ns;
 
             //  Apply a 1/64 average
             delay_us *= 63ULL;
@@ -126,7 +125,8 @@ protected:
                 ++loop_count;
                 std::cout << "Loop: " << loop_count
                           << " Delay (est): " << delay_us
-                          << " Diff: " << end - start
+                          << " Diff: "
+                          << elapsed_ns / uint64_t(bach_bot::NS_PER_US)
                           << std::endl;
             }
 
@@ -134,7 +134,7 @@ protected:
                 break;
             }
 
-            start_time = end_time;
+            start_ns = end_ns;
         }
 
         return nullptr;
@@ -156,7 +156,6 @@ protected:
 
 private:
     wxMutex m_mutex;
-    wxStopWatch m_current_time;
 
 #ifdef __APPLE__
     wxPowerResourceBlocker m_power_control;  ///<  Prevent low power mode
@@ -0,0 +1,412 @@
+/**
+ * @file smf_reader.cpp
+ * @brief Streaming Standard MIDI File reader
+ * @copyright
+ * 2022 Andrew Buettner (ABi)
+ *
+ * @section LICENSE
+ *
+ * BachBot - A hymn Midi player for Schlicker organs
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+//  system includes
+#include <algorithm>  //  std::stable_sort
+#include <cstring>  //  std::memcmp
+#include <functional>  //  std::greater
+#include <queue>  //  std::priority_queue
+#include <stdexcept>  //  std::runtime_error
+#include <utility>  //  std::pair
+#include <fmt/format.h>  //  fmt::format
+
+//  module includes
+// -none-
+
+//  local includes
+#include "smf_reader.h"  //  local include
+
+
+namespace {
+
+constexpr const auto CHUNK_HEADER_SIZE = 8U;
+constexpr const auto MTHD_MIN_SIZE = 6U;
+constexpr const auto META_EVENT = uint8_t(0xFFU);
+constexpr const auto SYSEX_EVENT = uint8_t(0xF0U);
+constexpr const auto SYSEX_ESCAPE = uint8_t(0xF7U);
+constexpr const auto META_END_OF_TRACK = uint8_t(0x2FU);
+constexpr const auto META_TEMPO = uint8_t(0x51U);
+constexpr const auto META_TIME_SIGNATURE = uint8_t(0x58U);
+constexpr const auto DEFAULT_US_PER_QUARTER = 500000.0;  //  120bpm
+constexpr const auto US_PER_MINUTE = 60000000.0;
+constexpr const auto US_PER_S = 1000000.0;
+
+uint32_t read_be(const uint8_t *const data, const size_t bytes)
+{
+    auto value = 0U;
+    for (auto i = 0U; i < bytes; ++i) {
+        value = (value << 8U) | data[i];
+    }
+    return value;
+}
+
+
+/**
+ * @brief Decoding state of a single track.
+ */
+struct TrackCursor
+{
+    TrackCursor(const uint8_t *const chunk_begin,
+                const uint8_t *const chunk_end) :
+        pos{chunk_begin},
+        end{chunk_end},
+        tick{0},
+        running_status{0U},
+        has_event{false},
+        event{},
+        meta_type{0U},
+        meta_data{nullptr},
+        meta_length{0U}
+    {
+        advance();
+    }
+
+    /**
+     * @brief Read a variable length quantity.
+     * @param[out] value decoded value
+     * @retval false track data is truncated
+     */
+    bool read_varlen(uint32_t &value)
+    {
+        value = 0U;
+        for (auto i = 0U; i < 4U; ++i) {
+            if (pos >= end) {
+                return false;
+            }
+            const auto byte = *pos++;
+            value = (value << 7U) | (byte & 0x7FU);
+            if (0U == (byte & 0x80U)) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    /**
+     * @brief Decode the next event in the track (sets `has_event`).
+     * @note Truncated tracks are treated as ending at the last whole event.
+     */
+    void advance()
+    {
+        has_event = false;
+        uint32_t delta;
+        if (!read_varlen(delta) || (pos >= end)) {
+            return;
+        }
+        tick += int(delta);
+
+        auto status = *pos;
+        if (status >= 0x80U) {
+            ++pos;
+        } else if (running_status >= 0x80U) {
+            status = running_status;
+        } else {
+            return;  //  Data byte without any status - corrupt track
+        }
+
+        meta_type = 0U;
+        if (META_EVENT == status) {
+            if (pos >= end) {
+                return;
+            }
+            meta_type = *pos++;
+            uint32_t length;
+            if (!read_varlen(length) || (size_t(end - pos) < length)) {
+                return;
+            }
+            meta_data = pos;
+            meta_length = length;
+            pos += length;
+            has_event = (META_END_OF_TRACK != meta_type);
+            event.status = status;
+            return;
+        }
+
+        if ((SYSEX_EVENT == status) || (SYSEX_ESCAPE == status)) {
+            uint32_t length;
+            if (!read_varlen(length) || (size_t(end - pos) < length)) {
+                return;
+            }
+            pos += length;
+            event.status = status;
+            has_event = true;
+            return;
+        }
+
+        const auto command = (status >> 4U);
+        running_status = status;
+        const auto data_bytes =
+            ((bach_bot::MidiCommands::PATCH_CHANGE == command) ||
+             (bach_bot::MidiCommands::CHANNEL_PRESSURE == command)) ? 1U : 2U;
+        if (size_t(end - pos) < data_bytes) {
+            return;
+        }
+        event.status = status;
+        event.byte1 = pos[0];
+        event.byte2 = (data_bytes > 1U) ? pos[1] : uint8_t(0U);
+        event.size = uint8_t(data_bytes + 1U);
+        pos += data_bytes;
+        has_event = true;
+    }
+
+    /**
+     * @brief Test if the current event is a channel (voice) message.
+     */
+    bool is_channel_event() const
+    {
+        return has_event && (event.status < SYSEX_EVENT);
+    }
+
+    /**
+     * @brief Test if the current event is a tempo meta event.
+     */
+    bool is_tempo_event() const
+    {
+        return has_event && (META_EVENT == event.status) &&
+               (META_TEMPO == meta_type) && (meta_length >= 3U);
+    }
+
+    /**
+     * @brief Test if the current event is a time signature meta event.
+     */
+    bool is_time_signature_event() const
+    {
+        return has_event && (META_EVENT == event.status) &&
+               (META_TIME_SIGNATURE == meta_type) && (meta_length >= 2U);
+    }
+
+    /**
+     * @brief Get the microseconds per quarter note of a tempo event
+     */
+    double get_us_per_quarter() const
+    {
+        return double(read_be(meta_data, 3U));
+    }
+
+    const uint8_t *pos;  ///< next byte to decode
+    const uint8_t *const end;  ///< end of track chunk
+    int tick;  ///< absolute tick of the current event
+    uint8_t running_status;  ///< last channel status byte
+    bool has_event;  ///< current event is valid
+    bach_bot::SmfEvent event;  ///< current event (channel events)
+    uint8_t meta_type;  ///< current event meta type (meta events)
+    const uint8_t *meta_data;  ///< current event meta payload
+    uint32_t meta_length;  ///< current event meta payload length
+};
+
+
+/**
+ * @brief Sort rank used for events sharing the same tick.
+ */
+int same_tick_rank(const bach_bot::SmfEvent &event)
+{
+    if (event.is_note_off()) {
+        return 0;
+    }
+    return event.is_note_on() ? 2 : 1;
+}
+
+}  //  end anonymous namespace
+
+
+namespace bach_bot {
+
+SmfReader::SmfReader(const std::string &file_name) :
+    m_file(file_name),
+    m_tracks(),
+    m_ticks_per_quarter{0},
+    m_seconds_per_tick{0.0}
+{
+    const auto *const data = m_file.data();
+    const auto size = m_file.size();
+    if ((size < CHUNK_HEADER_SIZE + MTHD_MIN_SIZE) ||
+            (0 != std::memcmp(data, "MThd", 4U))) {
+        throw std::runtime_error(fmt::format("{} is not a MIDI file",
+                                             file_name));
+    }
+
+    const auto header_size = read_be(data + 4U, 4U);
+    const auto track_count = read_be(data + 10U, 2U);
+    const auto division = read_be(data + 12U, 2U);
+    if ((header_size < MTHD_MIN_SIZE) || (0U == division)) {
+        throw std::runtime_error(fmt::format("{} has an invalid header",
+                                             file_name));
+    }
+
+    if (0U != (division & 0x8000U)) {
+        //  SMPTE: -frames/second in the upper byte, ticks/frame in the lower
+        const auto frames_per_second = 0x100U - (division >> 8U);
+        const auto ticks_per_frame = division & 0xFFU;
+        m_seconds_per_tick = 1.0 / double(frames_per_second * ticks_per_frame);
+    } else {
+        m_ticks_per_quarter = int(division);
+    }
+
+    m_tracks.reserve(track_count);
+    auto offset = size_t(CHUNK_HEADER_SIZE) + header_size;
+    while (offset + CHUNK_HEADER_SIZE <= size) {
+        const auto *const chunk = data + offset;
+        const auto chunk_size = read_be(chunk + 4U, 4U);
+        offset += CHUNK_HEADER_SIZE;
+        const auto chunk_end = std::min(size, offset + chunk_size);
+        if (0 == std::memcmp(chunk, "MTrk", 4U)) {
+            m_tracks.push_back({data + offset, data + chunk_end});
+        }
+        offset = chunk_end;
+    }
+}
+
+
+std::optional<double> SmfReader::get_tempo_bpm() const
+{
+    //  First tempo (by tick) of any track, the way a joined track sees it.
+    std::optional<std::pair<int, double>> first_tempo;
+    for (const auto &track: m_tracks) {
+        TrackCursor cursor(track.begin, track.end);
+        while (cursor.has_event) {
+            if (first_tempo.has_value() && (cursor.tick >= first_tempo->first)) {
+                break;
+            }
+            if (cursor.is_tempo_event()) {
+                first_tempo = {cursor.tick, cursor.get_us_per_quarter()};
+                break;
+            }
+            cursor.advance();
+        }
+    }
+
+    std::optional<double> tempo;
+    if (first_tempo.has_value() && (first_tempo->second > 0.0)) {
+        tempo = US_PER_MINUTE / first_tempo->second;
+    }
+    return tempo;
+}
+
+
+int SmfReader::get_ticks_per_quarter() const
+{
+    return m_ticks_per_quarter;
+}
+
+
+int SmfReader::get_ticks_per_measure() const
+{
+    //  First time signature (by tick) of any track, same as the tempo.
+    std::optional<std::pair<int, int>> first_signature;
+    for (const auto &track: m_tracks) {
+        TrackCursor cursor(track.begin, track.end);
+        while (cursor.has_event) {
+            if (first_signature.has_value() &&
+                    (cursor.tick >= first_signature->first)) {
+                break;
+            }
+            if (cursor.is_time_signature_event()) {
+                //  numerator, denominator (as a power of 2)
+                const auto ticks_per_beat = (4 * m_ticks_per_quarter) >>
+                                            std::min(cursor.meta_data[1],
+                                                     uint8_t(6U));
+                first_signature = {cursor.tick,
+                                   int(cursor.meta_data[0]) * ticks_per_beat};
+                break;
+            }
+            cursor.advance();
+        }
+    }
+
+    if (first_signature.has_value() && (first_signature->second > 0)) {
+        return first_signature->second;
+    }
+    return 4 * m_ticks_per_quarter;
+}
+
+
+void SmfReader::for_each_event(const EventCallback &callback) const
+{
+    using HeapEntry = std::pair<int, size_t>;  //  tick, track index
+    std::priority_queue<HeapEntry,
+                        std::vector<HeapEntry>,
+                        std::greater<HeapEntry>> next_track;
+    std::vector<TrackCursor> cursors;
+    cursors.reserve(m_tracks.size());
+    for (const auto &track: m_tracks) {
+        cursors.emplace_back(track.begin, track.end);
+        if (cursors.back().has_event) {
+            next_track.push({cursors.back().tick, cursors.size() - 1U});
+        }
+    }
+
+    //  Tempo map state: time of the last tempo change and the current rate
+    auto tempo_tick = 0;
+    auto tempo_seconds = 0.0;
+    auto seconds_per_tick = m_seconds_per_tick;
+    if (m_ticks_per_quarter > 0) {
+        seconds_per_tick = DEFAULT_US_PER_QUARTER /
+                           (US_PER_S * double(m_ticks_per_quarter));
+    }
+
+    std::vector<SmfEvent> same_tick_events;
+    while (!next_track.empty()) {
+        const auto current_tick = next_track.top().first;
+        same_tick_events.clear();
+
+        while (!next_track.empty() && (next_track.top().first == current_tick)) {
+            auto &cursor = cursors[next_track.top().second];
+            const auto track_index = next_track.top().second;
+            next_track.pop();
+
+            do {
+                if (cursor.is_channel_event()) {
+                    same_tick_events.push_back(cursor.event);
+                    same_tick_events.back().tick = current_tick;
+                } else if (cursor.is_tempo_event() &&
+                           (m_ticks_per_quarter > 0)) {
+                    tempo_seconds += double(current_tick - tempo_tick) *
+                                     seconds_per_tick;
+                    tempo_tick = current_tick;
+                    seconds_per_tick = cursor.get_us_per_quarter() /
+                                       (US_PER_S * double(m_ticks_per_quarter));
+                }
+                cursor.advance();
+            } while (cursor.has_event && (cursor.tick == current_tick));
+
+            if (cursor.has_event) {
+                next_track.push({cursor.tick, track_index});
+            }
+        }
+
+        const auto seconds = tempo_seconds +
+            double(current_tick - tempo_tick) * seconds_per_tick;
+        std::stable_sort(same_tick_events.begin(), same_tick_events.end(),
+                         [](const SmfEvent &lhs, const SmfEvent &rhs) {
+            return same_tick_rank(lhs) < same_tick_rank(rhs);
+        });
+        for (auto &event: same_tick_events) {
+            event.seconds = seconds;
+            callback(event);
+        }
+    }
+}
+
+}  //  end bach_bot
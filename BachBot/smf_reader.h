@@ -0,0 +1,166 @@
+/**
+ * @file smf_reader.h
+ * @brief Streaming Standard MIDI File reader
+ * @copyright
+ * 2022 Andrew Buettner (ABi)
+ *
+ * @section LICENSE
+ *
+ * BachBot - A hymn Midi player for Schlicker organs
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @section DESCRIPTION
+ * The general purpose MIDI library builds a complete in-memory copy of every
+ * track, joins them, sorts them and then walks the result to calculate the
+ * real time of each event.  The importer only needs to see each channel
+ * event once, in time order, with the time already in seconds.  This reader
+ * decodes the SMF chunks directly out of a memory mapped file, merges the
+ * tracks on the fly and resolves the tempo map as it goes so that events can
+ * be handed to the importer without ever building an intermediate copy of
+ * the song.
+ */
+
+#pragma once
+
+//  system includes
+#include <cstdint>  //  uintXX_t
+#include <functional>  //  std::function
+#include <optional>  //  std::optional
+#include <string>  //  std::string
+#include <vector>  //  std::vector
+
+//  module includes
+// -none-
+
+//  local includes
+#include "common_defs.h"  //  MidiCommands
+#include "mapped_file.h"  //  MappedFile
+
+
+namespace bach_bot {
+
+/**
+ * @brief Timed MIDI channel event.
+ * @note This is the common currency of the import stage; it is produced by
+ *       both the streaming reader and (by conversion) the MIDI file library.
+ */
+struct SmfEvent
+{
+    int tick;  ///< absolute time in MIDI ticks
+    double seconds;  ///< absolute time in seconds
+    uint8_t status;  ///< status (command + channel) byte
+    uint8_t byte1;  ///< first data byte (0 if unused)
+    uint8_t byte2;  ///< second data byte (0 if unused)
+    uint8_t size;  ///< number of bytes in the message, including status
+
+    /**
+     * @brief Get the MIDI channel of this event
+     * @returns channel number 0-15
+     */
+    int get_channel() const
+    {
+        return int(status & 0x0FU);
+    }
+
+    /**
+     * @brief Test for a note-on event (a note-on with zero velocity is a
+     *        note-off).
+     */
+    bool is_note_on() const
+    {
+        return ((status >> 4U) == MidiCommands::NOTE_ON) && (byte2 > 0U);
+    }
+
+    /**
+     * @brief Test for a note-off event (including zero velocity note-on).
+     */
+    bool is_note_off() const
+    {
+        const auto command = (status >> 4U);
+        return (command == MidiCommands::NOTE_OFF) ||
+               ((command == MidiCommands::NOTE_ON) && (0U == byte2));
+    }
+
+    /**
+     * @brief Test for either a note-on or a note-off event
+     */
+    bool is_note() const
+    {
+        return is_note_on() || is_note_off();
+    }
+};
+
+
+/**
+ * @brief Streaming reader for type 0 / type 1 Standard MIDI Files.
+ */
+class SmfReader
+{
+public:
+    using EventCallback = std::function<void(const SmfEvent&)>;
+
+    /**
+     * @brief Constructor - map the file and index the track chunks.
+     * @param file_name file to read (UTF-8)
+     * @throws std::runtime_error file can not be read or is not a MIDI file
+     */
+    explicit SmfReader(const std::string &file_name);
+
+    /**
+     * @brief Get the first tempo of the song.
+     * @returns tempo in beats per minute
+     * @retval std::nullopt song does not contain tempo information
+     */
+    std::optional<double> get_tempo_bpm() const;
+
+    /**
+     * @brief Get the ticks per quarter note of the file.
+     * @returns ticks per quarter note (0 for SMPTE timing)
+     */
+    int get_ticks_per_quarter() const;
+
+    /**
+     * @brief Get the length of a measure, from the first time signature.
+     * @returns MIDI ticks per measure (4/4 if there is no time signature)
+     * @retval 0 file uses SMPTE timing (no measures)
+     */
+    int get_ticks_per_measure() const;
+
+    /**
+     * @brief Decode every channel event of every track in time order.
+     * @param callback called once per event
+     * @note Events sharing a tick are delivered with note-offs ahead of
+     *       note-ons, which matches the order produced by the MIDI library
+     *       after `joinTracks`.
+     */
+    void for_each_event(const EventCallback &callback) const;
+
+private:
+    /**
+     * @brief Byte range of a single `MTrk` chunk
+     */
+    struct TrackChunk
+    {
+        const uint8_t *begin;  ///< first event byte
+        const uint8_t *end;  ///< one past the last byte
+    };
+
+    MappedFile m_file;  ///< raw file contents
+    std::vector<TrackChunk> m_tracks;  ///< track chunks in file order
+    int m_ticks_per_quarter;  ///< MThd division (metrical timing)
+    double m_seconds_per_tick;  ///< MThd division (SMPTE timing)
+};
+
+}  //  end bach_bot
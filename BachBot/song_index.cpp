@@ -0,0 +1,180 @@
+/**
+ * @file song_index.cpp
+ * @brief Song time index used for seeking
+ * @copyright
+ * 2022 Andrew Buettner (ABi)
+ *
+ * @section LICENSE
+ *
+ * BachBot - A hymn Midi player for Schlicker organs
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+//  system includes
+#include <algorithm>  //  std::partition_point, std::max
+
+//  module includes
+// -none-
+
+//  local includes
+#include "song_index.h"  //  local include
+
+
+namespace bach_bot {
+
+void SongPosition::apply(const OrganMidiEvent &event)
+{
+    config = event.get_bank_config();
+    us = event.get_us().GetValue();
+    tick = event.m_midi_time;
+
+    NoteMessage message;
+    if (event.get_midi_message(message) != MIDI_MESSAGE_SIZE) {
+        return;
+    }
+
+    const auto command = (message[0] >> 4U);
+    const auto key = uint16_t((message[0] << 8U) | message[1]);
+    if ((MidiCommands::NOTE_ON == command) && (message[2] > 0U)) {
+        held[key] = message;
+    } else if ((MidiCommands::NOTE_ON == command) ||
+               (MidiCommands::NOTE_OFF == command)) {
+        const auto on_key = uint16_t(
+            (make_midi_command_byte(message[0] & 0x0FU,
+                                    MidiCommands::NOTE_ON) << 8U) |
+            message[1]);
+        held.erase(on_key);
+    }
+}
+
+
+SongIndex::SongIndex(const EventPool &events, const int ticks_per_measure) :
+    m_snapshots(),
+    m_ticks_per_measure{ticks_per_measure},
+    m_last_tick{0},
+    m_duration_us{0}
+{
+    SongPosition state{0U, 0, 0, BankConfig(), {}};
+    if (!events.empty()) {
+        state.config = events.front().get_bank_config();
+    }
+
+    m_snapshots.reserve(events.size() / SONG_INDEX_INTERVAL + 1U);
+    for (const auto &event: events) {
+        if (0U == (state.event_index % SONG_INDEX_INTERVAL)) {
+            m_snapshots.push_back(state);
+            m_snapshots.back().us = event.get_us().GetValue();
+            m_snapshots.back().tick = event.m_midi_time;
+        }
+        state.apply(event);
+        ++state.event_index;
+    }
+
+    m_last_tick = state.tick;
+    m_duration_us = state.us;
+}
+
+
+template <typename Predicate>
+SongPosition SongIndex::replay_to(const std::deque<OrganMidiEvent> &events,
+                                  const Predicate &before_target) const
+{
+    //  Snapshots (and events) are in time order, so "before the target" is
+    // true for a prefix of them.
+    auto snapshot = std::partition_point(
+        m_snapshots.begin(), m_snapshots.end(),
+        [&](const SongPosition &position) {
+            return (position.event_index < events.size()) &&
+                   before_target(position.event_index,
+                                 events[position.event_index]);
+        });
+    if (m_snapshots.begin() != snapshot) {
+        --snapshot;
+    }
+
+    auto state = *snapshot;
+    while ((state.event_index < events.size()) &&
+           before_target(state.event_index, events[state.event_index])) {
+        state.apply(events[state.event_index]);
+        ++state.event_index;
+    }
+
+    if (state.event_index < events.size()) {
+        state.us = events[state.event_index].get_us().GetValue();
+        state.tick = events[state.event_index].m_midi_time;
+    }
+    return state;
+}
+
+
+SongPosition SongIndex::get_position(const std::deque<OrganMidiEvent> &events,
+                                     const size_t event_index) const
+{
+    return replay_to(events, [=](const size_t index, const OrganMidiEvent &) {
+        return index < event_index;
+    });
+}
+
+
+SongPosition SongIndex::seek_us(const std::deque<OrganMidiEvent> &events,
+                                const int64_t us) const
+{
+    auto state = replay_to(events,
+                           [=](const size_t, const OrganMidiEvent &event) {
+        return event.get_us().GetValue() < us;
+    });
+
+    //  Resume exactly where asked (which may be in the middle of a rest).
+    state.us = std::max(int64_t(0), us);
+    return state;
+}
+
+
+SongPosition SongIndex::seek_measure(const std::deque<OrganMidiEvent> &events,
+                                     const int measure) const
+{
+    const auto tick = std::max(0, measure - 1) * m_ticks_per_measure;
+    return replay_to(events, [=](const size_t, const OrganMidiEvent &event) {
+        return event.m_midi_time < tick;
+    });
+}
+
+
+int SongIndex::get_measure_count() const
+{
+    if (!has_measures()) {
+        return 0;
+    }
+    return m_last_tick / m_ticks_per_measure + 1;
+}
+
+
+size_t SongIndex::get_memory_bytes() const
+{
+    //  Tree node: the value plus (typically) three links and a color word
+    constexpr const auto HELD_NODE_BYTES =
+        sizeof(std::map<uint16_t, SongPosition::NoteMessage>::value_type) +
+        4U * sizeof(void*);
+
+    auto bytes = sizeof(*this) +
+                 m_snapshots.capacity() * sizeof(SongPosition);
+    for (const auto &snapshot: m_snapshots) {
+        bytes += snapshot.held.size() * HELD_NODE_BYTES;
+    }
+    return bytes;
+}
+
+}  //  end bach_bot
@@ -0,0 +1,166 @@
+/**
+ * @file song_index.h
+ * @brief Song time index used for seeking
+ * @copyright
+ * 2022 Andrew Buettner (ABi)
+ *
+ * @section LICENSE
+ *
+ * BachBot - A hymn Midi player for Schlicker organs
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @section DESCRIPTION
+ * To start playing in the middle of a song the player needs to know which
+ * notes should already be sounding and which registration the organ should
+ * be on at that point.  Both depend on everything that came before, so the
+ * index stores a snapshot of that state every `SONG_INDEX_INTERVAL` events.
+ * A seek is a binary search of the snapshots followed by a replay of at most
+ * `SONG_INDEX_INTERVAL` events.
+ */
+
+#pragma once
+
+//  system includes
+#include <array>  //  std::array
+#include <cstdint>  //  uintXX_t, int64_t
+#include <deque>  //  std::deque
+#include <map>  //  std::map
+#include <vector>  //  std::vector
+
+//  module includes
+// -none-
+
+//  local includes
+#include "common_defs.h"  //  MIDI_MESSAGE_SIZE
+#include "organ_midi_event.h"  //  OrganMidiEvent, BankConfig
+#include "event_pool.h"  //  EventPool
+
+
+namespace bach_bot {
+
+/** Number of events between index snapshots */
+constexpr const auto SONG_INDEX_INTERVAL = 128U;
+
+/**
+ * @brief Player state at a point in a song.
+ */
+struct SongPosition
+{
+    using NoteMessage = std::array<uint8_t, MIDI_MESSAGE_SIZE>;
+
+    size_t event_index;  ///< next event to play
+    int64_t us;  ///< song time (microseconds)
+    int tick;  ///< song time (MIDI ticks)
+    BankConfig config;  ///< registration expected by the next event
+    /** Sounding notes: note-on message keyed by `(status << 8) | note` */
+    std::map<uint16_t, NoteMessage> held;
+
+    /**
+     * @brief Advance the state past an event.
+     * @param event event being played
+     */
+    void apply(const OrganMidiEvent &event);
+};
+
+
+/**
+ * @brief Sparse index of the state of a song over time.
+ * @note The index refers to events by position; seeks must be given the same
+ *       sequence of events (in the same order) as the index was built from.
+ */
+class SongIndex
+{
+public:
+    /**
+     * @brief Constructor - build the index.
+     * @param events compiled song events
+     * @param ticks_per_measure MIDI ticks per measure (0 if unknown)
+     */
+    SongIndex(const EventPool &events, const int ticks_per_measure);
+
+    /**
+     * @brief Get the state of the song just before an event is played.
+     * @param events song events
+     * @param event_index event
+     * @returns song state
+     */
+    SongPosition get_position(const std::deque<OrganMidiEvent> &events,
+                              const size_t event_index) const;
+
+    /**
+     * @brief Find the state of the song at a time.
+     * @param events song events
+     * @param us song time (microseconds)
+     * @returns song state, the next event is the first at or after `us`
+     */
+    SongPosition seek_us(const std::deque<OrganMidiEvent> &events,
+                         const int64_t us) const;
+
+    /**
+     * @brief Find the state of the song at the start of a measure.
+     * @param events song events
+     * @param measure measure number (from 1)
+     * @returns song state, positioned at the first event of the measure
+     * @note Requires `has_measures`.
+     */
+    SongPosition seek_measure(const std::deque<OrganMidiEvent> &events,
+                              const int measure) const;
+
+    /**
+     * @brief Test if measure numbers are known for this song.
+     */
+    bool has_measures() const
+    {
+        return m_ticks_per_measure > 0;
+    }
+
+    /**
+     * @brief Get the number of measures in the song
+     */
+    int get_measure_count() const;
+
+    /**
+     * @brief Get the time of the last event of the song
+     * @returns song duration (microseconds)
+     */
+    int64_t get_duration_us() const
+    {
+        return m_duration_us;
+    }
+
+    /**
+     * @brief Get the (approximate) memory held by the index
+     * @returns size (bytes)
+     */
+    size_t get_memory_bytes() const;
+
+private:
+    /**
+     * @brief Find the last snapshot before a point and replay to it.
+     * @param events song events
+     * @param before_target `true` while an event is before the target
+     * @returns song state at the first event not before the target
+     */
+    template <typename Predicate>
+    SongPosition replay_to(const std::deque<OrganMidiEvent> &events,
+                           const Predicate &before_target) const;
+
+    std::vector<SongPosition> m_snapshots;  ///< in event order
+    int m_ticks_per_measure;
+    int m_last_tick;
+    int64_t m_duration_us;
+};
+
+}  //  end bach_bot
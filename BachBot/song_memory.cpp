@@ -0,0 +1,221 @@
+/**
+ * @file song_memory.cpp
+ * @brief Memory budget for compiled playlist songs
+ * @copyright
+ * 2022 Andrew Buettner (ABi)
+ *
+ * @section LICENSE
+ *
+ * BachBot - A hymn Midi player for Schlicker organs
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+
+//  system includes
+#include <algorithm>  //  std::sort, std::clamp, std::any_of
+#include <map>  //  std::map
+#include <set>  //  std::set
+#include <utility>  //  std::move
+#include <wx/config.h>  //  wxConfigBase
+
+//  module includes
+// -none-
+
+//  local includes
+#include "song_memory.h"  //  local include
+#include "profile_zone.h"  //  BACHBOT_ZONE, BACHBOT_THREAD_NAME
+
+
+namespace {
+constexpr const auto BUDGET_KEY = wxT("/Memory/SongBudgetMB");
+
+/**
+ * @brief Get how readily a song is evicted.
+ * @param song song position
+ * @returns weighted distance from the playhead (larger is evicted first)
+ */
+size_t get_eviction_distance(const bach_bot::SongResidency &song)
+{
+    return song.behind ? (2U * song.distance) : song.distance;
+}
+}  //  end anonymous namespace
+
+
+namespace bach_bot {
+
+long load_song_memory_budget_mb()
+{
+    const auto *const config = wxConfigBase::Get();
+    auto budget_mb = DEFAULT_SONG_MEMORY_BUDGET_MB;
+    static_cast<void>(config->Read(BUDGET_KEY, &budget_mb,
+                                   DEFAULT_SONG_MEMORY_BUDGET_MB));
+    return std::clamp(budget_mb, 1L, MAX_SONG_MEMORY_BUDGET_MB);
+}
+
+
+void save_song_memory_budget_mb(const long budget_mb)
+{
+    auto *const config = wxConfigBase::Get();
+    static_cast<void>(config->Write(BUDGET_KEY, budget_mb));
+    static_cast<void>(config->Flush());
+}
+
+
+std::vector<uint32_t> select_songs_to_evict(std::vector<SongResidency> songs,
+                                            const size_t budget_bytes)
+{
+    std::map<const EventPool*, size_t> holders;  ///< resident entries
+    std::set<const EventPool*> pinned;  ///< songs that can't be freed
+    auto total_bytes = size_t(0U);
+    for (const auto &song: songs) {
+        if (nullptr == song.events) {
+            continue;
+        }
+        if (0U == holders[song.events]++) {
+            total_bytes += song.bytes;
+        }
+        if (song.pinned) {
+            static_cast<void>(pinned.insert(song.events));
+        }
+    }
+
+    std::vector<uint32_t> evict;
+    if (total_bytes <= budget_bytes) {
+        return evict;
+    }
+
+    std::sort(songs.begin(), songs.end(),
+              [](const SongResidency &a, const SongResidency &b) {
+        const auto distance_a = get_eviction_distance(a);
+        const auto distance_b = get_eviction_distance(b);
+        if (distance_a != distance_b) {
+            return distance_a > distance_b;
+        }
+        return a.bytes > b.bytes;
+    });
+
+    for (const auto &song: songs) {
+        if (total_bytes <= budget_bytes) {
+            break;
+        }
+        if ((nullptr != song.events) && (pinned.count(song.events) == 0U)) {
+            evict.push_back(song.song_id);
+            if (0U == --holders[song.events]) {
+                total_bytes -= song.bytes;
+            }
+        }
+    }
+    return evict;
+}
+
+
+SongReloader::SongReloader(CallBack on_loaded) :
+    m_on_loaded(std::move(on_loaded)),
+    m_mutex(),
+    m_wake(),
+    m_requests(),
+    m_loading_song_id{0U},
+    m_reload_again(),
+    m_stop{false},
+    m_worker()
+{
+    m_worker = std::thread(&SongReloader::reload_loop, this);
+}
+
+
+SongReloader::~SongReloader()
+{
+    stop();
+}
+
+
+void SongReloader::request(const PlayListEntry &song, const bool file_changed)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        const auto queued = std::any_of(
+            m_requests.begin(), m_requests.end(),
+            [&](const PlayListEntry &i) { return i.song_id == song.song_id; });
+        if (m_stop || queued) {
+            return;
+        }
+        if (song.song_id == m_loading_song_id) {
+            //  The import in progress may have read the old file
+            if (file_changed) {
+                m_reload_again = song;
+            }
+            return;
+        }
+        m_requests.push_back(song);
+    }
+    m_wake.notify_one();
+}
+
+
+void SongReloader::stop()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stop = true;
+        m_requests.clear();
+        m_reload_again.reset();
+    }
+    m_wake.notify_one();
+    if (m_worker.joinable()) {
+        m_worker.join();
+    }
+}
+
+
+void SongReloader::reload_loop()
+{
+    BACHBOT_THREAD_NAME("song reloader");
+    std::unique_lock<std::mutex> lock(m_mutex);
+    while (true) {
+        m_wake.wait(lock, [this] { return m_stop || !m_requests.empty(); });
+        if (m_stop) {
+            break;
+        }
+
+        auto song = std::move(m_requests.front());
+        m_requests.pop_front();
+        m_loading_song_id = song.song_id;
+        lock.unlock();
+
+        const auto generation = song.generation;
+        auto imported = false;
+        {
+            BACHBOT_ZONE("SongReloader::import_midi");
+            imported = song.import_midi();
+        }
+
+        lock.lock();
+        m_loading_song_id = 0U;
+        if (m_reload_again.has_value()) {
+            //  Only the import of the changed file is handed over: adopting
+            // this one would also make the newer request look stale.
+            m_requests.push_front(std::move(m_reload_again.value()));
+            m_reload_again.reset();
+            continue;
+        }
+        lock.unlock();
+
+        m_on_loaded(std::move(song), generation, imported);
+        lock.lock();
+    }
+}
+
+}  //  end bach_bot
@@ -0,0 +1,174 @@
+/**
+ * @file song_memory.h
+ * @brief Memory budget for compiled playlist songs
+ * @copyright
+ * 2022 Andrew Buettner (ABi)
+ *
+ * @section LICENSE
+ *
+ * BachBot - A hymn Midi player for Schlicker organs
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @section DESCRIPTION
+ * Every playlist entry normally keeps its compiled events for the life of the
+ * playlist.  A library-style playlist of hundreds of songs does not fit on a
+ * low memory console machine, so songs far from the playhead are evicted
+ * down to their configuration once the total exceeds the configured budget.
+ *
+ * Songs coming up within `SONG_PREFETCH_DISTANCE` entries of the playhead are
+ * re-imported ahead of time by a background `SongReloader`.  A song that is
+ * still evicted when it is chosen to play next (or started) is re-imported
+ * on the spot, so the player is never left without a next song.  The same
+ * reloader picks up changes made to a song's file on disk.  Songs loaded
+ * from a service bundle are never evicted, as their MIDI files need not
+ * exist on this machine.
+ */
+
+#pragma once
+
+//  system includes
+#include <condition_variable>  //  std::condition_variable
+#include <cstdint>  //  uint32_t
+#include <deque>  //  std::deque
+#include <functional>  //  std::function
+#include <mutex>  //  std::mutex
+#include <optional>  //  std::optional
+#include <thread>  //  std::thread
+#include <vector>  //  std::vector
+
+//  module includes
+// -none-
+
+//  local includes
+#include "play_list.h"  //  PlayListEntry
+
+
+namespace bach_bot {
+
+/** Budget used until one is configured (MB) */
+constexpr const auto DEFAULT_SONG_MEMORY_BUDGET_MB = 64L;
+
+/** Largest budget that may be configured (MB) */
+constexpr const auto MAX_SONG_MEMORY_BUDGET_MB = 4096L;
+
+/** Songs this many entries ahead of the playhead are kept loaded */
+constexpr const auto SONG_PREFETCH_DISTANCE = 2U;
+
+/**
+ * @brief Position and size of a playlist entry for eviction decisions.
+ */
+struct SongResidency
+{
+    uint32_t song_id;
+    size_t distance;  ///< number of entries from the playhead
+    bool behind;  ///< before the playhead (already played)
+    /** playing, next, about to be or from a bundle (never evicted) */
+    bool pinned;
+    /** compiled song (shared by identical entries), `nullptr` if evicted */
+    const EventPool *events;
+    size_t bytes;  ///< memory held by `events`
+};
+
+
+/**
+ * @brief Load the song memory budget.
+ * @returns budget (MB)
+ */
+long load_song_memory_budget_mb();
+
+/**
+ * @brief Store the song memory budget.
+ * @param budget_mb budget (MB)
+ */
+void save_song_memory_budget_mb(const long budget_mb);
+
+/**
+ * @brief Choose the songs to evict to bring memory use within a budget.
+ * @param songs every entry in the playlist
+ * @param budget_bytes memory budget (bytes)
+ * @returns song IDs to evict, furthest from the playhead first
+ * @note Songs already played count as twice as far away as songs still to
+ *       come.  Pinned songs are never chosen, so the budget can be exceeded
+ *       when those alone do not fit.  A shared song counts once and is
+ *       only freed by evicting every entry sharing it.
+ */
+std::vector<uint32_t> select_songs_to_evict(std::vector<SongResidency> songs,
+                                            const size_t budget_bytes);
+
+
+/**
+ * @brief Re-imports evicted or changed songs on a background thread.
+ */
+class SongReloader
+{
+    /**
+     * @brief Callback function format for re-imported songs
+     * @note Called from the reload thread.
+     */
+    using CallBack = std::function<void(PlayListEntry /* loaded */,
+                                        uint32_t /* generation */,
+                                        bool /* imported */)>;
+
+public:
+    /**
+     * @brief Constructor - start the reload thread.
+     * @param on_loaded called with each re-imported song, the generation
+     *        of the entry it was copied from and whether the import worked
+     */
+    explicit SongReloader(CallBack on_loaded);
+
+    /**
+     * @brief Destructor - abandon outstanding requests.
+     */
+    ~SongReloader();
+
+    SongReloader(const SongReloader &) = delete;
+    SongReloader &operator=(const SongReloader &) = delete;
+
+    /**
+     * @brief Queue a song for re-import.
+     * @param song playlist entry (only the configuration is used)
+     * @param file_changed the song's file changed since it was last imported
+     * @note Ignored if the song is already queued.  If it is being
+     *       re-imported, a changed file is imported again once that
+     *       finishes (and the earlier result, which may predate the change,
+     *       is dropped); otherwise the request is ignored.
+     */
+    void request(const PlayListEntry &song, const bool file_changed=false);
+
+    /**
+     * @brief Stop the reload thread, abandoning outstanding requests.
+     * @note Waits for a re-import in progress to complete.
+     */
+    void stop();
+
+private:
+    /**
+     * @brief Reload thread function
+     */
+    void reload_loop();
+
+    CallBack m_on_loaded;
+    std::mutex m_mutex;  ///< protects the members below
+    std::condition_variable m_wake;
+    std::deque<PlayListEntry> m_requests;
+    uint32_t m_loading_song_id;  ///< 0 when idle
+    /** Request for `m_loading_song_id` made after its file changed again */
+    std::optional<PlayListEntry> m_reload_again;
+    bool m_stop;
+    std::thread m_worker;
+};
+
+}  //  end bach_bot
@@ -0,0 +1,164 @@
+/**
+ * @file startup_profiler.cpp
+ * @brief Application start-up phase timing
+ * @copyright
+ * 2022 Andrew Buettner (ABi)
+ *
+ * @section LICENSE
+ *
+ * BachBot - A hymn Midi player for Schlicker organs
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+//  system includes
+#include <fmt/format.h>  //  fmt::format
+#include <wx/datetime.h>  //  wxDateTime
+#include <wx/ffile.h>  //  wxFFile
+#include <wx/filename.h>  //  wxFileName
+#include <wx/stdpaths.h>  //  wxStandardPaths
+
+//  module includes
+// -none-
+
+//  local includes
+#include "startup_profiler.h"  //  local include
+
+
+namespace {
+    constexpr const auto LOG_FILE_NAME = L"startup.log";
+
+    double to_ms(const wxLongLong &us)
+    {
+        return us.ToDouble() / 1000.0;
+    }
+
+    wxString format_phase(const wxString &name, const wxLongLong &start_us,
+                          const wxLongLong &duration_us, const bool background)
+    {
+        return fmt::format(L"  {:<28} {:8.1f} ms{}\n", name.ToStdWstring(),
+                           to_ms(duration_us),
+                           background ? fmt::format(
+                               L"  (background, done at {:.1f} ms)",
+                               to_ms(start_us)) : std::wstring());
+    }
+}  //  end anonymous namespace
+
+
+namespace bach_bot {
+
+StartupProfiler &StartupProfiler::get()
+{
+    static StartupProfiler profiler;
+    return profiler;
+}
+
+
+StartupProfiler::StartupProfiler() :
+    m_timer(),
+    m_last_mark_us{0},
+    m_phases(),
+    m_total_us()
+{
+}
+
+
+void StartupProfiler::mark(const wxString &phase)
+{
+    const auto now = m_timer.TimeInMicro();
+    m_phases.push_back({phase, m_last_mark_us, now - m_last_mark_us, false});
+    m_last_mark_us = now;
+}
+
+
+void StartupProfiler::add_background(const wxString &phase,
+                                     const wxLongLong duration_us)
+{
+    m_phases.push_back({phase, m_timer.TimeInMicro(), duration_us, true});
+    if (m_total_us.has_value()) {
+        //  Arrived after the window became usable, log it on its own.
+        wxLogVerbose(wxT("%s"), format_phase(phase, m_phases.back().start_us,
+                                             duration_us, true));
+    }
+}
+
+
+void StartupProfiler::finish()
+{
+    if (m_total_us.has_value()) {
+        return;
+    }
+
+    m_total_us = m_timer.TimeInMicro();
+    if (*m_total_us > m_last_mark_us) {
+        m_phases.push_back({wxT("event loop start"), m_last_mark_us,
+                            *m_total_us - m_last_mark_us, false});
+        m_last_mark_us = *m_total_us;
+    }
+
+    if (*m_total_us > STARTUP_TARGET_MS * 1000L) {
+        wxLogVerbose(wxT("Start-up took %.1f ms, target is %ld ms"),
+                     to_ms(*m_total_us), STARTUP_TARGET_MS);
+    }
+    write_log();
+}
+
+
+std::optional<long> StartupProfiler::get_total_ms() const
+{
+    if (!m_total_us.has_value()) {
+        return std::nullopt;
+    }
+    return long(m_total_us->GetValue() / 1000);
+}
+
+
+wxString StartupProfiler::get_report() const
+{
+    wxString report;
+    if (m_total_us.has_value()) {
+        const auto exceeded = (*m_total_us > STARTUP_TARGET_MS * 1000L);
+        report += fmt::format(L"Start-up: {:.1f} ms (target {} ms{})\n\n",
+                              to_ms(*m_total_us), STARTUP_TARGET_MS,
+                              exceeded ? L", EXCEEDED" : L"");
+    } else {
+        report += wxT("Start-up still in progress\n\n");
+    }
+
+    for (const auto &phase : m_phases) {
+        report += format_phase(phase.name, phase.start_us, phase.duration_us,
+                               phase.background);
+    }
+    return report;
+}
+
+
+void StartupProfiler::write_log() const
+{
+    //  A missing or read-only profile directory is not worth a pop-up.
+    wxLogNull no_log;
+    const auto dir = wxStandardPaths::Get().GetUserLocalDataDir();
+    if (!wxFileName::Mkdir(dir, wxS_DIR_DEFAULT, wxPATH_MKDIR_FULL)) {
+        return;
+    }
+
+    wxFFile log_file(wxFileName(dir, LOG_FILE_NAME).GetFullPath(), "a");
+    if (log_file.IsOpened()) {
+        static_cast<void>(log_file.Write(
+            wxDateTime::Now().FormatISOCombined(' ') + wxT(" ") +
+            get_report() + wxT("\n")));
+    }
+}
+
+}  //  end bach_bot
@@ -0,0 +1,123 @@
+/**
+ * @file startup_profiler.h
+ * @brief Application start-up phase timing
+ * @copyright
+ * 2022 Andrew Buettner (ABi)
+ *
+ * @section LICENSE
+ *
+ * BachBot - A hymn Midi player for Schlicker organs
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @section DESCRIPTION
+ * The application is relaunched between services, so the time from
+ * `OnInit` to a usable window matters.  The profiler records how long each
+ * start-up phase took on the UI thread ("critical path") as well as work that
+ * was moved to the background (port enumeration, image decode) so that the
+ * effect of each phase can be seen.  The report is appended to a log file in
+ * the user's local data directory and can be displayed from the Help menu.
+ */
+
+#pragma once
+
+//  system includes
+#include <vector>  //  std::vector
+#include <optional>  //  std::optional
+#include <wx/wx.h>  //  wxString, wxStopWatch, wxLongLong
+
+//  module includes
+// -none-
+
+//  local includes
+// -none-
+
+
+namespace bach_bot {
+
+/** Start-up time (`OnInit` to first idle) that we are trying to stay under */
+constexpr const auto STARTUP_TARGET_MS = 500L;
+
+/**
+ * @brief Records the duration of each application start-up phase.
+ * @note All methods must be called from the UI thread.  Background work
+ *       should measure its own duration and report it with `add_background`
+ *       through `CallAfter`.
+ */
+class StartupProfiler
+{
+public:
+    /**
+     * @brief Get the application-wide profiler instance.
+     */
+    static StartupProfiler &get();
+
+    /**
+     * @brief End the current critical path phase and start the next one.
+     * @param phase name of the phase that just completed
+     */
+    void mark(const wxString &phase);
+
+    /**
+     * @brief Record a phase that ran off of the critical path.
+     * @param phase name of the phase
+     * @param duration_us time the phase took (microseconds)
+     */
+    void add_background(const wxString &phase, const wxLongLong duration_us);
+
+    /**
+     * @brief Stop the start-up timer and write the report to the log file.
+     * @note Subsequent calls are ignored.
+     */
+    void finish();
+
+    /**
+     * @brief Get the total start-up time
+     * @returns time in milliseconds
+     * @retval std::nullopt start-up has not finished yet
+     */
+    std::optional<long> get_total_ms() const;
+
+    /**
+     * @brief Format the phase timings as human readable text.
+     * @returns multi-line report
+     */
+    wxString get_report() const;
+
+private:
+    /**
+     * @brief Single recorded phase
+     */
+    struct Phase
+    {
+        wxString name;  ///< phase name
+        wxLongLong start_us;  ///< time since start-up the phase was recorded
+        wxLongLong duration_us;  ///< length of the phase
+        bool background;  ///< `true` if phase was not on the critical path
+    };
+
+    StartupProfiler();
+
+    /**
+     * @brief Append the report to the start-up log file.
+     */
+    void write_log() const;
+
+    wxStopWatch m_timer;  ///< started on first use (ie start of `OnInit`)
+    wxLongLong m_last_mark_us;  ///< end of the previous critical path phase
+    std::vector<Phase> m_phases;  ///< recorded phases in completion order
+    std::optional<wxLongLong> m_total_us;  ///< set by `finish`
+};
+
+}  //  end bach_bot
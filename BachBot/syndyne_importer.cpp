@@ -25,17 +25,23 @@
 
 //  system includes
 #include <limits>  //  std::numeric_limits
-#include <algorithm>  //  std::clamp, std::for_each
+#include <algorithm>  //  std::clamp, std::min, std::stable_sort
 #include <array>  //  std::array
-#include <utility>  //  std::pair
+#include <utility>  //  std::pair, std::move
 #include <stdexcept>   //  std::runtime_error, std::out_of_range
 #include <fmt/format.h>  //  fmt::format
+#ifdef _WIN32
+#include <filesystem>  //  std::filesystem::u8path
+#include <fstream>  //  std::ifstream
+#endif
 
 //  module includes
 // -none-
 
 //  local includes
 #include "syndyne_importer.h"  //  local include
+#include "transposer.h"  //  fold_to_keyboard
+#include "profile_zone.h"  //  BACHBOT_ZONE
 
 
 namespace {
@@ -166,6 +172,27 @@ double generate_test_pattern(const SyndyneKeyboards keyboard,
     return start_time;
 }
 
+/**
+ * @brief Convert a MIDI library event into the importer's event type.
+ * @param midi_event library event (after time analysis)
+ * @returns timed event
+ */
+bach_bot::SmfEvent to_smf_event(const smf::MidiEvent &midi_event)
+{
+    bach_bot::SmfEvent event{midi_event.tick, midi_event.seconds,
+                             0U, 0U, 0U, uint8_t(midi_event.size())};
+    if (midi_event.size() > 0U) {
+        event.status = midi_event[0];
+    }
+    if (midi_event.size() > 1U) {
+        event.byte1 = midi_event[1];
+    }
+    if (midi_event.size() > 2U) {
+        event.byte2 = midi_event[2];
+    }
+    return event;
+}
+
 }  //  end anonymous namespace
 
 
@@ -187,9 +214,71 @@ std::deque<OrganMidiEvent> generate_test_pattern()
 }
 
 
+std::deque<OrganMidiEvent> generate_pulse_pattern(size_t count,
+                                                  const double spacing_s)
+{
+    count = std::min(count, MAX_LATENCY_PULSES);
+
+    std::deque<OrganMidiEvent> event_queue;
+    auto midi_time = 0.0;
+    for (auto i = 0U; i < count; ++i) {
+        event_queue.emplace_back(MidiCommands::CONTROL_CHANGE,
+                                 SyndyneKeyboards(LATENCY_PULSE_CHANNEL),
+                                 int8_t(LATENCY_PULSE_CONTROLLER), int8_t(i));
+        event_queue.back().m_seconds = midi_time;
+        event_queue.back().m_song_id = 0U;
+        midi_time += spacing_s;
+    }
+
+    return event_queue;
+}
+
+
+ParsedMidiFile::ParsedMidiFile(const std::string &file_name,
+                               const MidiFileParser file_parser) :
+    midifile(),
+    reader(),
+    parser{file_parser}
+{
+    BACHBOT_ZONE("ParsedMidiFile");
+    if (MidiFileParser::NATIVE_STREAM_PARSER == parser) {
+        try {
+            reader = std::make_unique<SmfReader>(file_name);
+        } catch (const std::runtime_error &) {
+            //  Same outcome as a failed `smf::MidiFile::read`: no events.
+            reader.reset();
+        }
+    } else {
+#ifdef _WIN32
+        //  The library opens names in the ANSI code page.
+        std::ifstream input(std::filesystem::u8path(file_name),
+                            std::ios::binary);
+        midifile.read(input);
+#else
+        midifile.read(file_name);
+#endif
+        midifile.doTimeAnalysis();
+        midifile.joinTracks();
+    }
+}
+
+
 SyndineImporter::SyndineImporter(const std::string &file_name,
+                                 const uint32_t song_id,
+                                 const MidiFileParser parser) :
+    SyndineImporter(std::make_shared<const ParsedMidiFile>(file_name, parser),
+                    song_id)
+{
+}
+
+
+SyndineImporter::SyndineImporter(std::shared_ptr<const ParsedMidiFile> file,
                                  const uint32_t song_id) :
-    m_midifile(),
+    m_file(std::move(file)),
+    m_midifile(m_file->midifile),
+    m_reader(m_file->reader.get()),
+    m_parser{m_file->parser},
+    m_pool(),
     m_file_events(),
     m_current_state(),
     m_song_id{song_id},
@@ -200,11 +289,6 @@ SyndineImporter::SyndineImporter(const std::string &file_name,
     m_note_offset{0},
     m_drum_map()
 {
-    m_midifile.read(file_name);
-    m_midifile.doTimeAnalysis();
-    m_midifile.linkNotePairs();
-    m_midifile.joinTracks();
-
     for (auto i = 0U; i < m_current_state.size(); ++i) {
         const auto keyboard_id = g_keyboard_indexes[i];
         for (auto j = 0U; j < m_current_state[i].size(); ++j) {
@@ -270,20 +354,7 @@ size_t SyndineImporter::get_control_index(const int channel) const
 uint8_t SyndineImporter::remap_note(const int note,
                                     const SyndyneKeyboards keyboard) const
 {
-    uint8_t low_limit = 36U;  //  Standard range of organ keys.
-    uint8_t high_limit = 96U;
-    if (SyndyneKeyboards::PETAL == keyboard) {
-        high_limit = 67U;  //  Petal only goes up to G above middle-C
-    }
-
-    auto mapped_note = uint8_t(note + m_note_offset);
-    while (mapped_note < low_limit) {
-        mapped_note += MIDI_NOTES_IN_OCTAVE;  //  Bump 1 octave
-    }
-    while (mapped_note > high_limit) {
-        mapped_note -= MIDI_NOTES_IN_OCTAVE;  //  Bump 1 octave down
-    }
-    return mapped_note;
+    return fold_to_keyboard(note + m_note_offset, keyboard);
 }
 
 
@@ -324,35 +395,58 @@ void SyndineImporter::update_bank_event(const int note)
 }
 
 
-void SyndineImporter::build_syndyne_sequence(const smf::MidiEventList &event_list)
+void SyndineImporter::add_midi_event(SmfEvent midi_event,
+                                     std::vector<EventIndex> &events)
+{
+    midi_event.seconds *= m_time_scaling_factor;
+    if (midi_event.is_note()) {
+        const auto channel_id = get_control_index(midi_event.get_channel());
+        if (channel_id < m_current_state.size()) {
+            const auto note = remap_note(midi_event.byte1,
+                                         g_keyboard_indexes[channel_id]);
+            midi_event.byte1 = note;
+            m_current_state[channel_id][note].add_event(midi_event, m_pool);
+        } else if (midi_event.is_note_on()) {
+            //  Treat as control event
+            update_bank_event(midi_event.byte1);
+            events.push_back(m_pool.emplace(midi_event, m_current_config));
+        }
+    }
+}
+
+
+void SyndineImporter::build_syndyne_sequence()
 {
-    std::list<OrganNote> events;
+    BACHBOT_ZONE("build_syndyne_sequence");
+    std::vector<EventIndex> events;
     auto current_config = m_current_config;
+    m_pool.clear();
     m_file_events.clear();
 
     //  1st pass: Process all events
-    for (auto i = 0; i < event_list.size(); ++i) {
-        auto midi_event = event_list[i];
-        midi_event.seconds *= m_time_scaling_factor;
-        if (midi_event.isNote()) {
-            const auto channel_id = get_control_index(midi_event.getChannel());
-            if (channel_id < m_current_state.size()) {
-                const auto note = remap_note(midi_event.getKeyNumber(),
-                                             g_keyboard_indexes[channel_id]);
-                midi_event[1] = note;
-                m_current_state[channel_id][note].add_event(midi_event);
-            } else if (midi_event.isNoteOn()) {
-                //  Treat as control event
-                update_bank_event(midi_event.getKeyNumber());
-                events.emplace_back(new OrganMidiEvent(midi_event, m_current_config));
+    {
+        BACHBOT_ZONE("import: track notes");
+        if (nullptr != m_reader) {
+            m_reader->for_each_event([&](const SmfEvent &midi_event) {
+                add_midi_event(midi_event, events);
+            });
+        } else if (MidiFileParser::SMF_LIBRARY_PARSER == m_parser) {
+            const auto &event_list = m_midifile[0];
+            m_pool.reserve(size_t(event_list.size()));
+            for (auto i = 0; i < event_list.size(); ++i) {
+                add_midi_event(to_smf_event(event_list[i]), events);
             }
         }
     }
 
     //  2nd pass: append all de-duplicated events
-    for (const auto &i: m_current_state) {
-        for (const auto &j: i) {
-            j.append_events(events);
+    {
+        BACHBOT_ZONE("import: append notes");
+        events.reserve(m_pool.size() + 2U);
+        for (const auto &i: m_current_state) {
+            for (const auto &j: i) {
+                j.append_events(m_pool, events);
+            }
         }
     }
     if (events.size() == 0U) {
@@ -360,28 +454,40 @@ void SyndineImporter::build_syndyne_sequence(const smf::MidiEventList &event_lis
         return;
     }
 
-    //  3rd pass: sort by time
-    events.sort();
+    //  3rd pass: sort by time (stable, simultaneous events keep their order)
+    {
+        BACHBOT_ZONE("import: sort");
+        std::stable_sort(events.begin(), events.end(),
+                         [this](const EventIndex lhs, const EventIndex rhs) {
+            return m_pool[lhs] < m_pool[rhs];
+        });
+    }
 
     //  4th pass: update bank config, build output events
-    for (auto &i: events) {
-        if (i->is_mode_change_event()) {
-            current_config = i->get_bank_config();
-        } else {
-            i->set_bank_config(current_config);
+    {
+        BACHBOT_ZONE("import: bank config");
+        for (const auto i: events) {
+            auto &event = m_pool[i];
+            if (event.is_mode_change_event()) {
+                current_config = event.get_bank_config();
+            } else {
+                event.set_bank_config(current_config);
+            }
         }
-        m_file_events.push_back(i);
     }
+    m_file_events = std::move(events);
 
     //  5th pass: remove start dead time from song, assign song id
-    auto last_element =  m_file_events.front();
+    BACHBOT_ZONE("import: offset times");
+    const auto *last_element = &m_pool[m_file_events.front()];
     const auto initial_delay_s = last_element->m_seconds;
     const auto initial_delay_ticks = last_element->m_midi_time;
-    for (auto &i: m_file_events) {
-        i->m_song_id = m_song_id;
-        i->offset_time(initial_delay_s, initial_delay_ticks);
-        i->calculate_delta(*last_element);
-        last_element = i;
+    for (const auto i: m_file_events) {
+        auto &event = m_pool[i];
+        event.m_song_id = m_song_id;
+        event.offset_time(initial_delay_s, initial_delay_ticks);
+        event.calculate_delta(*last_element);
+        last_element = &event;
     }
 }
 
@@ -396,7 +502,13 @@ void SyndineImporter::adjust_key(int offset_steps)
 
 std::optional<int> SyndineImporter::get_tempo()
 {
-    if (!m_tempo_detected.has_value()) {
+    if (!m_tempo_detected.has_value() && (nullptr != m_reader)) {
+        m_tempo_detected = m_reader->get_tempo_bpm();
+        if (m_tempo_detected.has_value()) {
+            m_bpm = int(m_tempo_detected.value() + 0.5);
+        }
+    } else if (!m_tempo_detected.has_value() &&
+               (MidiFileParser::SMF_LIBRARY_PARSER == m_parser)) {
         for (auto i = 0; i < m_midifile[0].size(); ++i) {
             const auto &evt = m_midifile[0][i];
             if (evt.isTempo()) {
@@ -417,10 +529,37 @@ std::optional<int> SyndineImporter::get_tempo()
 }
 
 
-std::list<OrganNote> SyndineImporter::get_events(
+int SyndineImporter::get_ticks_per_measure() const
+{
+    if (nullptr != m_reader) {
+        return m_reader->get_ticks_per_measure();
+    } else if (MidiFileParser::NATIVE_STREAM_PARSER == m_parser) {
+        return 0;
+    }
+
+    const auto ticks_per_quarter = m_midifile.getTicksPerQuarterNote();
+    for (auto i = 0; i < m_midifile[0].size(); ++i) {
+        const auto &evt = m_midifile[0][i];
+        if (evt.isTimeSignature()) {
+            //  FF 58 04 nn dd cc bb; dd is a power of 2
+            const auto ticks_per_beat = (4 * ticks_per_quarter) >>
+                                        std::min(int(evt[4]), 6);
+            return int(evt[3]) * ticks_per_beat;
+        }
+    }
+
+    return 4 * ticks_per_quarter;
+}
+
+
+EventPool SyndineImporter::get_events(
     const double initial_delay_beats, const double extend_final_duration)
 {
-    build_syndyne_sequence(m_midifile[0]);
+    BACHBOT_ZONE("get_events");
+    build_syndyne_sequence();
+    if (m_file_events.empty()) {
+        throw std::out_of_range("Parsed events < 2");
+    }
 
     if (initial_delay_beats > 0.0) {
         if (!m_tempo_detected.has_value()) {
@@ -428,43 +567,45 @@ std::list<OrganNote> SyndineImporter::get_events(
         }
         const auto spb = 60.0 / double(m_bpm);  //  Seconds/beat
         const auto initial_delay = spb * initial_delay_beats;
-        auto first_entry = m_file_events.front();
-        OrganNote blank_note(new OrganMidiEvent(EMPTY_FIRST_META_EVENT,
-                                                first_entry.get()));
-        first_entry->m_delta_time = initial_delay;
-        std::for_each(m_file_events.begin(),
-                      m_file_events.end(),
-                      [=](OrganNote &evt) {
-            evt->m_seconds += spb * initial_delay_beats;
-        });
-        m_file_events.push_front(blank_note);
+        const auto first_entry = m_pool[m_file_events.front()];
+        const auto blank_note = m_pool.emplace(EMPTY_FIRST_META_EVENT,
+                                               &first_entry);
+        m_pool[m_file_events.front()].m_delta_time = initial_delay;
+        for (const auto i: m_file_events) {
+            m_pool[i].m_seconds += spb * initial_delay_beats;
+        }
+        m_file_events.insert(m_file_events.begin(), blank_note);
     }
 
     if (m_file_events.size() < 2) {
         throw std::out_of_range("Parsed events < 2");
     }
 
-    for (auto i = m_file_events.rbegin(); m_file_events.rend() != i; ++i) {
-        if ((*i)->m_delta > 0) {
-            (*i)->m_delta_time *= extend_final_duration;
+    for (auto i = m_file_events.size() - 1U; i > 0U; --i) {
+        if (m_pool[m_file_events[i]].m_delta > 0) {
+            m_pool[m_file_events[i]].m_delta_time *= extend_final_duration;
             //  Find last non-zero delta midi time MIDI event
-            ++i;
-            auto meta_event = OrganNote(
-                new OrganMidiEvent(LAST_NOTE_META_CODE, i->get()));
-            meta_event->m_delta_time = 0.0;
-            m_file_events.insert(i.base(), meta_event);
-            ++i;
-            auto next_event_time = (*i)->m_seconds;
-            do {
-                --i;
-                next_event_time += (*i)->m_delta_time;
-                (*i)->m_seconds = next_event_time;
-            } while (m_file_events.rbegin() != i);
+            const auto last_note = m_pool[m_file_events[i - 1U]];
+            const auto meta_event = m_pool.emplace(LAST_NOTE_META_CODE,
+                                                   &last_note);
+            m_pool[meta_event].m_delta_time = 0.0;
+            m_file_events.insert(m_file_events.begin() + ptrdiff_t(i),
+                                 meta_event);
+            auto next_event_time = last_note.m_seconds;
+            for (; i < m_file_events.size(); ++i) {
+                auto &event = m_pool[m_file_events[i]];
+                next_event_time += event.m_delta_time;
+                event.m_seconds = next_event_time;
+            }
             break;
         }
     }
 
-    return std::move(m_file_events);
+    //  Pack the song into play order, leaving behind the events that the
+    // note trackers dropped.
+    auto events = m_pool.reorder(m_file_events);
+    m_file_events.clear();
+    return events;
 }
 
 }
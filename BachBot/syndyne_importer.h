@@ -39,23 +39,85 @@
 #include <cstdint>
 #include <string>  //  std::string
 #include <optional>  //  std::optional
-#include <list>  //  std::list
 #include <deque>  //  std::deque
+#include <vector>  //  std::vector
+#include <memory>  //  std::unique_ptr
 #include <unordered_map>  //  std::unordered_map
 
 //  local includes
 #include "midi_note_tracker.h"  //  MidiNoteTracker
 #include "organ_midi_event.h"  //  OrganMidiEvent
+#include "event_pool.h"  //  EventPool, EventIndex
 #include "common_defs.h"  //  MIDI Event definitions
 #include "midi_interface.h"  //  smf::MidiFile
+#include "smf_reader.h"  //  SmfReader, SmfEvent
 
 namespace bach_bot {
 
+/**
+ * @brief Parser used to read the MIDI file.
+ */
+enum MidiFileParser : uint8_t
+{
+    SMF_LIBRARY_PARSER = 0U,  ///< smf::MidiFile (full in-memory copy)
+    NATIVE_STREAM_PARSER  ///< SmfReader (memory mapped, streamed)
+};
+
+/** Parser used when one isn't explicitly requested. */
+#ifdef BACHBOT_NATIVE_SMF_PARSER
+constexpr const auto DEFAULT_MIDI_FILE_PARSER =
+    MidiFileParser::NATIVE_STREAM_PARSER;
+#else
+constexpr const auto DEFAULT_MIDI_FILE_PARSER =
+    MidiFileParser::SMF_LIBRARY_PARSER;
+#endif
+
 /**
  * @brief Generate the test pattern as a sequence to be played.
  */
 std::deque<OrganMidiEvent> generate_test_pattern();
 
+/** Undefined controller number, ignored by the console */
+constexpr const uint8_t LATENCY_PULSE_CONTROLLER = 0x66U;
+
+/** Pulses are sent on the last channel, which is never used for a keyboard */
+constexpr const uint8_t LATENCY_PULSE_CHANNEL = 15U;
+
+/** Largest pulse train; the controller value identifies each pulse */
+constexpr const size_t MAX_LATENCY_PULSES = 128U;
+
+/**
+ * @brief Generate an evenly spaced train of latency measurement pulses.
+ * @param count number of pulses (clamped to `MAX_LATENCY_PULSES`)
+ * @param spacing_s time between pulses (seconds)
+ * @returns control changes to `LATENCY_PULSE_CONTROLLER` whose value is the
+ *          pulse number, timed from 0.0 seconds
+ */
+std::deque<OrganMidiEvent> generate_pulse_pattern(size_t count,
+                                                  const double spacing_s);
+
+
+/**
+ * @brief MIDI file as read from disk, before any import transforms.
+ * @note Never modified once read, so one file may be shared by any number of
+ *       importers (with different import parameters).
+ */
+struct ParsedMidiFile
+{
+    /**
+     * @brief Constructor - read the file
+     * @param file_name read midi data from file path (UTF-8)
+     * @param file_parser MIDI file parser to use
+     * @note A file that can't be read results in an importer with no events.
+     */
+    ParsedMidiFile(const std::string &file_name,
+                   const MidiFileParser file_parser);
+
+    smf::MidiFile midifile;  ///< parsed midi events (library parser)
+    std::unique_ptr<SmfReader> reader;  ///< streaming reader (native parser)
+    const MidiFileParser parser;  ///< parser used to read the file
+};
+
 
 /**
  * @brief Class that contains all logic to translate a MIDI file into an
@@ -66,10 +128,21 @@ class SyndineImporter
 public:
     /**
      * @brief Constructor
-     * @param file_name read midi data from file path
+     * @param file_name read midi data from file path (UTF-8)
+     * @param song_id assign song ID to events
+     * @param parser MIDI file parser to use
+     */
+    SyndineImporter(const std::string &file_name,
+                    const uint32_t song_id,
+                    const MidiFileParser parser=DEFAULT_MIDI_FILE_PARSER);
+
+    /**
+     * @brief Constructor - import an already read file
+     * @param file parsed MIDI file (shared, not modified)
      * @param song_id assign song ID to events
      */
-    SyndineImporter(const std::string &file_name, const uint32_t song_id);
+    SyndineImporter(std::shared_ptr<const ParsedMidiFile> file,
+                    const uint32_t song_id);
 
     /**
      * @brief Adjust the tempo to increase / decrease playback speed
@@ -100,6 +173,14 @@ public:
      */
     std::optional<int> get_tempo();
 
+    /**
+     * @brief Get the length of a measure from the first time signature of the
+     *        song (4/4 if the song doesn't have one).
+     * @returns MIDI ticks per measure
+     * @retval 0 measure length is unknown
+     */
+    int get_ticks_per_measure() const;
+
     /**
      * @brief Get the sequence of timed organ midi events from song.
      * @param initial_delay_beats a number of empty "rest" beats before first
@@ -108,10 +189,10 @@ public:
      *                              on duration by this value to extend the
      *                              final chord.
      * @throws std::out_of_range when the resulting song has too few events.
-     * @returns timed event list to send to player
+     * @returns timed events to send to player, in play order
      */
-    std::list<OrganNote> get_events(const double initial_delay_beats,
-                                    const double extend_final_duration);
+    EventPool get_events(const double initial_delay_beats,
+                         const double extend_final_duration);
 
 private:
     /**
@@ -140,13 +221,25 @@ private:
     void update_bank_event(const int note);
 
     /**
-    * @brief Logic to build an appropriate midi sequence to send to the organ
-    * @param value message to send
+    * @brief Route a single timed MIDI event to the note trackers (or the
+    *        bank control logic).
+    * @param midi_event event to process
+    * @param[in/out] events control events are appended here
     */
-    void build_syndyne_sequence(const smf::MidiEventList &event_list);
+    void add_midi_event(SmfEvent midi_event,
+                        std::vector<EventIndex> &events);
 
-    smf::MidiFile m_midifile;  ///< parsed midi events
-    std::list<OrganNote> m_file_events;  ///< intermediate events
+    /**
+    * @brief Logic to build an appropriate midi sequence to send to the organ
+    */
+    void build_syndyne_sequence();
+
+    std::shared_ptr<const ParsedMidiFile> m_file;  ///< file being imported
+    const smf::MidiFile &m_midifile;  ///< `m_file` library parser events
+    const SmfReader *const m_reader;  ///< `m_file` streaming reader
+    const MidiFileParser m_parser;  ///< parser used to read the file
+    EventPool m_pool;  ///< storage of every event created by the import
+    std::vector<EventIndex> m_file_events;  ///< intermediate events
     /** Array of tracks & notes */
     SyndyneMidiEventTable<MidiNoteTracker> m_current_state;
     const uint32_t m_song_id;  ///< Requested song ID
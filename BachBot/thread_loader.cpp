@@ -32,6 +32,7 @@
 //  local includes
 #include "thread_loader.h"  //  local include
 #include "playlist_entry_control.h"  //  set_label_filename
+#include "profile_zone.h"  //  BACHBOT_ZONE, BACHBOT_THREAD_NAME
 
 namespace {
     constexpr const size_t MAX_FILENAME_LEN = 58U;
@@ -49,6 +50,7 @@ ThreadLoader::ThreadLoader(wxFrame *const parent) :
     m_playlist(),
     m_error_text(),
     m_count{0U},
+    m_count_known{false},
     m_last_progress_len{MAX_FILENAME_LEN},
     m_success_callback{std::bind(&ThreadLoader::dummy_callback, this, _1)}
 {
@@ -79,6 +81,7 @@ void ThreadLoader::set_on_success_callback(SuccessCallback callback)
 
 wxThread::ExitCode ThreadLoader::Entry()
 {
+    BACHBOT_THREAD_NAME("playlist loader");
     wxMutexLocker lock(m_mutex);
     m_playlist.clear();
     m_error_text.reset();
@@ -88,11 +91,14 @@ wxThread::ExitCode ThreadLoader::Entry()
     start_event.SetInt(count);
     wxQueueEvent(this, start_event.Clone());
 
-    if (count > 0) {
+    if (count >= 0) {
         m_count = uint32_t(count);
         parse_playlist();
-    } else if (!m_error_text.has_value()) {
+    }
+    if (m_playlist.empty() && !m_error_text.has_value()) {
         m_error_text = wxT("Invalid file contents");
+    } else if (!m_error_text.has_value()) {
+        order_playlist(m_playlist);
     }
 
     wxThreadEvent exit_event(wxEVT_THREAD, LoaderEvents::EXIT_EVENT);
@@ -118,7 +124,8 @@ void ThreadLoader::set_error_text(const wxString &error)
 void ThreadLoader::on_start_event(wxThreadEvent &event)
 {
     const auto value = event.GetInt();
-    if (value > 0) {
+    m_count_known = (value > 0);
+    if (m_count_known) {
         progress_bar->SetRange(value);
     }
 }
@@ -127,13 +134,16 @@ void ThreadLoader::on_start_event(wxThreadEvent &event)
 void ThreadLoader::on_tick_event(wxThreadEvent &event)
 {
     const auto value = event.GetInt();
-    if (value > 0 && value <= progress_bar->GetRange()) {
+    if (!m_count_known) {
+        //  Streamed list: the total isn't known until the last entry
+        progress_bar->Pulse();
+    } else if (value > 0 && value <= progress_bar->GetRange()) {
         progress_bar->SetValue(value);
     }
 
-    const auto progress_text = wxString::Format("%i/%i",
-                                                value,
-                                                progress_bar->GetRange());
+    const auto progress_text = m_count_known ?
+        wxString::Format("%i/%i", value, progress_bar->GetRange()) :
+        wxString::Format("%i", value);
     progress_label->SetLabelText(progress_text);
     const auto label_len = progress_text.Length();
     //  The first entry will have a *very* brief glitch here.  I can't seem to
@@ -171,12 +181,15 @@ void ThreadLoader::on_filename_event(wxThreadEvent &event)
 
 void ThreadLoader::parse_playlist()
 {
-    for (auto song_id = 1U; song_id <= m_count; ++song_id) {
+    BACHBOT_ZONE("ThreadLoader::parse_playlist");
+    for (auto song_id = 1U; (0U == m_count) || (song_id <= m_count);
+         ++song_id)
+    {
         PlayListEntry song_entry;
         song_entry.song_id = song_id;
-        build_playlist_entry(song_entry, song_id);
-
-        if (m_error_text.has_value()) {
+        if (!build_playlist_entry(song_entry, song_id) ||
+            m_error_text.has_value())
+        {
             break;
         }
 
@@ -198,6 +211,12 @@ void ThreadLoader::parse_playlist()
 }
 
 
+void ThreadLoader::order_playlist(std::list<PlayListEntry> &playlist)
+{
+    static_cast<void>(playlist);
+}
+
+
 void ThreadLoader::dummy_callback(std::list<PlayListEntry>)
 {
     throw std::runtime_error("Error: playlist loader callback not specified!");
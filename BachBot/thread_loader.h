@@ -77,7 +77,9 @@ protected:
     /**
      * @brief Prepare data and count children (ie songs) that will be imported.
      * @return number of children
-     * @retval <= 0 indicates error
+     * @retval 0 count not known in advance; entries are read (and imported)
+     *         until `build_playlist_entry` reports the end of the list
+     * @retval < 0 indicates error
      */
     virtual int count_children() = 0;
 
@@ -85,14 +87,24 @@ protected:
      * @brief Load song configuration
      * @param[in/out] song_entry load configuration
      * @param song_number number of song in list (same as `song_entry.song_id`)
+     * @retval `true` entry built (or `set_error_text` called)
+     * @retval `false` no more entries
      * @note
      * function should call `set_error_text` if an error occurs.  This will 
      * abort further processing.  This function should only load the
      * configuration - the MIDI events will be loaded when control is returned.
      */
-    virtual void build_playlist_entry(PlayListEntry &song_entry,
+    virtual bool build_playlist_entry(PlayListEntry &song_entry,
                                       const uint32_t song_number) = 0;
 
+    /**
+     * @brief Put the imported entries in their final order.
+     * @param[in/out] playlist imported entries, in the order they were built
+     * @note Called only if every entry imported.  Entries moved here must be
+     *       given `song_id` values matching their new position.
+     */
+    virtual void order_playlist(std::list<PlayListEntry> &playlist);
+
     /**
      * @brief Set error text when a failure occurs (aborts futher processing)
      * @param error error text to report to the user
@@ -124,7 +136,8 @@ private:
     wxMutex m_mutex;
     std::list<PlayListEntry> m_playlist;
     std::optional<wxString> m_error_text;
-    uint32_t m_count;
+    uint32_t m_count;  ///< 0: not known in advance
+    bool m_count_known;  ///< UI thread copy of `m_count > 0`
     size_t m_last_progress_len;
     SuccessCallback m_success_callback;
 
@@ -0,0 +1,116 @@
+/**
+ * @file trace_format.h
+ * @brief Playback trace file format
+ * @copyright
+ * 2022 Andrew Buettner (ABi)
+ *
+ * @section LICENSE
+ *
+ * BachBot - A hymn Midi player for Schlicker organs
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @section DESCRIPTION
+ * A playback trace (`.bbt`) is a `TraceFileHeader` followed by fixed size
+ * `TraceRecord`s in the order they were recorded, in host byte order.  This
+ * header has no dependencies beyond the standard library so that it can be
+ * shared with the offline analyzer (`tools/trace_analyzer.cpp`).
+ */
+
+#pragma once
+
+//  system includes
+#include <cstdint>  //  uintXX_t, intXX_t
+
+//  module includes
+// -none-
+
+//  local includes
+// -none-
+
+
+namespace bach_bot {
+
+/** File extension used for playback traces */
+constexpr const auto TRACE_FILE_EXTENSION = "bbt";
+
+/** Current trace file version */
+constexpr const uint32_t TRACE_FILE_VERSION = 1U;
+
+/**
+ * @brief Kind of event a trace record describes.
+ */
+enum TraceRecordType : uint8_t
+{
+    /** MIDI message sent: scheduled/actual time, bytes, queue depth */
+    TRACE_MIDI_EVENT = 0U,
+
+    /** Bank command sent: `data[0]` is the command, memory/mode the result */
+    TRACE_BANK_CHANGE,
+
+    /** Timer ticks: `tick_interval_us` is the longest interval since the
+     *  previous tick record, `queue_depth` the number of ticks covered */
+    TRACE_TICK,
+
+    /** Song started playing (`scheduled_us` is 0, `actual_us` song time) */
+    TRACE_SONG_START,
+
+    /** Song finished or stopped (`data[0]` 1 = complete, 0 = stopped) */
+    TRACE_SONG_END,
+
+    /** Records were lost because the writer fell behind, `queue_depth` is
+     *  the number of records lost */
+    TRACE_DROPPED,
+
+    /** Player warm-up before the first song: `actual_us` is its duration,
+     *  `queue_depth` the number of timer ticks waited for */
+    TRACE_WARM_UP
+};
+
+
+/**
+ * @brief Trace file header
+ */
+struct TraceFileHeader
+{
+    char magic[8];  ///< "BBTRACE" (NUL terminated)
+    uint32_t version;  ///< `TRACE_FILE_VERSION`
+    uint32_t record_size;  ///< `sizeof(TraceRecord)`
+};
+static_assert(sizeof(TraceFileHeader) == 16U, "Trace header layout changed");
+
+/** Value of `TraceFileHeader::magic` */
+constexpr const char TRACE_FILE_MAGIC[8] = "BBTRACE";
+
+
+/**
+ * @brief Single trace record
+ */
+struct TraceRecord
+{
+    int64_t scheduled_us;  ///< song time the event was due
+    int64_t actual_us;  ///< song time the event was sent
+    uint32_t song_id;  ///< song being played
+    uint32_t queue_depth;  ///< events remaining in the song
+    uint32_t tick_interval_us;  ///< see `TRACE_TICK`
+    uint8_t type;  ///< `TraceRecordType`
+    uint8_t size;  ///< number of bytes used in `data`
+    uint8_t data[3];  ///< MIDI message bytes
+    uint8_t memory;  ///< bank memory after this record
+    uint8_t mode;  ///< bank mode after this record
+    uint8_t reserved[5];  ///< pad to 8 bytes (always 0)
+};
+static_assert(sizeof(TraceRecord) == 40U, "Trace record layout changed");
+
+}  //  end bach_bot
@@ -0,0 +1,192 @@
+/**
+ * @file transposer.cpp
+ * @brief Live transposition of outgoing notes
+ * @copyright
+ * 2022 Andrew Buettner (ABi)
+ *
+ * @section LICENSE
+ *
+ * BachBot - A hymn Midi player for Schlicker organs
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+//  system includes
+#include <algorithm>  //  std::clamp
+
+//  module includes
+// -none-
+
+//  local includes
+#include "transposer.h"  //  local include
+
+
+namespace bach_bot {
+
+uint8_t fold_to_keyboard(int note, const SyndyneKeyboards keyboard)
+{
+    const auto high_limit = (SyndyneKeyboards::PETAL == keyboard) ?
+        HIGHEST_PETAL_NOTE : HIGHEST_MANUAL_NOTE;
+    while (note < LOWEST_KEYBOARD_NOTE) {
+        note += MIDI_NOTES_IN_OCTAVE;  //  Bump 1 octave
+    }
+    while (note > high_limit) {
+        note -= MIDI_NOTES_IN_OCTAVE;  //  Bump 1 octave down
+    }
+    return uint8_t(note);
+}
+
+
+Transposer::Transposer() :
+    m_offset{0},
+    m_table(make_table(0)),
+    m_held(),
+    m_sounding()
+{
+}
+
+
+bool Transposer::apply(NoteMessage &midi_message, const size_t size)
+{
+    const auto command = (midi_message[0] >> 4U);
+    const auto channel = (midi_message[0] & 0x0FU);
+    if ((size < MIDI_MESSAGE_SIZE) ||
+        (channel < SyndyneKeyboards::MANUAL1_GREAT) ||
+        (channel > SyndyneKeyboards::PETAL) ||
+        ((MidiCommands::NOTE_ON != command) &&
+         (MidiCommands::NOTE_OFF != command))) {
+        return true;
+    }
+
+    const auto keyboard = size_t(channel - SyndyneKeyboards::MANUAL1_GREAT);
+    const auto note = size_t(midi_message[1] & 0x7FU);
+    const auto key = m_table[keyboard][note];
+    midi_message[1] = key;
+
+    auto &held = m_held[keyboard][note];
+    auto &sounding = m_sounding[keyboard][key];
+    if ((MidiCommands::NOTE_ON == command) && (midi_message[2] > 0U)) {
+        if (0U == held) {
+            held = midi_message[2];
+            return (0U == sounding++);
+        }
+        held = midi_message[2];
+        return true;
+    }
+
+    if (0U == held) {
+        //  Not one of ours, just pass it along.
+        return true;
+    }
+    held = 0U;
+    return (0U == --sounding);
+}
+
+
+void Transposer::set_offset(const int steps,
+                            std::vector<NoteMessage> &messages)
+{
+    const auto offset = std::clamp(steps, -MIDI_NOTES_IN_OCTAVE,
+                                   MIDI_NOTES_IN_OCTAVE);
+    if (offset == m_offset) {
+        return;
+    }
+
+    const auto table = make_table(offset);
+    KeyboardTable<uint8_t> sounding{};
+    for (size_t keyboard = 0U; keyboard < NUM_SYNDYNE_KEYBOARDS; ++keyboard) {
+        for (size_t note = 0U; note < m_held[keyboard].size(); ++note) {
+            if (0U != m_held[keyboard][note]) {
+                ++sounding[keyboard][table[keyboard][note]];
+            }
+        }
+    }
+
+    //  Keys held both before and after the change are left alone rather than
+    // re-struck.  All releases go before any strikes.
+    for (size_t keyboard = 0U; keyboard < NUM_SYNDYNE_KEYBOARDS; ++keyboard) {
+        const auto channel = uint8_t(keyboard +
+                                     SyndyneKeyboards::MANUAL1_GREAT);
+        for (size_t key = 0U; key < sounding[keyboard].size(); ++key) {
+            if ((0U != m_sounding[keyboard][key]) &&
+                (0U == sounding[keyboard][key])) {
+                messages.push_back({
+                    make_midi_command_byte(channel, MidiCommands::NOTE_OFF),
+                    uint8_t(key), 0U});
+            }
+        }
+    }
+    for (size_t keyboard = 0U; keyboard < NUM_SYNDYNE_KEYBOARDS; ++keyboard) {
+        const auto channel = uint8_t(keyboard +
+                                     SyndyneKeyboards::MANUAL1_GREAT);
+        for (size_t note = 0U; note < m_held[keyboard].size(); ++note) {
+            const auto velocity = m_held[keyboard][note];
+            const auto key = table[keyboard][note];
+            if ((0U != velocity) && (0U == m_sounding[keyboard][key])) {
+                //  Mark it struck so a second note on the same key is not.
+                m_sounding[keyboard][key] = 1U;
+                messages.push_back({
+                    make_midi_command_byte(channel, MidiCommands::NOTE_ON),
+                    key, velocity});
+            }
+        }
+    }
+
+    m_offset = offset;
+    m_table = table;
+    m_sounding = sounding;
+}
+
+
+void Transposer::get_held(std::vector<NoteMessage> &messages) const
+{
+    for (size_t keyboard = 0U; keyboard < NUM_SYNDYNE_KEYBOARDS; ++keyboard) {
+        const auto channel = uint8_t(keyboard +
+                                     SyndyneKeyboards::MANUAL1_GREAT);
+        for (size_t note = 0U; note < m_held[keyboard].size(); ++note) {
+            const auto velocity = m_held[keyboard][note];
+            if (0U != velocity) {
+                messages.push_back({
+                    make_midi_command_byte(channel, MidiCommands::NOTE_ON),
+                    uint8_t(note), velocity});
+            }
+        }
+    }
+}
+
+
+void Transposer::reset()
+{
+    m_held = KeyboardTable<uint8_t>();
+    m_sounding = KeyboardTable<uint8_t>();
+}
+
+
+Transposer::KeyboardTable<uint8_t> Transposer::make_table(const int steps)
+{
+    KeyboardTable<uint8_t> table;
+    for (size_t keyboard = 0U; keyboard < NUM_SYNDYNE_KEYBOARDS; ++keyboard) {
+        const auto id = SyndyneKeyboards(keyboard +
+                                         SyndyneKeyboards::MANUAL1_GREAT);
+        for (size_t note = 0U; note < table[keyboard].size(); ++note) {
+            //  Untransposed notes are sent exactly as imported.
+            table[keyboard][note] = (0 == steps) ? uint8_t(note) :
+                fold_to_keyboard(int(note) + steps, id);
+        }
+    }
+    return table;
+}
+
+}  //  end bach_bot
@@ -0,0 +1,135 @@
+/**
+ * @file transposer.h
+ * @brief Live transposition of outgoing notes
+ * @copyright
+ * 2022 Andrew Buettner (ABi)
+ *
+ * @section LICENSE
+ *
+ * BachBot - A hymn Midi player for Schlicker organs
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @section DESCRIPTION
+ * Songs are transposed at import (see `SyndineImporter::adjust_key`), which
+ * means a key change requires the song to be re-imported.  The transposer
+ * applies an additional offset to note events as they are sent so the key
+ * can be changed while playing.  The note mapping of each keyboard is a
+ * table rebuilt only when the offset changes, so sending a note is a single
+ * lookup.
+ *
+ * Transposed notes are folded back into the range of their keyboard, so two
+ * notes of a chord may land on the same key.  The transposer counts the
+ * notes holding each key down and only releases the key with the last of
+ * them.
+ */
+
+#pragma once
+
+//  system includes
+#include <array>  //  std::array
+#include <cstdint>  //  uint8_t
+#include <vector>  //  std::vector
+
+//  module includes
+// -none-
+
+//  local includes
+#include "common_defs.h"  //  SyndyneKeyboards, MIDI_MESSAGE_SIZE
+
+
+namespace bach_bot {
+
+/**
+ * @brief Move a note into the range of a keyboard by whole octaves.
+ * @param note MIDI note (may be out of range)
+ * @param keyboard keyboard the note will be played on
+ * @returns MIDI note that can be played on `keyboard`
+ */
+uint8_t fold_to_keyboard(int note, const SyndyneKeyboards keyboard);
+
+
+/**
+ * @brief Applies a transposition to outgoing note events.
+ * @note Only note events on the keyboard channels are changed, everything
+ *       else passes through untouched.
+ */
+class Transposer
+{
+public:
+    using NoteMessage = std::array<uint8_t, MIDI_MESSAGE_SIZE>;
+
+    /**
+     * @brief Constructor - no transposition.
+     */
+    Transposer();
+
+    /**
+     * @brief Transpose an outgoing message.
+     * @param midi_message[in/out] message to transpose
+     * @param size number of bytes in `midi_message`
+     * @retval `true` send the message
+     * @retval `false` drop the message (the key is still held by another
+     *         note, or was already struck)
+     */
+    bool apply(NoteMessage &midi_message, const size_t size);
+
+    /**
+     * @brief Change the transposition.
+     * @param steps half-steps up (or down if negative), at most one octave
+     * @param messages[out] note-offs for keys no longer held followed by
+     *        note-ons for newly held keys; these must be sent before any
+     *        further (transposed) message
+     */
+    void set_offset(const int steps, std::vector<NoteMessage> &messages);
+
+    /**
+     * @brief Get the song notes that are currently held.
+     * @param messages[out] note-on (untransposed) of each held note
+     */
+    void get_held(std::vector<NoteMessage> &messages) const;
+
+    /**
+     * @brief Forget all held notes (after they have all been released).
+     */
+    void reset();
+
+    /**
+     * @brief Get the current transposition (half-steps)
+     */
+    int get_offset() const
+    {
+        return m_offset;
+    }
+
+private:
+    /** Per-note value for each keyboard */
+    template <typename T>
+    using KeyboardTable = std::array<std::array<T, 128U>,
+                                     NUM_SYNDYNE_KEYBOARDS>;
+
+    /**
+     * @brief Build the note mapping for an offset.
+     * @param steps transposition (half-steps)
+     * @returns transposed note of each keyboard's notes
+     */
+    static KeyboardTable<uint8_t> make_table(const int steps);
+
+    int m_offset;
+    KeyboardTable<uint8_t> m_table;  ///< untransposed to transposed note
+    KeyboardTable<uint8_t> m_held;  ///< velocity of held (untransposed) notes
+    KeyboardTable<uint8_t> m_sounding;  ///< notes holding each key down
+};
+
+}  //  end bach_bot
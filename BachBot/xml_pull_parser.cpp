@@ -0,0 +1,388 @@
+/**
+ * @file xml_pull_parser.cpp
+ * @brief Streaming (pull) XML parser
+ * @copyright
+ * 2022 Andrew Buettner (ABi)
+ *
+ * @section LICENSE
+ *
+ * BachBot - A hymn Midi player for Schlicker organs
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+
+//  system includes
+#include <cstdlib>  //  std::strtoul
+#include <cstring>  //  std::strlen, std::memcmp, std::memmove
+#include <stdexcept>  //  std::runtime_error
+#include <fmt/format.h>  //  fmt::format
+
+//  module includes
+// -none-
+
+//  local includes
+#include "xml_pull_parser.h"  //  local include
+
+
+namespace {
+
+/** Longest entity / character reference accepted (`#x10FFFF` plus slack) */
+constexpr const auto MAX_REFERENCE_LEN = 10U;
+
+bool is_space(const int c)
+{
+    return (' ' == c) || ('\t' == c) || ('\n' == c) || ('\r' == c);
+}
+
+
+bool is_name_start(const int c)
+{
+    return ((c >= 'A') && (c <= 'Z')) || ((c >= 'a') && (c <= 'z')) ||
+           ('_' == c) || (':' == c) || (c >= 0x80);
+}
+
+
+bool is_name_char(const int c)
+{
+    return is_name_start(c) || ((c >= '0') && (c <= '9')) ||
+           ('-' == c) || ('.' == c);
+}
+
+
+/**
+ * @brief Append a code point to a string as UTF-8.
+ * @retval `false` not a valid code point
+ */
+bool append_utf8(std::string &text, const unsigned long code)
+{
+    if ((0UL == code) || (code > 0x10FFFFUL) ||
+        ((code >= 0xD800UL) && (code <= 0xDFFFUL)))
+    {
+        return false;
+    }
+
+    if (code < 0x80UL) {
+        text.push_back(char(code));
+    } else if (code < 0x800UL) {
+        text.push_back(char(0xC0UL | (code >> 6U)));
+        text.push_back(char(0x80UL | (code & 0x3FUL)));
+    } else if (code < 0x10000UL) {
+        text.push_back(char(0xE0UL | (code >> 12U)));
+        text.push_back(char(0x80UL | ((code >> 6U) & 0x3FUL)));
+        text.push_back(char(0x80UL | (code & 0x3FUL)));
+    } else {
+        text.push_back(char(0xF0UL | (code >> 18U)));
+        text.push_back(char(0x80UL | ((code >> 12U) & 0x3FUL)));
+        text.push_back(char(0x80UL | ((code >> 6U) & 0x3FUL)));
+        text.push_back(char(0x80UL | (code & 0x3FUL)));
+    }
+    return true;
+}
+
+}  //  end anonymous namespace
+
+
+namespace bach_bot {
+
+XmlPullParser::XmlPullParser(wxInputStream &input) :
+    m_input(input),
+    m_block(XML_READ_BLOCK_SIZE),
+    m_block_pos{0U},
+    m_block_len{0U},
+    m_line{1},
+    m_token_line{1},
+    m_pending_end{false},
+    m_seen_root{false},
+    m_open(),
+    m_name(),
+    m_attributes(),
+    m_text()
+{
+    //  UTF-8 byte order mark
+    static_cast<void>(accept("\xEF\xBB\xBF"));
+}
+
+
+XmlToken XmlPullParser::next()
+{
+    m_attributes.clear();
+    m_text.clear();
+    if (m_pending_end) {
+        m_pending_end = false;
+        m_open.pop_back();
+        return XmlToken::END_ELEMENT;
+    }
+
+    while (true) {
+        m_token_line = m_line;
+        const auto c = peek();
+        if (c < 0) {
+            if (!m_open.empty()) {
+                fail(fmt::format("end of file inside <{}>", m_open.back()));
+            } else if (!m_seen_root) {
+                fail("no document element");
+            }
+            return XmlToken::END_OF_DOCUMENT;
+        }
+
+        if ('<' != c) {
+            auto blank = true;
+            while ((peek() >= 0) && ('<' != peek())) {
+                const auto t = get();
+                blank = blank && is_space(t);
+                if ('&' == t) {
+                    read_reference(m_text);
+                } else {
+                    m_text.push_back(char(t));
+                }
+            }
+
+            if (!m_open.empty()) {
+                return XmlToken::TEXT;
+            } else if (!blank) {
+                fail("text outside the document element");
+            }
+            m_text.clear();
+            continue;
+        }
+
+        static_cast<void>(get());
+        if (accept("?")) {
+            read_until("?>", nullptr);
+        } else if (accept("!--")) {
+            read_until("-->", nullptr);
+        } else if (accept("![CDATA[")) {
+            if (m_open.empty()) {
+                fail("CDATA outside the document element");
+            }
+            read_until("]]>", &m_text);
+            return XmlToken::TEXT;
+        } else if (accept("!")) {
+            //  DOCTYPE (or similar): skip it, internal subset and all
+            auto brackets = 0;
+            auto t = get();
+            while (('>' != t) || (brackets > 0)) {
+                if (t < 0) {
+                    fail("end of file inside <!...>");
+                }
+                brackets += ('[' == t) ? 1 : ((']' == t) ? -1 : 0);
+                t = get();
+            }
+        } else {
+            return read_tag();
+        }
+    }
+}
+
+
+int XmlPullParser::get()
+{
+    const auto c = peek();
+    if (c >= 0) {
+        ++m_block_pos;
+        m_line += ('\n' == c) ? 1 : 0;
+    }
+    return c;
+}
+
+
+int XmlPullParser::peek()
+{
+    if (!fill(1U)) {
+        return -1;
+    }
+    return int(static_cast<unsigned char>(m_block[m_block_pos]));
+}
+
+
+bool XmlPullParser::fill(const size_t wanted)
+{
+    if ((m_block_len - m_block_pos) < wanted) {
+        const auto kept = m_block_len - m_block_pos;
+        std::memmove(m_block.data(), m_block.data() + m_block_pos, kept);
+        m_block_pos = 0U;
+        m_block_len = kept;
+        while (m_block_len < wanted) {
+            m_input.Read(m_block.data() + m_block_len,
+                         m_block.size() - m_block_len);
+            const auto read = m_input.LastRead();
+            if (0U == read) {
+                break;
+            }
+            m_block_len += read;
+        }
+    }
+    return (m_block_len - m_block_pos) >= wanted;
+}
+
+
+bool XmlPullParser::accept(const char *const literal)
+{
+    const auto len = std::strlen(literal);
+    if (!fill(len) ||
+        (0 != std::memcmp(m_block.data() + m_block_pos, literal, len)))
+    {
+        return false;
+    }
+
+    //  Literals passed in never contain a new line
+    m_block_pos += len;
+    return true;
+}
+
+
+void XmlPullParser::read_until(const std::string &terminator,
+                               std::string *const content)
+{
+    while (!accept(terminator.c_str())) {
+        const auto c = get();
+        if (c < 0) {
+            fail(fmt::format("end of file looking for '{}'", terminator));
+        } else if (nullptr != content) {
+            content->push_back(char(c));
+        }
+    }
+}
+
+
+std::string XmlPullParser::read_name()
+{
+    std::string name;
+    if (!is_name_start(peek())) {
+        fail("expected a name");
+    }
+    while (is_name_char(peek())) {
+        name.push_back(char(get()));
+    }
+    return name;
+}
+
+
+void XmlPullParser::skip_space()
+{
+    while (is_space(peek())) {
+        static_cast<void>(get());
+    }
+}
+
+
+void XmlPullParser::read_reference(std::string &text)
+{
+    std::string name;
+    auto c = get();
+    while (';' != c) {
+        if ((c < 0) || is_space(c) || ('<' == c) ||
+            (name.length() >= MAX_REFERENCE_LEN))
+        {
+            fail("unterminated '&' reference");
+        }
+        name.push_back(char(c));
+        c = get();
+    }
+
+    if ("amp" == name) {
+        text.push_back('&');
+    } else if ("lt" == name) {
+        text.push_back('<');
+    } else if ("gt" == name) {
+        text.push_back('>');
+    } else if ("quot" == name) {
+        text.push_back('"');
+    } else if ("apos" == name) {
+        text.push_back('\'');
+    } else if ((name.length() > 1U) && ('#' == name[0])) {
+        const auto hex = ('x' == name[1]);
+        const auto digits = name.substr(hex ? 2U : 1U);
+        char *end = nullptr;
+        const auto code = std::strtoul(digits.c_str(), &end, hex ? 16 : 10);
+        if (digits.empty() || ('\0' != *end) || !append_utf8(text, code)) {
+            fail(fmt::format("invalid character reference &{};", name));
+        }
+    } else {
+        fail(fmt::format("unknown entity &{};", name));
+    }
+}
+
+
+XmlToken XmlPullParser::read_tag()
+{
+    if (accept("/")) {
+        m_name = read_name();
+        skip_space();
+        if (!accept(">")) {
+            fail(fmt::format("expected '>' to close </{}", m_name));
+        } else if (m_open.empty() || (m_open.back() != m_name)) {
+            fail(fmt::format("unexpected </{}>", m_name));
+        }
+        m_open.pop_back();
+        return XmlToken::END_ELEMENT;
+    }
+
+    if (m_open.empty() && m_seen_root) {
+        fail("more than one document element");
+    }
+    m_name = read_name();
+    while (true) {
+        const auto spaced = is_space(peek());
+        skip_space();
+        if (accept(">")) {
+            break;
+        } else if (accept("/>")) {
+            m_pending_end = true;
+            break;
+        } else if (!spaced) {
+            fail(fmt::format("malformed <{}> tag", m_name));
+        }
+
+        auto name = read_name();
+        skip_space();
+        if (!accept("=")) {
+            fail(fmt::format("expected '=' after {}", name));
+        }
+        skip_space();
+        const auto quote = get();
+        if (('"' != quote) && ('\'' != quote)) {
+            fail(fmt::format("expected a quoted value for {}", name));
+        }
+
+        std::string value;
+        auto c = get();
+        while (quote != c) {
+            if ((c < 0) || ('<' == c)) {
+                fail(fmt::format("unterminated value for {}", name));
+            } else if ('&' == c) {
+                read_reference(value);
+            } else {
+                //  Attribute value normalization: white space reads as ' '
+                value.push_back(is_space(c) ? ' ' : char(c));
+            }
+            c = get();
+        }
+        m_attributes.emplace_back(std::move(name), std::move(value));
+    }
+
+    m_seen_root = true;
+    m_open.push_back(m_name);
+    return XmlToken::START_ELEMENT;
+}
+
+
+void XmlPullParser::fail(const std::string &reason) const
+{
+    throw std::runtime_error(fmt::format("line {}: {}", m_line, reason));
+}
+
+}  //  end bach_bot
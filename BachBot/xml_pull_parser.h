@@ -0,0 +1,206 @@
+/**
+ * @file xml_pull_parser.h
+ * @brief Streaming (pull) XML parser
+ * @copyright
+ * 2022 Andrew Buettner (ABi)
+ *
+ * @section LICENSE
+ *
+ * BachBot - A hymn Midi player for Schlicker organs
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @section DESCRIPTION
+ * `wxXmlDocument` builds the whole document tree before handing any of it
+ * back, so the cost of opening a playlist grows with the playlist.  This
+ * parser reads the file in fixed-size blocks and returns one token (start
+ * tag, text, end tag) at a time; callers keep only what they need.
+ *
+ * Only what BachBot files use is supported: elements, attributes, text,
+ * CDATA, comments, processing instructions and the predefined / numeric
+ * character references.  A DOCTYPE is skipped; its internal subset (entity
+ * declarations, etc) is not interpreted.  Text is returned as UTF-8.
+ */
+
+#pragma once
+
+//  system includes
+#include <cstdint>  //  uint32_t
+#include <string>  //  std::string
+#include <utility>  //  std::pair
+#include <vector>  //  std::vector
+#include <wx/stream.h>  //  wxInputStream
+
+//  module includes
+// -none-
+
+//  local includes
+// -none-
+
+
+namespace bach_bot {
+
+/** Size of the blocks read from the input stream (bytes) */
+constexpr const auto XML_READ_BLOCK_SIZE = size_t(64U * 1024U);
+
+/** Kind of token returned by `XmlPullParser::next` */
+enum class XmlToken
+{
+    START_ELEMENT,  ///< `<name attr="value">` (or `<name/>`, then END)
+    END_ELEMENT,  ///< `</name>`
+    TEXT,  ///< character data (including CDATA sections)
+    END_OF_DOCUMENT  ///< input exhausted
+};
+
+
+/**
+ * @brief Reads an XML document one token at a time.
+ */
+class XmlPullParser
+{
+public:
+    using Attribute = std::pair<std::string, std::string>;
+
+    /**
+     * @brief Constructor
+     * @param input stream to parse (must outlive the parser)
+     */
+    explicit XmlPullParser(wxInputStream &input);
+
+    /**
+     * @brief Read the next token.
+     * @returns token type; name, attributes and text describe this token
+     * @throws std::runtime_error malformed XML (message includes the line)
+     */
+    XmlToken next();
+
+    /**
+     * @brief Get the element name (START_ELEMENT / END_ELEMENT)
+     */
+    const std::string &get_name() const
+    {
+        return m_name;
+    }
+
+    /**
+     * @brief Get the attributes of the element (START_ELEMENT)
+     */
+    const std::vector<Attribute> &get_attributes() const
+    {
+        return m_attributes;
+    }
+
+    /**
+     * @brief Get the decoded character data (TEXT)
+     */
+    const std::string &get_text() const
+    {
+        return m_text;
+    }
+
+    /**
+     * @brief Get the line the current token started on (from 1)
+     */
+    int get_line() const
+    {
+        return m_token_line;
+    }
+
+    /**
+     * @brief Get the number of open elements (including a START_ELEMENT
+     *        just returned, excluding an END_ELEMENT just returned)
+     */
+    size_t get_depth() const
+    {
+        return m_open.size();
+    }
+
+private:
+    /**
+     * @brief Read the next byte of input
+     * @returns byte, or -1 at the end of input
+     */
+    int get();
+
+    /**
+     * @brief Make bytes of look-ahead available, reading more if needed.
+     * @param wanted number of unread bytes needed
+     * @retval `false` input ends first
+     */
+    bool fill(const size_t wanted);
+
+    /**
+     * @brief Look at the next byte of input without consuming it
+     * @returns byte, or -1 at the end of input
+     */
+    int peek();
+
+    /**
+     * @brief Consume input if it starts with a literal.
+     * @param literal text to match
+     * @retval `true` literal matched and consumed
+     * @retval `false` input is unchanged
+     * @note `literal` must be shorter than `XML_READ_BLOCK_SIZE`.
+     */
+    bool accept(const char *const literal);
+
+    /**
+     * @brief Consume input up to and including a terminator.
+     * @param terminator text ending the skipped section
+     * @param[out] content text before the terminator (may be `nullptr`)
+     * @throws std::runtime_error end of input first
+     */
+    void read_until(const std::string &terminator, std::string *const content);
+
+    /**
+     * @brief Read an element or attribute name.
+     */
+    std::string read_name();
+
+    /**
+     * @brief Skip white space.
+     */
+    void skip_space();
+
+    /**
+     * @brief Read a character reference (after the `&`) and append it.
+     * @param[in/out] text decoded text
+     */
+    void read_reference(std::string &text);
+
+    /**
+     * @brief Read the rest of a start or end tag (after the `<`).
+     */
+    XmlToken read_tag();
+
+    /**
+     * @brief Throw a parse error at the current line.
+     */
+    [[noreturn]] void fail(const std::string &reason) const;
+
+    wxInputStream &m_input;
+    std::vector<char> m_block;  ///< current input block
+    size_t m_block_pos;  ///< next unread byte of `m_block`
+    size_t m_block_len;  ///< valid bytes in `m_block`
+    int m_line;
+    int m_token_line;
+    bool m_pending_end;  ///< `<name/>` still owes an END_ELEMENT
+    bool m_seen_root;  ///< the document element has started
+    std::vector<std::string> m_open;  ///< names of the open elements
+    std::string m_name;
+    std::vector<Attribute> m_attributes;
+    std::string m_text;
+};
+
+}  //  end bach_bot
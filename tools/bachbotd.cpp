@@ -0,0 +1,432 @@
+/**
+ * @file bachbotd.cpp
+ * @brief Headless player daemon with local socket control
+ * @copyright
+ * 2022 Andrew Buettner (ABi)
+ *
+ * @section LICENSE
+ *
+ * BachBot - A hymn Midi player for Schlicker organs
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @section DESCRIPTION
+ * Runs the player engine as a background process with no GUI, for a
+ * dedicated real-time machine.  The player is controlled through a Unix
+ * domain socket using the line protocol of `PlayerService` (see
+ * player_service.h); every connected client also receives the status lines.
+ * The process never creates a window or runs a wx event loop; the player
+ * thread only ever hands notifications to the control thread through a
+ * queue and a wake-up pipe.
+ *
+ * Clients that stop reading are disconnected rather than allowed to stall
+ * the control thread.  `quit` (in addition to the service commands) shuts
+ * the daemon down, as does SIGINT / SIGTERM.
+ *
+ * Usage:
+ *   bachbotd [-s socket] [-p port] [-m monitor_port]... [-l]
+ *     -s  socket path (default $XDG_RUNTIME_DIR/bachbotd.sock)
+ *     -p  organ MIDI output port number (default 0)
+ *     -m  additional monitor output port number
+ *     -l  list the MIDI output ports and exit
+ *
+ * eg: echo "load service.bbp" | socat - UNIX-CONNECT:/run/user/1000/bachbotd.sock
+ */
+
+//  system includes
+#include <algorithm>  //  std::remove_if
+#include <cerrno>  //  errno
+#include <csignal>  //  std::signal
+#include <cstdio>  //  std::fflush
+#include <cstdlib>  //  EXIT_SUCCESS, std::getenv
+#include <cstring>  //  std::strerror, std::memcpy
+#include <iostream>  //  std::cerr
+#include <stdexcept>  //  std::runtime_error
+#include <string>  //  std::string, std::stoul
+#include <vector>  //  std::vector
+#include <fcntl.h>  //  O_NONBLOCK, O_CLOEXEC
+#include <poll.h>  //  poll
+#include <sys/socket.h>  //  socket, bind, listen, accept4
+#include <sys/stat.h>  //  umask
+#include <sys/un.h>  //  sockaddr_un
+#include <unistd.h>  //  close, pipe2, read, write, unlink
+#include <fmt/format.h>  //  fmt::format, fmt::print
+#include <wx/init.h>  //  wxInitializer
+#include <wx/app.h>  //  wxTheApp
+
+//  module includes
+// -none-
+
+//  local includes
+#include "player_service.h"  //  PlayerService
+#include "midi_interface.h"  //  RtMidiOut
+
+
+namespace {
+
+/** Longest command line accepted from a client */
+constexpr const size_t MAX_COMMAND_LEN = 4096U;
+
+/** Pending connections allowed by `listen` */
+constexpr const int LISTEN_BACKLOG = 4;
+
+/** Write end of the wake-up pipe (for the signal handler) */
+int g_wake_fd = -1;
+
+/** Set by SIGINT / SIGTERM */
+volatile std::sig_atomic_t g_stop = 0;
+
+
+void wake(const int fd)
+{
+    //  A full pipe already holds a wake-up, nothing is lost.
+    const char byte = 0;
+    static_cast<void>(::write(fd, &byte, 1U));
+}
+
+
+void on_signal(const int signal_number)
+{
+    static_cast<void>(signal_number);
+    g_stop = 1;
+    wake(g_wake_fd);
+}
+
+
+/**
+ * @brief Throw the current `errno` as an error.
+ * @param what operation that failed
+ */
+[[noreturn]] void throw_errno(const std::string &what)
+{
+    throw std::runtime_error(fmt::format("{}: {}", what,
+                                         std::strerror(errno)));
+}
+
+
+/**
+ * @brief Unix domain socket server for the control protocol.
+ */
+class ControlServer
+{
+public:
+    /**
+     * @brief Constructor - create the socket and wake-up pipe.
+     * @param socket_path socket to listen on
+     * @throws std::runtime_error socket can't be created (or is in use)
+     */
+    explicit ControlServer(const std::string &socket_path);
+
+    ~ControlServer();
+
+    ControlServer(const ControlServer &) = delete;
+    ControlServer &operator=(const ControlServer &) = delete;
+
+    /**
+     * @brief Serve clients until `quit` or a signal.
+     * @param service player service to run commands on
+     */
+    void run(bach_bot::PlayerService &service);
+
+    /**
+     * @brief Send a status line to every client.
+     * @param line status line (without line ending)
+     */
+    void broadcast(const std::string &line);
+
+    /**
+     * @brief Wake the control loop (safe from any thread).
+     */
+    void wake() const
+    {
+        ::wake(m_wake_write);
+    }
+
+private:
+    /**
+     * @brief Connected control client
+     */
+    struct Client
+    {
+        int fd;
+        std::string input;  ///< partial command line
+        bool closed;
+    };
+
+    /**
+     * @brief Send a line to a client without blocking.
+     * @note A client that can't take the whole line is disconnected.
+     */
+    void send_line(Client &client, const std::string &line);
+
+    /**
+     * @brief Read and run a client's commands.
+     * @returns `true` if the client asked the daemon to quit
+     */
+    bool read_commands(Client &client, bach_bot::PlayerService &service);
+
+    const std::string m_socket_path;
+    int m_listen_fd;
+    int m_wake_read;
+    int m_wake_write;
+    std::vector<Client> m_clients;
+};
+
+
+ControlServer::ControlServer(const std::string &socket_path) :
+    m_socket_path(socket_path),
+    m_listen_fd{-1},
+    m_wake_read{-1},
+    m_wake_write{-1},
+    m_clients()
+{
+    sockaddr_un address{};
+    address.sun_family = AF_UNIX;
+    if (socket_path.length() >= sizeof(address.sun_path)) {
+        throw std::runtime_error(fmt::format("Socket path too long: {}",
+                                             socket_path));
+    }
+    std::memcpy(address.sun_path, socket_path.c_str(),
+                socket_path.length() + 1U);
+
+    int wake_pipe[2];
+    if (0 != ::pipe2(wake_pipe, O_NONBLOCK | O_CLOEXEC)) {
+        throw_errno("Unable to create wake-up pipe");
+    }
+    m_wake_read = wake_pipe[0];
+    m_wake_write = wake_pipe[1];
+
+    m_listen_fd = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (m_listen_fd < 0) {
+        throw_errno("Unable to create socket");
+    }
+
+    //  A socket file left by a crash is replaced; a live daemon is not.
+    const auto *const socket_address =
+        reinterpret_cast<const sockaddr *>(&address);
+    if (0 == ::connect(m_listen_fd, socket_address, sizeof(address))) {
+        throw std::runtime_error(fmt::format("{} is already in use",
+                                             socket_path));
+    }
+    static_cast<void>(::close(m_listen_fd));
+    static_cast<void>(::unlink(socket_path.c_str()));
+    m_listen_fd = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+
+    //  Only the owner may control the player.
+    const auto old_mask = ::umask(0177);
+    const auto bound = ::bind(m_listen_fd, socket_address, sizeof(address));
+    static_cast<void>(::umask(old_mask));
+    if ((0 != bound) || (0 != ::listen(m_listen_fd, LISTEN_BACKLOG))) {
+        throw_errno(fmt::format("Unable to listen on {}", socket_path));
+    }
+}
+
+
+ControlServer::~ControlServer()
+{
+    for (const auto &client : m_clients) {
+        static_cast<void>(::close(client.fd));
+    }
+    if (m_listen_fd >= 0) {
+        static_cast<void>(::close(m_listen_fd));
+        static_cast<void>(::unlink(m_socket_path.c_str()));
+    }
+    static_cast<void>(::close(m_wake_read));
+    static_cast<void>(::close(m_wake_write));
+}
+
+
+void ControlServer::run(bach_bot::PlayerService &service)
+{
+    g_wake_fd = m_wake_write;
+    auto quit = false;
+    std::vector<pollfd> poll_fds;
+    while (!quit && (0 == g_stop)) {
+        poll_fds.clear();
+        poll_fds.push_back({m_wake_read, POLLIN, 0});
+        poll_fds.push_back({m_listen_fd, POLLIN, 0});
+        for (const auto &client : m_clients) {
+            poll_fds.push_back({client.fd, POLLIN, 0});
+        }
+
+        if (::poll(poll_fds.data(), poll_fds.size(), -1) < 0) {
+            if (EINTR == errno) {
+                continue;
+            }
+            throw_errno("poll");
+        }
+
+        if (0 != (poll_fds[0].revents & POLLIN)) {
+            char drain[64];
+            while (::read(m_wake_read, drain, sizeof(drain)) > 0) {
+            }
+            service.process_player_events();
+        }
+
+        //  Clients first: a new connection is added to `m_clients`.
+        for (auto i = 0U; i < m_clients.size(); ++i) {
+            if (0 != poll_fds[i + 2U].revents) {
+                quit = read_commands(m_clients[i], service) || quit;
+            }
+        }
+
+        if (0 != (poll_fds[1].revents & POLLIN)) {
+            const auto fd = ::accept4(m_listen_fd, nullptr, nullptr,
+                                      SOCK_NONBLOCK | SOCK_CLOEXEC);
+            if (fd >= 0) {
+                m_clients.push_back({fd, std::string(), false});
+            }
+        }
+
+        m_clients.erase(std::remove_if(m_clients.begin(), m_clients.end(),
+                                       [](const Client &client) {
+                                           if (client.closed) {
+                                               ::close(client.fd);
+                                           }
+                                           return client.closed;
+                                       }),
+                        m_clients.end());
+    }
+}
+
+
+void ControlServer::broadcast(const std::string &line)
+{
+    for (auto &client : m_clients) {
+        send_line(client, line);
+    }
+}
+
+
+void ControlServer::send_line(Client &client, const std::string &line)
+{
+    if (client.closed) {
+        return;
+    }
+
+    const auto text = line + "\n";
+    const auto sent = ::send(client.fd, text.data(), text.length(),
+                             MSG_NOSIGNAL | MSG_DONTWAIT);
+    if ((sent < 0) || (size_t(sent) != text.length())) {
+        client.closed = true;
+    }
+}
+
+
+bool ControlServer::read_commands(Client &client,
+                                  bach_bot::PlayerService &service)
+{
+    char buffer[1024];
+    const auto received = ::recv(client.fd, buffer, sizeof(buffer), 0);
+    if (received <= 0) {
+        client.closed = client.closed ||
+                        (0 == received) || (EAGAIN != errno);
+        return false;
+    }
+
+    client.input.append(buffer, size_t(received));
+    auto line_end = client.input.find('\n');
+    while (std::string::npos != line_end) {
+        const auto line = client.input.substr(0U, line_end);
+        client.input.erase(0U, line_end + 1U);
+        if ((line == "quit") || (line == "quit\r")) {
+            send_line(client, "ok");
+            return true;
+        }
+        send_line(client, service.execute(line));
+        line_end = client.input.find('\n');
+    }
+
+    if (client.input.length() > MAX_COMMAND_LEN) {
+        send_line(client, "error command too long");
+        client.closed = true;
+    }
+    return false;
+}
+
+
+std::string default_socket_path()
+{
+    const auto *const runtime_dir = std::getenv("XDG_RUNTIME_DIR");
+    return fmt::format("{}/bachbotd.sock",
+                       (nullptr != runtime_dir) ? runtime_dir : "/tmp");
+}
+
+
+void list_ports()
+{
+    RtMidiOut midi_out;
+    const auto port_count = midi_out.getPortCount();
+    for (auto i = 0U; i < port_count; ++i) {
+        fmt::print("{}: {}\n", i, midi_out.getPortName(i));
+    }
+}
+
+}  //  end anonymous namespace
+
+
+int main(int argc, char *argv[])
+{
+    auto socket_path = default_socket_path();
+    std::vector<uint32_t> ports{0U};
+    for (auto i = 1; i < argc; ++i) {
+        const std::string option(argv[i]);
+        const auto has_value = (i + 1 < argc);
+        if ((option == "-s") && has_value) {
+            socket_path = argv[++i];
+        } else if ((option == "-p") && has_value) {
+            ports[0] = uint32_t(std::stoul(argv[++i]));
+        } else if ((option == "-m") && has_value) {
+            ports.push_back(uint32_t(std::stoul(argv[++i])));
+        } else if (option == "-l") {
+            list_ports();
+            return EXIT_SUCCESS;
+        } else {
+            std::cerr << "Usage: bachbotd [-s socket] [-p port] "
+                         "[-m monitor_port]... [-l]\n";
+            return EXIT_FAILURE;
+        }
+    }
+
+    //  wx is needed for threads and settings only; no event loop is run.
+    wxInitializer initializer;
+    if (!initializer.IsOk()) {
+        std::cerr << "bachbotd: unable to initialize wxWidgets\n";
+        return EXIT_FAILURE;
+    }
+    //  Share the GUI's settings (latency profiles)
+    wxTheApp->SetAppName(wxT("BachBot"));
+
+    static_cast<void>(std::signal(SIGPIPE, SIG_IGN));
+    static_cast<void>(std::signal(SIGINT, on_signal));
+    static_cast<void>(std::signal(SIGTERM, on_signal));
+
+    try {
+        ControlServer server(socket_path);
+        bach_bot::PlayerService service(
+            ports,
+            [&server](const std::string &line) { server.broadcast(line); },
+            [&server]() { server.wake(); });
+
+        fmt::print("bachbotd: listening on {}\n", socket_path);
+        std::fflush(stdout);
+        server.run(service);
+        service.stop();
+    } catch (const std::exception &e) {
+        std::cerr << "bachbotd: " << e.what() << "\n";
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,288 @@
+/**
+ * @file import_benchmark.cpp
+ * @brief Import throughput and memory footprint benchmark
+ * @copyright
+ * 2022 Andrew Buettner (ABi)
+ *
+ * @section LICENSE
+ *
+ * BachBot - A hymn Midi player for Schlicker organs
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @section DESCRIPTION
+ * Imports a MIDI file repeatedly through `SyndineImporter` and reports the
+ * import rate along with the heap traffic of an import and the memory kept
+ * by the compiled song.  Heap use is measured by replacing the global
+ * allocation functions, so the numbers cover everything the importer does.
+ *
+ * Usage:
+ *   import_benchmark <song.mid> [-n iterations] [-p native|smf|both]
+ *
+ * `-p both` times each parser in turn and prints the ratio of the library
+ * parser to the native one.
+ */
+
+//  system includes
+#include <algorithm>  //  std::min, std::max
+#include <atomic>  //  std::atomic
+#include <chrono>  //  std::chrono::steady_clock
+#include <cstdlib>  //  std::malloc, std::free, EXIT_SUCCESS
+#include <iostream>  //  std::cerr
+#include <memory>  //  std::make_unique
+#include <new>  //  std::bad_alloc
+#include <optional>  //  std::optional
+#include <stdexcept>  //  std::runtime_error
+#include <string>  //  std::string, std::stoul
+#include <fmt/format.h>  //  fmt::print
+
+//  module includes
+// -none-
+
+//  local includes
+#include "syndyne_importer.h"  //  SyndineImporter
+
+
+namespace {
+
+/** Allocation header, keeps the size so `delete` can account for it */
+constexpr const size_t HEADER_SIZE = alignof(std::max_align_t);
+
+std::atomic<size_t> g_allocations{0U};  ///< number of allocations
+std::atomic<size_t> g_live_bytes{0U};  ///< bytes currently allocated
+std::atomic<size_t> g_peak_bytes{0U};  ///< highest `g_live_bytes`
+
+
+/**
+ * @brief Heap statistics at a point in time
+ */
+struct HeapSnapshot
+{
+    size_t allocations;
+    size_t live_bytes;
+
+    static HeapSnapshot take()
+    {
+        return HeapSnapshot{g_allocations.load(), g_live_bytes.load()};
+    }
+};
+
+
+/**
+ * @brief Result of a single import
+ */
+struct ImportResult
+{
+    double seconds;  ///< time taken by the import
+    size_t events;  ///< compiled events
+    size_t allocations;  ///< heap allocations made by the import
+    size_t peak_bytes;  ///< peak heap use during the import
+    size_t retained_bytes;  ///< heap kept by the compiled song
+};
+
+
+/**
+ * @brief Import a song once.
+ * @param file_name MIDI file
+ * @param parser MIDI file parser to use
+ * @returns measurements
+ */
+ImportResult import_once(const std::string &file_name,
+                         const bach_bot::MidiFileParser parser)
+{
+    const auto before = HeapSnapshot::take();
+    g_peak_bytes = before.live_bytes;
+    const auto start = std::chrono::steady_clock::now();
+
+    auto importer = std::make_unique<bach_bot::SyndineImporter>(file_name, 1U,
+                                                                parser);
+    static_cast<void>(importer->get_tempo());
+    auto events = importer->get_events(1.0, 1.0);
+    importer.reset();
+
+    const auto elapsed = std::chrono::steady_clock::now() - start;
+    const auto after = HeapSnapshot::take();
+    return ImportResult{
+        std::chrono::duration<double>(elapsed).count(),
+        events.size(),
+        after.allocations - before.allocations,
+        g_peak_bytes.load() - before.live_bytes,
+        after.live_bytes - before.live_bytes};
+}
+
+
+/**
+ * @brief Repeated imports of a song through one parser
+ */
+struct BenchmarkResult
+{
+    ImportResult first;  ///< first (cold) import
+    double mean_s;  ///< mean import time after the first
+    double best_s;  ///< fastest import
+};
+
+
+/**
+ * @brief Import a song repeatedly.
+ * @param file_name MIDI file
+ * @param parser MIDI file parser to use
+ * @param iterations imports to time after the first
+ * @returns measurements
+ * @throws std::runtime_error nothing could be imported
+ */
+BenchmarkResult run_benchmark(const std::string &file_name,
+                              const bach_bot::MidiFileParser parser,
+                              const unsigned long iterations)
+{
+    //  First import warms the file cache and any lazily built tables.
+    const auto first = import_once(file_name, parser);
+    if (0U == first.events) {
+        throw std::runtime_error("no events imported");
+    }
+
+    auto total_s = 0.0;
+    auto best_s = first.seconds;
+    for (auto i = 0UL; i < iterations; ++i) {
+        const auto result = import_once(file_name, parser);
+        total_s += result.seconds;
+        best_s = std::min(best_s, result.seconds);
+    }
+    return BenchmarkResult{first, total_s / double(iterations), best_s};
+}
+
+
+/**
+ * @brief Print the measurements of one parser.
+ * @param name parser name
+ * @param result measurements
+ * @param iterations number of timed imports
+ */
+void print_result(const char *const name, const BenchmarkResult &result,
+                  const unsigned long iterations)
+{
+    const auto &first = result.first;
+    fmt::print("Parser:             {}\n", name);
+    fmt::print("Compiled events:    {}\n", first.events);
+    fmt::print("First import:       {:.3f} ms\n", first.seconds * 1000.0);
+    fmt::print("Import time:        {:.3f} ms mean, {:.3f} ms best "
+               "({} runs)\n", result.mean_s * 1000.0, result.best_s * 1000.0,
+               iterations);
+    fmt::print("Throughput:         {:.0f} events/s\n",
+               double(first.events) / result.mean_s);
+    fmt::print("Heap allocations:   {} per import ({:.2f} per event)\n",
+               first.allocations,
+               double(first.allocations) / double(first.events));
+    fmt::print("Peak heap:          {} bytes during import\n",
+               first.peak_bytes);
+    fmt::print("Song footprint:     {} bytes ({:.1f} per event)\n",
+               first.retained_bytes,
+               double(first.retained_bytes) / double(first.events));
+}
+
+}  //  end anonymous namespace
+
+
+void *operator new(size_t size)
+{
+    auto *const block = static_cast<char*>(std::malloc(size + HEADER_SIZE));
+    if (nullptr == block) {
+        throw std::bad_alloc();
+    }
+    *reinterpret_cast<size_t*>(block) = size;
+
+    ++g_allocations;
+    const auto live = (g_live_bytes += size);
+    auto peak = g_peak_bytes.load();
+    while ((live > peak) && !g_peak_bytes.compare_exchange_weak(peak, live)) {
+    }
+    return block + HEADER_SIZE;
+}
+
+
+void operator delete(void *ptr) noexcept
+{
+    if (nullptr != ptr) {
+        auto *const block = static_cast<char*>(ptr) - HEADER_SIZE;
+        g_live_bytes -= *reinterpret_cast<size_t*>(block);
+        std::free(block);
+    }
+}
+
+
+void operator delete(void *ptr, size_t size) noexcept
+{
+    static_cast<void>(size);
+    operator delete(ptr);
+}
+
+
+int main(int argc, char *argv[])
+{
+    if (argc < 2) {
+        std::cerr << "Usage: import_benchmark <song.mid> [-n iterations] "
+                     "[-p native|smf|both]\n";
+        return EXIT_FAILURE;
+    }
+
+    const std::string file_name(argv[1]);
+    auto iterations = 200UL;
+    auto run_native = true;
+    auto run_library = false;
+    for (auto i = 2; i + 1 < argc; i += 2) {
+        const std::string option(argv[i]);
+        const std::string value(argv[i + 1]);
+        if (option == "-n") {
+            iterations = std::max(1UL, std::stoul(value));
+        } else if (option == "-p") {
+            run_native = (value != "smf");
+            run_library = (value != "native");
+        }
+    }
+
+    try {
+        fmt::print("File:               {}\n", file_name);
+        std::optional<BenchmarkResult> native;
+        if (run_native) {
+            native = run_benchmark(
+                file_name, bach_bot::MidiFileParser::NATIVE_STREAM_PARSER,
+                iterations);
+            print_result("native", native.value(), iterations);
+        }
+
+        std::optional<BenchmarkResult> library;
+        if (run_library) {
+            library = run_benchmark(
+                file_name, bach_bot::MidiFileParser::SMF_LIBRARY_PARSER,
+                iterations);
+            print_result("smf", library.value(), iterations);
+        }
+
+        if (native.has_value() && library.has_value()) {
+            const auto &n = native.value();
+            const auto &l = library.value();
+            fmt::print("Library / native:   time x{:.2f} (first x{:.2f}), "
+                       "allocations x{:.2f}, peak heap x{:.2f}\n",
+                       l.mean_s / n.mean_s, l.first.seconds / n.first.seconds,
+                       double(l.first.allocations) /
+                           double(std::max<size_t>(n.first.allocations, 1U)),
+                       double(l.first.peak_bytes) /
+                           double(std::max<size_t>(n.first.peak_bytes, 1U)));
+        }
+    } catch (const std::exception &e) {
+        std::cerr << "Import failed: " << e.what() << "\n";
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,514 @@
+/**
+ * @file trace_analyzer.cpp
+ * @brief Offline analyzer for BachBot playback traces
+ * @copyright
+ * 2022 Andrew Buettner (ABi)
+ *
+ * @section LICENSE
+ *
+ * BachBot - A hymn Midi player for Schlicker organs
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @section DESCRIPTION
+ * Reads a playback trace (`.bbt`) and prints lateness statistics, tick
+ * jitter, bank change spacing, the player warm-up, each song's first note
+ * against the rest of the song and the worst bursts of late events.
+ * Optionally writes every MIDI event to a CSV file and a lateness plot to an
+ * SVG file.
+ *
+ * Usage:
+ *   trace_analyzer <trace.bbt> [-c out.csv] [-s out.svg] [-t late_ms]
+ *                  [-w window_ms] [-n bursts]
+ */
+
+//  system includes
+#include <algorithm>  //  std::sort, std::max
+#include <cstdint>  //  intXX_t, uintXX_t
+#include <cstdlib>  //  EXIT_SUCCESS, std::stod
+#include <cstring>  //  std::memcmp
+#include <fstream>  //  std::ifstream, std::ofstream
+#include <iostream>  //  std::cerr
+#include <optional>  //  std::optional
+#include <stdexcept>  //  std::runtime_error
+#include <string>  //  std::string
+#include <vector>  //  std::vector
+#include <fmt/format.h>  //  fmt::format, fmt::print
+
+//  module includes
+// -none-
+
+//  local includes
+#include "trace_format.h"  //  TraceRecord, TraceFileHeader
+
+
+namespace {
+
+using namespace bach_bot;
+
+/** Tick intervals above this are considered late (2 timer periods) */
+constexpr const auto LATE_TICK_US = 2000U;
+
+/**
+ * @brief Command line options
+ */
+struct Options
+{
+    std::string trace_file;
+    std::optional<std::string> csv_file;
+    std::optional<std::string> svg_file;
+    double late_ms = 5.0;  ///< lateness considered "late"
+    double window_ms = 1000.0;  ///< burst window length
+    size_t burst_count = 5U;  ///< number of bursts to report
+};
+
+
+/**
+ * @brief MIDI event with its time on the whole-trace timeline
+ */
+struct TimedEvent
+{
+    double time_ms;  ///< time since the start of the trace
+    double lateness_ms;  ///< actual - scheduled
+    const TraceRecord *record;
+};
+
+
+/**
+ * @brief Lateness of one song, as played
+ */
+struct SongStats
+{
+    uint32_t song_id;
+    std::vector<double> lateness_ms;  ///< MIDI events in the order sent
+};
+
+
+/**
+ * @brief Window of late events
+ */
+struct Burst
+{
+    double start_ms;
+    double end_ms;
+    size_t late_events;
+    double worst_ms;
+    uint32_t song_id;
+};
+
+
+Options parse_options(const int argc, const char *const argv[])
+{
+    Options options;
+    for (auto i = 1; i < argc; ++i) {
+        const std::string arg(argv[i]);
+        const auto has_value = (i + 1 < argc);
+        if (("-c" == arg) && has_value) {
+            options.csv_file = argv[++i];
+        } else if (("-s" == arg) && has_value) {
+            options.svg_file = argv[++i];
+        } else if (("-t" == arg) && has_value) {
+            options.late_ms = std::stod(argv[++i]);
+        } else if (("-w" == arg) && has_value) {
+            options.window_ms = std::stod(argv[++i]);
+        } else if (("-n" == arg) && has_value) {
+            options.burst_count = size_t(std::stoul(argv[++i]));
+        } else if (options.trace_file.empty() && ('-' != arg[0])) {
+            options.trace_file = arg;
+        } else {
+            throw std::runtime_error(fmt::format("Unknown argument \"{}\"",
+                                                 arg));
+        }
+    }
+
+    if (options.trace_file.empty()) {
+        throw std::runtime_error(
+            "usage: trace_analyzer <trace.bbt> [-c out.csv] [-s out.svg] "
+            "[-t late_ms] [-w window_ms] [-n bursts]");
+    }
+    return options;
+}
+
+
+std::vector<TraceRecord> read_trace(const std::string &file_name)
+{
+    std::ifstream input(file_name, std::ios::binary);
+    if (!input) {
+        throw std::runtime_error(fmt::format("Unable to open \"{}\"",
+                                             file_name));
+    }
+
+    TraceFileHeader header{};
+    input.read(reinterpret_cast<char*>(&header), sizeof(header));
+    if (!input ||
+        (0 != std::memcmp(header.magic, TRACE_FILE_MAGIC,
+                          sizeof(header.magic)))) {
+        throw std::runtime_error("Not a BachBot playback trace");
+    }
+    if ((TRACE_FILE_VERSION != header.version) ||
+        (sizeof(TraceRecord) != header.record_size)) {
+        throw std::runtime_error(fmt::format(
+            "Unsupported trace version {} (record size {})", header.version,
+            header.record_size));
+    }
+
+    std::vector<TraceRecord> records;
+    TraceRecord record{};
+    while (input.read(reinterpret_cast<char*>(&record), sizeof(record))) {
+        records.push_back(record);
+    }
+    return records;
+}
+
+
+double percentile(const std::vector<double> &sorted, const double fraction)
+{
+    if (sorted.empty()) {
+        return 0.0;
+    }
+    const auto index = size_t(fraction * double(sorted.size() - 1U) + 0.5);
+    return sorted[std::min(index, sorted.size() - 1U)];
+}
+
+
+std::string format_time(const double time_ms)
+{
+    const auto ms = int64_t(time_ms + 0.5);
+    return fmt::format("{:02}:{:02}:{:02}.{:03}", ms / 3600000,
+                       (ms / 60000) % 60, (ms / 1000) % 60, ms % 1000);
+}
+
+
+/**
+ * @brief Find the worst non-overlapping windows of late events.
+ */
+std::vector<Burst> find_bursts(const std::vector<TimedEvent> &events,
+                               const Options &options)
+{
+    std::vector<Burst> candidates;
+    auto window_end = 0U;
+    for (auto start = 0U; start < events.size(); ++start) {
+        if (events[start].lateness_ms < options.late_ms) {
+            continue;
+        }
+
+        window_end = std::max(window_end, start);
+        while ((window_end + 1U < events.size()) &&
+               (events[window_end + 1U].time_ms <
+                    events[start].time_ms + options.window_ms)) {
+            ++window_end;
+        }
+
+        Burst burst{events[start].time_ms, events[window_end].time_ms, 0U,
+                    0.0, events[start].record->song_id};
+        for (auto i = start; i <= window_end; ++i) {
+            if (events[i].lateness_ms >= options.late_ms) {
+                ++burst.late_events;
+                burst.worst_ms = std::max(burst.worst_ms,
+                                          events[i].lateness_ms);
+            }
+        }
+        candidates.push_back(burst);
+    }
+
+    std::sort(candidates.begin(), candidates.end(),
+              [](const Burst &lhs, const Burst &rhs) {
+                  return (lhs.late_events != rhs.late_events) ?
+                      (lhs.late_events > rhs.late_events) :
+                      (lhs.worst_ms > rhs.worst_ms);
+              });
+
+    std::vector<Burst> bursts;
+    for (const auto &candidate : candidates) {
+        if (bursts.size() >= options.burst_count) {
+            break;
+        }
+        const auto overlaps = std::any_of(
+            bursts.begin(), bursts.end(), [&](const Burst &burst) {
+                return (candidate.start_ms <= burst.end_ms) &&
+                       (burst.start_ms <= candidate.end_ms);
+            });
+        if (!overlaps) {
+            bursts.push_back(candidate);
+        }
+    }
+    return bursts;
+}
+
+
+/**
+ * @brief Print the first note of each song against the rest of the song.
+ * @note A cold start shows up as a first note later than the song's median.
+ */
+void print_song_stats(const std::vector<SongStats> &songs)
+{
+    fmt::print("\nPer song lateness (ms):\n"
+               "  song  events     first  rest p50  rest max\n");
+    for (const auto &song : songs) {
+        if (song.lateness_ms.empty()) {
+            continue;
+        }
+
+        std::vector<double> rest(song.lateness_ms.begin() + 1,
+                                 song.lateness_ms.end());
+        std::sort(rest.begin(), rest.end());
+        fmt::print("  {:>4}  {:>6}  {:>8.3f}  {:>8}  {:>8}\n", song.song_id,
+                   song.lateness_ms.size(), song.lateness_ms.front(),
+                   rest.empty() ? std::string("n/a") :
+                       fmt::format("{:.3f}", percentile(rest, 0.50)),
+                   rest.empty() ? std::string("n/a") :
+                       fmt::format("{:.3f}", rest.back()));
+    }
+}
+
+
+void write_csv(const std::string &file_name,
+               const std::vector<TimedEvent> &events)
+{
+    std::ofstream output(file_name, std::ios::trunc);
+    if (!output) {
+        throw std::runtime_error(fmt::format("Unable to create \"{}\"",
+                                             file_name));
+    }
+
+    output << "time_ms,song_id,scheduled_ms,actual_ms,lateness_ms,"
+              "status,data1,data2,queue_depth,memory,mode\n";
+    for (const auto &event : events) {
+        const auto &record = *event.record;
+        output << fmt::format(
+            "{:.3f},{},{:.3f},{:.3f},{:.3f},0x{:02X},{},{},{},{},{}\n",
+            event.time_ms, record.song_id,
+            double(record.scheduled_us) / 1000.0,
+            double(record.actual_us) / 1000.0, event.lateness_ms,
+            record.data[0], record.data[1], record.data[2],
+            record.queue_depth, record.memory, record.mode);
+    }
+}
+
+
+void write_svg(const std::string &file_name,
+               const std::vector<TimedEvent> &events,
+               const std::vector<double> &late_ticks_ms,
+               const Options &options)
+{
+    constexpr const auto WIDTH = 1200.0;
+    constexpr const auto HEIGHT = 400.0;
+    constexpr const auto MARGIN = 50.0;
+
+    std::ofstream output(file_name, std::ios::trunc);
+    if (!output) {
+        throw std::runtime_error(fmt::format("Unable to create \"{}\"",
+                                             file_name));
+    }
+
+    auto max_time = 1.0;
+    auto max_late = options.late_ms * 2.0;
+    auto min_late = 0.0;
+    for (const auto &event : events) {
+        max_time = std::max(max_time, event.time_ms);
+        max_late = std::max(max_late, event.lateness_ms);
+        min_late = std::min(min_late, event.lateness_ms);
+    }
+    max_late = std::max(max_late, min_late + 1.0);
+
+    const auto plot_w = WIDTH - 2.0 * MARGIN;
+    const auto plot_h = HEIGHT - 2.0 * MARGIN;
+    const auto x = [&](const double time_ms) {
+        return MARGIN + time_ms / max_time * plot_w;
+    };
+    const auto y = [&](const double late_ms) {
+        return HEIGHT - MARGIN -
+            (late_ms - min_late) / (max_late - min_late) * plot_h;
+    };
+
+    output << fmt::format(
+        "<svg xmlns=\"http://www.w3.org/2000/svg\" width=\"{}\" "
+        "height=\"{}\" font-family=\"sans-serif\" font-size=\"12\">\n"
+        "<rect width=\"100%\" height=\"100%\" fill=\"white\"/>\n",
+        WIDTH, HEIGHT);
+
+    //  Axes, zero line and "late" threshold
+    output << fmt::format(
+        "<line x1=\"{0}\" y1=\"{1}\" x2=\"{0}\" y2=\"{2}\" "
+        "stroke=\"black\"/>\n"
+        "<line x1=\"{0}\" y1=\"{2}\" x2=\"{3}\" y2=\"{2}\" "
+        "stroke=\"black\"/>\n",
+        MARGIN, MARGIN, HEIGHT - MARGIN, WIDTH - MARGIN);
+    output << fmt::format(
+        "<line x1=\"{0}\" y1=\"{1:.1f}\" x2=\"{2}\" y2=\"{1:.1f}\" "
+        "stroke=\"grey\"/>\n"
+        "<line x1=\"{0}\" y1=\"{3:.1f}\" x2=\"{2}\" y2=\"{3:.1f}\" "
+        "stroke=\"orange\" stroke-dasharray=\"4\"/>\n",
+        MARGIN, y(0.0), WIDTH - MARGIN, y(options.late_ms));
+    output << fmt::format(
+        "<text x=\"{}\" y=\"{}\">lateness (ms) vs time, {:.1f} .. {:.1f} ms"
+        ", duration {}</text>\n",
+        MARGIN, MARGIN - 20.0, min_late, max_late, format_time(max_time));
+
+    for (const auto &tick_ms : late_ticks_ms) {
+        output << fmt::format(
+            "<line x1=\"{0:.1f}\" y1=\"{1}\" x2=\"{0:.1f}\" y2=\"{2}\" "
+            "stroke=\"lightblue\"/>\n",
+            x(tick_ms), MARGIN, HEIGHT - MARGIN);
+    }
+
+    for (const auto &event : events) {
+        const auto late = event.lateness_ms >= options.late_ms;
+        output << fmt::format(
+            "<circle cx=\"{:.1f}\" cy=\"{:.1f}\" r=\"{}\" fill=\"{}\"/>\n",
+            x(event.time_ms), y(event.lateness_ms), late ? 2 : 1,
+            late ? "red" : "green");
+    }
+    output << "</svg>\n";
+}
+
+
+int analyze(const Options &options)
+{
+    const auto records = read_trace(options.trace_file);
+
+    std::vector<TimedEvent> events;
+    std::vector<double> late_ticks_ms;
+    std::vector<double> bank_times_ms;
+    std::vector<SongStats> songs;
+    std::vector<const TraceRecord *> warm_ups;
+    size_t dropped = 0U;
+    uint32_t worst_tick_us = 0U;
+    auto base_ms = 0.0;  ///< timeline position of the current song start
+    auto last_ms = 0.0;
+
+    for (const auto &record : records) {
+        const auto song_ms = double(record.actual_us) / 1000.0;
+        auto time_ms = base_ms + song_ms;
+        switch (record.type) {
+        case TraceRecordType::TRACE_SONG_START:
+            songs.push_back({record.song_id, {}});
+            base_ms = last_ms;
+            time_ms = base_ms;
+            break;
+
+        case TraceRecordType::TRACE_MIDI_EVENT:
+            events.push_back({time_ms, double(record.actual_us -
+                                              record.scheduled_us) / 1000.0,
+                              &record});
+            if (!songs.empty()) {
+                songs.back().lateness_ms.push_back(events.back().lateness_ms);
+            }
+            break;
+
+        case TraceRecordType::TRACE_BANK_CHANGE:
+            bank_times_ms.push_back(time_ms);
+            break;
+
+        case TraceRecordType::TRACE_TICK:
+            worst_tick_us = std::max(worst_tick_us, record.tick_interval_us);
+            if (record.tick_interval_us > LATE_TICK_US) {
+                late_ticks_ms.push_back(time_ms);
+            }
+            break;
+
+        case TraceRecordType::TRACE_DROPPED:
+            dropped += record.queue_depth;
+            break;
+
+        case TraceRecordType::TRACE_WARM_UP:
+            //  Before the song timeline starts
+            warm_ups.push_back(&record);
+            time_ms = base_ms;
+            break;
+
+        default:
+            break;
+        }
+        last_ms = std::max(last_ms, time_ms);
+    }
+
+    std::vector<double> lateness;
+    lateness.reserve(events.size());
+    auto sum = 0.0;
+    auto late_count = 0U;
+    for (const auto &event : events) {
+        lateness.push_back(event.lateness_ms);
+        sum += event.lateness_ms;
+        if (event.lateness_ms >= options.late_ms) {
+            ++late_count;
+        }
+    }
+    std::sort(lateness.begin(), lateness.end());
+
+    std::optional<double> min_bank_spacing;
+    for (auto i = 1U; i < bank_times_ms.size(); ++i) {
+        const auto spacing = bank_times_ms[i] - bank_times_ms[i - 1U];
+        if ((spacing > 0.0) &&
+            (!min_bank_spacing.has_value() || (spacing < *min_bank_spacing))) {
+            min_bank_spacing = spacing;
+        }
+    }
+
+    fmt::print("Trace: {}\n", options.trace_file);
+    fmt::print("Duration: {}  songs: {}  records: {}  dropped: {}\n",
+               format_time(last_ms), songs.size(), records.size(), dropped);
+    fmt::print("MIDI events: {}  late (>= {:.1f} ms): {}\n", events.size(),
+               options.late_ms, late_count);
+    if (!lateness.empty()) {
+        fmt::print("Lateness (ms): min {:.3f}  mean {:.3f}  p50 {:.3f}  "
+                   "p95 {:.3f}  p99 {:.3f}  max {:.3f}\n",
+                   lateness.front(), sum / double(lateness.size()),
+                   percentile(lateness, 0.50), percentile(lateness, 0.95),
+                   percentile(lateness, 0.99), lateness.back());
+    }
+    fmt::print("Timer: worst tick interval {:.3f} ms, {} late tick record(s)"
+               "\n", double(worst_tick_us) / 1000.0, late_ticks_ms.size());
+    fmt::print("Bank changes: {}  minimum spacing: {}\n", bank_times_ms.size(),
+               min_bank_spacing.has_value() ?
+                   fmt::format("{:.1f} ms", *min_bank_spacing) :
+                   std::string("n/a"));
+    for (const auto *const warm_up : warm_ups) {
+        fmt::print("Warm-up: {:.3f} ms ({} timer ticks)\n",
+                   double(warm_up->actual_us) / 1000.0, warm_up->queue_depth);
+    }
+    print_song_stats(songs);
+
+    const auto bursts = find_bursts(events, options);
+    if (!bursts.empty()) {
+        fmt::print("\nWorst bursts ({:.0f} ms windows):\n", options.window_ms);
+        for (const auto &burst : bursts) {
+            fmt::print("  {} - {}  song {}  late events: {}  worst: "
+                       "{:.3f} ms\n", format_time(burst.start_ms),
+                       format_time(burst.end_ms), burst.song_id,
+                       burst.late_events, burst.worst_ms);
+        }
+    }
+
+    if (options.csv_file.has_value()) {
+        write_csv(*options.csv_file, events);
+    }
+    if (options.svg_file.has_value()) {
+        write_svg(*options.svg_file, events, late_ticks_ms, options);
+    }
+    return EXIT_SUCCESS;
+}
+
+}  //  end anonymous namespace
+
+
+int main(int argc, char *argv[])
+{
+    try {
+        return analyze(parse_options(argc, argv));
+    } catch (const std::exception &e) {
+        std::cerr << e.what() << std::endl;
+        return EXIT_FAILURE;
+    }
+}
@@ -0,0 +1,484 @@
+/**
+ * @file tracker_stress.cpp
+ * @brief Pathological input stress harness for MidiNoteTracker
+ * @copyright
+ * 2022 Andrew Buettner (ABi)
+ *
+ * @section LICENSE
+ *
+ * BachBot - A hymn Midi player for Schlicker organs
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @section DESCRIPTION
+ * Feeds a single `MidiNoteTracker` (one key of one keyboard) with generated
+ * inputs modelled on badly sequenced volunteer files: many channels merged
+ * onto the same key, stacks of simultaneous note-ons, staggered overlaps,
+ * rapid restrikes and unbalanced on/off counts.  Every scenario is run with
+ * randomized seeds and the output is checked for:
+ *   - note-on / note-off pairs that are linked to each other
+ *   - non-decreasing time
+ *   - notes at least `MINIMUM_NOTE_LENGTH_S` long
+ *   - gaps of at least `MINIMUM_NOTE_GAP_S` between notes
+ *
+ * Each scenario is also timed at two input sizes; a per-event cost that
+ * grows with the input (ie worse than linear) is reported as a failure.
+ * The exit status is non-zero if any check fails.
+ *
+ * Usage:
+ *   tracker_stress [-n notes] [-r rounds] [-s seed] [-g max_growth]
+ */
+
+//  system includes
+#include <algorithm>  //  std::min, std::max, std::stable_sort, std::shuffle
+#include <chrono>  //  std::chrono::steady_clock
+#include <cstdlib>  //  EXIT_SUCCESS, EXIT_FAILURE
+#include <functional>  //  std::function
+#include <iostream>  //  std::cerr
+#include <random>  //  std::mt19937
+#include <string>  //  std::string, std::stoul
+#include <vector>  //  std::vector
+#include <fmt/format.h>  //  fmt::print
+
+//  module includes
+// -none-
+
+//  local includes
+#include "midi_note_tracker.h"  //  MidiNoteTracker
+#include "event_pool.h"  //  EventPool
+
+
+namespace {
+
+using namespace bach_bot;
+
+/** MIDI ticks per quarter note of the generated songs */
+constexpr const auto TICKS_PER_QUARTER = 480;
+
+/** Seconds per tick at 120 BPM */
+constexpr const auto SECONDS_PER_TICK = 0.5 / double(TICKS_PER_QUARTER);
+
+/** Key used for every generated event */
+constexpr const uint8_t STRESS_NOTE = 60U;
+
+/** Allowance for floating point error in the time checks (seconds) */
+constexpr const auto TIME_EPSILON_S = 1e-9;
+
+/** Number of failures printed per scenario before going quiet */
+constexpr const auto MAX_REPORTED_FAILURES = 5U;
+
+using Generator = std::function<std::vector<SmfEvent>(std::mt19937 &,
+                                                      const size_t)>;
+
+/**
+ * @brief Named input generator
+ */
+struct Scenario
+{
+    const char *name;
+    Generator generate;  ///< (random source, note count) -> events
+};
+
+
+/**
+ * @brief Result of feeding one input through a tracker
+ */
+struct TrackerRun
+{
+    size_t events_in;  ///< note events fed to the tracker
+    size_t pairs_out;  ///< note pairs appended
+    size_t pool_size;  ///< events created in the pool
+    double seconds;  ///< time taken by `add_event` + `append_events`
+    std::vector<std::string> failures;  ///< invariant violations
+};
+
+
+SmfEvent make_note(const int tick, const int channel, const bool on)
+{
+    return SmfEvent{tick, double(tick) * SECONDS_PER_TICK,
+                    make_midi_command_byte(uint8_t(channel),
+                                           on ? MidiCommands::NOTE_ON :
+                                                MidiCommands::NOTE_OFF),
+                    STRESS_NOTE, uint8_t(on ? 100U : 0U), 3U};
+}
+
+
+/**
+ * @brief Put events in time order, shuffling events at the same tick.
+ * @note The SMF reader merges tracks by time only, so the order of
+ *       simultaneous events across channels is arbitrary.
+ */
+void merge_tracks(std::vector<SmfEvent> &events, std::mt19937 &random)
+{
+    std::shuffle(events.begin(), events.end(), random);
+    std::stable_sort(events.begin(), events.end(),
+                     [](const SmfEvent &lhs, const SmfEvent &rhs) {
+        return lhs.tick < rhs.tick;
+    });
+}
+
+
+/**
+ * @brief Sixteen channels playing random notes on the same key.
+ */
+std::vector<SmfEvent> random_overlap(std::mt19937 &random,
+                                     const size_t notes)
+{
+    std::uniform_int_distribution<int> channel(0, 15);
+    std::uniform_int_distribution<int> start(0, TICKS_PER_QUARTER / 2);
+    std::uniform_int_distribution<int> length(1, 2 * TICKS_PER_QUARTER);
+    std::vector<SmfEvent> events;
+    events.reserve(2U * notes);
+    auto tick = 0;
+    for (size_t i = 0U; i < notes; ++i) {
+        tick += start(random);
+        const auto chan = channel(random);
+        events.push_back(make_note(tick, chan, true));
+        events.push_back(make_note(tick + length(random), chan, false));
+    }
+    merge_tracks(events, random);
+    return events;
+}
+
+
+/**
+ * @brief Stacks of up to 64 simultaneous note-ons, released together.
+ */
+std::vector<SmfEvent> unison_stack(std::mt19937 &random, const size_t notes)
+{
+    std::uniform_int_distribution<size_t> depth(2U, 64U);
+    std::uniform_int_distribution<int> length(1, TICKS_PER_QUARTER);
+    std::vector<SmfEvent> events;
+    events.reserve(2U * notes);
+    auto tick = 0;
+    for (size_t i = 0U; i < notes;) {
+        const auto stack = std::min(depth(random), notes - i);
+        const auto off_tick = tick + length(random);
+        for (size_t j = 0U; j < stack; ++j) {
+            events.push_back(make_note(tick, int(j % 16U), true));
+            events.push_back(make_note(off_tick, int(j % 16U), false));
+        }
+        i += stack;
+        tick = off_tick + length(random) / 8;
+    }
+    merge_tracks(events, random);
+    return events;
+}
+
+
+/**
+ * @brief Overlapping notes a tick or two apart, released first-in-first-out
+ *        or last-in-first-out.
+ */
+std::vector<SmfEvent> staggered_stack(std::mt19937 &random,
+                                      const size_t notes)
+{
+    std::uniform_int_distribution<size_t> depth(2U, 128U);
+    std::uniform_int_distribution<int> spacing(0, 3);
+    std::uniform_int_distribution<int> length(1, TICKS_PER_QUARTER);
+    std::bernoulli_distribution reverse(0.5);
+    std::vector<SmfEvent> events;
+    events.reserve(2U * notes);
+    auto tick = 0;
+    for (size_t i = 0U; i < notes;) {
+        const auto stack = std::min(depth(random), notes - i);
+        std::vector<int> on_ticks;
+        for (size_t j = 0U; j < stack; ++j) {
+            tick += spacing(random);
+            on_ticks.push_back(tick);
+        }
+        auto off_tick = tick + length(random);
+        if (reverse(random)) {
+            std::reverse(on_ticks.begin(), on_ticks.end());
+        }
+        for (size_t j = 0U; j < stack; ++j) {
+            const auto chan = int(j % 16U);
+            events.push_back(make_note(on_ticks[j], chan, true));
+            off_tick += spacing(random);
+            events.push_back(make_note(off_tick, chan, false));
+        }
+        i += stack;
+        tick = off_tick + 1;
+    }
+    merge_tracks(events, random);
+    return events;
+}
+
+
+/**
+ * @brief Very short notes with little or no gap between them.
+ */
+std::vector<SmfEvent> rapid_restrike(std::mt19937 &random,
+                                     const size_t notes)
+{
+    std::uniform_int_distribution<int> length(0, 48);
+    std::uniform_int_distribution<int> gap(0, 2);
+    std::uniform_int_distribution<int> channel(0, 3);
+    std::vector<SmfEvent> events;
+    events.reserve(2U * notes);
+    auto tick = 0;
+    for (size_t i = 0U; i < notes; ++i) {
+        const auto chan = channel(random);
+        events.push_back(make_note(tick, chan, true));
+        tick += length(random);
+        events.push_back(make_note(tick, chan, false));
+        tick += gap(random);
+    }
+    merge_tracks(events, random);
+    return events;
+}
+
+
+/**
+ * @brief Random note-ons and note-offs with no pairing at all (stray
+ *        note-offs, notes that are never released).
+ */
+std::vector<SmfEvent> unbalanced(std::mt19937 &random, const size_t notes)
+{
+    std::uniform_int_distribution<int> step(0, TICKS_PER_QUARTER / 4);
+    std::uniform_int_distribution<int> channel(0, 15);
+    std::bernoulli_distribution note_on(0.5);
+    std::vector<SmfEvent> events;
+    events.reserve(2U * notes);
+    auto tick = 0;
+    for (size_t i = 0U; i < 2U * notes; ++i) {
+        tick += step(random);
+        events.push_back(make_note(tick, channel(random), note_on(random)));
+    }
+    return events;
+}
+
+
+/**
+ * @brief Check the output of a tracker.
+ * @param pool event storage
+ * @param output appended events
+ * @param[out] failures description of each violation found
+ */
+void check_invariants(const EventPool &pool,
+                      const std::vector<EventIndex> &output,
+                      std::vector<std::string> &failures)
+{
+    if (0U != (output.size() % 2U)) {
+        failures.push_back(fmt::format("odd output size {}", output.size()));
+        return;
+    }
+
+    auto last_off_seconds = -1.0;
+    for (size_t i = 0U; i < output.size(); i += 2U) {
+        const auto &note_on = pool[output[i]];
+        const auto &note_off = pool[output[i + 1U]];
+        const auto on_command = (note_on.m_event_code >> 4U);
+        const auto off_command = (note_off.m_event_code >> 4U);
+        if ((MidiCommands::NOTE_ON != on_command) ||
+                (note_on.m_byte2.value_or(0U) == 0U)) {
+            failures.push_back(fmt::format("pair {}: not a note-on", i / 2U));
+        }
+        if ((MidiCommands::NOTE_OFF != off_command) &&
+                (note_off.m_byte2.value_or(0U) != 0U)) {
+            failures.push_back(fmt::format("pair {}: not a note-off",
+                                           i / 2U));
+        }
+        if ((note_on.m_partner != output[i + 1U]) ||
+                (note_off.m_partner != output[i])) {
+            failures.push_back(fmt::format("pair {}: not linked", i / 2U));
+        }
+        if ((note_on.m_seconds + TIME_EPSILON_S < last_off_seconds) ||
+                (note_off.m_seconds + TIME_EPSILON_S < note_on.m_seconds)) {
+            failures.push_back(fmt::format("pair {}: time goes backwards "
+                                           "({:.6f} s)", i / 2U,
+                                           note_on.m_seconds));
+        }
+        if (note_off.m_seconds - note_on.m_seconds <
+                MINIMUM_NOTE_LENGTH_S - TIME_EPSILON_S) {
+            failures.push_back(fmt::format("pair {}: note only {:.1f} ms",
+                                           i / 2U, 1000.0 *
+                                           (note_off.m_seconds -
+                                            note_on.m_seconds)));
+        }
+        if ((last_off_seconds >= 0.0) &&
+                (note_on.m_seconds - last_off_seconds <
+                 MINIMUM_NOTE_GAP_S - TIME_EPSILON_S)) {
+            failures.push_back(fmt::format("pair {}: gap only {:.1f} ms",
+                                           i / 2U, 1000.0 *
+                                           (note_on.m_seconds -
+                                            last_off_seconds)));
+        }
+        last_off_seconds = note_off.m_seconds;
+    }
+}
+
+
+/**
+ * @brief Feed events through a new tracker.
+ * @param events input events
+ * @param pool event storage (cleared first)
+ * @param output appended events (cleared first)
+ * @note The storage is reused between rounds so that the timing is of the
+ *       tracker rather than of the allocator returning memory to the OS.
+ */
+TrackerRun run_tracker(const std::vector<SmfEvent> &events, EventPool &pool,
+                       std::vector<EventIndex> &output)
+{
+    pool.clear();
+    output.clear();
+    MidiNoteTracker tracker;
+    tracker.set_keyboard(SyndyneKeyboards::MANUAL1_GREAT);
+
+    const auto start = std::chrono::steady_clock::now();
+    for (const auto &event: events) {
+        tracker.add_event(event, pool);
+    }
+    tracker.append_events(pool, output);
+    const auto elapsed = std::chrono::steady_clock::now() - start;
+
+    TrackerRun run{events.size(), output.size() / 2U, pool.size(),
+                   std::chrono::duration<double>(elapsed).count(), {}};
+    check_invariants(pool, output, run.failures);
+    return run;
+}
+
+
+/**
+ * @brief Totals of one scenario at one input size
+ */
+struct ScenarioStats
+{
+    size_t events_in = 0U;
+    size_t pairs_out = 0U;
+    size_t max_pool = 0U;
+    double median_ns_per_event = 0.0;
+    double worst_ns_per_event = 0.0;  ///< slowest round
+    size_t failed_rounds = 0U;
+};
+
+
+ScenarioStats run_scenario(const Scenario &scenario, const size_t notes,
+                           const size_t rounds, const uint32_t seed)
+{
+    ScenarioStats stats;
+    EventPool pool;
+    std::vector<EventIndex> output;
+    std::vector<double> ns_per_event;
+    auto reported = 0U;
+
+    //  Untimed warm-up sizes the pool for the timed rounds.
+    {
+        std::mt19937 random(seed);
+        static_cast<void>(run_tracker(scenario.generate(random, notes), pool,
+                                      output));
+    }
+    for (size_t round = 0U; round < rounds; ++round) {
+        std::mt19937 random(seed + uint32_t(round));
+        const auto events = scenario.generate(random, notes);
+        const auto run = run_tracker(events, pool, output);
+        ns_per_event.push_back(1e9 * run.seconds /
+                               double(std::max<size_t>(1U, run.events_in)));
+
+        stats.events_in += run.events_in;
+        stats.pairs_out += run.pairs_out;
+        stats.max_pool = std::max(stats.max_pool, run.pool_size);
+        stats.worst_ns_per_event = std::max(stats.worst_ns_per_event,
+                                            ns_per_event.back());
+        if (!run.failures.empty()) {
+            ++stats.failed_rounds;
+            for (const auto &failure: run.failures) {
+                if (reported++ < MAX_REPORTED_FAILURES) {
+                    fmt::print("  FAIL {} seed {}: {}\n", scenario.name,
+                               seed + uint32_t(round), failure);
+                }
+            }
+        }
+    }
+
+    std::nth_element(ns_per_event.begin(),
+                     ns_per_event.begin() + ptrdiff_t(rounds / 2U),
+                     ns_per_event.end());
+    stats.median_ns_per_event = ns_per_event[rounds / 2U];
+    return stats;
+}
+
+}  //  end anonymous namespace
+
+
+int main(int argc, char *argv[])
+{
+    auto notes = size_t(2000U);
+    auto rounds = size_t(50U);
+    auto seed = uint32_t(1U);
+    auto max_growth = 4.0;
+    for (auto i = 1; i + 1 < argc; i += 2) {
+        const std::string option(argv[i]);
+        const std::string value(argv[i + 1]);
+        if (option == "-n") {
+            notes = std::max<size_t>(16U, std::stoul(value));
+        } else if (option == "-r") {
+            rounds = std::max<size_t>(1U, std::stoul(value));
+        } else if (option == "-s") {
+            seed = uint32_t(std::stoul(value));
+        } else if (option == "-g") {
+            max_growth = std::stod(value);
+        } else {
+            std::cerr << "Usage: tracker_stress [-n notes] [-r rounds] "
+                         "[-s seed] [-g max_growth]\n";
+            return EXIT_FAILURE;
+        }
+    }
+
+    const std::vector<Scenario> scenarios{
+        {"random_overlap", random_overlap},
+        {"unison_stack", unison_stack},
+        {"staggered_stack", staggered_stack},
+        {"rapid_restrike", rapid_restrike},
+        {"unbalanced", unbalanced}};
+
+    //  The large runs check that the cost per event doesn't grow with the
+    // input size; fewer rounds keep the run time reasonable.  Some growth is
+    // expected as the pool outgrows the cache, quadratic behaviour shows as
+    // growth near `SCALE`.
+    constexpr const auto SCALE = size_t(8U);
+    auto failed = false;
+    fmt::print("{:<16} {:>9} {:>9} {:>9} {:>9} {:>9} {:>7}\n", "scenario",
+               "events", "pairs", "max pool", "median ns", "worst ns",
+               "growth");
+    for (const auto &scenario: scenarios) {
+        const auto small = run_scenario(scenario, notes, rounds, seed);
+        const auto large = run_scenario(scenario, SCALE * notes,
+                                        std::max<size_t>(3U, rounds / SCALE),
+                                        seed);
+        const auto growth = large.median_ns_per_event /
+                            std::max(small.median_ns_per_event, 1e-3);
+        fmt::print("{:<16} {:>9} {:>9} {:>9} {:>9.1f} {:>9.1f} {:>6.2f}x\n",
+                   scenario.name, small.events_in, small.pairs_out,
+                   large.max_pool, small.median_ns_per_event,
+                   std::max(small.worst_ns_per_event,
+                            large.worst_ns_per_event),
+                   growth);
+
+        if ((small.failed_rounds + large.failed_rounds) > 0U) {
+            fmt::print("  {}: invariant failures in {} round(s)\n",
+                       scenario.name,
+                       small.failed_rounds + large.failed_rounds);
+            failed = true;
+        }
+        if (growth > max_growth) {
+            fmt::print("  {}: cost per event grew {:.2f}x with {}x the "
+                       "input (limit {:.2f}x)\n", scenario.name, growth,
+                       SCALE, max_growth);
+            failed = true;
+        }
+    }
+
+    return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}